@@ -0,0 +1,190 @@
+// Hands a buffer back and forth between the default queue and the async compute queue and checks its contents
+// after every step. The device asks for the graphics family fallback, so on a device with a single queue family
+// (e.g. Lavapipe) the async queue shares the family and the cross queue waits are exercised without ownership transfers.
+#include <wgvk.h>
+#include <stdio.h>
+#include <string.h>
+#ifndef STRVIEW
+    #define STRVIEW(X) (WGPUStringView){X, sizeof(X) - 1}
+#endif
+
+#define BUFFER_SIZE 256
+
+void adapterCallbackFunction(
+        enum WGPURequestAdapterStatus status,
+        WGPUAdapter adapter,
+        struct WGPUStringView label,
+        void* userdata1,
+        void* userdata2
+    ){
+    *((WGPUAdapter*)userdata1) = adapter;
+}
+void deviceCallbackFunction(
+        WGPURequestDeviceStatus status,
+        WGPUDevice device,
+        WGPUStringView message,
+        void* userdata1,
+        void* userdata2
+    ){
+    *((WGPUDevice*)userdata1) = device;
+}
+void errorCallbackFunction(const WGPUDevice* device, WGPUErrorType type, WGPUStringView message, void* userdata1, void* userdata2){
+    printf("Error: %.*s\n", (int)message.length, message.data);
+    ++*((int*)userdata1);
+}
+
+static WGPUCommandEncoder createEncoder(WGPUDevice device, WGPUQueue queue){
+    WGPUCommandEncoderQueueSelection selection = {
+        .chain = {
+            .sType = WGPUSType_CommandEncoderQueueSelection,
+        },
+        .queue = queue,
+    };
+    const WGPUCommandEncoderDescriptor descriptor = {
+        .nextInChain = &selection.chain,
+    };
+    return wgpuDeviceCreateCommandEncoder(device, &descriptor);
+}
+
+static void submit(WGPUQueue queue, WGPUCommandEncoder cenc){
+    WGPUCommandBuffer cmdBuffer = wgpuCommandEncoderFinish(cenc, NULL);
+    wgpuCommandEncoderRelease(cenc);
+    wgpuQueueSubmit(queue, 1, &cmdBuffer);
+    wgpuCommandBufferRelease(cmdBuffer);
+}
+
+// Reads source back through queue, its last use may have been on the other one
+static int compareReadback(WGPUDevice device, WGPUQueue queue, WGPUBuffer source, const uint8_t* expected, const char* what){
+    WGPUBuffer readback = wgpuDeviceCreateBuffer(device, &(WGPUBufferDescriptor){
+        .size = BUFFER_SIZE,
+        .usage = WGPUBufferUsage_MapRead | WGPUBufferUsage_CopyDst,
+    });
+    WGPUCommandEncoder cenc = createEncoder(device, queue);
+    wgpuCommandEncoderCopyBufferToBuffer(cenc, source, 0, readback, 0, BUFFER_SIZE);
+    submit(queue, cenc);
+
+    int failures = 0;
+    uint8_t* contents = NULL;
+    wgpuBufferMap(readback, WGPUMapMode_Read, 0, BUFFER_SIZE, (void**)&contents);
+    for(uint32_t i = 0;i < BUFFER_SIZE;i++){
+        if(contents[i] != expected[i]){
+            printf("%s: byte %u is 0x%02x, expected 0x%02x\n", what, i, contents[i], expected[i]);
+            ++failures;
+            break;
+        }
+    }
+    wgpuBufferUnmap(readback);
+    wgpuBufferRelease(readback);
+    printf("%s: %s\n", what, failures ? "FAILED" : "OK");
+    return failures;
+}
+
+int main(){
+    WGPUInstanceFeatureName instanceFeatures[1] = {
+        WGPUInstanceFeatureName_TimedWaitAny,
+    };
+    WGPUInstanceDescriptor instanceDescriptor = {
+        .requiredFeatures = instanceFeatures,
+        .requiredFeatureCount = 1,
+    };
+    WGPUInstance instance = wgpuCreateInstance(&instanceDescriptor);
+
+    WGPURequestAdapterOptions adapterOptions = {0};
+    adapterOptions.featureLevel = WGPUFeatureLevel_Core;
+    WGPURequestAdapterCallbackInfo adapterCallback = {0};
+    adapterCallback.callback = adapterCallbackFunction;
+    WGPUAdapter requestedAdapter;
+    adapterCallback.userdata1 = (void*)&requestedAdapter;
+    WGPUFutureWaitInfo winfo = {
+        .future = wgpuInstanceRequestAdapter(instance, &adapterOptions, adapterCallback),
+    };
+    wgpuInstanceWaitAny(instance, 1, &winfo, ~0ull);
+
+    int errorCount = 0;
+    WGPUAsyncComputeQueueSelection asyncComputeSelection = {
+        .chain = {
+            .sType = WGPUSType_AsyncComputeQueueSelection,
+        },
+        .allowGraphicsFamily = 1,
+    };
+    WGPUDeviceDescriptor deviceDescriptor = {
+        .nextInChain = &asyncComputeSelection.chain,
+        .label = STRVIEW("WGPU Device"),
+        .uncapturedErrorCallbackInfo = {
+            .callback = errorCallbackFunction,
+            .userdata1 = &errorCount,
+        },
+    };
+    WGPUDevice device = NULL;
+    WGPURequestDeviceCallbackInfo requestDeviceCallbackInfo = {
+        .callback = deviceCallbackFunction,
+        .mode = WGPUCallbackMode_WaitAnyOnly,
+        .userdata1 = &device
+    };
+    WGPUFutureWaitInfo requestDeviceFutureWaitInfo = {
+        .future = wgpuAdapterRequestDevice(requestedAdapter, &deviceDescriptor, requestDeviceCallbackInfo),
+    };
+    wgpuInstanceWaitAny(instance, 1, &requestDeviceFutureWaitInfo, ~0ull);
+    WGPUQueue queue = wgpuDeviceGetQueue(device);
+    WGPUQueue asyncQueue = wgpuDeviceGetAsyncComputeQueue(device);
+    if(asyncQueue == NULL){
+        printf("No async compute queue, the device lacks timeline semaphores\n");
+        wgpuQueueRelease(queue);
+        wgpuDeviceRelease(device);
+        wgpuAdapterRelease(requestedAdapter);
+        return 0;
+    }
+
+    int failures = 0;
+    uint8_t expected[BUFFER_SIZE];
+    WGPUBuffer scratch = wgpuDeviceCreateBuffer(device, &(WGPUBufferDescriptor){
+        .size = BUFFER_SIZE,
+        .usage = WGPUBufferUsage_Storage | WGPUBufferUsage_CopySrc | WGPUBufferUsage_CopyDst,
+    });
+    WGPUBuffer pattern = wgpuDeviceCreateBuffer(device, &(WGPUBufferDescriptor){
+        .size = BUFFER_SIZE,
+        .usage = WGPUBufferUsage_CopySrc | WGPUBufferUsage_CopyDst,
+    });
+    memset(expected, 0xAB, BUFFER_SIZE);
+    wgpuQueueWriteBuffer(queue, pattern, 0, expected, BUFFER_SIZE);
+
+    // Default queue writes, the async queue continues on the result
+    WGPUCommandEncoder cenc = createEncoder(device, queue);
+    wgpuCommandEncoderCopyBufferToBuffer(cenc, pattern, 0, scratch, 0, BUFFER_SIZE);
+    submit(queue, cenc);
+    cenc = createEncoder(device, asyncQueue);
+    wgpuCommandEncoderClearBuffer(cenc, scratch, 64, 64);
+    submit(asyncQueue, cenc);
+    memset(expected + 64, 0, 64);
+    failures += compareReadback(device, queue, scratch, expected, "Async clear after default copy");
+
+    // And back: the async queue writes over what the default queue read last
+    cenc = createEncoder(device, asyncQueue);
+    wgpuCommandEncoderCopyBufferToBuffer(cenc, pattern, 0, scratch, 0, 128);
+    wgpuCommandEncoderClearBuffer(cenc, scratch, 192, WGPU_WHOLE_SIZE);
+    submit(asyncQueue, cenc);
+    memset(expected, 0xAB, 128);
+    memset(expected + 192, 0, BUFFER_SIZE - 192);
+    failures += compareReadback(device, asyncQueue, scratch, expected, "Async copy and readback");
+    failures += compareReadback(device, queue, scratch, expected, "Default readback of async writes");
+
+    // Writes staged on the async queue land with its next submit
+    const uint8_t ones[16] = {1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1};
+    wgpuQueueWriteBuffer(asyncQueue, scratch, 32, ones, sizeof(ones));
+    memcpy(expected + 32, ones, sizeof(ones));
+    failures += compareReadback(device, asyncQueue, scratch, expected, "Async queue write");
+
+    if(errorCount != 0){
+        printf("Got %d errors\n", errorCount);
+        ++failures;
+    }
+    printf("%s\n", failures ? "FAILED" : "OK");
+
+    wgpuBufferRelease(pattern);
+    wgpuBufferRelease(scratch);
+    wgpuQueueRelease(asyncQueue);
+    wgpuQueueRelease(queue);
+    wgpuDeviceRelease(device);
+    wgpuAdapterRelease(requestedAdapter);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,156 @@
+// Barrier masks: checks on the CPU only which pipeline stages and accesses each binding usage maps to,
+// what a transition between two usages puts into its barrier, and how those fold into the legacy masks
+// used without synchronization2. Needs no device, so it also runs without a Vulkan driver.
+#include <wgvk.h>
+#include <wgvk_structs_impl.h>
+#include <stdio.h>
+#include <string.h>
+
+static int failures = 0;
+
+static void expectFlags(const char* what, uint64_t got, uint64_t expected){
+    if(got != expected){
+        printf("%s: got 0x%llx, expected 0x%llx\n", what, (unsigned long long)got, (unsigned long long)expected);
+        ++failures;
+    }
+}
+
+static WGPUBindGroupLayoutEntry bufferEntry(WGPUShaderStage visibility, WGPUBufferBindingType type, WGPUBool hasDynamicOffset){
+    WGPUBindGroupLayoutEntry entry = {0};
+    entry.visibility = visibility;
+    entry.buffer.type = type;
+    entry.buffer.hasDynamicOffset = hasDynamicOffset;
+    return entry;
+}
+static WGPUBindGroupLayoutEntry storageTextureEntry(WGPUStorageTextureAccess access){
+    WGPUBindGroupLayoutEntry entry = {0};
+    entry.visibility = WGPUShaderStage_Compute;
+    entry.storageTexture.access = access;
+    return entry;
+}
+
+static void checkStages(void){
+    expectFlags("Vertex stage", toVulkanPipelineStageBits(WGPUShaderStage_Vertex), VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT);
+    expectFlags("Fragment stage", toVulkanPipelineStageBits(WGPUShaderStage_Fragment), VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT);
+    expectFlags("Compute stage", toVulkanPipelineStageBits(WGPUShaderStage_Compute), VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT);
+    expectFlags("Vertex | Fragment stage", toVulkanPipelineStageBits(WGPUShaderStage_Vertex | WGPUShaderStage_Fragment),
+        VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT);
+}
+
+static void checkAccesses(void){
+    WGPUBindGroupLayoutEntry entry = bufferEntry(WGPUShaderStage_Fragment, WGPUBufferBindingType_Uniform, 0);
+    expectFlags("Uniform buffer", extractVkAccessFlags(&entry), VK_ACCESS_2_UNIFORM_READ_BIT);
+    entry = bufferEntry(WGPUShaderStage_Compute, WGPUBufferBindingType_Storage, 0);
+    expectFlags("Storage buffer", extractVkAccessFlags(&entry), VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT);
+    entry = bufferEntry(WGPUShaderStage_Compute, WGPUBufferBindingType_ReadOnlyStorage, 0);
+    expectFlags("Read-only storage buffer", extractVkAccessFlags(&entry), VK_ACCESS_2_SHADER_STORAGE_READ_BIT);
+
+    entry = storageTextureEntry(WGPUStorageTextureAccess_WriteOnly);
+    expectFlags("Write-only storage texture", extractVkAccessFlags(&entry), VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT);
+    entry = storageTextureEntry(WGPUStorageTextureAccess_ReadOnly);
+    expectFlags("Read-only storage texture", extractVkAccessFlags(&entry), VK_ACCESS_2_SHADER_STORAGE_READ_BIT);
+    entry = storageTextureEntry(WGPUStorageTextureAccess_ReadWrite);
+    expectFlags("Read-write storage texture", extractVkAccessFlags(&entry), VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT);
+
+    memset(&entry, 0, sizeof(entry));
+    entry.visibility = WGPUShaderStage_Fragment;
+    entry.texture.sampleType = WGPUTextureSampleType_Float;
+    expectFlags("Sampled texture", extractVkAccessFlags(&entry), VK_ACCESS_2_SHADER_SAMPLED_READ_BIT);
+
+    memset(&entry, 0, sizeof(entry));
+    entry.visibility = WGPUShaderStage_Fragment;
+    entry.sampler.type = WGPUSamplerBindingType_Filtering;
+    expectFlags("Sampler", extractVkAccessFlags(&entry), 0);
+}
+
+static void checkBufferUsage(void){
+    const WGPUBindGroupEntry bound = {.binding = 0, .offset = 256, .size = 64};
+
+    WGPUBindGroupLayoutEntry layoutEntry = bufferEntry(WGPUShaderStage_Compute, WGPUBufferBindingType_Storage, 0);
+    BufferUsageSnap usage = bindGroupBufferUsage(&layoutEntry, &bound);
+    expectFlags("Static storage binding stage", usage.stage, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT);
+    expectFlags("Static storage binding access", usage.access, VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT);
+    expectFlags("Static storage binding offset", usage.offset, 256);
+    expectFlags("Static storage binding size", usage.size, 64);
+
+    // The dynamic offset is only known at SetBindGroup, so the whole buffer is tracked
+    layoutEntry = bufferEntry(WGPUShaderStage_Vertex, WGPUBufferBindingType_Uniform, 1);
+    usage = bindGroupBufferUsage(&layoutEntry, &bound);
+    expectFlags("Dynamic uniform binding stage", usage.stage, VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT);
+    expectFlags("Dynamic uniform binding access", usage.access, VK_ACCESS_2_UNIFORM_READ_BIT);
+    expectFlags("Dynamic uniform binding offset", usage.offset, 0);
+    expectFlags("Dynamic uniform binding size", usage.size, WGPU_WHOLE_SIZE);
+}
+
+// The barrier between two usages of the same range, as recorded by the buffer range tracking:
+// only the writes of the earlier usage are made available, to all accesses of the later one
+static void checkTransition(const char* what, BufferUsageSnap before, BufferUsageSnap after, bool expectBarrier,
+                            VkPipelineStageFlags2 srcStage, VkAccessFlags2 srcAccess, VkPipelineStageFlags2 dstStage, VkAccessFlags2 dstAccess){
+    const bool readAfterRead = !isWritingAccess(before.access) && !isWritingAccess(after.access);
+    const bool covered = readAfterRead && (after.stage & ~before.stage) == 0 && (after.access & ~before.access) == 0;
+    if(covered == expectBarrier){
+        printf("%s: %s\n", what, expectBarrier ? "no barrier recorded" : "unexpected barrier");
+        ++failures;
+        return;
+    }
+    if(!expectBarrier){
+        return;
+    }
+    char label[128];
+    snprintf(label, sizeof(label), "%s src stage", what);
+    expectFlags(label, before.stage, srcStage);
+    snprintf(label, sizeof(label), "%s src access", what);
+    expectFlags(label, writingAccesses(before.access), srcAccess);
+    snprintf(label, sizeof(label), "%s dst stage", what);
+    expectFlags(label, after.stage, dstStage);
+    snprintf(label, sizeof(label), "%s dst access", what);
+    expectFlags(label, after.access, dstAccess);
+}
+
+static void checkTransitions(void){
+    const BufferUsageSnap copyDst = {VK_PIPELINE_STAGE_2_COPY_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT, 0, WGPU_WHOLE_SIZE};
+    const BufferUsageSnap computeReadWrite = {VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT, 0, WGPU_WHOLE_SIZE};
+    const BufferUsageSnap vertexUniform = {VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT, VK_ACCESS_2_UNIFORM_READ_BIT, 0, WGPU_WHOLE_SIZE};
+    const BufferUsageSnap fragmentUniform = {VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_UNIFORM_READ_BIT, 0, WGPU_WHOLE_SIZE};
+    const BufferUsageSnap vertexAndFragmentUniform = {vertexUniform.stage | fragmentUniform.stage, VK_ACCESS_2_UNIFORM_READ_BIT, 0, WGPU_WHOLE_SIZE};
+    const BufferUsageSnap indexRead = {VK_PIPELINE_STAGE_2_INDEX_INPUT_BIT, VK_ACCESS_2_INDEX_READ_BIT, 0, WGPU_WHOLE_SIZE};
+
+    checkTransition("Copy -> storage", copyDst, computeReadWrite, true,
+        VK_PIPELINE_STAGE_2_COPY_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT,
+        VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT);
+    checkTransition("Storage -> index", computeReadWrite, indexRead, true,
+        VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+        VK_PIPELINE_STAGE_2_INDEX_INPUT_BIT, VK_ACCESS_2_INDEX_READ_BIT);
+    checkTransition("Uniform -> copy", vertexUniform, copyDst, true,
+        VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT, 0,
+        VK_PIPELINE_STAGE_2_COPY_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT);
+    // A later stage reading the same data still needs its own execution dependency
+    checkTransition("Vertex uniform -> fragment uniform", vertexUniform, fragmentUniform, true,
+        VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT, 0,
+        VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_UNIFORM_READ_BIT);
+    checkTransition("Uniform read after covering read", vertexAndFragmentUniform, fragmentUniform, false, 0, 0, 0, 0);
+}
+
+static void checkLegacyMasks(void){
+    expectFlags("Legacy copy stage", toLegacyStageMask(VK_PIPELINE_STAGE_2_COPY_BIT, 0), VK_PIPELINE_STAGE_TRANSFER_BIT);
+    expectFlags("Legacy clear stage", toLegacyStageMask(VK_PIPELINE_STAGE_2_CLEAR_BIT, 0), VK_PIPELINE_STAGE_TRANSFER_BIT);
+    expectFlags("Legacy index stage", toLegacyStageMask(VK_PIPELINE_STAGE_2_INDEX_INPUT_BIT, 0), VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
+    expectFlags("Legacy compute stage", toLegacyStageMask(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, 0), VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+    expectFlags("Legacy empty stage", toLegacyStageMask(0, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT), VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+
+    expectFlags("Legacy sampled read", toLegacyAccessMask(VK_ACCESS_2_SHADER_SAMPLED_READ_BIT), VK_ACCESS_SHADER_READ_BIT);
+    expectFlags("Legacy storage read/write", toLegacyAccessMask(VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT),
+        VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+    expectFlags("Legacy transfer write", toLegacyAccessMask(VK_ACCESS_2_TRANSFER_WRITE_BIT), VK_ACCESS_TRANSFER_WRITE_BIT);
+    expectFlags("Legacy uniform read", toLegacyAccessMask(VK_ACCESS_2_UNIFORM_READ_BIT), VK_ACCESS_UNIFORM_READ_BIT);
+}
+
+int main(){
+    checkStages();
+    checkAccesses();
+    checkBufferUsage();
+    checkTransitions();
+    checkLegacyMasks();
+    printf("Barrier masks: %s\n", failures ? "FAILED" : "OK");
+    return failures ? 1 : 0;
+}
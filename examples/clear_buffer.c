@@ -0,0 +1,173 @@
+// wgpuCommandEncoderClearBuffer on partial ranges, checked against a CPU copy after reading the buffer back,
+// plus the validation errors for misaligned and out of range clears.
+// Built with WGVK_ZERO_INITIALIZE_BUFFERS=1 it also checks that new buffers read back as zero,
+// including one that is partially written by wgpuQueueWriteBuffer before the zero fill was submitted.
+#include <wgvk.h>
+#include <stdio.h>
+#include <string.h>
+#ifndef STRVIEW
+    #define STRVIEW(X) (WGPUStringView){X, sizeof(X) - 1}
+#endif
+
+#define BUFFER_SIZE 256
+
+void adapterCallbackFunction(
+        enum WGPURequestAdapterStatus status,
+        WGPUAdapter adapter,
+        struct WGPUStringView label,
+        void* userdata1,
+        void* userdata2
+    ){
+    *((WGPUAdapter*)userdata1) = adapter;
+}
+void deviceCallbackFunction(
+        WGPURequestDeviceStatus status,
+        WGPUDevice device,
+        WGPUStringView message,
+        void* userdata1,
+        void* userdata2
+    ){
+    *((WGPUDevice*)userdata1) = device;
+}
+void errorCallbackFunction(const WGPUDevice* device, WGPUErrorType type, WGPUStringView message, void* userdata1, void* userdata2){
+    printf("Expected error: %.*s\n", (int)message.length, message.data);
+    ++*((int*)userdata1);
+}
+
+static int compareReadback(WGPUDevice device, WGPUQueue queue, WGPUBuffer source, const uint8_t* expected, const char* what){
+    WGPUBuffer readback = wgpuDeviceCreateBuffer(device, &(WGPUBufferDescriptor){
+        .size = BUFFER_SIZE,
+        .usage = WGPUBufferUsage_MapRead | WGPUBufferUsage_CopyDst,
+    });
+    WGPUCommandEncoder cenc = wgpuDeviceCreateCommandEncoder(device, NULL);
+    wgpuCommandEncoderCopyBufferToBuffer(cenc, source, 0, readback, 0, BUFFER_SIZE);
+    WGPUCommandBuffer cmdBuffer = wgpuCommandEncoderFinish(cenc, NULL);
+    wgpuCommandEncoderRelease(cenc);
+    wgpuQueueSubmit(queue, 1, &cmdBuffer);
+    wgpuCommandBufferRelease(cmdBuffer);
+
+    int failures = 0;
+    uint8_t* contents = NULL;
+    wgpuBufferMap(readback, WGPUMapMode_Read, 0, BUFFER_SIZE, (void**)&contents);
+    for(uint32_t i = 0;i < BUFFER_SIZE;i++){
+        if(contents[i] != expected[i]){
+            printf("%s: byte %u is 0x%02x, expected 0x%02x\n", what, i, contents[i], expected[i]);
+            ++failures;
+            break;
+        }
+    }
+    wgpuBufferUnmap(readback);
+    wgpuBufferRelease(readback);
+    printf("%s: %s\n", what, failures ? "FAILED" : "OK");
+    return failures;
+}
+
+int main(){
+    WGPUInstanceFeatureName instanceFeatures[1] = {
+        WGPUInstanceFeatureName_TimedWaitAny,
+    };
+    WGPUInstanceDescriptor instanceDescriptor = {
+        .requiredFeatures = instanceFeatures,
+        .requiredFeatureCount = 1,
+    };
+    WGPUInstance instance = wgpuCreateInstance(&instanceDescriptor);
+
+    WGPURequestAdapterOptions adapterOptions = {0};
+    adapterOptions.featureLevel = WGPUFeatureLevel_Core;
+    WGPURequestAdapterCallbackInfo adapterCallback = {0};
+    adapterCallback.callback = adapterCallbackFunction;
+    WGPUAdapter requestedAdapter;
+    adapterCallback.userdata1 = (void*)&requestedAdapter;
+    WGPUFutureWaitInfo winfo = {
+        .future = wgpuInstanceRequestAdapter(instance, &adapterOptions, adapterCallback),
+    };
+    wgpuInstanceWaitAny(instance, 1, &winfo, ~0ull);
+
+    int errorCount = 0;
+    WGPUDeviceDescriptor deviceDescriptor = {
+        .label = STRVIEW("WGPU Device"),
+        .uncapturedErrorCallbackInfo = {
+            .callback = errorCallbackFunction,
+            .userdata1 = &errorCount,
+        },
+    };
+    WGPUDevice device = NULL;
+    WGPURequestDeviceCallbackInfo requestDeviceCallbackInfo = {
+        .callback = deviceCallbackFunction,
+        .mode = WGPUCallbackMode_WaitAnyOnly,
+        .userdata1 = &device
+    };
+    WGPUFutureWaitInfo requestDeviceFutureWaitInfo = {
+        .future = wgpuAdapterRequestDevice(requestedAdapter, &deviceDescriptor, requestDeviceCallbackInfo),
+    };
+    wgpuInstanceWaitAny(instance, 1, &requestDeviceFutureWaitInfo, ~0ull);
+    WGPUQueue queue = wgpuDeviceGetQueue(device);
+
+    int failures = 0;
+    uint8_t expected[BUFFER_SIZE];
+    const WGPUBufferDescriptor scratchDesc = {
+        .size = BUFFER_SIZE,
+        .usage = WGPUBufferUsage_Storage | WGPUBufferUsage_CopySrc | WGPUBufferUsage_CopyDst,
+    };
+
+    #if defined(WGVK_ZERO_INITIALIZE_BUFFERS) && WGVK_ZERO_INITIALIZE_BUFFERS == 1
+    {
+        WGPUBuffer fresh = wgpuDeviceCreateBuffer(device, &scratchDesc);
+        memset(expected, 0, BUFFER_SIZE);
+        failures += compareReadback(device, queue, fresh, expected, "Zero initialized");
+        wgpuBufferRelease(fresh);
+
+        // The write lands after the fill even though both only reach the GPU with the next submit
+        WGPUBuffer written = wgpuDeviceCreateBuffer(device, &scratchDesc);
+        const uint8_t ones[16] = {1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1};
+        wgpuQueueWriteBuffer(queue, written, 32, ones, sizeof(ones));
+        memset(expected + 32, 1, sizeof(ones));
+        failures += compareReadback(device, queue, written, expected, "Zero initialized, then written");
+        wgpuBufferRelease(written);
+    }
+    #endif
+
+    WGPUBuffer scratch = wgpuDeviceCreateBuffer(device, &scratchDesc);
+    memset(expected, 0xAB, BUFFER_SIZE);
+    wgpuQueueWriteBuffer(queue, scratch, 0, expected, BUFFER_SIZE);
+
+    WGPUCommandEncoder cenc = wgpuDeviceCreateCommandEncoder(device, NULL);
+    wgpuCommandEncoderClearBuffer(cenc, scratch, 64, 64);
+    wgpuCommandEncoderClearBuffer(cenc, scratch, 4, 4);
+    wgpuCommandEncoderClearBuffer(cenc, scratch, 192, WGPU_WHOLE_SIZE);
+    wgpuCommandEncoderClearBuffer(cenc, scratch, BUFFER_SIZE, 0);
+    memset(expected + 64, 0, 64);
+    memset(expected + 4, 0, 4);
+    memset(expected + 192, 0, BUFFER_SIZE - 192);
+
+    // None of these may touch the buffer
+    WGPUBuffer noCopyDst = wgpuDeviceCreateBuffer(device, &(WGPUBufferDescriptor){
+        .size = BUFFER_SIZE,
+        .usage = WGPUBufferUsage_Storage,
+    });
+    wgpuCommandEncoderClearBuffer(cenc, scratch, 2, 4);
+    wgpuCommandEncoderClearBuffer(cenc, scratch, 8, 6);
+    wgpuCommandEncoderClearBuffer(cenc, scratch, BUFFER_SIZE - 4, 8);
+    wgpuCommandEncoderClearBuffer(cenc, scratch, BUFFER_SIZE + 4, WGPU_WHOLE_SIZE);
+    wgpuCommandEncoderClearBuffer(cenc, noCopyDst, 0, 16);
+    const int expectedErrors = 5;
+
+    WGPUCommandBuffer cmdBuffer = wgpuCommandEncoderFinish(cenc, NULL);
+    wgpuCommandEncoderRelease(cenc);
+    wgpuQueueSubmit(queue, 1, &cmdBuffer);
+    wgpuCommandBufferRelease(cmdBuffer);
+
+    failures += compareReadback(device, queue, scratch, expected, "Partial clears");
+    if(errorCount != expectedErrors){
+        printf("Got %d validation errors, expected %d\n", errorCount, expectedErrors);
+        ++failures;
+    }
+    printf("%s\n", failures ? "FAILED" : "OK");
+
+    wgpuBufferRelease(noCopyDst);
+    wgpuBufferRelease(scratch);
+    wgpuQueueRelease(queue);
+    wgpuDeviceRelease(device);
+    wgpuAdapterRelease(requestedAdapter);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,150 @@
+// Times waiting for 64 fences: one wgpuFenceWait per fence against a single wgpuFencesWait for all of them,
+// and how quickly wgpuFencesWaitEx returns once any of them signalled. Each fence follows a buffer clear,
+// so the fences signal one after another.
+#include <wgvk.h>
+#include <stdio.h>
+#include <time.h>
+#ifndef STRVIEW
+    #define STRVIEW(X) (WGPUStringView){X, sizeof(X) - 1}
+#endif
+
+#define FENCE_COUNT 64
+#define ITERATIONS 32
+#define CLEAR_SIZE (1 << 20)
+
+void adapterCallbackFunction(
+        enum WGPURequestAdapterStatus status,
+        WGPUAdapter adapter,
+        struct WGPUStringView label,
+        void* userdata1,
+        void* userdata2
+    ){
+    *((WGPUAdapter*)userdata1) = adapter;
+}
+void deviceCallbackFunction(
+        WGPURequestDeviceStatus status,
+        WGPUDevice device,
+        WGPUStringView message,
+        void* userdata1,
+        void* userdata2
+    ){
+    *((WGPUDevice*)userdata1) = device;
+}
+void errorCallbackFunction(const WGPUDevice* device, WGPUErrorType type, WGPUStringView message, void* userdata1, void* userdata2){
+    printf("Error: %.*s\n", (int)message.length, message.data);
+    ++*((int*)userdata1);
+}
+
+static uint64_t nanoTime(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// Records FENCE_COUNT clears with a fence after each one
+static void submitFenced(WGPUDevice device, WGPUQueue queue, WGPUBuffer buffer, WGPUFence* fences){
+    for(uint32_t i = 0;i < FENCE_COUNT;i++){
+        WGPUCommandEncoder cenc = wgpuDeviceCreateCommandEncoder(device, NULL);
+        wgpuCommandEncoderClearBuffer(cenc, buffer, 0, WGPU_WHOLE_SIZE);
+        WGPUCommandBuffer cmdBuffer = wgpuCommandEncoderFinish(cenc, NULL);
+        wgpuCommandEncoderRelease(cenc);
+        wgpuQueueSubmit(queue, 1, &cmdBuffer);
+        wgpuCommandBufferRelease(cmdBuffer);
+        fences[i] = wgpuDeviceCreateFence(device);
+        wgpuQueueSignalFence(queue, fences[i]);
+    }
+}
+
+static void releaseFences(WGPUDevice device, WGPUFence* fences){
+    // wgpuFencesWaitEx only waited for the first fence in the wait-any round
+    wgpuFencesWait(fences, FENCE_COUNT, UINT64_MAX);
+    for(uint32_t i = 0;i < FENCE_COUNT;i++){
+        wgpuFenceRelease(fences[i]);
+    }
+    wgpuDeviceTick(device);
+}
+
+int main(){
+    WGPUInstanceFeatureName instanceFeatures[1] = {
+        WGPUInstanceFeatureName_TimedWaitAny,
+    };
+    WGPUInstanceDescriptor instanceDescriptor = {
+        .requiredFeatures = instanceFeatures,
+        .requiredFeatureCount = 1,
+    };
+    WGPUInstance instance = wgpuCreateInstance(&instanceDescriptor);
+
+    WGPURequestAdapterOptions adapterOptions = {0};
+    adapterOptions.featureLevel = WGPUFeatureLevel_Core;
+    WGPURequestAdapterCallbackInfo adapterCallback = {0};
+    adapterCallback.callback = adapterCallbackFunction;
+    WGPUAdapter requestedAdapter;
+    adapterCallback.userdata1 = (void*)&requestedAdapter;
+    WGPUFutureWaitInfo winfo = {
+        .future = wgpuInstanceRequestAdapter(instance, &adapterOptions, adapterCallback),
+    };
+    wgpuInstanceWaitAny(instance, 1, &winfo, ~0ull);
+
+    int errorCount = 0;
+    WGPUDeviceDescriptor deviceDescriptor = {
+        .label = STRVIEW("WGPU Device"),
+        .uncapturedErrorCallbackInfo = {
+            .callback = errorCallbackFunction,
+            .userdata1 = &errorCount,
+        },
+    };
+    WGPUDevice device = NULL;
+    WGPURequestDeviceCallbackInfo requestDeviceCallbackInfo = {
+        .callback = deviceCallbackFunction,
+        .mode = WGPUCallbackMode_WaitAnyOnly,
+        .userdata1 = &device
+    };
+    WGPUFutureWaitInfo requestDeviceFutureWaitInfo = {
+        .future = wgpuAdapterRequestDevice(requestedAdapter, &deviceDescriptor, requestDeviceCallbackInfo),
+    };
+    wgpuInstanceWaitAny(instance, 1, &requestDeviceFutureWaitInfo, ~0ull);
+    WGPUQueue queue = wgpuDeviceGetQueue(device);
+
+    WGPUBuffer buffer = wgpuDeviceCreateBuffer(device, &(WGPUBufferDescriptor){
+        .size = CLEAR_SIZE,
+        .usage = WGPUBufferUsage_Storage | WGPUBufferUsage_CopyDst,
+    });
+
+    WGPUFence fences[FENCE_COUNT];
+    uint64_t individualNS = 0, batchedNS = 0, anyNS = 0;
+    for(uint32_t iteration = 0;iteration < ITERATIONS;iteration++){
+        submitFenced(device, queue, buffer, fences);
+        uint64_t start = nanoTime();
+        for(uint32_t i = 0;i < FENCE_COUNT;i++){
+            wgpuFenceWait(fences[i], UINT64_MAX);
+        }
+        individualNS += nanoTime() - start;
+        releaseFences(device, fences);
+
+        submitFenced(device, queue, buffer, fences);
+        start = nanoTime();
+        wgpuFencesWait(fences, FENCE_COUNT, UINT64_MAX);
+        batchedNS += nanoTime() - start;
+        releaseFences(device, fences);
+
+        submitFenced(device, queue, buffer, fences);
+        start = nanoTime();
+        wgpuFencesWaitEx(fences, FENCE_COUNT, 0, UINT64_MAX);
+        anyNS += nanoTime() - start;
+        releaseFences(device, fences);
+    }
+
+    printf("%d fences, average over %d rounds\n", FENCE_COUNT, ITERATIONS);
+    printf("  wgpuFenceWait per fence: %8.1f us\n", individualNS / (1000.0 * ITERATIONS));
+    printf("  wgpuFencesWait, all:     %8.1f us\n", batchedNS / (1000.0 * ITERATIONS));
+    printf("  wgpuFencesWaitEx, any:   %8.1f us\n", anyNS / (1000.0 * ITERATIONS));
+    if(errorCount != 0){
+        printf("Got %d errors\n", errorCount);
+    }
+
+    wgpuBufferRelease(buffer);
+    wgpuQueueRelease(queue);
+    wgpuDeviceRelease(device);
+    wgpuAdapterRelease(requestedAdapter);
+    return errorCount ? 1 : 0;
+}
@@ -0,0 +1,142 @@
+// wgpuQueueWriteBufferFromFile: uploads a range of a temporary file into a buffer and compares it after reading it back.
+// The size in MiB can be passed as the first argument, anything above WGVK_FILE_UPLOAD_CHUNK_SIZE is read by several workers.
+#include <wgvk.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#ifndef STRVIEW
+    #define STRVIEW(X) (WGPUStringView){X, sizeof(X) - 1}
+#endif
+#ifdef _WIN32
+    #include <io.h>
+    #define fileno _fileno
+#endif
+
+#define FILE_OFFSET 4096
+
+void adapterCallbackFunction(
+        enum WGPURequestAdapterStatus status,
+        WGPUAdapter adapter,
+        struct WGPUStringView label,
+        void* userdata1,
+        void* userdata2
+    ){
+    *((WGPUAdapter*)userdata1) = adapter;
+}
+void deviceCallbackFunction(
+        WGPURequestDeviceStatus status,
+        WGPUDevice device,
+        WGPUStringView message,
+        void* userdata1,
+        void* userdata2
+    ){
+    *((WGPUDevice*)userdata1) = device;
+}
+void uploadCallbackFunction(WGPUQueueWorkDoneStatus status, void* userdata1, void* userdata2){
+    *((WGPUQueueWorkDoneStatus*)userdata1) = status;
+}
+
+static uint32_t patternAt(uint64_t index){
+    return (uint32_t)(index * 2654435761u) ^ 0x5bd1e995u;
+}
+
+int main(int argc, char** argv){
+    const uint64_t size = (argc > 1 ? strtoull(argv[1], NULL, 10) : 16) << 20;
+
+    FILE* file = tmpfile();
+    if(file == NULL){
+        printf("Could not create a temporary file\n");
+        return 1;
+    }
+    uint32_t block[4096];
+    fwrite(block, 1, FILE_OFFSET, file);
+    for(uint64_t written = 0;written < size;written += sizeof(block)){
+        for(uint32_t i = 0;i < 4096;i++){
+            block[i] = patternAt(written / 4 + i);
+        }
+        fwrite(block, 1, size - written < sizeof(block) ? size - written : sizeof(block), file);
+    }
+    fflush(file);
+
+    WGPUInstanceFeatureName instanceFeatures[1] = {
+        WGPUInstanceFeatureName_TimedWaitAny,
+    };
+    WGPUInstanceDescriptor instanceDescriptor = {
+        .requiredFeatures = instanceFeatures,
+        .requiredFeatureCount = 1,
+    };
+    WGPUInstance instance = wgpuCreateInstance(&instanceDescriptor);
+
+    WGPURequestAdapterOptions adapterOptions = {0};
+    adapterOptions.featureLevel = WGPUFeatureLevel_Core;
+    WGPURequestAdapterCallbackInfo adapterCallback = {0};
+    adapterCallback.callback = adapterCallbackFunction;
+    WGPUAdapter requestedAdapter;
+    adapterCallback.userdata1 = (void*)&requestedAdapter;
+    WGPUFutureWaitInfo winfo = {
+        .future = wgpuInstanceRequestAdapter(instance, &adapterOptions, adapterCallback),
+    };
+    wgpuInstanceWaitAny(instance, 1, &winfo, ~0ull);
+
+    WGPUDeviceDescriptor deviceDescriptor = {
+        .label = STRVIEW("WGPU Device"),
+    };
+    WGPUDevice device = NULL;
+    WGPURequestDeviceCallbackInfo requestDeviceCallbackInfo = {
+        .callback = deviceCallbackFunction,
+        .mode = WGPUCallbackMode_WaitAnyOnly,
+        .userdata1 = &device
+    };
+    WGPUFutureWaitInfo requestDeviceFutureWaitInfo = {
+        .future = wgpuAdapterRequestDevice(requestedAdapter, &deviceDescriptor, requestDeviceCallbackInfo),
+    };
+    wgpuInstanceWaitAny(instance, 1, &requestDeviceFutureWaitInfo, ~0ull);
+    WGPUQueue queue = wgpuDeviceGetQueue(device);
+
+    WGPUBuffer destination = wgpuDeviceCreateBuffer(device, &(WGPUBufferDescriptor){
+        .size = size,
+        .usage = WGPUBufferUsage_Storage | WGPUBufferUsage_CopySrc | WGPUBufferUsage_CopyDst,
+    });
+    WGPUBuffer readback = wgpuDeviceCreateBuffer(device, &(WGPUBufferDescriptor){
+        .size = size,
+        .usage = WGPUBufferUsage_MapRead | WGPUBufferUsage_CopyDst,
+    });
+
+    WGPUQueueWorkDoneStatus uploadStatus = WGPUQueueWorkDoneStatus_Force32;
+    WGPUFutureWaitInfo uploadWaitInfo = {
+        .future = wgpuQueueWriteBufferFromFile(queue, destination, 0, fileno(file), FILE_OFFSET, size, (WGPUQueueWorkDoneCallbackInfo){
+            .mode = WGPUCallbackMode_WaitAnyOnly,
+            .callback = uploadCallbackFunction,
+            .userdata1 = &uploadStatus,
+        }),
+    };
+    wgpuInstanceWaitAny(instance, 1, &uploadWaitInfo, ~0ull);
+
+    WGPUCommandEncoder cenc = wgpuDeviceCreateCommandEncoder(device, NULL);
+    wgpuCommandEncoderCopyBufferToBuffer(cenc, destination, 0, readback, 0, size);
+    WGPUCommandBuffer cmdBuffer = wgpuCommandEncoderFinish(cenc, NULL);
+    wgpuCommandEncoderRelease(cenc);
+    wgpuQueueSubmit(queue, 1, &cmdBuffer);
+    wgpuCommandBufferRelease(cmdBuffer);
+
+    int failures = uploadStatus != WGPUQueueWorkDoneStatus_Success;
+    const uint32_t* contents = NULL;
+    wgpuBufferMap(readback, WGPUMapMode_Read, 0, size, (void**)&contents);
+    for(uint64_t i = 0;i < size / 4 && !failures;i++){
+        if(contents[i] != patternAt(i)){
+            printf("Word %llu is 0x%08x, expected 0x%08x\n", (unsigned long long)i, contents[i], patternAt(i));
+            ++failures;
+        }
+    }
+    wgpuBufferUnmap(readback);
+    printf("Uploaded %llu MiB from file: %s\n", (unsigned long long)(size >> 20), failures ? "FAILED" : "OK");
+
+    wgpuBufferRelease(readback);
+    wgpuBufferRelease(destination);
+    wgpuQueueRelease(queue);
+    wgpuDeviceRelease(device);
+    wgpuAdapterRelease(requestedAdapter);
+    fclose(file);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,254 @@
+// Frame graph layer: plans a graph on the CPU only and checks culling, reordering and aliasing of the schedule,
+// then runs a small graph on the GPU that clears transient textures and copies them into a readback buffer.
+#include <wgvk.h>
+#include <wgvk_frame_graph.h>
+#include <stdio.h>
+#include <string.h>
+#ifndef STRVIEW
+    #define STRVIEW(X) (WGPUStringView){X, sizeof(X) - 1}
+#endif
+
+#define TARGET_SIZE 64
+
+void adapterCallbackFunction(
+        enum WGPURequestAdapterStatus status,
+        WGPUAdapter adapter,
+        struct WGPUStringView label,
+        void* userdata1,
+        void* userdata2
+    ){
+    *((WGPUAdapter*)userdata1) = adapter;
+}
+void deviceCallbackFunction(
+        WGPURequestDeviceStatus status,
+        WGPUDevice device,
+        WGPUStringView message,
+        void* userdata1,
+        void* userdata2
+    ){
+    *((WGPUDevice*)userdata1) = device;
+}
+
+static const WGPUTextureDescriptor targetDesc = {
+    .usage = WGPUTextureUsage_RenderAttachment | WGPUTextureUsage_CopySrc,
+    .dimension = WGPUTextureDimension_2D,
+    .size = {TARGET_SIZE, TARGET_SIZE, 1},
+    .format = WGPUTextureFormat_RGBA8Unorm,
+    .mipLevelCount = 1,
+    .sampleCount = 1
+};
+
+static int expectSchedule(WGVKFrameGraph graph, const uint32_t* expected, size_t expectedCount){
+    uint32_t schedule[16];
+    const size_t count = wgvkFrameGraphGetSchedule(graph, schedule, 16);
+    printf("Schedule:");
+    for(size_t i = 0;i < count;i++){
+        printf(" %u", schedule[i]);
+    }
+    printf("\n");
+    if(count != expectedCount || memcmp(schedule, expected, count * sizeof(uint32_t)) != 0){
+        printf("Schedule mismatch\n");
+        return 1;
+    }
+    return 0;
+}
+
+// shadow -> lighting and gbuffer -> resolve are independent chains joined by composite; debug is never consumed
+static int planOnly(void){
+    int failures = 0;
+    WGVKFrameGraph graph = wgvkFrameGraphCreate(NULL);
+    WGVKFrameGraphResource a = wgvkFrameGraphCreateTexture(graph, &targetDesc);
+    WGVKFrameGraphResource b = wgvkFrameGraphCreateTexture(graph, &targetDesc);
+    WGVKFrameGraphResource c = wgvkFrameGraphCreateTexture(graph, &targetDesc);
+    WGVKFrameGraphResource d = wgvkFrameGraphCreateTexture(graph, &targetDesc);
+    WGVKFrameGraphResource out = wgvkFrameGraphCreateTexture(graph, &targetDesc);
+    WGVKFrameGraphResource debug = wgvkFrameGraphCreateTexture(graph, &targetDesc);
+    wgvkFrameGraphMarkOutput(graph, out);
+
+    wgvkFrameGraphAddPass(graph, &(WGVKFrameGraphPassDescriptor){.label = STRVIEW("shadow"),    .writeCount = 1, .writes = &a});
+    wgvkFrameGraphAddPass(graph, &(WGVKFrameGraphPassDescriptor){.label = STRVIEW("lighting"),  .readCount = 1, .reads = &a, .writeCount = 1, .writes = &b});
+    wgvkFrameGraphAddPass(graph, &(WGVKFrameGraphPassDescriptor){.label = STRVIEW("gbuffer"),   .writeCount = 1, .writes = &c});
+    wgvkFrameGraphAddPass(graph, &(WGVKFrameGraphPassDescriptor){.label = STRVIEW("resolve"),   .readCount = 1, .reads = &c, .writeCount = 1, .writes = &d});
+    wgvkFrameGraphAddPass(graph, &(WGVKFrameGraphPassDescriptor){.label = STRVIEW("debug"),     .readCount = 1, .reads = &d, .writeCount = 1, .writes = &debug});
+    const WGVKFrameGraphResource compositeReads[2] = {b, d};
+    wgvkFrameGraphAddPass(graph, &(WGVKFrameGraphPassDescriptor){.label = STRVIEW("composite"), .readCount = 2, .reads = compositeReads, .writeCount = 1, .writes = &out});
+    wgvkFrameGraphCompile(graph);
+
+    const uint32_t expected[5] = {0, 2, 1, 3, 5};
+    failures += expectSchedule(graph, expected, 5);
+    WGVKFrameGraphStats stats;
+    wgvkFrameGraphGetStats(graph, &stats);
+    printf("%u of %u passes scheduled, %u directly after their producer, %u transient textures in %u\n",
+        stats.scheduledPassCount, stats.passCount, stats.adjacentDependencies, stats.transientTextureCount, stats.physicalTextureCount);
+    if(stats.scheduledPassCount != 5 || stats.adjacentDependencies != 1 || stats.transientTextureCount != 5 || stats.physicalTextureCount != 3){
+        printf("Unexpected stats\n");
+        ++failures;
+    }
+    // a is dead once lighting ran, resolve's output takes its place
+    if(wgvkFrameGraphGetTextureSlot(graph, a) != wgvkFrameGraphGetTextureSlot(graph, d)
+    || wgvkFrameGraphGetTextureSlot(graph, debug) != WGVK_FRAME_GRAPH_NO_SLOT){
+        printf("Unexpected texture slots\n");
+        ++failures;
+    }
+    wgvkFrameGraphRelease(graph);
+    printf("Planning: %s\n", failures ? "FAILED" : "OK");
+    return failures;
+}
+
+typedef struct ClearPass{
+    WGVKFrameGraphResource target;
+    WGPUColor color;
+}ClearPass;
+
+typedef struct CopyPass{
+    WGVKFrameGraphResource source;
+    WGVKFrameGraphResource readback;
+    uint64_t offset;
+}CopyPass;
+
+static void clearPass(WGVKFrameGraph graph, WGPUCommandEncoder encoder, void* userdata){
+    const ClearPass* pass = (const ClearPass*)userdata;
+    WGPUTextureView view = wgpuTextureCreateView(wgvkFrameGraphGetTexture(graph, pass->target), &(WGPUTextureViewDescriptor){
+        .format = WGPUTextureFormat_RGBA8Unorm,
+        .dimension = WGPUTextureViewDimension_2D,
+        .mipLevelCount = 1,
+        .arrayLayerCount = 1,
+        .aspect = WGPUTextureAspect_All,
+        .usage = WGPUTextureUsage_RenderAttachment
+    });
+    WGPURenderPassColorAttachment colorAttachment = {
+        .view = view,
+        .loadOp = WGPULoadOp_Clear,
+        .storeOp = WGPUStoreOp_Store,
+        .clearValue = pass->color,
+        .depthSlice = WGPU_DEPTH_SLICE_UNDEFINED,
+    };
+    WGPURenderPassEncoder rpenc = wgpuCommandEncoderBeginRenderPass(encoder, &(const WGPURenderPassDescriptor){
+        .colorAttachmentCount = 1,
+        .colorAttachments = &colorAttachment,
+    });
+    wgpuRenderPassEncoderEnd(rpenc);
+    wgpuRenderPassEncoderRelease(rpenc);
+    wgpuTextureViewRelease(view);
+}
+
+static void copyPass(WGVKFrameGraph graph, WGPUCommandEncoder encoder, void* userdata){
+    const CopyPass* pass = (const CopyPass*)userdata;
+    wgpuCommandEncoderCopyTextureToBuffer(encoder,
+        &(WGPUTexelCopyTextureInfo){
+            .texture = wgvkFrameGraphGetTexture(graph, pass->source),
+            .aspect = WGPUTextureAspect_All,
+        },
+        &(WGPUTexelCopyBufferInfo){
+            .buffer = wgvkFrameGraphGetBuffer(graph, pass->readback),
+            .layout = {.offset = pass->offset, .bytesPerRow = TARGET_SIZE * 4, .rowsPerImage = TARGET_SIZE},
+        },
+        &(WGPUExtent3D){TARGET_SIZE, TARGET_SIZE, 1}
+    );
+}
+
+int main(){
+    int failures = planOnly();
+
+    WGPUInstanceFeatureName instanceFeatures[1] = {
+        WGPUInstanceFeatureName_TimedWaitAny,
+    };
+    WGPUInstanceDescriptor instanceDescriptor = {
+        .requiredFeatures = instanceFeatures,
+        .requiredFeatureCount = 1,
+    };
+    WGPUInstance instance = wgpuCreateInstance(&instanceDescriptor);
+
+    WGPURequestAdapterOptions adapterOptions = {0};
+    adapterOptions.featureLevel = WGPUFeatureLevel_Core;
+    WGPURequestAdapterCallbackInfo adapterCallback = {0};
+    adapterCallback.callback = adapterCallbackFunction;
+    WGPUAdapter requestedAdapter;
+    adapterCallback.userdata1 = (void*)&requestedAdapter;
+    WGPUFutureWaitInfo winfo = {
+        .future = wgpuInstanceRequestAdapter(instance, &adapterOptions, adapterCallback),
+    };
+    wgpuInstanceWaitAny(instance, 1, &winfo, ~0ull);
+
+    WGPUDeviceDescriptor deviceDescriptor = {
+        .label = STRVIEW("WGPU Device"),
+    };
+    WGPUDevice device = NULL;
+    WGPURequestDeviceCallbackInfo requestDeviceCallbackInfo = {
+        .callback = deviceCallbackFunction,
+        .mode = WGPUCallbackMode_WaitAnyOnly,
+        .userdata1 = &device
+    };
+    WGPUFutureWaitInfo requestDeviceFutureWaitInfo = {
+        .future = wgpuAdapterRequestDevice(requestedAdapter, &deviceDescriptor, requestDeviceCallbackInfo),
+    };
+    wgpuInstanceWaitAny(instance, 1, &requestDeviceFutureWaitInfo, ~0ull);
+    WGPUQueue queue = wgpuDeviceGetQueue(device);
+
+    const uint64_t imageSize = TARGET_SIZE * TARGET_SIZE * 4;
+    WGPUBuffer readback = wgpuDeviceCreateBuffer(device, &(WGPUBufferDescriptor){
+        .size = 2 * imageSize,
+        .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_MapRead
+    });
+
+    // Two frames through the same graph, the second one reuses the transient textures of the first
+    WGVKFrameGraph graph = wgvkFrameGraphCreate(device);
+    for(uint32_t frame = 0;frame < 2;frame++){
+        WGVKFrameGraphResource red = wgvkFrameGraphCreateTexture(graph, &targetDesc);
+        WGVKFrameGraphResource green = wgvkFrameGraphCreateTexture(graph, &targetDesc);
+        WGVKFrameGraphResource unused = wgvkFrameGraphCreateTexture(graph, &targetDesc);
+        WGVKFrameGraphResource target = wgvkFrameGraphImportBuffer(graph, readback);
+
+        ClearPass clears[3] = {
+            {red,    {1, 0, 0, 1}},
+            {green,  {0, 1, 0, 1}},
+            {unused, {0, 0, 1, 1}},
+        };
+        CopyPass copies[2] = {
+            {red,   target, 0},
+            {green, target, imageSize},
+        };
+        wgvkFrameGraphAddPass(graph, &(WGVKFrameGraphPassDescriptor){.label = STRVIEW("clear red"),   .writeCount = 1, .writes = &red,    .execute = clearPass, .userdata = clears + 0});
+        wgvkFrameGraphAddPass(graph, &(WGVKFrameGraphPassDescriptor){.label = STRVIEW("copy red"),    .readCount = 1, .reads = &red,      .writeCount = 1, .writes = &target, .execute = copyPass, .userdata = copies + 0});
+        wgvkFrameGraphAddPass(graph, &(WGVKFrameGraphPassDescriptor){.label = STRVIEW("clear green"), .writeCount = 1, .writes = &green,  .execute = clearPass, .userdata = clears + 1});
+        wgvkFrameGraphAddPass(graph, &(WGVKFrameGraphPassDescriptor){.label = STRVIEW("copy green"),  .readCount = 1, .reads = &green,    .writeCount = 1, .writes = &target, .execute = copyPass, .userdata = copies + 1});
+        wgvkFrameGraphAddPass(graph, &(WGVKFrameGraphPassDescriptor){.label = STRVIEW("clear blue"),  .writeCount = 1, .writes = &unused, .execute = clearPass, .userdata = clears + 2});
+
+        WGPUCommandEncoder cenc = wgpuDeviceCreateCommandEncoder(device, NULL);
+        wgvkFrameGraphExecute(graph, cenc);
+        WGPUCommandBuffer cmdBuffer = wgpuCommandEncoderFinish(cenc, NULL);
+        wgpuCommandEncoderRelease(cenc);
+        wgpuQueueSubmit(queue, 1, &cmdBuffer);
+        wgpuCommandBufferRelease(cmdBuffer);
+
+        WGVKFrameGraphStats stats;
+        wgvkFrameGraphGetStats(graph, &stats);
+        if(stats.scheduledPassCount != 4 || wgvkFrameGraphGetTextureSlot(graph, unused) != WGVK_FRAME_GRAPH_NO_SLOT){
+            printf("Frame %u: the unused clear was not culled\n", frame);
+            ++failures;
+        }
+
+        const uint8_t* pixels = NULL;
+        wgpuBufferMap(readback, WGPUMapMode_Read, 0, 2 * imageSize, (void**)&pixels);
+        const uint8_t expected[2][4] = {{255, 0, 0, 255}, {0, 255, 0, 255}};
+        for(uint32_t image = 0;image < 2;image++){
+            for(uint64_t i = 0;i < TARGET_SIZE * TARGET_SIZE;i++){
+                if(memcmp(pixels + image * imageSize + i * 4, expected[image], 4) != 0){
+                    printf("Frame %u: pixel %llu of image %u is wrong\n", frame, (unsigned long long)i, image);
+                    ++failures;
+                    break;
+                }
+            }
+        }
+        wgpuBufferUnmap(readback);
+        wgvkFrameGraphReset(graph);
+    }
+    wgvkFrameGraphRelease(graph);
+    printf("%s\n", failures ? "FAILED" : "OK");
+
+    wgpuBufferRelease(readback);
+    wgpuQueueRelease(queue);
+    wgpuDeviceRelease(device);
+    wgpuAdapterRelease(requestedAdapter);
+    return failures ? 1 : 0;
+}
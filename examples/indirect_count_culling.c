@@ -0,0 +1,393 @@
+// GPU-driven culling: a compute pass frustum-culls a grid of instances and
+// compacts the survivors into an indirect argument buffer plus a draw count,
+// which a render bundle then consumes through wgpuRenderBundleEncoderMultiDrawIndexedIndirect.
+// The count and the rendered image are read back and checked against the CPU,
+// so a missing barrier on the argument or count buffer shows up as a failure.
+// Requires WGVK_BUILD_WGSL_SUPPORT.
+#include <wgvk.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#ifndef STRVIEW
+    #define STRVIEW(X) (WGPUStringView){X, sizeof(X) - 1}
+#endif
+
+#define GRID_SIZE 16
+#define INSTANCE_COUNT (GRID_SIZE * GRID_SIZE)
+#define TARGET_SIZE 256
+#define INSTANCE_RADIUS 0.04f
+
+const char cullSource[] =
+"struct Instance {\n"
+"    center: vec2f,\n"
+"    radius: f32,\n"
+"    pad: f32,\n"
+"};\n"
+"struct DrawArgs {\n"
+"    indexCount: u32,\n"
+"    instanceCount: u32,\n"
+"    firstIndex: u32,\n"
+"    baseVertex: i32,\n"
+"    firstInstance: u32,\n"
+"};\n"
+"@group(0) @binding(0) var<storage, read> instances: array<Instance>;\n"
+"@group(0) @binding(1) var<storage, read_write> draws: array<DrawArgs>;\n"
+"@group(0) @binding(2) var<storage, read_write> drawCount: atomic<u32>;\n"
+"\n"
+"@compute @workgroup_size(64)\n"
+"fn cull_main(@builtin(global_invocation_id) id: vec3u) {\n"
+"    if (id.x >= arrayLength(&instances)) { return; }\n"
+"    let inst = instances[id.x];\n"
+"    if (any(abs(inst.center) + vec2f(inst.radius) > vec2f(1.0))) { return; }\n"
+"    let slot = atomicAdd(&drawCount, 1u);\n"
+"    draws[slot] = DrawArgs(6u, 1u, 0u, 0, id.x);\n"
+"}\n";
+
+const char drawSource[] =
+"struct VertexOutput {\n"
+"    @builtin(position) position: vec4f,\n"
+"};\n"
+"@vertex\n"
+"fn vs_main(@location(0) corner: vec2f, @location(1) instance: vec4f) -> VertexOutput {\n"
+"    var out: VertexOutput;\n"
+"    out.position = vec4f(instance.xy + corner * instance.z, 0.0, 1.0);\n"
+"    return out;\n"
+"}\n"
+"@fragment\n"
+"fn fs_main(in: VertexOutput) -> @location(0) vec4f {\n"
+"    return vec4f(1.0);\n"
+"}\n";
+
+void adapterCallbackFunction(
+        enum WGPURequestAdapterStatus status,
+        WGPUAdapter adapter,
+        struct WGPUStringView label,
+        void* userdata1,
+        void* userdata2
+    ){
+    *((WGPUAdapter*)userdata1) = adapter;
+}
+void deviceCallbackFunction(
+        WGPURequestDeviceStatus status,
+        WGPUDevice device,
+        WGPUStringView message,
+        void* userdata1,
+        void* userdata2
+    ){
+    *((WGPUDevice*)userdata1) = device;
+}
+
+static WGPUShaderModule createWGSLModule(WGPUDevice device, const char* source){
+    WGPUShaderSourceWGSL wgslDesc = {
+        .chain = { .sType = WGPUSType_ShaderSourceWGSL },
+        .code = { .data = source, .length = WGPU_STRLEN }
+    };
+    return wgpuDeviceCreateShaderModule(device, &(WGPUShaderModuleDescriptor){ .nextInChain = &wgslDesc.chain });
+}
+
+int main(){
+    WGPUInstanceFeatureName instanceFeatures[1] = {
+        WGPUInstanceFeatureName_TimedWaitAny,
+    };
+    WGPUInstanceDescriptor instanceDescriptor = {
+        .requiredFeatures = instanceFeatures,
+        .requiredFeatureCount = 1,
+    };
+    WGPUInstance instance = wgpuCreateInstance(&instanceDescriptor);
+
+    WGPURequestAdapterOptions adapterOptions = {0};
+    adapterOptions.featureLevel = WGPUFeatureLevel_Core;
+    WGPURequestAdapterCallbackInfo adapterCallback = {0};
+    adapterCallback.callback = adapterCallbackFunction;
+    WGPUAdapter requestedAdapter;
+    adapterCallback.userdata1 = (void*)&requestedAdapter;
+    WGPUFutureWaitInfo winfo = {
+        .future = wgpuInstanceRequestAdapter(instance, &adapterOptions, adapterCallback),
+    };
+    wgpuInstanceWaitAny(instance, 1, &winfo, ~0ull);
+
+    WGPUDeviceDescriptor deviceDescriptor = {
+        .label = STRVIEW("WGPU Device"),
+    };
+    WGPUDevice device = NULL;
+    WGPURequestDeviceCallbackInfo requestDeviceCallbackInfo = {
+        .callback = deviceCallbackFunction,
+        .mode = WGPUCallbackMode_WaitAnyOnly,
+        .userdata1 = &device
+    };
+    WGPUFutureWaitInfo requestDeviceFutureWaitInfo = {
+        .future = wgpuAdapterRequestDevice(requestedAdapter, &deviceDescriptor, requestDeviceCallbackInfo),
+    };
+    wgpuInstanceWaitAny(instance, 1, &requestDeviceFutureWaitInfo, ~0ull);
+    WGPUQueue queue = wgpuDeviceGetQueue(device);
+
+    // A grid that deliberately overhangs the viewport so that the outer ring gets culled
+    float instanceData[INSTANCE_COUNT * 4];
+    uint32_t expectedVisible = 0;
+    for(uint32_t y = 0;y < GRID_SIZE;y++){
+        for(uint32_t x = 0;x < GRID_SIZE;x++){
+            float* inst = instanceData + 4 * (y * GRID_SIZE + x);
+            inst[0] = -1.1f + 2.2f * (x + 0.5f) / GRID_SIZE;
+            inst[1] = -1.1f + 2.2f * (y + 0.5f) / GRID_SIZE;
+            inst[2] = INSTANCE_RADIUS;
+            inst[3] = 0.0f;
+            if(fabsf(inst[0]) + inst[2] <= 1.0f && fabsf(inst[1]) + inst[2] <= 1.0f){
+                ++expectedVisible;
+            }
+        }
+    }
+    const float corners[8] = {-1,-1, 1,-1, 1,1, -1,1};
+    const uint32_t indices[6] = {0, 1, 2, 0, 2, 3};
+    const uint32_t zero = 0;
+
+    WGPUBuffer instanceBuffer = wgpuDeviceCreateBuffer(device, &(WGPUBufferDescriptor){
+        .size = sizeof(instanceData),
+        .usage = WGPUBufferUsage_Storage | WGPUBufferUsage_Vertex | WGPUBufferUsage_CopyDst
+    });
+    WGPUBuffer cornerBuffer = wgpuDeviceCreateBuffer(device, &(WGPUBufferDescriptor){
+        .size = sizeof(corners),
+        .usage = WGPUBufferUsage_Vertex | WGPUBufferUsage_CopyDst
+    });
+    WGPUBuffer indexBuffer = wgpuDeviceCreateBuffer(device, &(WGPUBufferDescriptor){
+        .size = sizeof(indices),
+        .usage = WGPUBufferUsage_Index | WGPUBufferUsage_CopyDst
+    });
+    WGPUBuffer drawBuffer = wgpuDeviceCreateBuffer(device, &(WGPUBufferDescriptor){
+        .size = INSTANCE_COUNT * 5 * sizeof(uint32_t),
+        .usage = WGPUBufferUsage_Storage | WGPUBufferUsage_Indirect
+    });
+    WGPUBuffer countBuffer = wgpuDeviceCreateBuffer(device, &(WGPUBufferDescriptor){
+        .size = sizeof(uint32_t),
+        .usage = WGPUBufferUsage_Storage | WGPUBufferUsage_Indirect | WGPUBufferUsage_CopySrc | WGPUBufferUsage_CopyDst
+    });
+    WGPUBuffer countReadback = wgpuDeviceCreateBuffer(device, &(WGPUBufferDescriptor){
+        .size = sizeof(uint32_t),
+        .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_MapRead
+    });
+    WGPUBuffer pixelReadback = wgpuDeviceCreateBuffer(device, &(WGPUBufferDescriptor){
+        .size = TARGET_SIZE * TARGET_SIZE * 4,
+        .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_MapRead
+    });
+    wgpuQueueWriteBuffer(queue, instanceBuffer, 0, instanceData, sizeof(instanceData));
+    wgpuQueueWriteBuffer(queue, cornerBuffer, 0, corners, sizeof(corners));
+    wgpuQueueWriteBuffer(queue, indexBuffer, 0, indices, sizeof(indices));
+    wgpuQueueWriteBuffer(queue, countBuffer, 0, &zero, sizeof(zero));
+
+    WGPUTexture target = wgpuDeviceCreateTexture(device, &(WGPUTextureDescriptor){
+        .usage = WGPUTextureUsage_RenderAttachment | WGPUTextureUsage_CopySrc,
+        .dimension = WGPUTextureDimension_2D,
+        .size = {TARGET_SIZE, TARGET_SIZE, 1},
+        .format = WGPUTextureFormat_RGBA8Unorm,
+        .mipLevelCount = 1,
+        .sampleCount = 1
+    });
+    WGPUTextureView targetView = wgpuTextureCreateView(target, &(WGPUTextureViewDescriptor){
+        .format = WGPUTextureFormat_RGBA8Unorm,
+        .dimension = WGPUTextureViewDimension_2D,
+        .baseMipLevel = 0,
+        .mipLevelCount = 1,
+        .baseArrayLayer = 0,
+        .arrayLayerCount = 1,
+        .aspect = WGPUTextureAspect_All,
+        .usage = WGPUTextureUsage_RenderAttachment
+    });
+
+    // Culling pipeline
+    WGPUShaderModule cullModule = createWGSLModule(device, cullSource);
+    WGPUBindGroupLayoutEntry cullLayoutEntries[3] = {
+        {.binding = 0, .visibility = WGPUShaderStage_Compute, .buffer.type = WGPUBufferBindingType_ReadOnlyStorage},
+        {.binding = 1, .visibility = WGPUShaderStage_Compute, .buffer.type = WGPUBufferBindingType_Storage},
+        {.binding = 2, .visibility = WGPUShaderStage_Compute, .buffer.type = WGPUBufferBindingType_Storage},
+    };
+    WGPUBindGroupLayout cullLayout = wgpuDeviceCreateBindGroupLayout(device, &(WGPUBindGroupLayoutDescriptor){
+        .entries = cullLayoutEntries,
+        .entryCount = 3
+    });
+    WGPUPipelineLayout cullPipelineLayout = wgpuDeviceCreatePipelineLayout(device, &(WGPUPipelineLayoutDescriptor){
+        .bindGroupLayoutCount = 1,
+        .bindGroupLayouts = &cullLayout,
+    });
+    WGPUComputePipeline cullPipeline = wgpuDeviceCreateComputePipeline(device, &(WGPUComputePipelineDescriptor){
+        .label = STRVIEW("Culling Pipeline"),
+        .layout = cullPipelineLayout,
+        .compute = {
+            .entryPoint = STRVIEW("cull_main"),
+            .module = cullModule,
+        }
+    });
+    WGPUBindGroupEntry cullEntries[3] = {
+        {.binding = 0, .buffer = instanceBuffer, .size = sizeof(instanceData)},
+        {.binding = 1, .buffer = drawBuffer,     .size = INSTANCE_COUNT * 5 * sizeof(uint32_t)},
+        {.binding = 2, .buffer = countBuffer,    .size = sizeof(uint32_t)},
+    };
+    WGPUBindGroup cullGroup = wgpuDeviceCreateBindGroup(device, &(WGPUBindGroupDescriptor){
+        .layout = cullLayout,
+        .entries = cullEntries,
+        .entryCount = 3
+    });
+
+    // Draw pipeline
+    WGPUShaderModule drawModule = createWGSLModule(device, drawSource);
+    WGPUVertexAttribute cornerAttribute = {
+        .shaderLocation = 0,
+        .format = WGPUVertexFormat_Float32x2,
+        .offset = 0,
+    };
+    WGPUVertexAttribute instanceAttribute = {
+        .shaderLocation = 1,
+        .format = WGPUVertexFormat_Float32x4,
+        .offset = 0,
+    };
+    WGPUVertexBufferLayout vbLayouts[2] = {
+        {
+            .arrayStride = sizeof(float) * 2,
+            .attributeCount = 1,
+            .attributes = &cornerAttribute,
+            .stepMode = WGPUVertexStepMode_Vertex
+        },
+        {
+            .arrayStride = sizeof(float) * 4,
+            .attributeCount = 1,
+            .attributes = &instanceAttribute,
+            .stepMode = WGPUVertexStepMode_Instance
+        },
+    };
+    WGPUColorTargetState colorTargetState = {
+        .format = WGPUTextureFormat_RGBA8Unorm,
+        .writeMask = WGPUColorWriteMask_All,
+    };
+    WGPUFragmentState fragmentState = {
+        .entryPoint = STRVIEW("fs_main"),
+        .module = drawModule,
+        .targetCount = 1,
+        .targets = &colorTargetState,
+    };
+    WGPUPipelineLayout drawPipelineLayout = wgpuDeviceCreatePipelineLayout(device, &(WGPUPipelineLayoutDescriptor){
+        .bindGroupLayoutCount = 0,
+    });
+    WGPURenderPipeline drawPipeline = wgpuDeviceCreateRenderPipeline(device, &(WGPURenderPipelineDescriptor){
+        .vertex = {
+            .module = drawModule,
+            .entryPoint = STRVIEW("vs_main"),
+            .bufferCount = 2,
+            .buffers = vbLayouts,
+        },
+        .fragment = &fragmentState,
+        .primitive = {
+            .topology = WGPUPrimitiveTopology_TriangleList,
+            .cullMode = WGPUCullMode_None,
+            .frontFace = WGPUFrontFace_CCW
+        },
+        .layout = drawPipelineLayout,
+        .multisample = {
+            .count = 1,
+            .mask = 0xffffffff
+        },
+    });
+
+    // The bundle never sees the culling results, it only references the buffers
+    const WGPUTextureFormat bundleFormat = WGPUTextureFormat_RGBA8Unorm;
+    WGPURenderBundleEncoder bundleEncoder = wgpuDeviceCreateRenderBundleEncoder(device, &(WGPURenderBundleEncoderDescriptor){
+        .colorFormatCount = 1,
+        .colorFormats = &bundleFormat,
+        .sampleCount = 1,
+    });
+    wgpuRenderBundleEncoderSetPipeline(bundleEncoder, drawPipeline);
+    wgpuRenderBundleEncoderSetVertexBuffer(bundleEncoder, 0, cornerBuffer, 0, sizeof(corners));
+    wgpuRenderBundleEncoderSetVertexBuffer(bundleEncoder, 1, instanceBuffer, 0, sizeof(instanceData));
+    wgpuRenderBundleEncoderSetIndexBuffer(bundleEncoder, indexBuffer, WGPUIndexFormat_Uint32, 0, sizeof(indices));
+    wgpuRenderBundleEncoderMultiDrawIndexedIndirect(bundleEncoder, drawBuffer, 0, INSTANCE_COUNT, countBuffer, 0);
+    WGPURenderBundle bundle = wgpuRenderBundleEncoderFinish(bundleEncoder, NULL);
+
+    WGPUCommandEncoder cenc = wgpuDeviceCreateCommandEncoder(device, NULL);
+    WGPUComputePassEncoder cpenc = wgpuCommandEncoderBeginComputePass(cenc, NULL);
+    wgpuComputePassEncoderSetPipeline(cpenc, cullPipeline);
+    wgpuComputePassEncoderSetBindGroup(cpenc, 0, cullGroup, 0, NULL);
+    wgpuComputePassEncoderDispatchWorkgroups(cpenc, (INSTANCE_COUNT + 63) / 64, 1, 1);
+    wgpuComputePassEncoderEnd(cpenc);
+    wgpuComputePassEncoderRelease(cpenc);
+
+    WGPURenderPassColorAttachment colorAttachment = {
+        .view = targetView,
+        .loadOp = WGPULoadOp_Clear,
+        .storeOp = WGPUStoreOp_Store,
+        .clearValue = {0, 0, 0, 0},
+        .depthSlice = WGPU_DEPTH_SLICE_UNDEFINED,
+    };
+    WGPURenderPassEncoder rpenc = wgpuCommandEncoderBeginRenderPass(cenc, &(const WGPURenderPassDescriptor){
+        .colorAttachmentCount = 1,
+        .colorAttachments = &colorAttachment,
+    });
+    wgpuRenderPassEncoderExecuteBundles(rpenc, 1, &bundle);
+    wgpuRenderPassEncoderEnd(rpenc);
+    wgpuRenderPassEncoderRelease(rpenc);
+
+    wgpuCommandEncoderCopyBufferToBuffer(cenc, countBuffer, 0, countReadback, 0, sizeof(uint32_t));
+    wgpuCommandEncoderCopyTextureToBuffer(cenc,
+        &(WGPUTexelCopyTextureInfo){
+            .texture = target,
+            .aspect = WGPUTextureAspect_All,
+        },
+        &(WGPUTexelCopyBufferInfo){
+            .buffer = pixelReadback,
+            .layout = {.bytesPerRow = TARGET_SIZE * 4, .rowsPerImage = TARGET_SIZE},
+        },
+        &(WGPUExtent3D){TARGET_SIZE, TARGET_SIZE, 1}
+    );
+    WGPUCommandBuffer cmdBuffer = wgpuCommandEncoderFinish(cenc, NULL);
+    wgpuCommandEncoderRelease(cenc);
+    wgpuQueueSubmit(queue, 1, &cmdBuffer);
+    wgpuCommandBufferRelease(cmdBuffer);
+
+    int failures = 0;
+    uint32_t* countRead = NULL;
+    wgpuBufferMap(countReadback, WGPUMapMode_Read, 0, sizeof(uint32_t), (void**)&countRead);
+    if(*countRead != expectedVisible){
+        printf("Draw count mismatch: GPU culled down to %u, expected %u\n", *countRead, expectedVisible);
+        ++failures;
+    }
+    wgpuBufferUnmap(countReadback);
+
+    // Every surviving instance covers its own center pixel, every culled one is off-screen
+    uint8_t* pixels = NULL;
+    wgpuBufferMap(pixelReadback, WGPUMapMode_Read, 0, TARGET_SIZE * TARGET_SIZE * 4, (void**)&pixels);
+    for(uint32_t i = 0;i < INSTANCE_COUNT;i++){
+        const float* inst = instanceData + 4 * i;
+        if(fabsf(inst[0]) + inst[2] > 1.0f || fabsf(inst[1]) + inst[2] > 1.0f){
+            continue;
+        }
+        uint32_t px = (uint32_t)((inst[0] * 0.5f + 0.5f) * TARGET_SIZE);
+        uint32_t py = (uint32_t)((0.5f - inst[1] * 0.5f) * TARGET_SIZE);
+        if(pixels[(py * TARGET_SIZE + px) * 4] != 255){
+            printf("Instance %u was not drawn\n", i);
+            ++failures;
+        }
+    }
+    wgpuBufferUnmap(pixelReadback);
+    printf("%u of %u instances visible, %s\n", expectedVisible, INSTANCE_COUNT, failures ? "FAILED" : "OK");
+
+    wgpuRenderBundleRelease(bundle);
+    wgpuRenderPipelineRelease(drawPipeline);
+    wgpuPipelineLayoutRelease(drawPipelineLayout);
+    wgpuShaderModuleRelease(drawModule);
+    wgpuBindGroupRelease(cullGroup);
+    wgpuComputePipelineRelease(cullPipeline);
+    wgpuPipelineLayoutRelease(cullPipelineLayout);
+    wgpuBindGroupLayoutRelease(cullLayout);
+    wgpuShaderModuleRelease(cullModule);
+    wgpuTextureViewRelease(targetView);
+    wgpuTextureRelease(target);
+    wgpuBufferRelease(pixelReadback);
+    wgpuBufferRelease(countReadback);
+    wgpuBufferRelease(countBuffer);
+    wgpuBufferRelease(drawBuffer);
+    wgpuBufferRelease(indexBuffer);
+    wgpuBufferRelease(cornerBuffer);
+    wgpuBufferRelease(instanceBuffer);
+    wgpuQueueRelease(queue);
+    wgpuDeviceRelease(device);
+    wgpuAdapterRelease(requestedAdapter);
+    wgpuInstanceRelease(instance);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,276 @@
+// Stress test for render bundle encoding from worker threads.
+// Every thread encodes and finishes its share of a few thousand bundles, each drawing one cell of a grid.
+// All bundles are then executed in a single render pass and every cell is checked in the readback.
+// Requires WGVK_BUILD_WGSL_SUPPORT.
+#include <wgvk.h>
+#include <wgvk_structs_impl.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#ifndef STRVIEW
+    #define STRVIEW(X) (WGPUStringView){X, sizeof(X) - 1}
+#endif
+
+#define GRID_SIZE 64
+#define BUNDLE_COUNT (GRID_SIZE * GRID_SIZE)
+#define TARGET_SIZE (GRID_SIZE * 4)
+#define MAX_THREADS 16
+
+const char wgslSource[] =
+"const gridSize = 64u;\n"
+"@vertex\n"
+"fn vs_main(@builtin(vertex_index) vertex: u32, @builtin(instance_index) cell: u32) -> @builtin(position) vec4f {\n"
+"    var corners = array<vec2f, 6>(vec2f(0, 0), vec2f(1, 0), vec2f(1, 1), vec2f(0, 0), vec2f(1, 1), vec2f(0, 1));\n"
+"    let origin = vec2f(f32(cell % gridSize), f32(cell / gridSize));\n"
+"    let ndc = (origin + corners[vertex]) / f32(gridSize) * 2.0 - 1.0;\n"
+"    return vec4f(ndc, 0.0, 1.0);\n"
+"}\n"
+"@fragment\n"
+"fn fs_main() -> @location(0) vec4f {\n"
+"    return vec4f(1.0);\n"
+"}\n";
+
+static uint64_t benchNanoTime(void){
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return ((uint64_t)ts.tv_sec) * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+void adapterCallbackFunction(
+        enum WGPURequestAdapterStatus status,
+        WGPUAdapter adapter,
+        struct WGPUStringView label,
+        void* userdata1,
+        void* userdata2
+    ){
+    *((WGPUAdapter*)userdata1) = adapter;
+}
+void deviceCallbackFunction(
+        WGPURequestDeviceStatus status,
+        WGPUDevice device,
+        WGPUStringView message,
+        void* userdata1,
+        void* userdata2
+    ){
+    *((WGPUDevice*)userdata1) = device;
+}
+
+typedef struct BundleJob{
+    WGPUDevice device;
+    WGPURenderPipeline pipeline;
+    WGPURenderBundle* output;
+    uint32_t firstCell;
+    uint32_t count;
+}BundleJob;
+
+static void* bundleThreadFunction(void* arg){
+    BundleJob* job = (BundleJob*)arg;
+    const WGPUTextureFormat format = WGPUTextureFormat_RGBA8Unorm;
+    for(uint32_t i = 0;i < job->count;i++){
+        WGPURenderBundleEncoder benc = wgpuDeviceCreateRenderBundleEncoder(job->device, &(WGPURenderBundleEncoderDescriptor){
+            .colorFormatCount = 1,
+            .colorFormats = &format,
+            .sampleCount = 1,
+        });
+        wgpuRenderBundleEncoderSetPipeline(benc, job->pipeline);
+        wgpuRenderBundleEncoderDraw(benc, 6, 1, 0, job->firstCell + i);
+        job->output[i] = wgpuRenderBundleEncoderFinish(benc, NULL);
+        wgpuRenderBundleEncoderRelease(benc);
+    }
+    return NULL;
+}
+
+int main(){
+    WGPUInstanceFeatureName instanceFeatures[1] = {
+        WGPUInstanceFeatureName_TimedWaitAny,
+    };
+    WGPUInstanceDescriptor instanceDescriptor = {
+        .requiredFeatures = instanceFeatures,
+        .requiredFeatureCount = 1,
+    };
+    WGPUInstance instance = wgpuCreateInstance(&instanceDescriptor);
+
+    WGPURequestAdapterOptions adapterOptions = {0};
+    adapterOptions.featureLevel = WGPUFeatureLevel_Core;
+    WGPURequestAdapterCallbackInfo adapterCallback = {0};
+    adapterCallback.callback = adapterCallbackFunction;
+    WGPUAdapter requestedAdapter;
+    adapterCallback.userdata1 = (void*)&requestedAdapter;
+    WGPUFutureWaitInfo winfo = {
+        .future = wgpuInstanceRequestAdapter(instance, &adapterOptions, adapterCallback),
+    };
+    wgpuInstanceWaitAny(instance, 1, &winfo, ~0ull);
+
+    WGPUDeviceDescriptor deviceDescriptor = {
+        .label = STRVIEW("WGPU Device"),
+    };
+    WGPUDevice device = NULL;
+    WGPURequestDeviceCallbackInfo requestDeviceCallbackInfo = {
+        .callback = deviceCallbackFunction,
+        .mode = WGPUCallbackMode_WaitAnyOnly,
+        .userdata1 = &device
+    };
+    WGPUFutureWaitInfo requestDeviceFutureWaitInfo = {
+        .future = wgpuAdapterRequestDevice(requestedAdapter, &deviceDescriptor, requestDeviceCallbackInfo),
+    };
+    wgpuInstanceWaitAny(instance, 1, &requestDeviceFutureWaitInfo, ~0ull);
+    WGPUQueue queue = wgpuDeviceGetQueue(device);
+
+    WGPUShaderSourceWGSL wgslDesc = {
+        .chain = { .sType = WGPUSType_ShaderSourceWGSL },
+        .code = { .data = wgslSource, .length = WGPU_STRLEN }
+    };
+    WGPUShaderModule shaderModule = wgpuDeviceCreateShaderModule(device, &(WGPUShaderModuleDescriptor){ .nextInChain = &wgslDesc.chain });
+    WGPUColorTargetState colorTargetState = {
+        .format = WGPUTextureFormat_RGBA8Unorm,
+        .writeMask = WGPUColorWriteMask_All,
+    };
+    WGPUFragmentState fragmentState = {
+        .entryPoint = STRVIEW("fs_main"),
+        .module = shaderModule,
+        .targetCount = 1,
+        .targets = &colorTargetState,
+    };
+    WGPUPipelineLayout pllayout = wgpuDeviceCreatePipelineLayout(device, &(WGPUPipelineLayoutDescriptor){
+        .bindGroupLayoutCount = 0,
+    });
+    WGPURenderPipeline pipeline = wgpuDeviceCreateRenderPipeline(device, &(WGPURenderPipelineDescriptor){
+        .vertex = {
+            .module = shaderModule,
+            .entryPoint = STRVIEW("vs_main"),
+        },
+        .fragment = &fragmentState,
+        .primitive = {
+            .topology = WGPUPrimitiveTopology_TriangleList,
+            .cullMode = WGPUCullMode_None,
+            .frontFace = WGPUFrontFace_CCW
+        },
+        .layout = pllayout,
+        .multisample = {
+            .count = 1,
+            .mask = 0xffffffff
+        },
+    });
+
+    WGPUTexture target = wgpuDeviceCreateTexture(device, &(WGPUTextureDescriptor){
+        .usage = WGPUTextureUsage_RenderAttachment | WGPUTextureUsage_CopySrc,
+        .dimension = WGPUTextureDimension_2D,
+        .size = {TARGET_SIZE, TARGET_SIZE, 1},
+        .format = WGPUTextureFormat_RGBA8Unorm,
+        .mipLevelCount = 1,
+        .sampleCount = 1
+    });
+    WGPUTextureView targetView = wgpuTextureCreateView(target, &(WGPUTextureViewDescriptor){
+        .format = WGPUTextureFormat_RGBA8Unorm,
+        .dimension = WGPUTextureViewDimension_2D,
+        .baseMipLevel = 0,
+        .mipLevelCount = 1,
+        .baseArrayLayer = 0,
+        .arrayLayerCount = 1,
+        .aspect = WGPUTextureAspect_All,
+        .usage = WGPUTextureUsage_RenderAttachment
+    });
+    WGPUBuffer readback = wgpuDeviceCreateBuffer(device, &(WGPUBufferDescriptor){
+        .size = TARGET_SIZE * TARGET_SIZE * 4,
+        .usage = WGPUBufferUsage_CopyDst | WGPUBufferUsage_MapRead
+    });
+
+    WGPURenderBundle* bundles = (WGPURenderBundle*)calloc(BUNDLE_COUNT, sizeof(WGPURenderBundle));
+    double singleThreadedSeconds = 0.0;
+    int failures = 0;
+
+    for(uint32_t threadCount = 1;threadCount <= MAX_THREADS;threadCount *= 2){
+        wgvk_thread_t threads[MAX_THREADS];
+        BundleJob jobs[MAX_THREADS];
+        const uint32_t perThread = BUNDLE_COUNT / threadCount;
+
+        const uint64_t begin = benchNanoTime();
+        for(uint32_t t = 0;t < threadCount;t++){
+            jobs[t] = (BundleJob){
+                .device = device,
+                .pipeline = pipeline,
+                .output = bundles + t * perThread,
+                .firstCell = t * perThread,
+                .count = perThread
+            };
+            wgvk_thread_create(threads + t, bundleThreadFunction, jobs + t);
+        }
+        for(uint32_t t = 0;t < threadCount;t++){
+            wgvk_thread_join(threads + t, NULL);
+        }
+        const double seconds = (double)(benchNanoTime() - begin) / 1e9;
+        if(threadCount == 1){
+            singleThreadedSeconds = seconds;
+        }
+        printf("%2u threads: %8.0f bundles/s, speedup %.2fx\n", threadCount, BUNDLE_COUNT / seconds, singleThreadedSeconds / seconds);
+
+        WGPUCommandEncoder cenc = wgpuDeviceCreateCommandEncoder(device, NULL);
+        WGPURenderPassColorAttachment colorAttachment = {
+            .view = targetView,
+            .loadOp = WGPULoadOp_Clear,
+            .storeOp = WGPUStoreOp_Store,
+            .clearValue = {0, 0, 0, 0},
+            .depthSlice = WGPU_DEPTH_SLICE_UNDEFINED,
+        };
+        WGPURenderPassEncoder rpenc = wgpuCommandEncoderBeginRenderPass(cenc, &(const WGPURenderPassDescriptor){
+            .colorAttachmentCount = 1,
+            .colorAttachments = &colorAttachment,
+        });
+        wgpuRenderPassEncoderExecuteBundles(rpenc, perThread * threadCount, bundles);
+        wgpuRenderPassEncoderEnd(rpenc);
+        wgpuRenderPassEncoderRelease(rpenc);
+        wgpuCommandEncoderCopyTextureToBuffer(cenc,
+            &(WGPUTexelCopyTextureInfo){
+                .texture = target,
+                .aspect = WGPUTextureAspect_All,
+            },
+            &(WGPUTexelCopyBufferInfo){
+                .buffer = readback,
+                .layout = {.bytesPerRow = TARGET_SIZE * 4, .rowsPerImage = TARGET_SIZE},
+            },
+            &(WGPUExtent3D){TARGET_SIZE, TARGET_SIZE, 1}
+        );
+        WGPUCommandBuffer cmdBuffer = wgpuCommandEncoderFinish(cenc, NULL);
+        wgpuCommandEncoderRelease(cenc);
+        wgpuQueueSubmit(queue, 1, &cmdBuffer);
+        wgpuCommandBufferRelease(cmdBuffer);
+
+        uint8_t* pixels = NULL;
+        wgpuBufferMap(readback, WGPUMapMode_Read, 0, TARGET_SIZE * TARGET_SIZE * 4, (void**)&pixels);
+        uint32_t missing = 0;
+        for(uint32_t cell = 0;cell < perThread * threadCount;cell++){
+            const uint32_t px = (cell % GRID_SIZE) * (TARGET_SIZE / GRID_SIZE) + (TARGET_SIZE / GRID_SIZE) / 2;
+            const uint32_t py = (cell / GRID_SIZE) * (TARGET_SIZE / GRID_SIZE) + (TARGET_SIZE / GRID_SIZE) / 2;
+            // The viewport is flipped, cell rows grow upwards in NDC and downwards in the image
+            const uint32_t row = TARGET_SIZE - 1 - py;
+            if(pixels[(row * TARGET_SIZE + px) * 4] != 255){
+                ++missing;
+            }
+        }
+        wgpuBufferUnmap(readback);
+        if(missing){
+            printf("%2u threads: %u of %u cells were not drawn\n", threadCount, missing, perThread * threadCount);
+            ++failures;
+        }
+
+        for(uint32_t i = 0;i < perThread * threadCount;i++){
+            wgpuRenderBundleRelease(bundles[i]);
+        }
+        wgpuDeviceTick(device);
+        wgpuDeviceTick(device);
+    }
+
+    free(bundles);
+    wgpuBufferRelease(readback);
+    wgpuTextureViewRelease(targetView);
+    wgpuTextureRelease(target);
+    wgpuRenderPipelineRelease(pipeline);
+    wgpuPipelineLayoutRelease(pllayout);
+    wgpuShaderModuleRelease(shaderModule);
+    wgpuQueueRelease(queue);
+    wgpuDeviceRelease(device);
+    wgpuAdapterRelease(requestedAdapter);
+    wgpuInstanceRelease(instance);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,254 @@
+// Measures how command encoding scales with the number of recording threads.
+// Every thread records its share of a fixed number of compute encoders; with
+// per-thread command pools the threads never contend on the same VkCommandPool.
+#include <wgvk.h>
+#include <wgvk_structs_impl.h>
+#include <external/volk.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#ifndef STRVIEW
+    #define STRVIEW(X) (WGPUStringView){X, sizeof(X) - 1}
+#endif
+const uint32_t binary_data[] = {
+    0x07230203, 0x00010300, 0x00170001, 0x0000002e, 0x00000000, 0x00020011, 0x00000001, 0x0006000b,
+    0x00000017, 0x4c534c47, 0x6474732e, 0x3035342e, 0x00000000, 0x0003000e, 0x00000000, 0x00000001,
+    0x0008000f, 0x00000005, 0x00000029, 0x706d6f63, 0x5f657475, 0x6e69616d, 0x00000000, 0x00000006,
+    0x00060010, 0x00000029, 0x00000011, 0x00000001, 0x00000001, 0x00000001, 0x00050006, 0x00000003,
+    0x00000000, 0x656e6e69, 0x00000072, 0x000a0005, 0x00000003, 0x61746164, 0x6f6c625f, 0x745f6b63,
+    0x5f746e69, 0x6c707865, 0x74696369, 0x79616c5f, 0x0074756f, 0x000c0005, 0x00000006, 0x706d6f63,
+    0x5f657475, 0x6e69616d, 0x6f6c675f, 0x5f6c6162, 0x6f766e69, 0x69746163, 0x695f6e6f, 0x6e495f64,
+    0x00747570, 0x00070005, 0x0000000a, 0x706d6f63, 0x5f657475, 0x6e69616d, 0x6e6e695f, 0x00007265,
+    0x00030005, 0x0000000c, 0x00006469, 0x00060005, 0x00000029, 0x706d6f63, 0x5f657475, 0x6e69616d,
+    0x00000000, 0x00040047, 0x00000004, 0x00000006, 0x00000004, 0x00050048, 0x00000003, 0x00000000,
+    0x00000023, 0x00000000, 0x00030047, 0x00000003, 0x00000002, 0x00040047, 0x00000001, 0x00000022,
+    0x00000000, 0x00040047, 0x00000001, 0x00000021, 0x00000000, 0x00030047, 0x00000001, 0x00000017,
+    0x00040047, 0x00000006, 0x0000000b, 0x0000001c, 0x00030016, 0x00000005, 0x00000020, 0x0003001d,
+    0x00000004, 0x00000005, 0x0003001e, 0x00000003, 0x00000004, 0x00040020, 0x00000002, 0x0000000c,
+    0x00000003, 0x0004003b, 0x00000002, 0x00000001, 0x0000000c, 0x00040015, 0x00000009, 0x00000020,
+    0x00000000, 0x00040017, 0x00000008, 0x00000009, 0x00000003, 0x00040020, 0x00000007, 0x00000001,
+    0x00000008, 0x0004003b, 0x00000007, 0x00000006, 0x00000001, 0x00020013, 0x0000000b, 0x00040021,
+    0x0000000d, 0x0000000b, 0x00000008, 0x00040020, 0x00000011, 0x0000000c, 0x00000004, 0x0004002b,
+    0x00000009, 0x00000012, 0x00000000, 0x0004002b, 0x00000009, 0x00000015, 0x00000001, 0x00040020,
+    0x00000019, 0x0000000c, 0x00000005, 0x00030021, 0x0000002a, 0x0000000b, 0x00050036, 0x0000000b,
+    0x0000000a, 0x00000000, 0x0000000d, 0x00030037, 0x00000008, 0x0000000c, 0x000200f8, 0x0000000e,
+    0x00050051, 0x00000009, 0x0000000f, 0x0000000c, 0x00000000, 0x00050041, 0x00000011, 0x00000010,
+    0x00000001, 0x00000012, 0x00050044, 0x00000009, 0x00000013, 0x00000001, 0x00000000, 0x00050082,
+    0x00000009, 0x00000014, 0x00000013, 0x00000015, 0x0007000c, 0x00000009, 0x00000016, 0x00000017,
+    0x00000026, 0x0000000f, 0x00000014, 0x00060041, 0x00000019, 0x00000018, 0x00000001, 0x00000012,
+    0x00000016, 0x00050051, 0x00000009, 0x0000001a, 0x0000000c, 0x00000000, 0x00050041, 0x00000011,
+    0x0000001b, 0x00000001, 0x00000012, 0x00050044, 0x00000009, 0x0000001c, 0x00000001, 0x00000000,
+    0x00050082, 0x00000009, 0x0000001d, 0x0000001c, 0x00000015, 0x0007000c, 0x00000009, 0x0000001e,
+    0x00000017, 0x00000026, 0x0000001a, 0x0000001d, 0x00060041, 0x00000019, 0x0000001f, 0x00000001,
+    0x00000012, 0x0000001e, 0x0005003d, 0x00000005, 0x00000020, 0x0000001f, 0x00000000, 0x00050051,
+    0x00000009, 0x00000021, 0x0000000c, 0x00000000, 0x00050041, 0x00000011, 0x00000022, 0x00000001,
+    0x00000012, 0x00050044, 0x00000009, 0x00000023, 0x00000001, 0x00000000, 0x00050082, 0x00000009,
+    0x00000024, 0x00000023, 0x00000015, 0x0007000c, 0x00000009, 0x00000025, 0x00000017, 0x00000026,
+    0x00000021, 0x00000024, 0x00060041, 0x00000019, 0x00000026, 0x00000001, 0x00000012, 0x00000025,
+    0x0005003d, 0x00000005, 0x00000027, 0x00000026, 0x00000000, 0x00050085, 0x00000005, 0x00000028,
+    0x00000020, 0x00000027, 0x0004003e, 0x00000018, 0x00000028, 0x00000000, 0x000100fd, 0x00010038,
+    0x00050036, 0x0000000b, 0x00000029, 0x00000000, 0x0000002a, 0x000200f8, 0x0000002b, 0x0005003d,
+    0x00000008, 0x0000002c, 0x00000006, 0x00000000, 0x00050039, 0x0000000b, 0x0000002d, 0x0000000a,
+    0x0000002c, 0x000100fd, 0x00010038
+};
+
+#define ENCODER_COUNT 4096
+#define DISPATCHES_PER_ENCODER 16
+#define MAX_THREADS 16
+
+static uint64_t benchNanoTime(void){
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return ((uint64_t)ts.tv_sec) * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+void adapterCallbackFunction(
+        enum WGPURequestAdapterStatus status,
+        WGPUAdapter adapter,
+        struct WGPUStringView label,
+        void* userdata1,
+        void* userdata2
+    ){
+    *((WGPUAdapter*)userdata1) = adapter;
+}
+void deviceCallbackFunction(
+        WGPURequestDeviceStatus status,
+        WGPUDevice device,
+        WGPUStringView message,
+        void* userdata1,
+        void* userdata2
+    ){
+    *((WGPUDevice*)userdata1) = device;
+}
+
+typedef struct EncodeJob{
+    WGPUDevice device;
+    WGPUComputePipeline pipeline;
+    WGPUBindGroup group;
+    WGPUCommandBuffer* output;
+    uint32_t count;
+}EncodeJob;
+
+static void* encodeThreadFunction(void* arg){
+    EncodeJob* job = (EncodeJob*)arg;
+    for(uint32_t i = 0;i < job->count;i++){
+        WGPUCommandEncoder cenc = wgpuDeviceCreateCommandEncoder(job->device, NULL);
+        WGPUComputePassEncoder cpenc = wgpuCommandEncoderBeginComputePass(cenc, NULL);
+        wgpuComputePassEncoderSetPipeline(cpenc, job->pipeline);
+        wgpuComputePassEncoderSetBindGroup(cpenc, 0, job->group, 0, NULL);
+        for(uint32_t d = 0;d < DISPATCHES_PER_ENCODER;d++){
+            wgpuComputePassEncoderDispatchWorkgroups(cpenc, 1, 1, 1);
+        }
+        wgpuComputePassEncoderEnd(cpenc);
+        wgpuComputePassEncoderRelease(cpenc);
+        job->output[i] = wgpuCommandEncoderFinish(cenc, NULL);
+        wgpuCommandEncoderRelease(cenc);
+    }
+    return NULL;
+}
+
+int main(){
+    WGPUInstanceFeatureName instanceFeatures[2] = {
+        WGPUInstanceFeatureName_TimedWaitAny,
+        WGPUInstanceFeatureName_ShaderSourceSPIRV,
+    };
+    WGPUInstanceDescriptor instanceDescriptor = {
+        .requiredFeatures = instanceFeatures,
+        .requiredFeatureCount = 2,
+    };
+    WGPUInstance instance = wgpuCreateInstance(&instanceDescriptor);
+
+    WGPURequestAdapterOptions adapterOptions = {0};
+    adapterOptions.featureLevel = WGPUFeatureLevel_Core;
+    WGPURequestAdapterCallbackInfo adapterCallback = {0};
+    adapterCallback.callback = adapterCallbackFunction;
+    WGPUAdapter requestedAdapter;
+    adapterCallback.userdata1 = (void*)&requestedAdapter;
+    WGPUFutureWaitInfo winfo = {
+        .future = wgpuInstanceRequestAdapter(instance, &adapterOptions, adapterCallback),
+    };
+    wgpuInstanceWaitAny(instance, 1, &winfo, ~0ull);
+
+    WGPUDeviceDescriptor deviceDescriptor = {
+        .label = STRVIEW("WGPU Device"),
+    };
+    WGPUDevice device = NULL;
+    WGPURequestDeviceCallbackInfo requestDeviceCallbackInfo = {
+        .callback = deviceCallbackFunction,
+        .mode = WGPUCallbackMode_WaitAnyOnly,
+        .userdata1 = &device
+    };
+    WGPUFutureWaitInfo requestDeviceFutureWaitInfo = {
+        .future = wgpuAdapterRequestDevice(requestedAdapter, &deviceDescriptor, requestDeviceCallbackInfo),
+    };
+    wgpuInstanceWaitAny(instance, 1, &requestDeviceFutureWaitInfo, ~0ull);
+
+    WGPUShaderSourceSPIRV computeSourceSpirv = {
+        .chain = {
+            .next = NULL,
+            .sType = WGPUSType_ShaderSourceSPIRV
+        },
+        .code = binary_data,
+        .codeSize = sizeof(binary_data)
+    };
+    WGPUShaderModuleDescriptor computeModuleDesc = {
+        .nextInChain = &computeSourceSpirv.chain,
+        .label = STRVIEW("Compute Module"),
+    };
+    WGPUShaderModule computeModule = wgpuDeviceCreateShaderModule(device, &computeModuleDesc);
+
+    WGPUBindGroupLayoutEntry bglEntries[1] = {
+        [0] = {
+            .binding = 0,
+            .visibility = WGPUShaderStage_Compute,
+            .buffer = {
+                .type = WGPUBufferBindingType_Storage,
+                .minBindingSize = 4
+            }
+        }
+    };
+    WGPUBindGroupLayout layout = wgpuDeviceCreateBindGroupLayout(device, &(WGPUBindGroupLayoutDescriptor){
+        .entries = bglEntries,
+        .entryCount = 1
+    });
+    WGPUPipelineLayout pllayout = wgpuDeviceCreatePipelineLayout(device, &(WGPUPipelineLayoutDescriptor){
+        .bindGroupLayoutCount = 1,
+        .bindGroupLayouts = &layout,
+    });
+    WGPUComputePipeline cpl = wgpuDeviceCreateComputePipeline(device, &(WGPUComputePipelineDescriptor){
+        .label = STRVIEW("Compute Pipeline"),
+        .layout = pllayout,
+        .compute = {
+            .entryPoint = STRVIEW("compute_main"),
+            .module = computeModule,
+        }
+    });
+    WGPUBuffer stbuf = wgpuDeviceCreateBuffer(device, &(WGPUBufferDescriptor){
+        .size = 64,
+        .usage = WGPUBufferUsage_Storage
+    });
+    WGPUBindGroupEntry entries[1] = {
+        (WGPUBindGroupEntry){
+            .binding = 0,
+            .buffer = stbuf,
+            .size = 64,
+        }
+    };
+    WGPUBindGroup group = wgpuDeviceCreateBindGroup(device, &(WGPUBindGroupDescriptor){
+        .entries = entries,
+        .entryCount = 1,
+        .layout = layout
+    });
+    WGPUQueue queue = wgpuDeviceGetQueue(device);
+
+    WGPUCommandBuffer* commandBuffers = (WGPUCommandBuffer*)calloc(ENCODER_COUNT, sizeof(WGPUCommandBuffer));
+    double singleThreadedSeconds = 0.0;
+
+    for(uint32_t threadCount = 1;threadCount <= MAX_THREADS;threadCount *= 2){
+        wgvk_thread_t threads[MAX_THREADS];
+        EncodeJob jobs[MAX_THREADS];
+        const uint32_t perThread = ENCODER_COUNT / threadCount;
+
+        const uint64_t begin = benchNanoTime();
+        for(uint32_t t = 0;t < threadCount;t++){
+            jobs[t] = (EncodeJob){
+                .device = device,
+                .pipeline = cpl,
+                .group = group,
+                .output = commandBuffers + t * perThread,
+                .count = perThread
+            };
+            wgvk_thread_create(threads + t, encodeThreadFunction, jobs + t);
+        }
+        for(uint32_t t = 0;t < threadCount;t++){
+            wgvk_thread_join(threads + t, NULL);
+        }
+        const double seconds = (double)(benchNanoTime() - begin) / 1e9;
+        if(threadCount == 1){
+            singleThreadedSeconds = seconds;
+        }
+        printf("%2u threads: %8.0f encoders/s, speedup %.2fx\n", threadCount, ENCODER_COUNT / seconds, singleThreadedSeconds / seconds);
+
+        wgpuQueueSubmit(queue, perThread * threadCount, commandBuffers);
+        for(uint32_t i = 0;i < perThread * threadCount;i++){
+            wgpuCommandBufferRelease(commandBuffers[i]);
+        }
+        // Retires the submitted command buffers so their pools can be reset in bulk
+        wgpuDeviceTick(device);
+        wgpuDeviceTick(device);
+    }
+
+    free(commandBuffers);
+    wgpuBindGroupRelease(group);
+    wgpuBufferRelease(stbuf);
+    wgpuComputePipelineRelease(cpl);
+    wgpuShaderModuleRelease(computeModule);
+    wgpuPipelineLayoutRelease(pllayout);
+    wgpuBindGroupLayoutRelease(layout);
+    wgpuQueueRelease(queue);
+    wgpuDeviceRelease(device);
+    wgpuAdapterRelease(requestedAdapter);
+    wgpuInstanceRelease(instance);
+    return 0;
+}
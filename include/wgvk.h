@@ -291,6 +291,8 @@ typedef enum WGPUSType {
     WGPUSType_ShaderSourceGLSL = 0x10000003,
     WGPUSType_PrimitiveLineWidthInfo = 0x10000004,
     WGPUSType_SurfaceSourceDrmPlane = 0x10000005,
+    WGPUSType_AsyncComputeQueueSelection = 0x10000006,
+    WGPUSType_CommandEncoderQueueSelection = 0x10000007,
 }WGPUSType WGPU_ENUM_ATTRIBUTE;
 
 typedef enum WGPUCallbackMode {
@@ -1310,6 +1312,15 @@ typedef struct WGPUDeviceDescriptor {
     WGPUUncapturedErrorCallbackInfo uncapturedErrorCallbackInfo;
 } WGPUDeviceDescriptor WGPU_STRUCT_ATTRIBUTE;
 
+// Chained in WGPUDeviceDescriptor to request the async compute queue, which normally needs a compute-only queue family.
+// With allowGraphicsFamily set a device without one gets it on the graphics family instead: a second queue if the
+// family has one, otherwise the default queue's VkQueue, in which case submits to the two queues are serialized.
+// That path exists to exercise the cross queue tracking
+typedef struct WGPUAsyncComputeQueueSelection{
+    WGPUChainedStruct chain;
+    WGPUBool allowGraphicsFamily;
+}WGPUAsyncComputeQueueSelection;
+
 typedef struct WGPUColor {
     double r;
     double g;
@@ -1371,6 +1382,12 @@ typedef struct WGPUCommandEncoderDescriptor{
     WGPUStringView label;
 }WGPUCommandEncoderDescriptor;
 
+// Can be chained in WGPUCommandEncoderDescriptor, required for command buffers submitted to a queue other than the default one
+typedef struct WGPUCommandEncoderQueueSelection{
+    WGPUChainedStruct chain;
+    WGPUQueue queue;
+}WGPUCommandEncoderQueueSelection;
+
 typedef struct Extent3D{
     uint32_t width, height, depthOrArrayLayers;
 }Extent3D;
@@ -1917,6 +1934,10 @@ WGVK_EXPORT WGPUStatus wgpuDeviceGetAdapterInfo(WGPUDevice device, WGPUAdapterIn
 WGVK_EXPORT WGPUStatus wgpuAdapterGetLimits(WGPUAdapter adapter, WGPULimits * limits) WGPU_FUNCTION_ATTRIBUTE;
 WGVK_EXPORT WGPUFuture wgpuAdapterRequestDevice(WGPUAdapter adapter, WGPU_NULLABLE WGPUDeviceDescriptor const * options, WGPURequestDeviceCallbackInfo callbackInfo) WGPU_FUNCTION_ATTRIBUTE;
 WGVK_EXPORT WGPUQueue wgpuDeviceGetQueue(WGPUDevice device);
+// Compute and copy only queue that runs alongside the default one. Resources used on both are handed over
+// at submit: the later submit waits for the other queue and queue family ownership is transferred if needed.
+// NULL unless the device was created with a WGPUAsyncComputeQueueSelection and has a queue for it and timeline semaphores
+WGVK_EXPORT WGPU_NULLABLE WGPUQueue wgpuDeviceGetAsyncComputeQueue(WGPUDevice device);
 WGVK_EXPORT void wgpuSurfaceGetCapabilities(WGPUSurface wgpuSurface, WGPUAdapter adapter, WGPUSurfaceCapabilities* capabilities);
 WGVK_EXPORT void wgpuSurfaceConfigure(WGPUSurface surface, const WGPUSurfaceConfiguration* config);
 WGVK_EXPORT void wgpuSurfaceRelease(WGPUSurface surface);
@@ -1941,10 +1962,20 @@ WGVK_EXPORT void wgpuBufferUnmap(WGPUBuffer buffer);
 WGVK_EXPORT WGPUFuture wgpuBufferMapAsync(WGPUBuffer buffer, WGPUMapMode mode, size_t offset, size_t size, WGPUBufferMapCallbackInfo callbackInfo);
 WGVK_EXPORT size_t wgpuBufferGetSize(WGPUBuffer buffer);
 WGVK_EXPORT void wgpuQueueWriteTexture(WGPUQueue queue, WGPUTexelCopyTextureInfo const * destination, const void* data, size_t dataSize, WGPUTexelCopyBufferLayout const * dataLayout, WGPUExtent3D const * writeSize);
+// Reads size bytes at fileOffset of fd into buffer on the device's worker threads, WGVK_FILE_UPLOAD_MAX_CHUNKS_IN_FLIGHT chunks
+// at a time. Each wgpuQueueSubmit on queue records the copies of the chunks read so far and starts reading the next ones.
+// wgpuInstanceProcessEvents does the same and submits the recorded copies, waiting on the future does so until the upload
+// is done. The callback is invoked once the GPU finished all copies, with WGPUQueueWorkDoneStatus_Error if the file could
+// not be read in full. fd has to stay open until then.
+WGVK_EXPORT WGPUFuture wgpuQueueWriteBufferFromFile(WGPUQueue queue, WGPUBuffer buffer, uint64_t bufferOffset, int fd, uint64_t fileOffset, uint64_t size, WGPUQueueWorkDoneCallbackInfo callbackInfo);
 
 WGVK_EXPORT WGPUFence wgpuDeviceCreateFence                      (WGPUDevice device);
 WGVK_EXPORT void wgpuFenceWait                                   (WGPUFence fence, uint64_t timeoutNS);
+// Waits for all fences, same as wgpuFencesWaitEx with waitAll set
 WGVK_EXPORT void wgpuFencesWait                                  (const WGPUFence* fences, uint32_t fenceCount, uint64_t timeoutNS);
+// Waits for all fences, or for any of them if waitAll is zero, with a single wait on the device. NULL entries are skipped.
+// Returns WGPUWaitStatus_TimedOut if timeoutNS passed first, the fences that signalled by then are completed either way
+WGVK_EXPORT WGPUWaitStatus wgpuFencesWaitEx                      (const WGPUFence* fences, uint32_t fenceCount, WGPUBool waitAll, uint64_t timeoutNS);
 WGVK_EXPORT void wgpuFenceAttachCallback                         (WGPUFence fence, void(*callback)(void*), void* userdata);
 WGVK_EXPORT void wgpuFenceAddRef                                 (WGPUFence fence);
 WGVK_EXPORT void wgpuFenceRelease                                (WGPUFence fence);
@@ -1958,7 +1989,12 @@ WGVK_EXPORT WGPUBindGroup wgpuDeviceCreateBindGroup              (WGPUDevice dev
 WGVK_EXPORT void wgpuWriteBindGroup                              (WGPUDevice device, WGPUBindGroup, const WGPUBindGroupDescriptor* bgdesc);
 WGVK_EXPORT WGPUCommandEncoder wgpuDeviceCreateCommandEncoder    (WGPUDevice device, const WGPUCommandEncoderDescriptor* cdesc);
 WGVK_EXPORT WGPUCommandBuffer wgpuCommandEncoderFinish           (WGPUCommandEncoder commandEncoder, WGPU_NULLABLE WGPUCommandBufferDescriptor const * descriptor);
+// Ends the frame: submits what the queues recorded on their own, then waits until the GPU released the frame slot
+// that is reused next. Callbacks of the fences retired there run on the calling thread
 WGVK_EXPORT void wgpuDeviceTick                                  (WGPUDevice device);
+// Retires the submissions of earlier frames the GPU already completed and runs their callbacks, never waits.
+// Returns whether the next wgpuDeviceTick can reuse its frame slot without waiting for the GPU
+WGVK_EXPORT WGPUBool wgpuDevicePoll                              (WGPUDevice device);
 WGVK_EXPORT void wgpuQueueSubmit                                 (WGPUQueue queue, size_t commandCount, const WGPUCommandBuffer* buffers);
 WGVK_EXPORT void wgpuQueueWaitIdle                               (WGPUQueue queue);
 WGVK_EXPORT void wgpuCommandEncoderCopyBufferToBuffer            (WGPUCommandEncoder commandEncoder, WGPUBuffer source, uint64_t sourceOffset, WGPUBuffer destination, uint64_t destinationOffset, uint64_t size);
@@ -2004,12 +2040,18 @@ WGVK_EXPORT void wgpuRenderBundleEncoderDraw(WGPURenderBundleEncoder renderBundl
 WGVK_EXPORT void wgpuRenderBundleEncoderDrawIndexed(WGPURenderBundleEncoder renderBundleEncoder, uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex, int32_t baseVertex, uint32_t firstInstance) WGPU_FUNCTION_ATTRIBUTE;
 WGVK_EXPORT void wgpuRenderBundleEncoderDrawIndexedIndirect(WGPURenderBundleEncoder renderBundleEncoder, WGPUBuffer indirectBuffer, uint64_t indirectOffset) WGPU_FUNCTION_ATTRIBUTE;
 WGVK_EXPORT void wgpuRenderBundleEncoderDrawIndirect(WGPURenderBundleEncoder renderBundleEncoder, WGPUBuffer indirectBuffer, uint64_t indirectOffset) WGPU_FUNCTION_ATTRIBUTE;
+WGVK_EXPORT void wgpuRenderBundleEncoderMultiDrawIndexedIndirect(WGPURenderBundleEncoder renderBundleEncoder, WGPUBuffer indirectBuffer, uint64_t indirectOffset, uint32_t maxDrawCount, WGPU_NULLABLE WGPUBuffer drawCountBuffer, uint64_t drawCountBufferOffset) WGPU_FUNCTION_ATTRIBUTE;
+WGVK_EXPORT void wgpuRenderBundleEncoderMultiDrawIndirect(WGPURenderBundleEncoder renderBundleEncoder, WGPUBuffer indirectBuffer, uint64_t indirectOffset, uint32_t maxDrawCount, WGPU_NULLABLE WGPUBuffer drawCountBuffer, uint64_t drawCountBufferOffset) WGPU_FUNCTION_ATTRIBUTE;
 WGVK_EXPORT void wgpuRenderBundleEncoderSetBindGroup(WGPURenderBundleEncoder renderBundleEncoder, uint32_t groupIndex, WGPU_NULLABLE WGPUBindGroup group, size_t dynamicOffsetCount, uint32_t const * dynamicOffsets) WGPU_FUNCTION_ATTRIBUTE;
 WGVK_EXPORT void wgpuRenderBundleEncoderSetIndexBuffer(WGPURenderBundleEncoder renderBundleEncoder, WGPUBuffer buffer, WGPUIndexFormat format, uint64_t offset, uint64_t size) WGPU_FUNCTION_ATTRIBUTE;
 WGVK_EXPORT void wgpuRenderBundleEncoderSetPipeline(WGPURenderBundleEncoder renderBundleEncoder, WGPURenderPipeline pipeline) WGPU_FUNCTION_ATTRIBUTE;
 WGVK_EXPORT void wgpuRenderBundleEncoderSetVertexBuffer(WGPURenderBundleEncoder renderBundleEncoder, uint32_t slot, WGPU_NULLABLE WGPUBuffer buffer, uint64_t offset, uint64_t size) WGPU_FUNCTION_ATTRIBUTE;
 WGVK_EXPORT void wgpuRenderBundleEncoderAddRef(WGPURenderBundleEncoder renderBundleEncoder) WGPU_FUNCTION_ATTRIBUTE;
 WGVK_EXPORT void wgpuRenderBundleEncoderRelease(WGPURenderBundleEncoder renderBundleEncoder) WGPU_FUNCTION_ATTRIBUTE;
+// Bundles are recorded once into a secondary command buffer that inherits viewport and scissor, executing one is a single
+// vkCmdExecuteCommands as long as the pass uses a [0, 1] depth range, the default blend constants and stencil reference 0.
+// Devices without VK_NV_inherited_viewport_scissor and VK_KHR_maintenance7 (e.g. lavapipe) and passes with other dynamic
+// state replay the bundle's commands into the pass instead, see RENDERBUNDLES_AS_SECONDARY_COMMANDBUFFERS
 WGVK_EXPORT void wgpuRenderPassEncoderExecuteBundles(WGPURenderPassEncoder renderPassEncoder, size_t bundleCount, WGPURenderBundle const * bundles) WGPU_FUNCTION_ATTRIBUTE;
 
 WGVK_EXPORT void wgpuAdapterInfoFreeMembers(WGPUAdapterInfo value) WGPU_FUNCTION_ATTRIBUTE;
@@ -2068,6 +2110,7 @@ WGVK_EXPORT void wgpuDevicePushErrorScope(WGPUDevice device, WGPUErrorFilter fil
 WGVK_EXPORT void wgpuDeviceSetLabel(WGPUDevice device, WGPUStringView label) WGPU_FUNCTION_ATTRIBUTE;
 WGVK_EXPORT WGPUStatus wgpuInstanceGetWGSLLanguageFeatures(WGPUInstance instance, WGPUSupportedWGSLLanguageFeatures * features) WGPU_FUNCTION_ATTRIBUTE;
 WGVK_EXPORT WGPUBool wgpuInstanceHasWGSLLanguageFeature(WGPUInstance instance, WGPUWGSLLanguageFeatureName feature) WGPU_FUNCTION_ATTRIBUTE;
+// Runs the callbacks of AllowProcessEvents and AllowSpontaneous futures whose work is done, never waits for the GPU
 WGVK_EXPORT void wgpuInstanceProcessEvents(WGPUInstance instance) WGPU_FUNCTION_ATTRIBUTE;
 WGVK_EXPORT void wgpuPipelineLayoutSetLabel(WGPUPipelineLayout pipelineLayout, WGPUStringView label) WGPU_FUNCTION_ATTRIBUTE;
 WGVK_EXPORT void wgpuQuerySetDestroy(WGPUQuerySet querySet) WGPU_FUNCTION_ATTRIBUTE;
@@ -2077,6 +2120,8 @@ WGVK_EXPORT void wgpuQuerySetSetLabel(WGPUQuerySet querySet, WGPUStringView labe
 WGVK_EXPORT void wgpuQuerySetAddRef(WGPUQuerySet querySet) WGPU_FUNCTION_ATTRIBUTE;
 WGVK_EXPORT void wgpuQuerySetRelease(WGPUQuerySet querySet) WGPU_FUNCTION_ATTRIBUTE;
 WGVK_EXPORT WGPUFuture wgpuQueueOnSubmittedWorkDone(WGPUQueue queue, WGPUQueueWorkDoneCallbackInfo callbackInfo) WGPU_FUNCTION_ATTRIBUTE;
+// Signals fence once the work submitted to queue so far completed. fence has to be fresh from wgpuDeviceCreateFence
+WGVK_EXPORT void wgpuQueueSignalFence(WGPUQueue queue, WGPUFence fence) WGPU_FUNCTION_ATTRIBUTE;
 WGVK_EXPORT void wgpuQueueSetLabel(WGPUQueue queue, WGPUStringView label) WGPU_FUNCTION_ATTRIBUTE;
 WGVK_EXPORT void wgpuRenderBundleSetLabel(WGPURenderBundle renderBundle, WGPUStringView label) WGPU_FUNCTION_ATTRIBUTE;
 WGVK_EXPORT void wgpuRenderBundleAddRef(WGPURenderBundle renderBundle) WGPU_FUNCTION_ATTRIBUTE;
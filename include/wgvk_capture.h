@@ -0,0 +1,243 @@
+#ifndef WGVK_CAPTURE_H
+#define WGVK_CAPTURE_H
+#include <stdint.h>
+
+/*
+ * Trace format shared by the capture layer (src/wgvk_capture.c, built with WGVK_ENABLE_CAPTURE)
+ * and tools/wgvk_replay.c.
+ *
+ * Capturing starts in wgpuCreateInstance if the environment variable WGVK_CAPTURE_FILE names a writable path
+ * and the file is finalized at exit. The trace starts with WGVKCaptureHeader, followed by records of the form
+ *
+ *     uint32_t op; uint32_t payloadSize; uint8_t payload[payloadSize];
+ *
+ * Payloads are a flat sequence of little endian scalars in the order documented next to each op.
+ * Objects are referenced by 64 bit ids, 0 is NULL. Ids are handed out in creation order and never reused,
+ * devices, queues and surfaces receive theirs the first time they are seen.
+ * Strings and blobs are prefixed with their length as u32 (strings) or u64 (blobs).
+ *
+ * Only calls that create GPU work or objects are recorded; labels, debug groups, queries, getters
+ * the raytracing extension and wgpuQueueWriteBufferFromFile are not part of the trace.
+ */
+
+#define WGVK_CAPTURE_MAGIC "WGVKCAP"
+#define WGVK_CAPTURE_VERSION 1
+
+typedef struct WGVKCaptureHeader{
+    char magic[8];
+    uint32_t version;
+    uint32_t pointerSize;
+}WGVKCaptureHeader;
+
+typedef enum WGVKCaptureObjectType{
+    WGVKCaptureObjectType_Buffer = 1,
+    WGVKCaptureObjectType_Texture,
+    WGVKCaptureObjectType_TextureView,
+    WGVKCaptureObjectType_Sampler,
+    WGVKCaptureObjectType_ShaderModule,
+    WGVKCaptureObjectType_BindGroupLayout,
+    WGVKCaptureObjectType_PipelineLayout,
+    WGVKCaptureObjectType_BindGroup,
+    WGVKCaptureObjectType_RenderPipeline,
+    WGVKCaptureObjectType_ComputePipeline,
+    WGVKCaptureObjectType_CommandEncoder,
+    WGVKCaptureObjectType_CommandBuffer,
+    WGVKCaptureObjectType_RenderPassEncoder,
+    WGVKCaptureObjectType_ComputePassEncoder,
+    WGVKCaptureObjectType_RenderBundleEncoder,
+    WGVKCaptureObjectType_RenderBundle,
+}WGVKCaptureObjectType;
+
+typedef enum WGVKCaptureOp{
+    WGVKCaptureOp_Invalid = 0,
+
+    // Object creation, the new object's id follows the parent
+    WGVKCaptureOp_CreateBuffer = 1,                 // device, buffer, u64 usage, u64 size, u32 mappedAtCreation
+    WGVKCaptureOp_CreateTexture,                    // device, texture, u64 usage, u32 dimension, u32 width, height, depthOrArrayLayers, u32 format, mipLevelCount, sampleCount, u32 viewFormatCount, u32 viewFormats[]
+    WGVKCaptureOp_TextureCreateView,                // texture, view, u32 hasDescriptor, [u32 format, dimension, baseMipLevel, mipLevelCount, baseArrayLayer, arrayLayerCount, aspect, u64 usage, u32 hasSwizzle, u32 r, g, b, a]
+    WGVKCaptureOp_CreateSampler,                    // device, sampler, u32 addressModeU, V, W, magFilter, minFilter, mipmapFilter, f32 lodMinClamp, lodMaxClamp, u32 compare, maxAnisotropy
+    WGVKCaptureOp_CreateShaderModule,               // device, module, u32 sType, u32 stage, blob code
+    WGVKCaptureOp_CreateBindGroupLayout,            // device, layout, u32 entryCount, entries[]
+    WGVKCaptureOp_CreatePipelineLayout,             // device, layout, u32 count, bindGroupLayouts[], u32 immediateDataRangeByteSize
+    WGVKCaptureOp_CreateBindGroup,                  // device, group, layout, u32 entryCount, {u32 binding, buffer, u64 offset, u64 size, sampler, textureView}[]
+    WGVKCaptureOp_CreateRenderPipeline,             // device, pipeline, layout, vertex, primitive, depthStencil?, multisample, fragment?
+    WGVKCaptureOp_CreateComputePipeline,            // device, pipeline, layout, module, string entryPoint, constants
+    WGVKCaptureOp_RenderPipelineGetBindGroupLayout, // pipeline, u32 groupIndex, layout
+    WGVKCaptureOp_ComputePipelineGetBindGroupLayout,// pipeline, u32 groupIndex, layout
+    WGVKCaptureOp_CreateCommandEncoder,             // device, encoder
+    WGVKCaptureOp_CreateRenderBundleEncoder,        // device, encoder, u32 colorFormatCount, u32 colorFormats[], u32 depthStencilFormat, sampleCount, depthReadOnly, stencilReadOnly
+
+    // Object lifetime
+    WGVKCaptureOp_AddRef = 32,                      // u32 WGVKCaptureObjectType, object
+    WGVKCaptureOp_Release,                          // u32 WGVKCaptureObjectType, object
+    WGVKCaptureOp_BufferDestroy,                    // buffer
+    WGVKCaptureOp_TextureDestroy,                   // texture
+    WGVKCaptureOp_BufferUnmap,                      // buffer, u32 mapMode, u64 offset, u64 size, blob contents (empty unless mapped for writing)
+
+    // Queue
+    WGVKCaptureOp_QueueWriteBuffer = 48,            // queue, buffer, u64 offset, blob data
+    WGVKCaptureOp_QueueWriteTexture,                // queue, texelCopyTexture, texelCopyBufferLayout, extent, blob data
+    WGVKCaptureOp_QueueSubmit,                      // queue, u32 count, commandBuffers[], u64 timestamp
+
+    // Command encoder
+    WGVKCaptureOp_BeginRenderPass = 64,             // encoder, pass, u32 colorAttachmentCount, colorAttachments[], u32 hasDepthStencil, [depthStencilAttachment]
+    WGVKCaptureOp_BeginComputePass,                 // encoder, pass
+    WGVKCaptureOp_CopyBufferToBuffer,               // encoder, source, u64 sourceOffset, destination, u64 destinationOffset, u64 size
+    WGVKCaptureOp_CopyBufferToTexture,              // encoder, texelCopyBuffer, texelCopyTexture, extent
+    WGVKCaptureOp_CopyTextureToBuffer,              // encoder, texelCopyTexture, texelCopyBuffer, extent
+    WGVKCaptureOp_CopyTextureToTexture,             // encoder, texelCopyTexture, texelCopyTexture, extent
+    WGVKCaptureOp_ClearBuffer,                      // encoder, buffer, u64 offset, u64 size
+    WGVKCaptureOp_CommandEncoderFinish,             // encoder, commandBuffer
+
+    // Render pass and render bundle encoders, the first field is the pass or bundle encoder
+    WGVKCaptureOp_RenderPassSetPipeline = 80,       // pipeline
+    WGVKCaptureOp_RenderPassSetBindGroup,           // u32 groupIndex, group, u32 dynamicOffsetCount, u32 dynamicOffsets[]
+    WGVKCaptureOp_RenderPassSetVertexBuffer,        // u32 slot, buffer, u64 offset, u64 size
+    WGVKCaptureOp_RenderPassSetIndexBuffer,         // buffer, u32 format, u64 offset, u64 size
+    WGVKCaptureOp_RenderPassSetViewport,            // f32 x, y, width, height, minDepth, maxDepth
+    WGVKCaptureOp_RenderPassSetScissorRect,         // u32 x, y, width, height
+    WGVKCaptureOp_RenderPassSetBlendConstant,       // f64 r, g, b, a
+    WGVKCaptureOp_RenderPassSetStencilReference,    // u32 reference
+    WGVKCaptureOp_RenderPassDraw,                   // u32 vertexCount, instanceCount, firstVertex, firstInstance
+    WGVKCaptureOp_RenderPassDrawIndexed,            // u32 indexCount, instanceCount, firstIndex, i32 baseVertex, u32 firstInstance
+    WGVKCaptureOp_RenderPassDrawIndirect,           // buffer, u64 offset
+    WGVKCaptureOp_RenderPassDrawIndexedIndirect,    // buffer, u64 offset
+    WGVKCaptureOp_RenderPassMultiDrawIndirect,      // buffer, u64 offset, u32 maxDrawCount, countBuffer, u64 countOffset
+    WGVKCaptureOp_RenderPassMultiDrawIndexedIndirect, // buffer, u64 offset, u32 maxDrawCount, countBuffer, u64 countOffset
+    WGVKCaptureOp_RenderPassExecuteBundles,         // u32 count, bundles[]
+    WGVKCaptureOp_RenderPassEnd,                    //
+
+    WGVKCaptureOp_ComputePassSetPipeline = 112,     // pipeline
+    WGVKCaptureOp_ComputePassSetBindGroup,          // u32 groupIndex, group, u32 dynamicOffsetCount, u32 dynamicOffsets[]
+    WGVKCaptureOp_ComputePassDispatchWorkgroups,    // u32 x, y, z
+    WGVKCaptureOp_ComputePassDispatchWorkgroupsIndirect, // buffer, u64 offset
+    WGVKCaptureOp_ComputePassEnd,                   //
+
+    WGVKCaptureOp_RenderBundleSetPipeline = 128,    // same payloads as the render pass ops
+    WGVKCaptureOp_RenderBundleSetBindGroup,
+    WGVKCaptureOp_RenderBundleSetVertexBuffer,
+    WGVKCaptureOp_RenderBundleSetIndexBuffer,
+    WGVKCaptureOp_RenderBundleDraw,
+    WGVKCaptureOp_RenderBundleDrawIndexed,
+    WGVKCaptureOp_RenderBundleDrawIndirect,
+    WGVKCaptureOp_RenderBundleDrawIndexedIndirect,
+    WGVKCaptureOp_RenderBundleMultiDrawIndirect,
+    WGVKCaptureOp_RenderBundleMultiDrawIndexedIndirect,
+    WGVKCaptureOp_RenderBundleFinish,               // bundle
+
+    // Frame boundaries. Surfaces are replaced by offscreen textures in the replay
+    WGVKCaptureOp_SurfaceConfigure = 160,           // surface, u32 format, u64 usage, u32 width, height, u32 viewFormatCount, u32 viewFormats[]
+    WGVKCaptureOp_SurfaceGetCurrentTexture,         // surface, texture
+    WGVKCaptureOp_SurfacePresent,                   // surface, u64 timestamp
+    WGVKCaptureOp_DeviceTick,                       // device, u64 timestamp
+}WGVKCaptureOp;
+
+#endif // WGVK_CAPTURE_H
+
+/*
+ * wgvk.c defines this before including anything else when built with WGVK_ENABLE_CAPTURE.
+ * The wrapped entry points are then compiled as wgvkCore_*, internal calls between them bypass the capture layer
+ * and the public names are defined by src/wgvk_capture.c. Keep in sync with the wrappers there.
+ */
+#if defined(WGVK_CAPTURE_RENAME_CORE) && !defined(WGVK_CAPTURE_CORE_RENAMED)
+#define WGVK_CAPTURE_CORE_RENAMED
+#define wgpuCreateInstance                                  wgvkCore_CreateInstance
+#define wgpuDeviceCreateBuffer                              wgvkCore_DeviceCreateBuffer
+#define wgpuDeviceCreateTexture                             wgvkCore_DeviceCreateTexture
+#define wgpuTextureCreateView                               wgvkCore_TextureCreateView
+#define wgpuDeviceCreateSampler                             wgvkCore_DeviceCreateSampler
+#define wgpuDeviceCreateShaderModule                        wgvkCore_DeviceCreateShaderModule
+#define wgpuDeviceCreateBindGroupLayout                     wgvkCore_DeviceCreateBindGroupLayout
+#define wgpuDeviceCreatePipelineLayout                      wgvkCore_DeviceCreatePipelineLayout
+#define wgpuDeviceCreateBindGroup                           wgvkCore_DeviceCreateBindGroup
+#define wgpuDeviceCreateRenderPipeline                      wgvkCore_DeviceCreateRenderPipeline
+#define wgpuDeviceCreateComputePipeline                     wgvkCore_DeviceCreateComputePipeline
+#define wgpuRenderPipelineGetBindGroupLayout                wgvkCore_RenderPipelineGetBindGroupLayout
+#define wgpuComputePipelineGetBindGroupLayout               wgvkCore_ComputePipelineGetBindGroupLayout
+#define wgpuDeviceCreateCommandEncoder                      wgvkCore_DeviceCreateCommandEncoder
+#define wgpuDeviceCreateRenderBundleEncoder                 wgvkCore_DeviceCreateRenderBundleEncoder
+#define wgpuBufferMap                                       wgvkCore_BufferMap
+#define wgpuBufferMapAsync                                  wgvkCore_BufferMapAsync
+#define wgpuBufferUnmap                                     wgvkCore_BufferUnmap
+#define wgpuBufferDestroy                                   wgvkCore_BufferDestroy
+#define wgpuTextureDestroy                                  wgvkCore_TextureDestroy
+#define wgpuQueueWriteBuffer                                wgvkCore_QueueWriteBuffer
+#define wgpuQueueWriteTexture                               wgvkCore_QueueWriteTexture
+#define wgpuQueueSubmit                                     wgvkCore_QueueSubmit
+#define wgpuCommandEncoderBeginRenderPass                   wgvkCore_CommandEncoderBeginRenderPass
+#define wgpuCommandEncoderBeginComputePass                  wgvkCore_CommandEncoderBeginComputePass
+#define wgpuCommandEncoderCopyBufferToBuffer                wgvkCore_CommandEncoderCopyBufferToBuffer
+#define wgpuCommandEncoderCopyBufferToTexture               wgvkCore_CommandEncoderCopyBufferToTexture
+#define wgpuCommandEncoderCopyTextureToBuffer               wgvkCore_CommandEncoderCopyTextureToBuffer
+#define wgpuCommandEncoderCopyTextureToTexture              wgvkCore_CommandEncoderCopyTextureToTexture
+#define wgpuCommandEncoderClearBuffer                       wgvkCore_CommandEncoderClearBuffer
+#define wgpuCommandEncoderFinish                            wgvkCore_CommandEncoderFinish
+#define wgpuRenderPassEncoderSetPipeline                    wgvkCore_RenderPassEncoderSetPipeline
+#define wgpuRenderPassEncoderSetBindGroup                   wgvkCore_RenderPassEncoderSetBindGroup
+#define wgpuRenderPassEncoderSetVertexBuffer                wgvkCore_RenderPassEncoderSetVertexBuffer
+#define wgpuRenderPassEncoderSetIndexBuffer                 wgvkCore_RenderPassEncoderSetIndexBuffer
+#define wgpuRenderPassEncoderSetViewport                    wgvkCore_RenderPassEncoderSetViewport
+#define wgpuRenderPassEncoderSetScissorRect                 wgvkCore_RenderPassEncoderSetScissorRect
+#define wgpuRenderPassEncoderSetBlendConstant               wgvkCore_RenderPassEncoderSetBlendConstant
+#define wgpuRenderPassEncoderSetStencilReference            wgvkCore_RenderPassEncoderSetStencilReference
+#define wgpuRenderPassEncoderDraw                           wgvkCore_RenderPassEncoderDraw
+#define wgpuRenderPassEncoderDrawIndexed                    wgvkCore_RenderPassEncoderDrawIndexed
+#define wgpuRenderPassEncoderDrawIndirect                   wgvkCore_RenderPassEncoderDrawIndirect
+#define wgpuRenderPassEncoderDrawIndexedIndirect            wgvkCore_RenderPassEncoderDrawIndexedIndirect
+#define wgpuRenderPassEncoderMultiDrawIndirect              wgvkCore_RenderPassEncoderMultiDrawIndirect
+#define wgpuRenderPassEncoderMultiDrawIndexedIndirect       wgvkCore_RenderPassEncoderMultiDrawIndexedIndirect
+#define wgpuRenderPassEncoderExecuteBundles                 wgvkCore_RenderPassEncoderExecuteBundles
+#define wgpuRenderPassEncoderEnd                            wgvkCore_RenderPassEncoderEnd
+#define wgpuComputePassEncoderSetPipeline                   wgvkCore_ComputePassEncoderSetPipeline
+#define wgpuComputePassEncoderSetBindGroup                  wgvkCore_ComputePassEncoderSetBindGroup
+#define wgpuComputePassEncoderDispatchWorkgroups            wgvkCore_ComputePassEncoderDispatchWorkgroups
+#define wgpuComputePassEncoderDispatchWorkgroupsIndirect    wgvkCore_ComputePassEncoderDispatchWorkgroupsIndirect
+#define wgpuComputePassEncoderEnd                           wgvkCore_ComputePassEncoderEnd
+#define wgpuRenderBundleEncoderSetPipeline                  wgvkCore_RenderBundleEncoderSetPipeline
+#define wgpuRenderBundleEncoderSetBindGroup                 wgvkCore_RenderBundleEncoderSetBindGroup
+#define wgpuRenderBundleEncoderSetVertexBuffer              wgvkCore_RenderBundleEncoderSetVertexBuffer
+#define wgpuRenderBundleEncoderSetIndexBuffer               wgvkCore_RenderBundleEncoderSetIndexBuffer
+#define wgpuRenderBundleEncoderDraw                         wgvkCore_RenderBundleEncoderDraw
+#define wgpuRenderBundleEncoderDrawIndexed                  wgvkCore_RenderBundleEncoderDrawIndexed
+#define wgpuRenderBundleEncoderDrawIndirect                 wgvkCore_RenderBundleEncoderDrawIndirect
+#define wgpuRenderBundleEncoderDrawIndexedIndirect          wgvkCore_RenderBundleEncoderDrawIndexedIndirect
+#define wgpuRenderBundleEncoderMultiDrawIndirect            wgvkCore_RenderBundleEncoderMultiDrawIndirect
+#define wgpuRenderBundleEncoderMultiDrawIndexedIndirect     wgvkCore_RenderBundleEncoderMultiDrawIndexedIndirect
+#define wgpuRenderBundleEncoderFinish                       wgvkCore_RenderBundleEncoderFinish
+#define wgpuSurfaceConfigure                                wgvkCore_SurfaceConfigure
+#define wgpuSurfaceGetCurrentTexture                        wgvkCore_SurfaceGetCurrentTexture
+#define wgpuSurfacePresent                                  wgvkCore_SurfacePresent
+#define wgpuDeviceTick                                      wgvkCore_DeviceTick
+#define wgpuBufferAddRef                                    wgvkCore_BufferAddRef
+#define wgpuBufferRelease                                   wgvkCore_BufferRelease
+#define wgpuTextureAddRef                                   wgvkCore_TextureAddRef
+#define wgpuTextureRelease                                  wgvkCore_TextureRelease
+#define wgpuTextureViewAddRef                               wgvkCore_TextureViewAddRef
+#define wgpuTextureViewRelease                              wgvkCore_TextureViewRelease
+#define wgpuSamplerAddRef                                   wgvkCore_SamplerAddRef
+#define wgpuSamplerRelease                                  wgvkCore_SamplerRelease
+#define wgpuShaderModuleAddRef                              wgvkCore_ShaderModuleAddRef
+#define wgpuShaderModuleRelease                             wgvkCore_ShaderModuleRelease
+#define wgpuBindGroupLayoutAddRef                           wgvkCore_BindGroupLayoutAddRef
+#define wgpuBindGroupLayoutRelease                          wgvkCore_BindGroupLayoutRelease
+#define wgpuPipelineLayoutAddRef                            wgvkCore_PipelineLayoutAddRef
+#define wgpuPipelineLayoutRelease                           wgvkCore_PipelineLayoutRelease
+#define wgpuBindGroupAddRef                                 wgvkCore_BindGroupAddRef
+#define wgpuBindGroupRelease                                wgvkCore_BindGroupRelease
+#define wgpuRenderPipelineAddRef                            wgvkCore_RenderPipelineAddRef
+#define wgpuRenderPipelineRelease                           wgvkCore_RenderPipelineRelease
+#define wgpuComputePipelineAddRef                           wgvkCore_ComputePipelineAddRef
+#define wgpuComputePipelineRelease                          wgvkCore_ComputePipelineRelease
+#define wgpuCommandEncoderAddRef                            wgvkCore_CommandEncoderAddRef
+#define wgpuCommandEncoderRelease                           wgvkCore_CommandEncoderRelease
+#define wgpuCommandBufferAddRef                             wgvkCore_CommandBufferAddRef
+#define wgpuCommandBufferRelease                            wgvkCore_CommandBufferRelease
+#define wgpuRenderPassEncoderAddRef                         wgvkCore_RenderPassEncoderAddRef
+#define wgpuRenderPassEncoderRelease                        wgvkCore_RenderPassEncoderRelease
+#define wgpuComputePassEncoderAddRef                        wgvkCore_ComputePassEncoderAddRef
+#define wgpuComputePassEncoderRelease                       wgvkCore_ComputePassEncoderRelease
+#define wgpuRenderBundleEncoderAddRef                       wgvkCore_RenderBundleEncoderAddRef
+#define wgpuRenderBundleEncoderRelease                      wgvkCore_RenderBundleEncoderRelease
+#define wgpuRenderBundleAddRef                              wgvkCore_RenderBundleAddRef
+#define wgpuRenderBundleRelease                             wgvkCore_RenderBundleRelease
+#endif
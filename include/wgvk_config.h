@@ -34,9 +34,48 @@
 #ifndef VULKAN_USE_DYNAMIC_RENDERING
     #define VULKAN_USE_DYNAMIC_RENDERING 1
 #endif
+// Record every render bundle once into a secondary command buffer. Requires dynamic rendering,
+// bundles are still replayed inline on devices without VK_NV_inherited_viewport_scissor and VK_KHR_maintenance7
+#ifndef RENDERBUNDLES_AS_SECONDARY_COMMANDBUFFERS
+    #define RENDERBUNDLES_AS_SECONDARY_COMMANDBUFFERS VULKAN_USE_DYNAMIC_RENDERING
+#endif
 #ifndef VULKAN_ENABLE_RAYTRACING
     #define VULKAN_ENABLE_RAYTRACING 1
 #endif
+// Split barriers: a command encoder stops setting events after the writes of a command once this many of its events
+// were not waited for yet, so runs of independent writes do not pay one vkCmdSetEvent2 each
+#ifndef WGVK_MAX_UNCONSUMED_SPLIT_EVENTS
+    #define WGVK_MAX_UNCONSUMED_SPLIT_EVENTS 4
+#endif
+// Size of the transient buffers command encoders sub-allocate from, e.g. for coalesced indirect draws
+#ifndef WGVK_BATCH_BUFFER_SIZE
+    #define WGVK_BATCH_BUFFER_SIZE (1 << 16)
+#endif
+// Without VK_EXT_multi_draw, shorter runs of draws are recorded one by one
+#ifndef WGVK_MIN_INDIRECT_COALESCED_DRAWS
+    #define WGVK_MIN_INDIRECT_COALESCED_DRAWS 8
+#endif
+// wgpuQueueWriteBuffer records writes up to this size with vkCmdUpdateBuffer, which is capped at 65536 bytes
+#ifndef WGVK_INLINE_BUFFER_UPDATE_SIZE
+    #define WGVK_INLINE_BUFFER_UPDATE_SIZE 65536
+#endif
+// Zero the contents of new buffers. Mappable buffers are cleared on the CPU, all others
+// with vkCmdFillBuffer in the presubmitCache of the next submit
+#ifndef WGVK_ZERO_INITIALIZE_BUFFERS
+    #define WGVK_ZERO_INITIALIZE_BUFFERS 0
+#endif
+// wgpuQueueWriteBufferFromFile splits uploads into staging buffers of this size, each read by one thread pool job
+#ifndef WGVK_FILE_UPLOAD_CHUNK_SIZE
+    #define WGVK_FILE_UPLOAD_CHUNK_SIZE (64ull << 20)
+#endif
+// Number of chunks an upload reads or copies at once, each with its own staging buffer that is reused once its copy finished
+#ifndef WGVK_FILE_UPLOAD_MAX_CHUNKS_IN_FLIGHT
+    #define WGVK_FILE_UPLOAD_MAX_CHUNKS_IN_FLIGHT 4
+#endif
+// Build src/wgvk_capture.c into the library, see wgvk_capture.h
+#ifndef WGVK_ENABLE_CAPTURE
+    #define WGVK_ENABLE_CAPTURE 0
+#endif
 #if !defined(RL_MALLOC) && !defined(RL_CALLOC) && !defined(RL_REALLOC) && !defined(RL_FREE)
 #define RL_MALLOC  malloc
 #define RL_CALLOC  calloc
@@ -0,0 +1,79 @@
+#ifndef WGVK_FRAME_GRAPH_H
+#define WGVK_FRAME_GRAPH_H
+#include <wgvk.h>
+
+/*
+ * Optional frame graph layer on top of the command encoder (src/wgvk_frame_graph.c, built with WGVK_ENABLE_FRAME_GRAPH).
+ *
+ * Passes declare the resources they read and write and record their commands from a callback.
+ * The order in which passes are added defines what the graph means: a read sees the last write added before it.
+ *
+ * wgvkFrameGraphCompile only works on the CPU, a graph created without a device can be planned and inspected:
+ *   - Passes that contribute nothing are culled. A pass is needed if it has side effects, writes an imported
+ *     resource or one marked with wgvkFrameGraphMarkOutput, or produces something a needed pass consumes.
+ *   - The remaining passes are reordered within their dependencies so that a pass rarely consumes what the pass
+ *     right before it produced. Independent work then sits between producer and consumer, which the encoder's
+ *     split barriers can overlap with the producer.
+ *   - Transient textures with equal descriptors and disjoint lifetimes in the schedule share one texture.
+ *
+ * wgvkFrameGraphExecute creates the transient textures and runs the scheduled passes into a command encoder.
+ * The encoder's resource tracking records the barriers between them as for any other commands.
+ * Transient textures are kept by the graph across wgvkFrameGraphReset and reused by later frames,
+ * their contents are undefined when a pass first writes them.
+ */
+
+typedef struct WGVKFrameGraphImpl* WGVKFrameGraph;
+
+// Handle of a resource within one frame, 0 is invalid. Handles are invalidated by wgvkFrameGraphReset
+typedef uint32_t WGVKFrameGraphResource;
+
+typedef void (*WGVKFrameGraphExecuteCallback)(WGVKFrameGraph graph, WGPUCommandEncoder encoder, void* userdata);
+
+typedef struct WGVKFrameGraphPassDescriptor{
+    WGPUStringView label;             // Wraps the pass in a debug group if not empty
+    size_t readCount;
+    const WGVKFrameGraphResource* reads;
+    size_t writeCount;
+    const WGVKFrameGraphResource* writes;
+    WGPUBool hasSideEffects;          // Never culled, e.g. a pass presenting or reading back results
+    WGVKFrameGraphExecuteCallback execute;
+    void* userdata;
+}WGVKFrameGraphPassDescriptor;
+
+typedef struct WGVKFrameGraphStats{
+    uint32_t passCount;               // Passes added since the last reset
+    uint32_t scheduledPassCount;      // Passes left after culling
+    uint32_t adjacentDependencies;    // Scheduled passes that depend on the pass right before them
+    uint32_t transientTextureCount;   // Transient textures used by scheduled passes
+    uint32_t physicalTextureCount;    // Textures backing them after aliasing
+}WGVKFrameGraphStats;
+
+#define WGVK_FRAME_GRAPH_NO_SLOT UINT32_MAX
+
+WGVK_EXPORT WGVKFrameGraph wgvkFrameGraphCreate(WGPU_NULLABLE WGPUDevice device);
+WGVK_EXPORT void wgvkFrameGraphRelease(WGVKFrameGraph graph);
+// Drops all passes and resources of the current frame, the transient textures stay for the next one
+WGVK_EXPORT void wgvkFrameGraphReset(WGVKFrameGraph graph);
+
+WGVK_EXPORT WGVKFrameGraphResource wgvkFrameGraphImportBuffer(WGVKFrameGraph graph, WGPUBuffer buffer);
+WGVK_EXPORT WGVKFrameGraphResource wgvkFrameGraphImportTexture(WGVKFrameGraph graph, WGPUTexture texture);
+// The label and view formats of the descriptor are ignored
+WGVK_EXPORT WGVKFrameGraphResource wgvkFrameGraphCreateTexture(WGVKFrameGraph graph, const WGPUTextureDescriptor* descriptor);
+WGVK_EXPORT void wgvkFrameGraphMarkOutput(WGVKFrameGraph graph, WGVKFrameGraphResource resource);
+// Returns the index of the pass, in the order passes were added
+WGVK_EXPORT uint32_t wgvkFrameGraphAddPass(WGVKFrameGraph graph, const WGVKFrameGraphPassDescriptor* descriptor);
+
+WGVK_EXPORT void wgvkFrameGraphCompile(WGVKFrameGraph graph);
+// Writes up to capacity pass indices in execution order, returns the number of scheduled passes
+WGVK_EXPORT size_t wgvkFrameGraphGetSchedule(WGVKFrameGraph graph, uint32_t* passes, size_t capacity);
+// The texture a transient resource was assigned to, equal slots alias. WGVK_FRAME_GRAPH_NO_SLOT if it is not transient or unused
+WGVK_EXPORT uint32_t wgvkFrameGraphGetTextureSlot(WGVKFrameGraph graph, WGVKFrameGraphResource resource);
+WGVK_EXPORT void wgvkFrameGraphGetStats(WGVKFrameGraph graph, WGVKFrameGraphStats* stats);
+
+// Compiles the graph if needed and records the scheduled passes into encoder
+WGVK_EXPORT void wgvkFrameGraphExecute(WGVKFrameGraph graph, WGPUCommandEncoder encoder);
+// Valid inside execute callbacks and until the next reset
+WGVK_EXPORT WGPUTexture wgvkFrameGraphGetTexture(WGVKFrameGraph graph, WGVKFrameGraphResource resource);
+WGVK_EXPORT WGPUBuffer wgvkFrameGraphGetBuffer(WGVKFrameGraph graph, WGVKFrameGraphResource resource);
+
+#endif
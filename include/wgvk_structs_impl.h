@@ -115,6 +115,7 @@ int  wgvk_thread_create(wgvk_thread_t* thread, wgvk_thread_func_t func, void* ar
 int  wgvk_thread_join  (wgvk_thread_t* thread, void** result);
 int  wgvk_thread_detach(wgvk_thread_t* thread);
 void wgvk_thread_yield (void);
+uint64_t wgvk_thread_current_id(void); /* nonzero, unique among live threads */
 
 /* lock backend selection */
 typedef enum wgvk_locktype{
@@ -169,8 +170,12 @@ wgvk_thread_pool_t* wgvk_thread_pool_create(size_t num_threads);
 void wgvk_thread_pool_destroy(wgvk_thread_pool_t* pool);
 wgvk_job_t* wgvk_job_enqueue(wgvk_thread_pool_t* pool, wgvk_thread_func_t func, void* arg);
 int wgvk_job_wait(wgvk_job_t* job, void** result);
+int wgvk_job_completed(wgvk_job_t* job); // Nonzero once the job ran, never blocks
 void wgvk_job_destroy(wgvk_job_t* job);
 
+// Reads up to size bytes at offset without moving the file position, returns the amount read or -1
+int64_t wgvk_file_pread(int fd, void* buffer, size_t size, uint64_t offset);
+
 
 
 
@@ -1328,35 +1333,59 @@ struct WgvkAllocator {
     VkPhysicalDeviceMemoryProperties memoryProperties;
 };
 
+// Layout and last use of a block of mip levels and array layers
+typedef struct SubresourceState{
+    uint32_t baseMipLevel;
+    uint32_t levelCount;
+    uint32_t baseArrayLayer;
+    uint32_t layerCount;
+    VkImageLayout layout;
+    VkPipelineStageFlags2 stage;
+    VkAccessFlags2 access;
+}SubresourceState;
+
+// Non-overlapping blocks, adjacent blocks in the same state are merged. Subresources without a block are untouched.
+DEFINE_VECTOR(static inline, SubresourceState, SubresourceStateVector)
+
 typedef struct ImageUsageRecord{
-    VkPipelineStageFlags initialStage;
-    VkAccessFlags initialAccess;
-    VkPipelineStageFlags lastStage;
-    VkAccessFlags lastAccess;
-    VkImageLayout initialLayout;
-    VkImageLayout lastLayout;
-    VkImageSubresourceRange initiallyAccessedSubresource;
-    VkImageSubresourceRange lastAccessedSubresource;
+    SubresourceStateVector initialStates; // How each subresource is used first, covers the same subresources as lastStates
+    SubresourceStateVector lastStates;
 }ImageUsageRecord;
 
 typedef struct ImageUsageSnap{
     VkImageLayout layout;
-    VkPipelineStageFlags stage;
-    VkAccessFlags access;
+    VkPipelineStageFlags2 stage;
+    VkAccessFlags2 access;
     VkImageSubresourceRange subresource;
 }ImageUsageSnap;
 
+// Accesses since the last barrier covering a byte range, reads that need no barrier between them accumulate
+typedef struct BufferRangeState{
+    uint64_t offset;
+    uint64_t size;
+    VkPipelineStageFlags2 stage;
+    VkAccessFlags2 access;
+    uint32_t producer; // Encoder command serial of the write, only meaningful if access writes
+}BufferRangeState;
+
+// Sorted by offset, non-overlapping, bytes without a range are untouched
+DEFINE_VECTOR(static inline, BufferRangeState, BufferRangeStateVector)
+
 typedef struct BufferUsageRecord{
-    VkPipelineStageFlags initialStage;
-    VkAccessFlags initialAccess;
-    VkPipelineStageFlags lastStage;
-    VkAccessFlags lastAccess;
+    VkPipelineStageFlags2 initialStage; // Union of the first uses of all ranges
+    VkAccessFlags2 initialAccess;
+    VkPipelineStageFlags2 lastStage;    // Union of the current states of all ranges
+    VkAccessFlags2 lastAccess;
     VkBool32 everWrittenTo;
+    VkBool32 unsubmitted; // Counted in WGPUBufferImpl::unsubmittedUses
+    BufferRangeStateVector ranges;
 }BufferUsageRecord;
 
 typedef struct BufferUsageSnap{
-    VkPipelineStageFlags stage;
-    VkAccessFlags access;
+    VkPipelineStageFlags2 stage;
+    VkAccessFlags2 access;
+    uint64_t offset;
+    uint64_t size; // 0 or WGPU_WHOLE_SIZE reach to the end of the buffer
 }BufferUsageSnap;
 
 typedef enum RCPassCommandType{
@@ -1587,6 +1616,7 @@ DEFINE_VECTOR (CONTAINERAPI, VkFence, VkFenceVector)
 DEFINE_VECTOR (CONTAINERAPI, VkCommandBuffer, VkCommandBufferVector)
 DEFINE_VECTOR (CONTAINERAPI, RenderPassCommandGeneric, RenderPassCommandGenericVector)
 DEFINE_VECTOR (CONTAINERAPI, VkSemaphore, VkSemaphoreVector)
+DEFINE_VECTOR (CONTAINERAPI, VkEvent, VkEventVector)
 DEFINE_VECTOR (CONTAINERAPI, WGPUCommandBuffer, WGPUCommandBufferVector)
 DEFINE_VECTOR (CONTAINERAPI, WGPUCommandEncoder, WGPUCommandEncoderVector)
 DEFINE_VECTOR (CONTAINERAPI, VkDescriptorBufferInfo, VkDescriptorBufferInfoVector)
@@ -1604,6 +1634,11 @@ typedef struct DescriptorSetAndPool{
 DEFINE_VECTOR(static inline, VkAttachmentDescription, VkAttachmentDescriptionVector)
 DEFINE_VECTOR(static inline, WGPUBuffer, WGPUBufferVector)
 DEFINE_VECTOR(static inline, DescriptorSetAndPool, DescriptorSetAndPoolVector)
+typedef struct RetiredDescriptorSet{
+    WGPUBindGroupLayout layout; // Referenced until the set is back in the bindGroupCache
+    DescriptorSetAndPool setAndPool;
+}RetiredDescriptorSet;
+DEFINE_VECTOR(static inline, RetiredDescriptorSet, RetiredDescriptorSetVector)
 DEFINE_PTR_HASH_MAP_ERASABLE(static inline, BindGroupCacheMap, DescriptorSetAndPoolVector)
 
 
@@ -1847,13 +1882,46 @@ static size_t renderPassLayoutHash(RenderPassLayout layout){
 }
 
 
+/**
+ * @brief Command pool owned by a single recording thread for one frame in flight
+ * @details Only the owning thread allocates and records from it, so encoding on different threads never contends.
+ * mutex guards the pool itself and both free-lists against the bulk reset in wgpuDeviceTick and against
+ * command buffers being retired from another thread (e.g. the one that waited for the fence).
+ * Buffers are never reset individually: freeBuffers only holds buffers that went through vkResetCommandPool.
+ */
+typedef struct ThreadCommandPool{
+    uint64_t threadId;
+    VkCommandPool pool;
+    VkCommandBufferLevel level;
+    VkCommandBufferVector freeBuffers;
+    VkCommandBufferVector retiredBuffers;
+    uint32_t outstandingBuffers; // Allocated from this pool and not yet retired
+    uint32_t queueFamily;
+    wgvk_mutex_t* mutex;
+}ThreadCommandPool;
+
+DEFINE_PTR_HASH_MAP_ERASABLE(CONTAINERAPI, ThreadCommandPoolMap, ThreadCommandPool*)
+DEFINE_VECTOR(CONTAINERAPI, ThreadCommandPool*, ThreadCommandPoolVector)
+
+// Command buffers can only be submitted to queues of the family their pool was created for
+typedef enum QueueFamilySlot{
+    QueueFamilySlot_Default = 0,
+    QueueFamilySlot_AsyncCompute = 1, // Only used if the async compute queue has a family of its own
+    QueueFamilySlot_Transfer = 2,
+    QueueFamilySlot_Count = 3,
+}QueueFamilySlot;
+
 typedef struct PerframeCache{
     VkCommandPool commandPool;
-    VkCommandBufferVector commandBuffers;
+    ThreadCommandPoolMap threadCommandPools[QueueFamilySlot_Count];
+    ThreadCommandPoolVector detachedCommandPools; // Still owned by an encoder that outlived its frame
+    ThreadCommandPoolVector spareCommandPools;    // Reset and ready to be handed to any thread
+    wgvk_mutex_t* threadCommandPoolsMutex;
     VkCommandBufferVector secondaryCommandBuffers;
 
     WGPUBufferVector unusedBatchBuffers;
     WGPUBufferVector usedBatchBuffers;
+    wgvk_mutex_t* batchBuffersMutex;
     
     VkCommandBuffer finalTransitionBuffer;
     VkSemaphore finalTransitionSemaphore;
@@ -1864,6 +1932,10 @@ typedef struct PerframeCache{
     //std::unordered_map<WGPUBindGroupLayout, std::vector<std::pair<VkDescriptorPool, VkDescriptorSet>>> bindGroupCache;
     BindGroupCacheMap bindGroupCache;
     VkFenceVector reusableFences;
+
+    // Buffer backings and descriptor sets replaced during this frame, released once the frame's fences are waited for
+    WGPUBufferVector retiredBuffers;
+    RetiredDescriptorSetVector retiredDescriptorSets;
 }PerframeCache;
 
 typedef struct QueueIndices{
@@ -1906,7 +1978,9 @@ typedef struct WorkDoneFutureState {
 } WorkDoneFutureState;
 
 typedef struct WGPUFenceImpl {
-    VkFence fence;
+    VkFence fence;                               // Only without timeline semaphores
+    VkSemaphore timelineSemaphore;               // Otherwise the timeline of the queue it was submitted to
+    uint64_t timelineValue;                      // and the value the submit signals
     Atomar(WGPUFenceState) state; 
     WGPUDevice device;
     refcount_type refCount;
@@ -1932,6 +2006,7 @@ typedef struct WGPUBindGroupImpl{
     WGPUDevice device;
     uint32_t cacheIndex;
     WGPUBindGroupEntry* entries;
+    uint32_t* bufferGenerations; // backingGeneration of each entry's buffer when the set was written
     uint32_t entryCount;
 }WGPUBindGroupImpl;
 
@@ -1977,6 +2052,15 @@ typedef struct WGPUBufferImpl{
     VkDeviceAddress address; //uint64_t, if applicable (BufferUsage_ShaderDeviceAddress)
     refcount_type refCount;
     WGPUFence latestFence;
+    VkBool32 latestFenceWrites;      // The submits behind latestFence write to the buffer
+    refcount_type unsubmittedUses;   // Encoders and command buffers that recorded the current backing and are not submitted yet
+    refcount_type backingGeneration; // Incremented whenever wgpuQueueWriteBuffer swaps in a fresh backing
+    VkBool32 backingPinned;          // Baked into a render bundle's secondary command buffer, never swapped
+    VkBool32 zeroFillPending;        // Zeroed by the presubmitCache, host writes have to be ordered after it
+    VkPipelineStageFlags2 lastStage; // Last use in a submitted command buffer, the source scope of the first barrier in the next submit
+    VkAccessFlags2 lastAccess;
+    WGPUQueue lastQueue;             // Queue of that submit and the timeline value it signals, NULL if unused
+    uint64_t lastQueueValue;
 }WGPUBufferImpl;
 
 typedef struct WGPURayTracingShaderBindingTableImpl{
@@ -2028,8 +2112,10 @@ static inline int comparison_sdf(uint64_t x, uint64_t y){
 
 typedef struct WGPUFutureImpl{
     void* userdataForFunction;
-    void (*functionCalledOnWaitAny)(void*);
+    void (*functionCalledOnWaitAny)(void*); // NULL once the future completed
     void (*freeUserData)(void*);
+    bool (*isReady)(void*);                 // Whether functionCalledOnWaitAny would return without waiting, NULL if it never waits
+    WGPUCallbackMode mode;                  // wgpuInstanceProcessEvents only completes AllowProcessEvents and AllowSpontaneous futures
 }WGPUFutureImpl;
 
 DEFINE_GENERIC_HASH_MAP(CONTAINERAPI, RenderPassCache, RenderPassLayout, LayoutedRenderPass, renderPassLayoutHash, renderPassLayoutCompare, CLITERAL(RenderPassLayout){0});
@@ -2043,6 +2129,7 @@ typedef struct WGPUInstanceImpl{
 
     Atomar(uint64_t) currentFutureId;
     FutureIDMap g_futureIDMap;
+    wgvk_mutex_t* futureMutex; // Guards g_futureIDMap, futures are created on any thread
 }WGPUInstanceImpl;
 
 
@@ -2062,6 +2149,9 @@ typedef struct WGPUAdapterImpl{
 typedef struct FenceCache{
     WGPUDevice device;
     VkFenceVector cachedFences;
+    // Released WGPUFences. Every submit takes one, so their mutex, condition variable and callback storage are reused
+    WGPUFenceVector cachedFenceObjects;
+    wgvk_mutex_t* mutex; // Fences are released on any thread
 }FenceCache;
 
 typedef struct WGVKCapabilities{
@@ -2070,12 +2160,23 @@ typedef struct WGVKCapabilities{
     WGPUBool dynamicRendering;
     WGPUBool depthClipEnable;
     WGPUBool depthClipControl;
+    WGPUBool multiDraw;
+    uint32_t maxMultiDrawCount;
+    WGPUBool multiDrawIndirect;
+    WGPUBool drawIndirectFirstInstance;
+    WGPUBool drawIndirectCount;
+    WGPUBool inheritedViewportScissor;
+    WGPUBool mixedRenderingContents;
+    WGPUBool synchronization2;
+    WGPUBool splitBarriers; // vkCmdSetEvent2 / vkCmdWaitEvents2 are available
+    WGPUBool timelineSemaphore;
 }WGVKCapabilities;
 
 typedef struct FIFCache{
     WGPUDevice device;
     PerframeCache frameCaches[framesInFlight];
     WGPUFence topFence;
+    uint32_t queueFamily;
 }FIFCache;
 
 typedef struct WGPUDeviceImpl{
@@ -2083,6 +2184,8 @@ typedef struct WGPUDeviceImpl{
     refcount_type refCount;
     WGPUAdapter adapter;
     WGPUQueue queue;
+    WGPUQueue asyncComputeQueue; // NULL if not available, see wgpuDeviceGetAsyncComputeQueue
+    WGPUQueue transferQueue;     // Internal, runs the staging copies of the other queues. NULL without a transfer-only family
     size_t submittedFrames;
     WGVKCapabilities capabilities;
     WgvkAllocator builtinAllocator;
@@ -2094,19 +2197,31 @@ typedef struct WGPUDeviceImpl{
 
     VmaPool aligned_hostVisiblePool;
     FIFCache fifCache;
-    VkCommandPool secondaryCommandPool;
+    // Per-thread pools for render bundle secondaries. Bundles have their own lifetime, so these pools
+    // allow resetting individual buffers and hand released buffers straight back through freeBuffers.
+    ThreadCommandPoolMap bundleCommandPools;
+    wgvk_mutex_t* bundleCommandPoolsMutex;
+    // Reset VkEvents for split barriers, handed back by command buffers once they are done
+    VkEventVector spareEvents;
+    wgvk_mutex_t* spareEventsMutex;
+    // Guards rewriting bind groups whose buffers were renamed, and the retired lists of the PerframeCaches
+    wgvk_mutex_t* backingRetireMutex;
     RenderPassCache renderPassCache;
     WGPUUncapturedErrorCallbackInfo uncapturedErrorCallbackInfo;
     FenceCache fenceCache;
     wgvk_thread_pool_t* thread_pool;
+    // wgpuQueueWriteBufferFromFile uploads that are still reading or copying, advanced by wgpuQueueSubmit
+    // and by their futures. fileUploadsMutex guards the list and the state of every upload in it
+    struct FileUploadState* fileUploads;
+    wgvk_mutex_t* fileUploadsMutex;
     struct VolkDeviceTable functions;
 }WGPUDeviceImpl;
 
-static PerframeCache* DeviceGetFIFCache(WGPUDevice device, uint32_t cacheIndex){
+static inline PerframeCache* DeviceGetFIFCache(WGPUDevice device, uint32_t cacheIndex){
     wgvk_assert(cacheIndex < framesInFlight, "CacheIndex >= framesInFlight passed");
     return device->fifCache.frameCaches + cacheIndex;
 }
-static SyncState* DeviceGetSyncState(WGPUDevice device, uint32_t cacheIndex){
+static inline SyncState* DeviceGetSyncState(WGPUDevice device, uint32_t cacheIndex){
     //wgvk_assert(cacheIndex < framesInFlight, "CacheIndex >= framesInFlight passed");
     return &DeviceGetFIFCache(device, cacheIndex)->syncState;
 }
@@ -2116,6 +2231,8 @@ static SyncState* DeviceGetSyncState(WGPUDevice device, uint32_t cacheIndex){
 static inline void FenceCache_Init(WGPUDevice device, FenceCache* ptr){
     ptr->device = device;
     VkFenceVector_init(&ptr->cachedFences);
+    WGPUFenceVector_init(&ptr->cachedFenceObjects);
+    ptr->mutex = wgvk_mutex_create(wgvk_locktype_spin);
 }
 /**
  * @brief Registers commandBuffers to depend on fence and be released when fence is waited for
@@ -2129,9 +2246,36 @@ void FIFCache_init(FIFCache* fifCache, WGPUDevice device, uint32_t queueFamily);
 void SyncState_destroy(WGPUDevice device, SyncState* syncState);
 void FIFCache_destroy(FIFCache* fcache);
 
+/**
+ * @brief Returns the calling thread's command pool of queueFamily for this frame, creating it on first use
+ */
+ThreadCommandPool* PerframeCache_getThreadCommandPool(WGPUDevice device, PerframeCache* pfcache, uint32_t queueFamily);
+VkCommandBuffer ThreadCommandPool_acquire(WGPUDevice device, ThreadCommandPool* tpool);
+/**
+ * @brief Hands a command buffer back to its pool. May be called from any thread;
+ * the buffer becomes reusable after the next bulk recycle in wgpuDeviceTick
+ */
+void ThreadCommandPool_retire(ThreadCommandPool* tpool, VkCommandBuffer buffer);
+/**
+ * @brief Returns the calling thread's pool for render bundle secondaries, creating it on first use
+ */
+ThreadCommandPool* Device_getBundleCommandPool(WGPUDevice device);
+/**
+ * @brief Hands a bundle's secondary back to its pool for immediate reuse. May be called from any thread
+ */
+void ThreadCommandPool_release(ThreadCommandPool* tpool, VkCommandBuffer buffer);
+/**
+ * @brief Resets every pool of this frame whose buffers have all retired with one vkResetCommandPool each.
+ * @details Pools that still back a live encoder are detached from their thread and replaced on next use,
+ * so a long-lived encoder never prevents the rest of the frame from being recycled.
+ */
+void PerframeCache_recycleCommandPools(WGPUDevice device, PerframeCache* pfcache);
+
 
 static inline VkFence FenceCache_GetFence(FenceCache* ptr){
+    wgvk_mutex_lock(ptr->mutex);
     if(ptr->cachedFences.size == 0){
+        wgvk_mutex_unlock(ptr->mutex);
         VkFence ret = NULL;
         VkFenceCreateInfo createInfo = {VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
         VkResult result = ptr->device->functions.vkCreateFence(
@@ -2147,13 +2291,40 @@ static inline VkFence FenceCache_GetFence(FenceCache* ptr){
     else{
         VkFence ret = ptr->cachedFences.data[ptr->cachedFences.size - 1];
         VkFenceVector_pop_back(&ptr->cachedFences);
+        wgvk_mutex_unlock(ptr->mutex);
         return ret;
     }
 }
 static inline void FenceCache_PutFence(FenceCache* ptr, VkFence fence){
+    wgvk_mutex_lock(ptr->mutex);
     VkFenceVector_push_back(&ptr->cachedFences, fence);
+    wgvk_mutex_unlock(ptr->mutex);
+}
+// Returns NULL if no released fence is left
+static inline WGPUFence FenceCache_GetFenceObject(FenceCache* ptr){
+    WGPUFence ret = NULL;
+    wgvk_mutex_lock(ptr->mutex);
+    if(ptr->cachedFenceObjects.size > 0){
+        ret = ptr->cachedFenceObjects.data[ptr->cachedFenceObjects.size - 1];
+        WGPUFenceVector_pop_back(&ptr->cachedFenceObjects);
+    }
+    wgvk_mutex_unlock(ptr->mutex);
+    return ret;
+}
+static inline void FenceCache_PutFenceObject(FenceCache* ptr, WGPUFence fence){
+    wgvk_mutex_lock(ptr->mutex);
+    WGPUFenceVector_push_back(&ptr->cachedFenceObjects, fence);
+    wgvk_mutex_unlock(ptr->mutex);
 }
 static inline void FenceCache_Destroy(FenceCache* ptr){
+    for(size_t i = 0;i < ptr->cachedFenceObjects.size;i++){
+        WGPUFence fence = ptr->cachedFenceObjects.data[i];
+        wgvk_mutex_destroy(fence->wait_mutex);
+        wgvk_cond_destroy(fence->wait_cond);
+        CallbackWithUserdataVector_free(&fence->callbacksOnWaitComplete);
+        RL_FREE(fence);
+    }
+    WGPUFenceVector_free(&ptr->cachedFenceObjects);
     for(size_t i = 0;i < ptr->cachedFences.size;i++){
         ptr->device->functions.vkDestroyFence(
             ptr->device->device,
@@ -2162,6 +2333,7 @@ static inline void FenceCache_Destroy(FenceCache* ptr){
         );
     }
     VkFenceVector_free(&ptr->cachedFences);
+    wgvk_mutex_destroy(ptr->mutex);
 }
 typedef uint8_t SlimComponentSwizzle;
 
@@ -2249,7 +2421,9 @@ typedef struct WGPUTextureImpl{
     VkImage image;
     VkFormat format;
     VkImageUsageFlags usage;
-    VkImageLayout layout;
+    SubresourceStateVector states; // Layouts and last uses in submitted command buffers
+    WGPUQueue lastQueue;           // Queue of the last submit that used the texture and the timeline value it signals
+    uint64_t lastQueueValue;
     VkImageType dimension;
     VkDeviceMemory memory;
     WGPUDevice device;
@@ -2342,6 +2516,7 @@ typedef struct WGPURenderPassEncoderImpl{
     WGPUPipelineLayout lastLayout;
     VkFramebuffer frameBuffer;
     WGPUCommandEncoder cmdEncoder;
+    bool continuesRendering; // Compatible with cmdEncoder->openRenderPass, attachments are only tracked if it cannot merge after all
 }WGPURenderPassEncoderImpl;
 
 typedef struct WGPUComputePassEncoderImpl{
@@ -2355,47 +2530,11 @@ typedef struct WGPUComputePassEncoderImpl{
     WGPUBindGroup bindGroups[8];
 }WGPUComputePassEncoderImpl;
 
-static inline size_t hashDynamicState(DefaultDynamicState dst){
-    float accum = dst.viewport.x;
-    accum = accum * 1.79421351f + dst.blendConstants[0];
-    accum = accum * 1.79421351f + dst.blendConstants[1];
-    accum = accum * 1.79421351f + dst.blendConstants[2];
-    accum = accum * 1.79421351f + dst.blendConstants[3];
-    accum = accum * 1.19421351f + dst.viewport.y;
-    accum = accum * 1.19421351f + dst.viewport.width;
-    accum = accum * 1.19421351f + dst.viewport.height;
-    accum = accum * 1.19421351f + dst.viewport.minDepth;
-    accum = accum * 1.19421351f + dst.viewport.maxDepth;
-    size_t ret = dst.scissorRect.extent.width;
-    ret = (ret * PHM_HASH_MULTIPLIER) ^ dst.scissorRect.extent.height;
-    ret = (ret * PHM_HASH_MULTIPLIER) ^ dst.scissorRect.offset.x;
-    ret = (ret * PHM_HASH_MULTIPLIER) ^ dst.scissorRect.offset.y;
-    ret = (ret * PHM_HASH_MULTIPLIER) ^ dst.stencilReference;
-    return ret ^ ((size_t)accum);
-}
-static inline size_t cmpDynamicState(DefaultDynamicState a, DefaultDynamicState b){
-    return 
-    a.viewport.x == b.viewport.x &&
-    a.viewport.y == b.viewport.y &&
-    a.viewport.width == b.viewport.width &&
-    a.viewport.height == b.viewport.height &&
-    a.viewport.minDepth == b.viewport.minDepth &&
-    a.viewport.maxDepth == b.viewport.maxDepth &&
-    a.scissorRect.offset.x == b.scissorRect.offset.x &&
-    a.scissorRect.offset.y == b.scissorRect.offset.y &&
-    a.scissorRect.extent.width == b.scissorRect.extent.width &&
-    a.scissorRect.extent.height == b.scissorRect.extent.height &&
-    a.blendConstants[0] == b.blendConstants[0] &&
-    a.blendConstants[0] == b.blendConstants[0] &&
-    a.blendConstants[0] == b.blendConstants[0] &&
-    a.blendConstants[0] == b.blendConstants[0] &&
-    a.stencilReference == b.stencilReference;
-}
-DEFINE_GENERIC_HASH_MAP(static inline, DynamicStateCommandBufferMap, DefaultDynamicState, VkCommandBuffer, hashDynamicState, cmpDynamicState, CLITERAL(DefaultDynamicState){0})
-
 typedef struct WGPURenderBundleImpl{
     RenderPassCommandGenericVector bufferedCommands;
-    DynamicStateCommandBufferMap encodedCommandBuffers;
+    // Recorded once at Finish, VK_NULL_HANDLE if bundles are replayed inline
+    VkCommandBuffer secondaryBuffer;
+    ThreadCommandPool* secondaryPool;
     WGPUDevice device;
     refcount_type refCount;
     
@@ -2403,6 +2542,7 @@ typedef struct WGPURenderBundleImpl{
     uint32_t colorAttachmentCount;
     VkFormat depthFormat;
     VkFormat depthStencilFormat;
+    uint32_t sampleCount;
 }WGPURenderBundleImpl;
 
 typedef struct WGPURenderBundleEncoderImpl{
@@ -2416,11 +2556,64 @@ typedef struct WGPURenderBundleEncoderImpl{
     VkFormat* colorAttachmentFormats;
     uint32_t colorAttachmentCount;
     VkFormat depthStencilFormat;
+    uint32_t sampleCount;
 }WGPURenderBundleEncoderImpl;
 
 void RenderPassEncoder_PushCommand(WGPURenderPassEncoder, const RenderPassCommandGeneric* cmd);
 void ComputePassEncoder_PushCommand(WGPUComputePassEncoder, const RenderPassCommandGeneric* cmd);
 
+DEFINE_VECTOR(static inline, VkBufferCopy, VkBufferCopyVector)
+DEFINE_VECTOR(static inline, VkBufferImageCopy, VkBufferImageCopyVector)
+DEFINE_VECTOR(static inline, VkImageBlit, VkImageBlitVector)
+
+typedef enum PendingCopyType{
+    pending_copy_none,
+    pending_copy_buffer_to_buffer,
+    pending_copy_buffer_to_texture,
+    pending_copy_texture_to_texture,
+}PendingCopyType;
+
+// Consecutive copies between the same source and destination, recorded as a single vkCmdCopy* once anything else is encoded.
+// Only the first copy emits barriers, so the destination regions of one batch never overlap.
+typedef struct PendingCopies{
+    PendingCopyType type;
+    void* source;      // WGPUBuffer or WGPUTexture
+    void* destination; // WGPUBuffer or WGPUTexture
+    uint32_t sourceMipLevel;
+    uint32_t sourceLayer;
+    uint32_t destinationMipLevel;
+    WGPUTextureAspect sourceAspect;
+    WGPUTextureAspect destinationAspect;
+    uint64_t bufferBegin; // Bounds of all destination regions so far
+    uint64_t bufferEnd;
+    VkOffset3D boxBegin;
+    VkOffset3D boxEnd;
+    VkBufferCopyVector bufferCopies;
+    VkBufferImageCopyVector bufferImageCopies;
+    VkImageBlitVector blits;
+}PendingCopies;
+
+DEFINE_VECTOR(static inline, VkBufferMemoryBarrier2, VkBufferMemoryBarrierVector)
+DEFINE_VECTOR(static inline, VkMemoryBarrier2, VkMemoryBarrierVector)
+DEFINE_VECTOR(static inline, VkImageMemoryBarrier2, VkImageMemoryBarrierVector)
+
+typedef struct CmdBarrierSet{
+    VkBufferMemoryBarrierVector bufferBarriers;
+    VkMemoryBarrierVector memoryBarriers;
+    VkImageMemoryBarrierVector imageBarriers;
+}CmdBarrierSet;
+
+// An event set right after the buffer writes of one command. The barrier is part of both
+// vkCmdSetEvent2 and vkCmdWaitEvents2, which synchronization2 requires to match
+typedef struct SplitEvent{
+    VkEvent event;
+    uint32_t producer;
+    bool consumed;     // A later command waits for it
+    VkMemoryBarrier2 barrier;
+}SplitEvent;
+DEFINE_VECTOR(static inline, SplitEvent, SplitEventVector)
+DEFINE_VECTOR(static inline, uint32_t, SplitEventWaitVector)
+
 typedef struct WGPUCommandEncoderImpl{
     VkCommandBuffer buffer;
     refcount_type refCount;
@@ -2433,8 +2626,32 @@ typedef struct WGPUCommandEncoderImpl{
     WGPUDevice device;
     uint32_t cacheIndex;
     uint32_t movedFrom;
-    
-    
+    ThreadCommandPool* commandPool;
+    PendingCopies pendingCopies;
+    CmdBarrierSet pendingBarriers; // Transitions for the next recorded command, see CommandEncoder_flushBarriers
+
+    // Split barriers: every command that uses tracked resources gets a serial. The buffer writes of the
+    // previous command get an event unless the current one already waits for them with a barrier
+    uint32_t commandSerial;
+    VkPipelineStageFlags2 currentWriteStages;
+    VkAccessFlags2 currentWriteAccesses;
+    VkPipelineStageFlags2 previousWriteStages;
+    VkAccessFlags2 previousWriteAccesses;
+    bool previousWritesConsumed;
+    SplitEventVector splitEvents;
+    SplitEventWaitVector pendingEventWaits; // Indices into splitEvents
+    uint32_t unconsumedSplitEvents;         // Capped by WGVK_MAX_UNCONSUMED_SPLIT_EVENTS
+
+    // Begin info of the render pass whose rendering instance is still open so that a compatible next pass can continue it,
+    // ended by CommandEncoder_endRendering before anything else is recorded. A copy, the pass encoder is usually released by then
+    bool renderingOpen;
+    RenderPassCommandBegin openRenderPass;
+    VkRenderingFlags openRenderingFlags;
+
+    // Transient indirect buffer the current run of coalesced draws is sub-allocated from. Referenced by resourceUsage,
+    // so it lives as long as the command buffer recorded from this encoder
+    WGPUBuffer batchBuffer;
+    uint64_t batchBufferOffset;
 }WGPUCommandEncoderImpl;
 typedef struct WGPUCommandBufferImpl{
     VkCommandBuffer buffer;
@@ -2447,6 +2664,8 @@ typedef struct WGPUCommandBufferImpl{
     WGPUString label;
     WGPUDevice device;
     uint32_t cacheIndex;
+    ThreadCommandPool* commandPool;
+    SplitEventVector splitEvents;
 }WGPUCommandBufferImpl;
 
 
@@ -2500,18 +2719,55 @@ typedef struct WGPUSurfaceImpl{
     WGPUSurfaceCapabilities capabilityCache;
 }WGPUSurfaceImpl;
 
+// A wgpuQueueWriteBuffer to device local memory that is recorded into the presubmit cache at the next submit
+typedef struct PendingBufferWrite{
+    WGPUBuffer buffer;
+    uint64_t offset;
+    uint64_t size;
+    size_t dataOffset; // Into PendingBufferWrites::data
+}PendingBufferWrite;
+
+DEFINE_VECTOR(static inline, PendingBufferWrite, PendingBufferWriteVector)
+DEFINE_PTR_HASH_MAP(static inline, PendingBufferWriteMap, uint32_t)
+
+typedef struct PendingBufferWrites{
+    PendingBufferWriteVector writes;
+    PendingBufferWriteMap lastWriteOfBuffer; // Index into writes
+    uint8_t* data;
+    size_t dataSize;
+    size_t dataCapacity;
+    WGPUBufferVector zeroFills;   // Buffers created with WGVK_ZERO_INITIALIZE_BUFFERS, filled before the writes
+    wgvk_mutex_t* zeroFillsMutex; // Buffers are created on any thread
+}PendingBufferWrites;
+
+// A submit waits until queue's timeline semaphore reached value
+typedef struct QueueTimelineWait{
+    WGPUQueue queue;
+    uint64_t value;
+}QueueTimelineWait;
+
 typedef struct WGPUQueueImpl{
-    VkQueue graphicsQueue;
+    VkQueue graphicsQueue;       // NULL for the async compute queue, which submits to computeQueue, and the transfer queue
     VkQueue computeQueue;
-    VkQueue transferQueue;
+    VkQueue transferQueue;       // Only set for the transfer queue
     VkQueue presentQueue;
     refcount_type refCount;
+    uint32_t familyIndex;
+    VkExtent3D imageTransferGranularity; // Transfer queue only, copies into images that are not multiples of it have to cover whole mip levels
+
+    // Every submit signals the next value, fences only remember theirs. Binary semaphores are left for acquire and present.
+    // Each queue has its own, values of one timeline have to be signalled in order
+    VkSemaphore timelineSemaphore;
+    uint64_t timelineValue; // Signalled by the latest submit
+    // Shared by queues that submit to the same VkQueue, which Vulkan requires to be externally synchronized.
+    // NULL if the queue has its VkQueue to itself
+    wgvk_mutex_t* vkQueueMutex;
 
     
     WGPUDevice device;
 
     WGPUCommandEncoder presubmitCache;
-
+    PendingBufferWrites pendingWrites;
     
 }WGPUQueueImpl;
 
@@ -3074,7 +3330,6 @@ static inline VkColorComponentFlags toVulkanColorWriteMask(WGPUColorWriteMask ma
     return ret;
 }
 static inline VkImageViewType toVulkanTextureViewDimension(WGPUTextureViewDimension dim){
-    VkImageViewCreateInfo info;
     switch(dim){
         default:
         case 0:{
@@ -3096,7 +3351,6 @@ static inline VkImageViewType toVulkanTextureViewDimension(WGPUTextureViewDimens
     }
 }
 static inline VkImageType toVulkanTextureDimension(WGPUTextureDimension dim){
-    VkImageViewCreateInfo info;
     switch(dim){
         default:
         case 0:{
@@ -3114,7 +3368,6 @@ static inline VkImageType toVulkanTextureDimension(WGPUTextureDimension dim){
     }
 }
 static inline WGPUTextureDimension fromVulkanTextureDimension(VkImageType dim){
-    VkImageViewCreateInfo info;
     switch(dim){
         default:
             rg_unreachable();
@@ -3698,49 +3951,49 @@ static inline VkShaderStageFlags toVulkanShaderStageBits(WGPUShaderStage stage)
     return ret;
 }
 
-static inline VkPipelineStageFlags toVulkanPipelineStageBits(WGPUShaderStage stage) {
-    VkPipelineStageFlags ret = 0;
+static inline VkPipelineStageFlags2 toVulkanPipelineStageBits(WGPUShaderStage stage) {
+    VkPipelineStageFlags2 ret = 0;
     if(stage & WGPUShaderStage_Vertex){
-        ret |= VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT;
+        ret |= VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT;
     }
     if(stage & WGPUShaderStage_TessControl){
-        ret |= VK_PIPELINE_STAGE_TESSELLATION_CONTROL_SHADER_BIT;
+        ret |= VK_PIPELINE_STAGE_2_TESSELLATION_CONTROL_SHADER_BIT;
     }
     if(stage & WGPUShaderStage_TessEvaluation){
-        ret |= VK_PIPELINE_STAGE_TESSELLATION_EVALUATION_SHADER_BIT;
+        ret |= VK_PIPELINE_STAGE_2_TESSELLATION_EVALUATION_SHADER_BIT;
     }
     if(stage & WGPUShaderStage_Geometry){
-        ret |= VK_PIPELINE_STAGE_GEOMETRY_SHADER_BIT;
+        ret |= VK_PIPELINE_STAGE_2_GEOMETRY_SHADER_BIT;
     }
     if(stage & WGPUShaderStage_Fragment){
-        ret |= VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+        ret |= VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT;
     }
     if(stage & WGPUShaderStage_Compute){
-        ret |= VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+        ret |= VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
     }
     if(stage & WGPUShaderStage_RayGen){
-        ret |= VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR;
+        ret |= VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR;
     }
     if(stage & WGPUShaderStage_Miss){
-        ret |= VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR;
+        ret |= VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR;
     }
     if(stage & WGPUShaderStage_ClosestHit){
-        ret |= VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR;
+        ret |= VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR;
     }
     if(stage & WGPUShaderStage_AnyHit){
-        ret |= VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR;
+        ret |= VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR;
     }
     if(stage & WGPUShaderStage_Intersect){
-        ret |= VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR;
+        ret |= VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR;
     }
     if(stage & WGPUShaderStage_Callable){
-        ret |= VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR;
+        ret |= VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR;
     }
     if(stage & WGPUShaderStage_Task){
-        ret |= VK_PIPELINE_STAGE_TASK_SHADER_BIT_EXT;
+        ret |= VK_PIPELINE_STAGE_2_TASK_SHADER_BIT_EXT;
     }
     if(stage & WGPUShaderStage_Mesh){
-        ret |= VK_PIPELINE_STAGE_MESH_SHADER_BIT_EXT;
+        ret |= VK_PIPELINE_STAGE_2_MESH_SHADER_BIT_EXT;
     }
     return ret;
 }
@@ -3856,21 +4109,25 @@ static inline VkDescriptorType extractVkDescriptorType(const WGPUBindGroupLayout
     rg_trap();
 }
 
-static inline VkAccessFlags extractVkAccessFlags(const WGPUBindGroupLayoutEntry* entry){
+// The accesses a binding can perform, with the storage and sampled reads split out as in synchronization2
+static inline VkAccessFlags2 extractVkAccessFlags(const WGPUBindGroupLayoutEntry* entry){
     if(entry->buffer.type == WGPUBufferBindingType_Storage){
-        return VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        return VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
     }
     if(entry->buffer.type == WGPUBufferBindingType_ReadOnlyStorage){
-        return VK_ACCESS_SHADER_READ_BIT;
+        return VK_ACCESS_2_SHADER_STORAGE_READ_BIT;
     }
     if(entry->buffer.type == WGPUBufferBindingType_Uniform){
-        return VK_ACCESS_SHADER_READ_BIT;
+        return VK_ACCESS_2_UNIFORM_READ_BIT;
     }
-    if(entry->storageTexture.access != WGPUStorageTextureAccess_BindingNotUsed){
-        return VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT;
+    switch(entry->storageTexture.access){
+        case WGPUStorageTextureAccess_BindingNotUsed: break;
+        case WGPUStorageTextureAccess_WriteOnly: return VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
+        case WGPUStorageTextureAccess_ReadOnly: return VK_ACCESS_2_SHADER_STORAGE_READ_BIT;
+        default: return VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
     }
     if(entry->texture.sampleType != WGPUTextureSampleType_BindingNotUsed){
-        return VK_ACCESS_SHADER_READ_BIT;
+        return VK_ACCESS_2_SHADER_SAMPLED_READ_BIT;
     }
     if(entry->sampler.type != WGPUSamplerBindingType_BindingNotUsed){
         return 0;
@@ -3878,6 +4135,71 @@ static inline VkAccessFlags extractVkAccessFlags(const WGPUBindGroupLayoutEntry*
     rg_trap();
 }
 
+// The byte range a buffer binding can touch. Dynamic offsets are only known when the group is bound, so those cover the whole buffer
+static inline BufferUsageSnap bindGroupBufferUsage(const WGPUBindGroupLayoutEntry* layoutEntry, const WGPUBindGroupEntry* entry){
+    const bool dynamic = layoutEntry->buffer.hasDynamicOffset;
+    return (BufferUsageSnap){
+        .stage = toVulkanPipelineStageBits(layoutEntry->visibility),
+        .access = extractVkAccessFlags(layoutEntry),
+        .offset = dynamic ? 0 : entry->offset,
+        .size = dynamic ? WGPU_WHOLE_SIZE : entry->size,
+    };
+}
+
+// Barriers only make writes available, so their source access keeps just the write bits
+static inline VkAccessFlags2 writingAccesses(VkAccessFlags2 flags){
+    return flags & (
+          VK_ACCESS_2_SHADER_WRITE_BIT
+        | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT
+        | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT
+        | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT
+        | VK_ACCESS_2_TRANSFER_WRITE_BIT
+        | VK_ACCESS_2_HOST_WRITE_BIT
+        | VK_ACCESS_2_MEMORY_WRITE_BIT
+        | VK_ACCESS_2_TRANSFORM_FEEDBACK_WRITE_BIT_EXT
+        | VK_ACCESS_2_TRANSFORM_FEEDBACK_COUNTER_WRITE_BIT_EXT
+        | VK_ACCESS_2_ACCELERATION_STRUCTURE_WRITE_BIT_KHR
+        | VK_ACCESS_2_COMMAND_PREPROCESS_WRITE_BIT_EXT
+    );
+}
+static inline bool isWritingAccess(VkAccessFlags2 flags){
+    return writingAccesses(flags) != 0;
+}
+
+// Without synchronization2 the split stages and accesses fold back into the coarser legacy bits they were carved out of
+static inline VkPipelineStageFlags toLegacyStageMask(VkPipelineStageFlags2 stages, VkPipelineStageFlags ifNone){
+    VkPipelineStageFlags ret = (VkPipelineStageFlags)(stages & 0xffffffffull);
+    if(stages & (VK_PIPELINE_STAGE_2_COPY_BIT | VK_PIPELINE_STAGE_2_RESOLVE_BIT | VK_PIPELINE_STAGE_2_BLIT_BIT | VK_PIPELINE_STAGE_2_CLEAR_BIT)){
+        ret |= VK_PIPELINE_STAGE_TRANSFER_BIT;
+    }
+    if(stages & (VK_PIPELINE_STAGE_2_INDEX_INPUT_BIT | VK_PIPELINE_STAGE_2_VERTEX_ATTRIBUTE_INPUT_BIT)){
+        ret |= VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+    }
+    if(stages & VK_PIPELINE_STAGE_2_PRE_RASTERIZATION_SHADERS_BIT){
+        ret |= VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_TESSELLATION_CONTROL_SHADER_BIT | VK_PIPELINE_STAGE_TESSELLATION_EVALUATION_SHADER_BIT | VK_PIPELINE_STAGE_GEOMETRY_SHADER_BIT;
+    }
+    const VkPipelineStageFlags2 knownHighBits = VK_PIPELINE_STAGE_2_COPY_BIT | VK_PIPELINE_STAGE_2_RESOLVE_BIT | VK_PIPELINE_STAGE_2_BLIT_BIT | VK_PIPELINE_STAGE_2_CLEAR_BIT
+                                              | VK_PIPELINE_STAGE_2_INDEX_INPUT_BIT | VK_PIPELINE_STAGE_2_VERTEX_ATTRIBUTE_INPUT_BIT | VK_PIPELINE_STAGE_2_PRE_RASTERIZATION_SHADERS_BIT;
+    if((stages >> 32) & ~(knownHighBits >> 32)){
+        ret |= VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+    }
+    return ret ? ret : ifNone;
+}
+static inline VkAccessFlags toLegacyAccessMask(VkAccessFlags2 access){
+    VkAccessFlags ret = (VkAccessFlags)(access & 0xffffffffull);
+    if(access & (VK_ACCESS_2_SHADER_SAMPLED_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_READ_BIT)){
+        ret |= VK_ACCESS_SHADER_READ_BIT;
+    }
+    if(access & VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT){
+        ret |= VK_ACCESS_SHADER_WRITE_BIT;
+    }
+    const VkAccessFlags2 knownHighBits = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
+    if((access >> 32) & ~(knownHighBits >> 32)){
+        ret |= VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+    }
+    return ret;
+}
+
 
 #define ENTRY()// (void)0// printf("Entering: %s\n", __func__)
 #define EXIT()// (void)0// printf("Exiting: %s\n", __func__)
@@ -25,6 +25,11 @@
  */
 
 #include "wgvk_config.h"
+#if WGVK_ENABLE_CAPTURE == 1
+    // The entry points wrapped by src/wgvk_capture.c are compiled as wgvkCore_*
+    #define WGVK_CAPTURE_RENAME_CORE
+    #include "wgvk_capture.h"
+#endif
 #include <stdatomic.h>
 #define VK_NO_PROTOTYPES
 #include "vulkan/vulkan_core.h"
@@ -689,6 +694,9 @@ WGPUStatus wgpuDeviceGetAdapterInfo(WGPUDevice device, WGPUAdapterInfo* adapterI
 #ifndef MIN
     #define MIN(a, b) (((a) < (b)) ? (a) : (b))
 #endif
+#ifndef MAX
+    #define MAX(a, b) (((a) > (b)) ? (a) : (b))
+#endif
 WGPUStatus wgpuAdapterGetLimits(WGPUAdapter adapter, WGPULimits* limits) WGPU_FUNCTION_ATTRIBUTE{
     ENTRY();
     VkPhysicalDeviceSubgroupProperties subgroupProperties = {
@@ -794,8 +802,194 @@ void PerframeCache_pushFenceDependencies(PerframeCache* pfcache, WGPUFence fence
     }
 }
 
+static QueueFamilySlot FIFCache_familySlot(const FIFCache* fifCache, uint32_t queueFamily){
+    if(queueFamily == fifCache->queueFamily){
+        return QueueFamilySlot_Default;
+    }
+    const WGPUQueue transferQueue = fifCache->device->transferQueue;
+    return (transferQueue && queueFamily == transferQueue->familyIndex) ? QueueFamilySlot_Transfer : QueueFamilySlot_AsyncCompute;
+}
+
+ThreadCommandPool* PerframeCache_getThreadCommandPool(WGPUDevice device, PerframeCache* pfcache, uint32_t queueFamily){
+    const uint64_t threadId = wgvk_thread_current_id();
+    ThreadCommandPoolMap* pools = pfcache->threadCommandPools + FIFCache_familySlot(&device->fifCache, queueFamily);
+    wgvk_mutex_lock(pfcache->threadCommandPoolsMutex);
+    ThreadCommandPool** existing = ThreadCommandPoolMap_get(pools, (void*)(uintptr_t)threadId);
+    if(existing){
+        ThreadCommandPool* ret = *existing;
+        wgvk_mutex_unlock(pfcache->threadCommandPoolsMutex);
+        return ret;
+    }
+    ThreadCommandPool* ret = NULL;
+    for(size_t i = pfcache->spareCommandPools.size;i > 0;i--){
+        if(pfcache->spareCommandPools.data[i - 1]->queueFamily == queueFamily){
+            ret = pfcache->spareCommandPools.data[i - 1];
+            pfcache->spareCommandPools.data[i - 1] = pfcache->spareCommandPools.data[pfcache->spareCommandPools.size - 1];
+            ThreadCommandPoolVector_pop_back(&pfcache->spareCommandPools);
+            break;
+        }
+    }
+    if(ret == NULL){
+        ret = RL_CALLOC(1, sizeof(ThreadCommandPool));
+        ret->level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        ret->queueFamily = queueFamily;
+        ret->mutex = wgvk_mutex_create(wgvk_locktype_spin);
+        VkCommandBufferVector_init(&ret->freeBuffers);
+        VkCommandBufferVector_init(&ret->retiredBuffers);
+        const VkCommandPoolCreateInfo pci = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+            .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+            .queueFamilyIndex = queueFamily
+        };
+        VkResult cpcres = device->functions.vkCreateCommandPool(device->device, &pci, NULL, &ret->pool);
+        if(cpcres != VK_SUCCESS){
+            TRACELOG(WGPU_LOG_ERROR, "vkCreateCommandPool returned %s", vkErrorString(cpcres));
+        }
+    }
+    ret->threadId = threadId;
+    ThreadCommandPoolMap_put(pools, (void*)(uintptr_t)threadId, ret);
+    wgvk_mutex_unlock(pfcache->threadCommandPoolsMutex);
+    return ret;
+}
+
+VkCommandBuffer ThreadCommandPool_acquire(WGPUDevice device, ThreadCommandPool* tpool){
+    VkCommandBuffer ret = VK_NULL_HANDLE;
+    wgvk_mutex_lock(tpool->mutex);
+    if(!VkCommandBufferVector_empty(&tpool->freeBuffers)){
+        ret = tpool->freeBuffers.data[tpool->freeBuffers.size - 1];
+        VkCommandBufferVector_pop_back(&tpool->freeBuffers);
+    }
+    else{
+        const VkCommandBufferAllocateInfo bai = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+            .commandPool = tpool->pool,
+            .level = tpool->level,
+            .commandBufferCount = 1,
+        };
+        device->functions.vkAllocateCommandBuffers(device->device, &bai, &ret);
+    }
+    ++tpool->outstandingBuffers;
+    wgvk_mutex_unlock(tpool->mutex);
+    return ret;
+}
+
+void ThreadCommandPool_retire(ThreadCommandPool* tpool, VkCommandBuffer buffer){
+    wgvk_mutex_lock(tpool->mutex);
+    wgvk_assert(tpool->outstandingBuffers > 0, "Retiring more command buffers than were acquired");
+    VkCommandBufferVector_push_back(&tpool->retiredBuffers, buffer);
+    --tpool->outstandingBuffers;
+    wgvk_mutex_unlock(tpool->mutex);
+}
+
+/**
+ * @brief Resets the whole pool if none of its buffers is alive anymore
+ * @return true if the pool was reset and all its buffers are free again
+ */
+static bool ThreadCommandPool_tryReset(WGPUDevice device, ThreadCommandPool* tpool){
+    wgvk_mutex_lock(tpool->mutex);
+    const bool idle = tpool->outstandingBuffers == 0;
+    if(idle){
+        if(tpool->retiredBuffers.size > 0){
+            device->functions.vkResetCommandPool(device->device, tpool->pool, 0);
+            VkCommandBufferVector* freeBuffers = &tpool->freeBuffers;
+            VkCommandBufferVector* retiredBuffers = &tpool->retiredBuffers;
+            VkCommandBufferVector_reserve(freeBuffers, freeBuffers->size + retiredBuffers->size);
+            memcpy(freeBuffers->data + freeBuffers->size, retiredBuffers->data, retiredBuffers->size * sizeof(VkCommandBuffer));
+            freeBuffers->size += retiredBuffers->size;
+            VkCommandBufferVector_clear(retiredBuffers);
+        }
+    }
+    wgvk_mutex_unlock(tpool->mutex);
+    return idle;
+}
+
+void PerframeCache_recycleCommandPools(WGPUDevice device, PerframeCache* pfcache){
+    wgvk_mutex_lock(pfcache->threadCommandPoolsMutex);
+    
+    for(size_t i = 0;i < pfcache->detachedCommandPools.size;){
+        ThreadCommandPool* tpool = pfcache->detachedCommandPools.data[i];
+        if(ThreadCommandPool_tryReset(device, tpool)){
+            ThreadCommandPoolVector_push_back(&pfcache->spareCommandPools, tpool);
+            pfcache->detachedCommandPools.data[i] = pfcache->detachedCommandPools.data[pfcache->detachedCommandPools.size - 1];
+            ThreadCommandPoolVector_pop_back(&pfcache->detachedCommandPools);
+        }
+        else{
+            ++i;
+        }
+    }
+
+    for(uint32_t slot = 0;slot < QueueFamilySlot_Count;slot++){
+        ThreadCommandPoolMap* map = pfcache->threadCommandPools + slot;
+        for(size_t i = 0;i < map->current_capacity;i++){
+            ThreadCommandPoolMap_kv_pair* kvp = map->table + i;
+            if(kvp->key == PHM_EMPTY_SLOT_KEY || kvp->key == PHM_DELETED_SLOT_KEY){
+                continue;
+            }
+            ThreadCommandPool* tpool = kvp->value;
+            if(!ThreadCommandPool_tryReset(device, tpool)){
+                // An encoder from this pool lives across the frame boundary.
+                // It keeps the pool to itself, the thread gets a different one on its next encoder.
+                ThreadCommandPoolVector_push_back(&pfcache->detachedCommandPools, tpool);
+                ThreadCommandPoolMap_erase(map, kvp->key);
+            }
+        }
+    }
+    wgvk_mutex_unlock(pfcache->threadCommandPoolsMutex);
+}
+
+ThreadCommandPool* Device_getBundleCommandPool(WGPUDevice device){
+    const uint64_t threadId = wgvk_thread_current_id();
+    wgvk_mutex_lock(device->bundleCommandPoolsMutex);
+    ThreadCommandPool** existing = ThreadCommandPoolMap_get(&device->bundleCommandPools, (void*)(uintptr_t)threadId);
+    if(existing){
+        ThreadCommandPool* ret = *existing;
+        wgvk_mutex_unlock(device->bundleCommandPoolsMutex);
+        return ret;
+    }
+    ThreadCommandPool* ret = RL_CALLOC(1, sizeof(ThreadCommandPool));
+    ret->threadId = threadId;
+    ret->level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+    ret->queueFamily = device->fifCache.queueFamily;
+    ret->mutex = wgvk_mutex_create(wgvk_locktype_spin);
+    VkCommandBufferVector_init(&ret->freeBuffers);
+    VkCommandBufferVector_init(&ret->retiredBuffers);
+    const VkCommandPoolCreateInfo pci = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+        .queueFamilyIndex = device->fifCache.queueFamily
+    };
+    VkResult cpcres = device->functions.vkCreateCommandPool(device->device, &pci, NULL, &ret->pool);
+    if(cpcres != VK_SUCCESS){
+        TRACELOG(WGPU_LOG_ERROR, "vkCreateCommandPool returned %s", vkErrorString(cpcres));
+    }
+    ThreadCommandPoolMap_put(&device->bundleCommandPools, (void*)(uintptr_t)threadId, ret);
+    wgvk_mutex_unlock(device->bundleCommandPoolsMutex);
+    return ret;
+}
+
+void ThreadCommandPool_release(ThreadCommandPool* tpool, VkCommandBuffer buffer){
+    // Bundle pools allow individual resets, vkBeginCommandBuffer resets the buffer on its next use
+    wgvk_mutex_lock(tpool->mutex);
+    wgvk_assert(tpool->outstandingBuffers > 0, "Releasing more command buffers than were acquired");
+    if(buffer != VK_NULL_HANDLE){
+        VkCommandBufferVector_push_back(&tpool->freeBuffers, buffer);
+    }
+    --tpool->outstandingBuffers;
+    wgvk_mutex_unlock(tpool->mutex);
+}
+
+static void ThreadCommandPool_destroy(WGPUDevice device, ThreadCommandPool* tpool){
+    // Destroying the pool frees all of its command buffers
+    device->functions.vkDestroyCommandPool(device->device, tpool->pool, NULL);
+    VkCommandBufferVector_free(&tpool->freeBuffers);
+    VkCommandBufferVector_free(&tpool->retiredBuffers);
+    wgvk_mutex_destroy(tpool->mutex);
+    RL_FREE(tpool);
+}
+
 void FIFCache_init(FIFCache* fifCache, WGPUDevice device, uint32_t queueFamily){
     fifCache->device = device;
+    fifCache->queueFamily = queueFamily;
     VkSemaphoreCreateInfo sci = { VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO };
     VkCommandPoolCreateInfo pci = { 
         .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
@@ -817,10 +1011,22 @@ void FIFCache_init(FIFCache* fifCache, WGPUDevice device, uint32_t queueFamily){
             .commandBufferCount = 1
         };
         device->functions.vkAllocateCommandBuffers(device->device, &cbai, ftb);
+        for(uint32_t slot = 0;slot < QueueFamilySlot_Count;slot++){
+            ThreadCommandPoolMap_init(fifCache->frameCaches[i].threadCommandPools + slot);
+        }
+        ThreadCommandPoolVector_init(&fifCache->frameCaches[i].detachedCommandPools);
+        ThreadCommandPoolVector_init(&fifCache->frameCaches[i].spareCommandPools);
+        fifCache->frameCaches[i].threadCommandPoolsMutex = wgvk_mutex_create(wgvk_locktype_spin);
+        fifCache->frameCaches[i].batchBuffersMutex = wgvk_mutex_create(wgvk_locktype_spin);
+        WGPUBufferVector_init(&fifCache->frameCaches[i].retiredBuffers);
+        RetiredDescriptorSetVector_init(&fifCache->frameCaches[i].retiredDescriptorSets);
         fifCache->frameCaches[i].finalTransitionFence = wgpuDeviceCreateFence(device);
         VkSemaphoreVector* semvec = &fifCache->frameCaches[i].syncState.semaphores;
-        VkSemaphoreVector_reserve(semvec, 100);
-        semvec->size = 100;
+        // The binary chain between submits is only needed without a timeline
+        if(!device->capabilities.timelineSemaphore){
+            VkSemaphoreVector_reserve(semvec, 100);
+            semvec->size = 100;
+        }
         for(uint32_t j = 0;j < semvec->size;j++){
             device->functions.vkCreateSemaphore(device->device, &sci, NULL, semvec->data + j);
         }
@@ -836,6 +1042,40 @@ void SyncState_destroy(WGPUDevice device, SyncState* syncState){
     VkSemaphoreVector_free(&syncState->semaphores);
 }
 
+static void BindGroupCache_return(BindGroupCacheMap* bgcm, WGPUBindGroupLayout layout, DescriptorSetAndPool setAndPool){
+    DescriptorSetAndPoolVector* maybeAlreadyThere = BindGroupCacheMap_get(bgcm, layout);
+    if(maybeAlreadyThere == NULL){
+        DescriptorSetAndPoolVector empty zeroinit;
+        BindGroupCacheMap_put(bgcm, layout, empty);
+        maybeAlreadyThere = BindGroupCacheMap_get(bgcm, layout);
+        wgvk_assert(maybeAlreadyThere != NULL, "Still null after insert");
+        DescriptorSetAndPoolVector_init(maybeAlreadyThere);
+    }
+    DescriptorSetAndPoolVector_push_back(maybeAlreadyThere, setAndPool);
+}
+
+// Called once the fences of the frame are waited for. Descriptor sets go back into the bindGroupCache
+// unless their layout is about to die, buffer backings are destroyed.
+static void PerframeCache_releaseRetired(WGPUDevice device, PerframeCache* cache){
+    wgvk_mutex_lock(device->backingRetireMutex);
+    for(size_t i = 0;i < cache->retiredBuffers.size;i++){
+        wgpuBufferRelease(cache->retiredBuffers.data[i]);
+    }
+    WGPUBufferVector_clear(&cache->retiredBuffers);
+    for(size_t i = 0;i < cache->retiredDescriptorSets.size;i++){
+        RetiredDescriptorSet* retired = cache->retiredDescriptorSets.data + i;
+        if(retired->layout->refCount > 1){
+            BindGroupCache_return(&cache->bindGroupCache, retired->layout, retired->setAndPool);
+        }
+        else{
+            device->functions.vkDestroyDescriptorPool(device->device, retired->setAndPool.pool, NULL);
+        }
+        wgpuBindGroupLayoutRelease(retired->layout);
+    }
+    RetiredDescriptorSetVector_clear(&cache->retiredDescriptorSets);
+    wgvk_mutex_unlock(device->backingRetireMutex);
+}
+
 void FIFCache_destroy(FIFCache* fcache){
     for(uint32_t i = 0;i < framesInFlight;i++){
         PerframeCache* cache = fcache->frameCaches + i;
@@ -864,16 +1104,43 @@ void FIFCache_destroy(FIFCache* fcache){
         SyncState_destroy(fcache->device, &fcache->frameCaches[i].syncState);
         wgpuFenceRelease(cache->finalTransitionFence);
         
-        if(cache->commandBuffers.size){
-            device->functions.vkFreeCommandBuffers(device->device, cache->commandPool, cache->commandBuffers.size, cache->commandBuffers.data);
-            VkCommandBufferVector_free(&cache->commandBuffers);
+        for(uint32_t slot = 0;slot < QueueFamilySlot_Count;slot++){
+            ThreadCommandPoolMap* pools = cache->threadCommandPools + slot;
+            for(size_t tp = 0;tp < pools->current_capacity;tp++){
+                ThreadCommandPoolMap_kv_pair* kvp = pools->table + tp;
+                if(kvp->key != PHM_EMPTY_SLOT_KEY && kvp->key != PHM_DELETED_SLOT_KEY){
+                    ThreadCommandPool_destroy(device, kvp->value);
+                }
+            }
+            ThreadCommandPoolMap_free(pools);
+        }
+        for(size_t tp = 0;tp < cache->detachedCommandPools.size;tp++){
+            ThreadCommandPool_destroy(device, cache->detachedCommandPools.data[tp]);
+        }
+        for(size_t tp = 0;tp < cache->spareCommandPools.size;tp++){
+            ThreadCommandPool_destroy(device, cache->spareCommandPools.data[tp]);
+        }
+        ThreadCommandPoolVector_free(&cache->detachedCommandPools);
+        ThreadCommandPoolVector_free(&cache->spareCommandPools);
+        wgvk_mutex_destroy(cache->threadCommandPoolsMutex);
+        for(size_t bb = 0;bb < cache->usedBatchBuffers.size;bb++){
+            wgpuBufferRelease(cache->usedBatchBuffers.data[bb]);
         }
+        for(size_t bb = 0;bb < cache->unusedBatchBuffers.size;bb++){
+            wgpuBufferRelease(cache->unusedBatchBuffers.data[bb]);
+        }
+        WGPUBufferVector_free(&cache->usedBatchBuffers);
+        WGPUBufferVector_free(&cache->unusedBatchBuffers);
+        wgvk_mutex_destroy(cache->batchBuffersMutex);
+        PerframeCache_releaseRetired(device, cache);
+        WGPUBufferVector_free(&cache->retiredBuffers);
+        RetiredDescriptorSetVector_free(&cache->retiredDescriptorSets);
         for(size_t bgc = 0;bgc < cache->bindGroupCache.current_capacity;bgc++){
             if(cache->bindGroupCache.table[bgc].key != PHM_EMPTY_SLOT_KEY && cache->bindGroupCache.table[bgc].key != PHM_DELETED_SLOT_KEY){
                 DescriptorSetAndPoolVector* dspv = &cache->bindGroupCache.table[bgc].value;
                 for(size_t vi = 0;vi < dspv->size;vi++){
                     //device->functions.vkFreeDescriptorSets(device->device, dspv->data[i].pool, 1, &dspv->data[i].set);
-                    device->functions.vkDestroyDescriptorPool(device->device, dspv->data[i].pool, NULL);
+                    device->functions.vkDestroyDescriptorPool(device->device, dspv->data[vi].pool, NULL);
                 }
                 DescriptorSetAndPoolVector_free(dspv);
             }
@@ -1172,20 +1439,304 @@ static VKAPI_ATTR VkBool32 VKAPI_CALL debugCallback(
     return VK_FALSE;
 }
 
-static inline bool isWritingAccess(VkAccessFlags flags){
-    return flags & (
-          VK_ACCESS_SHADER_WRITE_BIT
-        | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT
-        | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT
-        | VK_ACCESS_TRANSFER_WRITE_BIT
-        | VK_ACCESS_HOST_WRITE_BIT
-        | VK_ACCESS_MEMORY_WRITE_BIT
-        | VK_ACCESS_TRANSFORM_FEEDBACK_WRITE_BIT_EXT
-        | VK_ACCESS_TRANSFORM_FEEDBACK_COUNTER_WRITE_BIT_EXT
-        | VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR
-        | VK_ACCESS_COMMAND_PREPROCESS_WRITE_BIT_EXT
+// All barriers are built as synchronization2 structs with their own stage masks. Devices without
+// synchronization2 get a single vkCmdPipelineBarrier with the union of the stages instead.
+static void Device_pipelineBarrier(WGPUDevice device, VkCommandBuffer buffer, const VkDependencyInfo* dependencyInfo){
+    const uint32_t barrierCount = dependencyInfo->memoryBarrierCount + dependencyInfo->bufferMemoryBarrierCount + dependencyInfo->imageMemoryBarrierCount;
+    if(barrierCount == 0){
+        return;
+    }
+    if(device->capabilities.synchronization2){
+        device->functions.vkCmdPipelineBarrier2(buffer, dependencyInfo);
+        return;
+    }
+    VkMemoryBarrier       memoryInline[4];
+    VkBufferMemoryBarrier bufferInline[8];
+    VkImageMemoryBarrier  imageInline[8];
+    VkMemoryBarrier*       memoryBarriers = dependencyInfo->memoryBarrierCount       <= 4 ? memoryInline : RL_MALLOC(dependencyInfo->memoryBarrierCount       * sizeof(VkMemoryBarrier));
+    VkBufferMemoryBarrier* bufferBarriers = dependencyInfo->bufferMemoryBarrierCount <= 8 ? bufferInline : RL_MALLOC(dependencyInfo->bufferMemoryBarrierCount * sizeof(VkBufferMemoryBarrier));
+    VkImageMemoryBarrier*  imageBarriers  = dependencyInfo->imageMemoryBarrierCount  <= 8 ? imageInline  : RL_MALLOC(dependencyInfo->imageMemoryBarrierCount  * sizeof(VkImageMemoryBarrier));
+    VkPipelineStageFlags2 srcStages = 0;
+    VkPipelineStageFlags2 dstStages = 0;
+    for(uint32_t i = 0;i < dependencyInfo->memoryBarrierCount;i++){
+        const VkMemoryBarrier2* b = dependencyInfo->pMemoryBarriers + i;
+        srcStages |= b->srcStageMask;
+        dstStages |= b->dstStageMask;
+        memoryBarriers[i] = (VkMemoryBarrier){
+            .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+            .srcAccessMask = toLegacyAccessMask(b->srcAccessMask),
+            .dstAccessMask = toLegacyAccessMask(b->dstAccessMask),
+        };
+    }
+    for(uint32_t i = 0;i < dependencyInfo->bufferMemoryBarrierCount;i++){
+        const VkBufferMemoryBarrier2* b = dependencyInfo->pBufferMemoryBarriers + i;
+        srcStages |= b->srcStageMask;
+        dstStages |= b->dstStageMask;
+        bufferBarriers[i] = (VkBufferMemoryBarrier){
+            .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+            .srcAccessMask = toLegacyAccessMask(b->srcAccessMask),
+            .dstAccessMask = toLegacyAccessMask(b->dstAccessMask),
+            .srcQueueFamilyIndex = b->srcQueueFamilyIndex,
+            .dstQueueFamilyIndex = b->dstQueueFamilyIndex,
+            .buffer = b->buffer,
+            .offset = b->offset,
+            .size = b->size,
+        };
+    }
+    for(uint32_t i = 0;i < dependencyInfo->imageMemoryBarrierCount;i++){
+        const VkImageMemoryBarrier2* b = dependencyInfo->pImageMemoryBarriers + i;
+        srcStages |= b->srcStageMask;
+        dstStages |= b->dstStageMask;
+        imageBarriers[i] = (VkImageMemoryBarrier){
+            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            .srcAccessMask = toLegacyAccessMask(b->srcAccessMask),
+            .dstAccessMask = toLegacyAccessMask(b->dstAccessMask),
+            .oldLayout = b->oldLayout,
+            .newLayout = b->newLayout,
+            .srcQueueFamilyIndex = b->srcQueueFamilyIndex,
+            .dstQueueFamilyIndex = b->dstQueueFamilyIndex,
+            .image = b->image,
+            .subresourceRange = b->subresourceRange,
+        };
+    }
+    device->functions.vkCmdPipelineBarrier(
+        buffer,
+        toLegacyStageMask(srcStages, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT),
+        toLegacyStageMask(dstStages, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT),
+        dependencyInfo->dependencyFlags,
+        dependencyInfo->memoryBarrierCount,       memoryBarriers,
+        dependencyInfo->bufferMemoryBarrierCount, bufferBarriers,
+        dependencyInfo->imageMemoryBarrierCount,  imageBarriers
     );
+    if(memoryBarriers != memoryInline) RL_FREE(memoryBarriers);
+    if(bufferBarriers != bufferInline) RL_FREE(bufferBarriers);
+    if(imageBarriers  != imageInline)  RL_FREE(imageBarriers);
+}
+
+static void CmdBarrierSet_init(CmdBarrierSet* set){
+    VkBufferMemoryBarrierVector_init(&set->bufferBarriers);
+    VkMemoryBarrierVector_init(&set->memoryBarriers);
+    VkImageMemoryBarrierVector_init(&set->imageBarriers);
+}
+
+static void CmdBarrierSet_free(CmdBarrierSet* set){
+    VkBufferMemoryBarrierVector_free(&set->bufferBarriers);
+    VkMemoryBarrierVector_free(&set->memoryBarriers);
+    VkImageMemoryBarrierVector_free(&set->imageBarriers);
+}
+
+static void CmdBarrierSet_clear(CmdBarrierSet* set){
+    VkBufferMemoryBarrierVector_clear(&set->bufferBarriers);
+    VkMemoryBarrierVector_clear(&set->memoryBarriers);
+    VkImageMemoryBarrierVector_clear(&set->imageBarriers);
+}
+
+static bool CmdBarrierSet_empty(const CmdBarrierSet* set){
+    return set->bufferBarriers.size == 0 && set->memoryBarriers.size == 0 && set->imageBarriers.size == 0;
+}
+
+static void CmdBarrierSet_encodeVk(WGPUDevice device, VkCommandBuffer buffer, const CmdBarrierSet* set){
+    const VkDependencyInfo dependencyInfo = {
+        .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .memoryBarrierCount = (uint32_t)set->memoryBarriers.size,
+        .pMemoryBarriers = set->memoryBarriers.data,
+        .bufferMemoryBarrierCount = (uint32_t)set->bufferBarriers.size,
+        .pBufferMemoryBarriers = set->bufferBarriers.data,
+        .imageMemoryBarrierCount = (uint32_t)set->imageBarriers.size,
+        .pImageMemoryBarriers = set->imageBarriers.data,
+    };
+    Device_pipelineBarrier(device, buffer, &dependencyInfo);
+}
+
+static void CmdBarrierSet_encode(WGPUCommandEncoder encoder, const CmdBarrierSet* set){
+    CmdBarrierSet_encodeVk(encoder->device, encoder->buffer, set);
+}
+
+static VkEvent Device_acquireEvent(WGPUDevice device){
+    VkEvent ret = VK_NULL_HANDLE;
+    wgvk_mutex_lock(device->spareEventsMutex);
+    if(!VkEventVector_empty(&device->spareEvents)){
+        ret = device->spareEvents.data[device->spareEvents.size - 1];
+        VkEventVector_pop_back(&device->spareEvents);
+    }
+    wgvk_mutex_unlock(device->spareEventsMutex);
+    if(ret == VK_NULL_HANDLE){
+        const VkEventCreateInfo eci = {
+            .sType = VK_STRUCTURE_TYPE_EVENT_CREATE_INFO,
+        };
+        device->functions.vkCreateEvent(device->device, &eci, NULL, &ret);
+    }
+    return ret;
+}
+
+// Resets the events and hands them back to the device, no pending submission may use them anymore
+static void Device_releaseSplitEvents(WGPUDevice device, SplitEventVector* events){
+    if(events->size > 0){
+        wgvk_mutex_lock(device->spareEventsMutex);
+        for(size_t i = 0;i < events->size;i++){
+            device->functions.vkResetEvent(device->device, events->data[i].event);
+            VkEventVector_push_back(&device->spareEvents, events->data[i].event);
+        }
+        wgvk_mutex_unlock(device->spareEventsMutex);
+    }
+    SplitEventVector_free(events);
+}
+
+// Lets the next command wait for the event set after command producer instead of getting a barrier,
+// which would also wait for everything recorded in between. Returns false if there is no such event
+static bool CommandEncoder_waitForProducer(WGPUCommandEncoder encoder, uint32_t producer){
+    for(size_t i = encoder->splitEvents.size;i-- > 0;){
+        if(encoder->splitEvents.data[i].producer != producer){
+            continue;
+        }
+        for(size_t j = 0;j < encoder->pendingEventWaits.size;j++){
+            if(encoder->pendingEventWaits.data[j] == i){
+                return true;
+            }
+        }
+        SplitEventWaitVector_push_back(&encoder->pendingEventWaits, (uint32_t)i);
+        if(!encoder->splitEvents.data[i].consumed){
+            encoder->splitEvents.data[i].consumed = true;
+            --encoder->unconsumedSplitEvents;
+        }
+        return true;
+    }
+    return false;
+}
+
+// Ends the rendering instance the last render pass left open, see wgpuRenderPassEncoderEnd
+static void CommandEncoder_endRendering(WGPUCommandEncoder encoder){
+    if(!encoder->renderingOpen){
+        return;
+    }
+    encoder->device->functions.vkCmdEndRendering(encoder->buffer);
+    encoder->renderingOpen = false;
+    encoder->openRenderingFlags = 0;
+}
+
+static void CommandEncoder_recordPendingBarriers(WGPUCommandEncoder encoder){
+    if(!CmdBarrierSet_empty(&encoder->pendingBarriers)){
+        CommandEncoder_endRendering(encoder);
+    }
+    CmdBarrierSet_encode(encoder, &encoder->pendingBarriers);
+    CmdBarrierSet_clear(&encoder->pendingBarriers);
+}
+
+// Records the barriers collected by ce_track* since the last command as one pipeline barrier.
+// Has to be called right before every command recorded into encoder->buffer that uses tracked resources.
+static void CommandEncoder_flushBarriers(WGPUCommandEncoder encoder){
+    WGPUDevice device = encoder->device;
+    CommandEncoder_endRendering(encoder);
+    // Transfer-only queues have no events
+    const bool transferFamily = device->transferQueue && encoder->commandPool->queueFamily == device->transferQueue->familyIndex;
+    // Whether a later command reads those writes is not known yet. Events nobody waited for so far limit how many more
+    // are set, which keeps runs of independent writes from paying one event each
+    const bool eventBudget = encoder->unconsumedSplitEvents < WGVK_MAX_UNCONSUMED_SPLIT_EVENTS;
+    if(device->capabilities.splitBarriers && !transferFamily && eventBudget && encoder->previousWriteStages != 0 && !encoder->previousWritesConsumed){
+        // The upcoming command does not wait for the previous one, so later readers of its writes can wait for this event
+        SplitEvent split = {
+            .event = Device_acquireEvent(device),
+            .producer = encoder->commandSerial - 1,
+            .barrier = {
+                .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+                .srcStageMask = encoder->previousWriteStages,
+                .srcAccessMask = encoder->previousWriteAccesses,
+                .dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+                .dstAccessMask = VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT,
+            },
+        };
+        const VkDependencyInfo dependencyInfo = {
+            .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+            .memoryBarrierCount = 1,
+            .pMemoryBarriers = &split.barrier,
+        };
+        device->functions.vkCmdSetEvent2(encoder->buffer, split.event, &dependencyInfo);
+        SplitEventVector_push_back(&encoder->splitEvents, split);
+        ++encoder->unconsumedSplitEvents;
+    }
+    const size_t waitCount = encoder->pendingEventWaits.size;
+    if(waitCount > 0){
+        VkEvent          eventsInline[8];
+        VkDependencyInfo dependenciesInline[8];
+        VkEvent*          events       = waitCount <= 8 ? eventsInline       : RL_MALLOC(waitCount * sizeof(VkEvent));
+        VkDependencyInfo* dependencies = waitCount <= 8 ? dependenciesInline : RL_MALLOC(waitCount * sizeof(VkDependencyInfo));
+        for(size_t i = 0;i < waitCount;i++){
+            const SplitEvent* split = encoder->splitEvents.data + encoder->pendingEventWaits.data[i];
+            events[i] = split->event;
+            dependencies[i] = (VkDependencyInfo){
+                .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+                .memoryBarrierCount = 1,
+                .pMemoryBarriers = &split->barrier,
+            };
+        }
+        device->functions.vkCmdWaitEvents2(encoder->buffer, (uint32_t)waitCount, events, dependencies);
+        if(events != eventsInline){
+            RL_FREE(events);
+            RL_FREE(dependencies);
+        }
+        SplitEventWaitVector_clear(&encoder->pendingEventWaits);
+    }
+    CommandEncoder_recordPendingBarriers(encoder);
+
+    encoder->previousWriteStages    = encoder->currentWriteStages;
+    encoder->previousWriteAccesses  = encoder->currentWriteAccesses;
+    encoder->previousWritesConsumed = false;
+    encoder->currentWriteStages     = 0;
+    encoder->currentWriteAccesses   = 0;
+    ++encoder->commandSerial;
+}
+
+static inline bool subresourceRangesOverlap(const VkImageSubresourceRange* a, const VkImageSubresourceRange* b){
+    const uint32_t aLevelEnd = a->levelCount == VK_REMAINING_MIP_LEVELS   ? UINT32_MAX : a->baseMipLevel + a->levelCount;
+    const uint32_t bLevelEnd = b->levelCount == VK_REMAINING_MIP_LEVELS   ? UINT32_MAX : b->baseMipLevel + b->levelCount;
+    const uint32_t aLayerEnd = a->layerCount == VK_REMAINING_ARRAY_LAYERS ? UINT32_MAX : a->baseArrayLayer + a->layerCount;
+    const uint32_t bLayerEnd = b->layerCount == VK_REMAINING_ARRAY_LAYERS ? UINT32_MAX : b->baseArrayLayer + b->layerCount;
+    return (a->aspectMask & b->aspectMask)
+        && a->baseMipLevel < bLevelEnd && b->baseMipLevel < aLevelEnd
+        && a->baseArrayLayer < bLayerEnd && b->baseArrayLayer < aLayerEnd;
+}
+
+// A resource tracked twice before the next flush chains old -> first use -> second use.
+// Both transitions would land in the same barrier with no defined order between them,
+// so the second one is folded into the first instead.
+static void CommandEncoder_queueBufferBarrier(WGPUCommandEncoder encoder, const VkBufferMemoryBarrier2* barrier){
+    VkBufferMemoryBarrierVector* pending = &encoder->pendingBarriers.bufferBarriers;
+    for(size_t i = 0;i < pending->size;i++){
+        VkBufferMemoryBarrier2* queued = pending->data + i;
+        if(queued->buffer != barrier->buffer || queued->offset >= barrier->offset + barrier->size || barrier->offset >= queued->offset + queued->size){
+            continue;
+        }
+        if(queued->offset == barrier->offset && queued->size == barrier->size){
+            queued->dstStageMask  |= barrier->dstStageMask;
+            queued->dstAccessMask |= barrier->dstAccessMask;
+            return;
+        }
+        CommandEncoder_recordPendingBarriers(encoder);
+        break;
+    }
+    VkBufferMemoryBarrierVector_push_back(pending, *barrier);
+}
+
+static void CommandEncoder_queueImageBarrier(WGPUCommandEncoder encoder, const VkImageMemoryBarrier2* barrier){
+    VkImageMemoryBarrierVector* pending = &encoder->pendingBarriers.imageBarriers;
+    for(size_t i = 0;i < pending->size;i++){
+        VkImageMemoryBarrier2* queued = pending->data + i;
+        if(queued->image != barrier->image || !subresourceRangesOverlap(&queued->subresourceRange, &barrier->subresourceRange)){
+            continue;
+        }
+        if(memcmp(&queued->subresourceRange, &barrier->subresourceRange, sizeof(VkImageSubresourceRange)) == 0){
+            queued->dstStageMask  |= barrier->dstStageMask;
+            queued->dstAccessMask |= barrier->dstAccessMask;
+            queued->newLayout      = barrier->newLayout;
+            return;
+        }
+        // Partially overlapping ranges cannot be folded, the earlier transition has to complete first
+        CommandEncoder_recordPendingBarriers(encoder);
+        break;
+    }
+    VkImageMemoryBarrierVector_push_back(pending, *barrier);
 }
+
 static inline int endswith_(const char* str, const char* suffix) {
     if (!str || !suffix)
         return 0;
@@ -1404,6 +1955,7 @@ WGPUInstance wgpuCreateInstance(const WGPUInstanceDescriptor* descriptor) {
     }
     ret->currentFutureId = 1;
     FutureIDMap_init(&ret->g_futureIDMap);
+    ret->futureMutex = wgvk_mutex_create(wgvk_locktype_kernel);
     // 6. Load instance-level functions using volk
     volkLoadInstance(ret->instance);
 
@@ -1434,15 +1986,36 @@ WGPUInstance wgpuCreateInstance(const WGPUInstanceDescriptor* descriptor) {
     return ret;
     EXIT();
 }
+
+static void Instance_putFuture(WGPUInstance instance, uint64_t id, WGPUFutureImpl future){
+    wgvk_mutex_lock(instance->futureMutex);
+    FutureIDMap_put(&instance->g_futureIDMap, id, future);
+    wgvk_mutex_unlock(instance->futureMutex);
+}
+
+// Runs the future's function unless wgpuInstanceProcessEvents or an earlier wait did already. The entry is marked
+// complete before the function runs, which may create futures itself
+static void Instance_completeFuture(WGPUInstance instance, uint64_t id){
+    wgvk_mutex_lock(instance->futureMutex);
+    WGPUFutureImpl* futureObject = FutureIDMap_get(&instance->g_futureIDMap, id);
+    if(futureObject == NULL || futureObject->functionCalledOnWaitAny == NULL){
+        wgvk_mutex_unlock(instance->futureMutex);
+        return;
+    }
+    const WGPUFutureImpl future = *futureObject;
+    futureObject->functionCalledOnWaitAny = NULL;
+    wgvk_mutex_unlock(instance->futureMutex);
+    future.functionCalledOnWaitAny(future.userdataForFunction);
+    if(future.freeUserData){
+        future.freeUserData(future.userdataForFunction);
+    }
+}
+
 WGPUWaitStatus wgpuInstanceWaitAny(WGPUInstance instance, size_t futureCount, WGPUFutureWaitInfo* futureWaitInfos, uint64_t timeoutNS){
     ENTRY();
     for(uint32_t i = 0;i < futureCount;i++){
         if(!futureWaitInfos[i].completed){
-            WGPUFutureImpl* futureObject = FutureIDMap_get(&instance->g_futureIDMap, futureWaitInfos[i].future.id);
-            futureObject->functionCalledOnWaitAny(futureObject->userdataForFunction);
-            if(futureObject->freeUserData){
-                futureObject->freeUserData(futureObject->userdataForFunction);
-            }
+            Instance_completeFuture(instance, futureWaitInfos[i].future.id);
             futureWaitInfos[i].completed = 1;
         }
     }
@@ -1505,12 +2078,24 @@ void wgpuCreateAdapter_sync(void* userdata_v){
         );
         return;
     }
-    uint32_t i = 0;
-    for(i = 0;i < physicalDeviceCount;i++){
-        VkPhysicalDeviceProperties properties zeroinit;
-        vkGetPhysicalDeviceProperties(pds[i], &properties);
-        if(properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU){
-            break;
+    uint32_t i = physicalDeviceCount;
+    if(userdata->options.forceFallbackAdapter){
+        // Software implementations such as lavapipe
+        for(i = 0;i < physicalDeviceCount;i++){
+            VkPhysicalDeviceProperties properties zeroinit;
+            vkGetPhysicalDeviceProperties(pds[i], &properties);
+            if(properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_CPU){
+                break;
+            }
+        }
+    }
+    if(i == physicalDeviceCount){
+        for(i = 0;i < physicalDeviceCount;i++){
+            VkPhysicalDeviceProperties properties zeroinit;
+            vkGetPhysicalDeviceProperties(pds[i], &properties);
+            if(properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU){
+                break;
+            }
         }
     }
     if(i == physicalDeviceCount){
@@ -1562,6 +2147,20 @@ void wgpuCreateAdapter_sync(void* userdata_v){
             break;
         }
     }
+    // A compute-only family is usually backed by hardware queues that run alongside the graphics queue
+    for(uint32_t i = 0;i < queueFamilyPropertyCount;i++){
+        if((props[i].queueFlags & VK_QUEUE_COMPUTE_BIT) && !(props[i].queueFlags & VK_QUEUE_GRAPHICS_BIT)){
+            adapter->queueIndices.computeIndex = i;
+            break;
+        }
+    }
+    // Transfer-only families are the DMA engines, copies on them do not take time from the other queues
+    for(uint32_t i = 0;i < queueFamilyPropertyCount;i++){
+        if((props[i].queueFlags & VK_QUEUE_TRANSFER_BIT) && !(props[i].queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))){
+            adapter->queueIndices.transferIndex = i;
+            break;
+        }
+    }
     RL_FREE((void*)pds);
     RL_FREE((void*)props);
     userdata->info.callback(WGPURequestAdapterStatus_Success, adapter, CLITERAL(WGPUStringView){NULL, 0}, userdata->info.userdata1, userdata->info.userdata2);
@@ -1577,11 +2176,12 @@ WGPUFuture wgpuInstanceRequestAdapter(WGPUInstance instance, const WGPURequestAd
     WGPUFutureImpl ret = {
         .userdataForFunction = info,
         .functionCalledOnWaitAny = wgpuCreateAdapter_sync,
-        .freeUserData = RL_FREE
+        .freeUserData = RL_FREE,
+        .mode = callbackInfo.mode,
     };
 
     uint64_t id = instance->currentFutureId++; //atomic?
-    FutureIDMap_put(&instance->g_futureIDMap, id, ret);
+    Instance_putFuture(instance, id, ret);
     return (WGPUFuture){ id };
     EXIT();
 }
@@ -1625,6 +2225,43 @@ static size_t sort_uniqueuints(uint32_t *arr, size_t count) {
     (b) = temp;            \
 } while (0)
 
+static VkResult Queue_createTimeline(WGPUQueue queue){
+    const VkSemaphoreTypeCreateInfo timelineCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+        .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+        .initialValue = 0,
+    };
+    const VkSemaphoreCreateInfo timelineSci = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+        .pNext = &timelineCreateInfo,
+    };
+    return queue->device->functions.vkCreateSemaphore(queue->device->device, &timelineSci, NULL, &queue->timelineSemaphore);
+}
+
+// Records into a command buffer of the queue's family for the current frame
+static WGPUCommandEncoder Queue_createPresubmitCache(WGPUQueue queue){
+    WGPUCommandEncoderQueueSelection selection = {
+        .chain = {
+            .sType = WGPUSType_CommandEncoderQueueSelection,
+        },
+        .queue = queue,
+    };
+    const WGPUCommandEncoderDescriptor cedesc = {
+        .nextInChain = &selection.chain,
+    };
+    return wgpuDeviceCreateCommandEncoder(queue->device, &cedesc);
+}
+
+static void Queue_init(WGPUQueue queue, WGPUDevice device, uint32_t familyIndex){
+    queue->device = device;
+    queue->familyIndex = familyIndex;
+    queue->presubmitCache = Queue_createPresubmitCache(queue);
+    PendingBufferWriteVector_init(&queue->pendingWrites.writes);
+    PendingBufferWriteMap_init(&queue->pendingWrites.lastWriteOfBuffer);
+    WGPUBufferVector_init(&queue->pendingWrites.zeroFills);
+    queue->pendingWrites.zeroFillsMutex = wgvk_mutex_create(wgvk_locktype_spin);
+}
+
 typedef struct userdataforcreatedevice{
     WGPUAdapter adapter;
     WGPUDeviceDescriptor deviceDescriptor;
@@ -1644,17 +2281,44 @@ WGPUDevice wgpuAdapterCreateDevice(WGPUAdapter adapter, const WGPUDeviceDescript
         }
     }
     // Collect unique queue families
-    uint32_t queueFamilies[3] = {
+    uint32_t queueFamilies[4] = {
         adapter->queueIndices.graphicsIndex,
         adapter->queueIndices.computeIndex,
-        adapter->queueIndices.presentIndex
+        adapter->queueIndices.presentIndex,
+        adapter->queueIndices.transferIndex
     };
-    uint32_t queueFamilyCount = sort_uniqueuints(queueFamilies, 3);
+    uint32_t queueFamilyCount = sort_uniqueuints(queueFamilies, 4);
+
+    // Only devices that chain a WGPUAsyncComputeQueueSelection get an async compute queue, on the compute-only family
+    // or, if allowed, the graphics family's second queue
+    const WGPUAsyncComputeQueueSelection* asyncComputeSelection = NULL;
+    for(const WGPUChainedStruct* chain = descriptor->nextInChain;chain != NULL;chain = chain->next){
+        if(chain->sType == WGPUSType_AsyncComputeQueueSelection){
+            asyncComputeSelection = (const WGPUAsyncComputeQueueSelection*)chain;
+        }
+    }
+    uint32_t asyncComputeFamily = VK_QUEUE_FAMILY_IGNORED;
+    uint32_t asyncComputeQueueIndex = 0;
+    if(asyncComputeSelection == NULL){
+        // No async compute queue
+    }
+    else if(adapter->queueIndices.computeIndex != adapter->queueIndices.graphicsIndex){
+        asyncComputeFamily = adapter->queueIndices.computeIndex;
+    }
+    else if(asyncComputeSelection->allowGraphicsFamily){
+        asyncComputeFamily = adapter->queueIndices.graphicsIndex;
+        uint32_t familyPropertyCount = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(adapter->physicalDevice, &familyPropertyCount, NULL);
+        VkQueueFamilyProperties* familyProperties = (VkQueueFamilyProperties*)RL_CALLOC(familyPropertyCount, sizeof(VkQueueFamilyProperties));
+        vkGetPhysicalDeviceQueueFamilyProperties(adapter->physicalDevice, &familyPropertyCount, familyProperties);
+        asyncComputeQueueIndex = familyProperties[asyncComputeFamily].queueCount > 1 ? 1 : 0;
+        RL_FREE(familyProperties);
+    }
     
     // Create queue create infos
     VkDeviceQueueCreateInfo queueCreateInfos[8] = {0};
     uint32_t queueCreateInfoCount = 0;
-    float queuePriority = 1.0f;
+    const float queuePriorities[2] = {1.0f, 1.0f};
 
     for (uint32_t queueFamilyIndex = 0;queueFamilyIndex < queueFamilyCount; queueFamilyIndex++) {
         uint32_t queueFamily = queueFamilies[queueFamilyIndex]; 
@@ -1662,8 +2326,8 @@ WGPUDevice wgpuAdapterCreateDevice(WGPUAdapter adapter, const WGPUDeviceDescript
         VkDeviceQueueCreateInfo queueCreateInfo zeroinit;
         queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
         queueCreateInfo.queueFamilyIndex = queueFamily;
-        queueCreateInfo.queueCount = 1;
-        queueCreateInfo.pQueuePriorities = &queuePriority;
+        queueCreateInfo.queueCount = (queueFamily == asyncComputeFamily) ? asyncComputeQueueIndex + 1 : 1;
+        queueCreateInfo.pQueuePriorities = queuePriorities;
         queueCreateInfos[queueCreateInfoCount++] = queueCreateInfo;
     }
     
@@ -1677,8 +2341,12 @@ WGPUDevice wgpuAdapterCreateDevice(WGPUAdapter adapter, const WGPUDeviceDescript
         VK_KHR_SWAPCHAIN_EXTENSION_NAME,
         VK_EXT_DEPTH_CLIP_CONTROL_EXTENSION_NAME,
         VK_EXT_DEPTH_CLIP_ENABLE_EXTENSION_NAME,
+        VK_EXT_MULTI_DRAW_EXTENSION_NAME,
+        VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME,
+        VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME,
         #if RENDERBUNDLES_AS_SECONDARY_COMMANDBUFFERS == 1
         VK_KHR_MAINTENANCE_7_EXTENSION_NAME,
+        VK_NV_INHERITED_VIEWPORT_SCISSOR_EXTENSION_NAME,
         #endif
         //#endif
         #if VULKAN_ENABLE_RAYTRACING == 1
@@ -1695,6 +2363,10 @@ WGPUDevice wgpuAdapterCreateDevice(WGPUAdapter adapter, const WGPUDeviceDescript
     
     int depthClipControl_Found = 0;
     int depthClipEnable_Found = 0;
+    int multiDraw_Found = 0;
+    int synchronization2_Found = 0;
+    int maintenance7_Found = 0;
+    int inheritedViewportScissor_Found = 0;
 
     const char* deviceExtensionsFound[deviceExtensionsToLookForCount + 1];
     uint32_t extInsertIndex = 0;
@@ -1707,6 +2379,20 @@ WGPUDevice wgpuAdapterCreateDevice(WGPUAdapter adapter, const WGPUDeviceDescript
             if(strcmp(deprops[j].extensionName, VK_EXT_DEPTH_CLIP_ENABLE_EXTENSION_NAME) == 0){
                 depthClipEnable_Found = 1;
             }
+            if(strcmp(deprops[j].extensionName, VK_EXT_MULTI_DRAW_EXTENSION_NAME) == 0){
+                multiDraw_Found = 1;
+            }
+            if(strcmp(deprops[j].extensionName, VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME) == 0){
+                synchronization2_Found = 1;
+            }
+            #if RENDERBUNDLES_AS_SECONDARY_COMMANDBUFFERS == 1
+            if(strcmp(deprops[j].extensionName, VK_KHR_MAINTENANCE_7_EXTENSION_NAME) == 0){
+                maintenance7_Found = 1;
+            }
+            if(strcmp(deprops[j].extensionName, VK_NV_INHERITED_VIEWPORT_SCISSOR_EXTENSION_NAME) == 0){
+                inheritedViewportScissor_Found = 1;
+            }
+            #endif
 
             if(strcmp(deviceExtensionsToLookFor[i], deprops[j].extensionName) == 0){
                 deviceExtensionsFound[extInsertIndex++] = deviceExtensionsToLookFor[i];
@@ -1721,12 +2407,14 @@ WGPUDevice wgpuAdapterCreateDevice(WGPUAdapter adapter, const WGPUDeviceDescript
         
     }
 
-    VkPhysicalDeviceBufferDeviceAddressFeaturesKHR deviceFeaturesAddressKhr = {
-        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_BUFFER_DEVICE_ADDRESS_FEATURES_KHR,
+    // Covers bufferDeviceAddress and drawIndirectCount, the standalone
+    // VkPhysicalDeviceBufferDeviceAddressFeatures must not be chained alongside it
+    VkPhysicalDeviceVulkan12Features v12features = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
     };
     VkPhysicalDeviceRayTracingPipelineFeaturesKHR pipelineFeatures = {
         .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_TRACING_PIPELINE_FEATURES_KHR,
-        .pNext = &deviceFeaturesAddressKhr,
+        .pNext = &v12features,
     };
     VkPhysicalDeviceAccelerationStructureFeaturesKHR accelerationStructureFeatures = {
         .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ACCELERATION_STRUCTURE_FEATURES_KHR,
@@ -1738,11 +2426,47 @@ WGPUDevice wgpuAdapterCreateDevice(WGPUAdapter adapter, const WGPUDeviceDescript
         .pNext = &accelerationStructureFeatures,
     };
     
+    // Extension feature structs are only chained if the extension is enabled, they are invalid otherwise
+    void* featureChain = &v13features;
+    VkPhysicalDeviceMultiDrawFeaturesEXT multiDrawFeatures = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MULTI_DRAW_FEATURES_EXT,
+    };
+    if(multiDraw_Found){
+        multiDrawFeatures.pNext = featureChain;
+        featureChain = &multiDrawFeatures;
+    }
+    VkPhysicalDeviceMaintenance7FeaturesKHR maintenance7Features = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MAINTENANCE_7_FEATURES_KHR,
+    };
+    if(maintenance7_Found){
+        maintenance7Features.pNext = featureChain;
+        featureChain = &maintenance7Features;
+    }
+    VkPhysicalDeviceInheritedViewportScissorFeaturesNV inheritedViewportScissorFeatures = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_INHERITED_VIEWPORT_SCISSOR_FEATURES_NV,
+    };
+    if(inheritedViewportScissor_Found){
+        inheritedViewportScissorFeatures.pNext = featureChain;
+        featureChain = &inheritedViewportScissorFeatures;
+    }
+    
     VkPhysicalDeviceFeatures2 deviceFeatures = {
         .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
-        .pNext =  &v13features
+        .pNext = featureChain
     };
     vkGetPhysicalDeviceFeatures2(adapter->physicalDevice, &deviceFeatures);
+    uint32_t maxMultiDrawCount = 0;
+    if(multiDraw_Found && multiDrawFeatures.multiDraw){
+        VkPhysicalDeviceMultiDrawPropertiesEXT multiDrawProperties = {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MULTI_DRAW_PROPERTIES_EXT,
+        };
+        VkPhysicalDeviceProperties2 deviceProperties2 = {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+            .pNext = &multiDrawProperties,
+        };
+        vkGetPhysicalDeviceProperties2(adapter->physicalDevice, &deviceProperties2);
+        maxMultiDrawCount = multiDrawProperties.maxMultiDrawCount;
+    }
     if(pipelineFeatures.rayTracingPipeline == VK_TRUE){
         VkPhysicalDeviceRayTracingPipelinePropertiesKHR rayTracingPipelineProperties = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_TRACING_PIPELINE_PROPERTIES_KHR};
         VkPhysicalDeviceAccelerationStructurePropertiesKHR accelerationStructureProperties = {
@@ -1791,8 +2515,33 @@ WGPUDevice wgpuAdapterCreateDevice(WGPUAdapter adapter, const WGPUDeviceDescript
         retDevice->capabilities.depthClipControl = depthClipControl_Found;    
     }
     retDevice->capabilities.dynamicRendering = v13features.dynamicRendering;
+    retDevice->capabilities.multiDraw = multiDraw_Found && multiDrawFeatures.multiDraw && maxMultiDrawCount > 1;
+    retDevice->capabilities.maxMultiDrawCount = maxMultiDrawCount;
+    retDevice->capabilities.multiDrawIndirect = deviceFeatures.features.multiDrawIndirect;
+    retDevice->capabilities.drawIndirectFirstInstance = deviceFeatures.features.drawIndirectFirstInstance;
     retDevice->capabilities.raytracing = pipelineFeatures.rayTracingPipeline && accelerationStructureFeatures.accelerationStructure;
-    retDevice->capabilities.shaderDeviceAddress = deviceFeaturesAddressKhr.bufferDeviceAddress;
+    retDevice->capabilities.shaderDeviceAddress = v12features.bufferDeviceAddress;
+    retDevice->capabilities.drawIndirectCount = v12features.drawIndirectCount;
+    retDevice->capabilities.inheritedViewportScissor = inheritedViewportScissor_Found && inheritedViewportScissorFeatures.inheritedViewportScissor2D;
+    retDevice->capabilities.mixedRenderingContents = maintenance7_Found && maintenance7Features.maintenance7;
+    // The feature bit is enabled through v13features, the entry point may only be loaded under its KHR name
+    if(synchronization2_Found && retDevice->functions.vkCmdPipelineBarrier2 == NULL){
+        retDevice->functions.vkCmdPipelineBarrier2 = retDevice->functions.vkCmdPipelineBarrier2KHR;
+    }
+    retDevice->capabilities.synchronization2 = v13features.synchronization2 && retDevice->functions.vkCmdPipelineBarrier2 != NULL;
+    if(synchronization2_Found && retDevice->functions.vkCmdSetEvent2 == NULL){
+        retDevice->functions.vkCmdSetEvent2 = retDevice->functions.vkCmdSetEvent2KHR;
+        retDevice->functions.vkCmdWaitEvents2 = retDevice->functions.vkCmdWaitEvents2KHR;
+    }
+    retDevice->capabilities.splitBarriers = retDevice->capabilities.synchronization2
+        && retDevice->functions.vkCmdSetEvent2 != NULL && retDevice->functions.vkCmdWaitEvents2 != NULL;
+    // Core in 1.2, VK_KHR_timeline_semaphore on 1.1
+    if(retDevice->functions.vkWaitSemaphores == NULL){
+        retDevice->functions.vkWaitSemaphores = retDevice->functions.vkWaitSemaphoresKHR;
+        retDevice->functions.vkGetSemaphoreCounterValue = retDevice->functions.vkGetSemaphoreCounterValueKHR;
+    }
+    retDevice->capabilities.timelineSemaphore = v12features.timelineSemaphore
+        && retDevice->functions.vkWaitSemaphores != NULL && retDevice->functions.vkGetSemaphoreCounterValue != NULL;
     retDevice->uncapturedErrorCallbackInfo = descriptor->uncapturedErrorCallbackInfo;
 
     // Retrieve and assign queues
@@ -1815,18 +2564,58 @@ WGPUDevice wgpuAdapterCreateDevice(WGPUAdapter adapter, const WGPUDeviceDescript
             retQueue->computeQueue = retQueue->presentQueue;
         }
     }
-    const VkCommandPoolCreateInfo pci = {
-        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
-        .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT
-    };
-    retDevice->functions.vkCreateCommandPool(retDevice->device, &pci, NULL, &retDevice->secondaryCommandPool);
+    ThreadCommandPoolMap_init(&retDevice->bundleCommandPools);
+    retDevice->bundleCommandPoolsMutex = wgvk_mutex_create(wgvk_locktype_spin);
+    VkEventVector_init(&retDevice->spareEvents);
+    retDevice->spareEventsMutex = wgvk_mutex_create(wgvk_locktype_spin);
+    retDevice->backingRetireMutex = wgvk_mutex_create(wgvk_locktype_spin);
+    retDevice->fileUploadsMutex = wgvk_mutex_create(wgvk_locktype_kernel);
     
-    WGPUCommandEncoderDescriptor cedesc = {0};
-
     FenceCache_Init(retDevice, &retDevice->fenceCache);
+    retQueue->device = retDevice;
+    if(retDevice->capabilities.timelineSemaphore && Queue_createTimeline(retQueue) != VK_SUCCESS){
+        retDevice->capabilities.timelineSemaphore = false;
+    }
     FIFCache_init(&retDevice->fifCache, retDevice, adapter->queueIndices.graphicsIndex);
-    
-    retQueue->presubmitCache = wgpuDeviceCreateCommandEncoder(retDevice, &cedesc);
+    Queue_init(retQueue, retDevice, adapter->queueIndices.graphicsIndex);
+
+    // Cross queue waits go through the timelines
+    if(asyncComputeFamily != VK_QUEUE_FAMILY_IGNORED && retDevice->capabilities.timelineSemaphore){
+        WGPUQueue asyncComputeQueue = RL_CALLOC(1, sizeof(WGPUQueueImpl));
+        asyncComputeQueue->device = retDevice;
+        retDevice->functions.vkGetDeviceQueue(retDevice->device, asyncComputeFamily, asyncComputeQueueIndex, &asyncComputeQueue->computeQueue);
+        if(Queue_createTimeline(asyncComputeQueue) == VK_SUCCESS){
+            Queue_init(asyncComputeQueue, retDevice, asyncComputeFamily);
+            retDevice->asyncComputeQueue = asyncComputeQueue;
+            // A graphics family with a single queue: both submit to the same VkQueue
+            if(asyncComputeQueue->computeQueue == retQueue->graphicsQueue){
+                retQueue->vkQueueMutex = wgvk_mutex_create(wgvk_locktype_kernel);
+                asyncComputeQueue->vkQueueMutex = retQueue->vkQueueMutex;
+            }
+        }
+        else{
+            RL_FREE(asyncComputeQueue);
+        }
+    }
+    if(indices.transferIndex != indices.graphicsIndex && retDevice->capabilities.timelineSemaphore){
+        WGPUQueue transferQueue = RL_CALLOC(1, sizeof(WGPUQueueImpl));
+        transferQueue->device = retDevice;
+        retDevice->functions.vkGetDeviceQueue(retDevice->device, indices.transferIndex, 0, &transferQueue->transferQueue);
+        uint32_t familyPropertyCount = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(adapter->physicalDevice, &familyPropertyCount, NULL);
+        VkQueueFamilyProperties* familyProperties = (VkQueueFamilyProperties*)RL_CALLOC(familyPropertyCount, sizeof(VkQueueFamilyProperties));
+        vkGetPhysicalDeviceQueueFamilyProperties(adapter->physicalDevice, &familyPropertyCount, familyProperties);
+        transferQueue->imageTransferGranularity = familyProperties[indices.transferIndex].minImageTransferGranularity;
+        RL_FREE(familyProperties);
+        if(Queue_createTimeline(transferQueue) == VK_SUCCESS){
+            // Set before Queue_init so that the presubmit cache comes from the transfer family's pools
+            retDevice->transferQueue = transferQueue;
+            Queue_init(transferQueue, retDevice, indices.transferIndex);
+        }
+        else{
+            RL_FREE(transferQueue);
+        }
+    }
     VkDeviceSize limit = (((uint64_t)1) << 30);
 
     VkPhysicalDeviceMemoryProperties2 memoryProperties = {VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2};
@@ -1930,10 +2719,11 @@ WGPUFuture wgpuAdapterRequestDevice(WGPUAdapter adapter, WGPU_NULLABLE WGPUDevic
     WGPUFutureImpl impl = {
         .userdataForFunction = userdata,
         .functionCalledOnWaitAny = wgpuAdapterCreateDevice_sync,
-        .freeUserData = RL_FREE
+        .freeUserData = RL_FREE,
+        .mode = callbackInfo.mode,
     };
     uint64_t id = adapter->instance->currentFutureId++;
-    FutureIDMap_put(&adapter->instance->g_futureIDMap, id, impl);
+    Instance_putFuture(adapter->instance, id, impl);
     return (WGPUFuture){id};
     EXIT();
 }
@@ -1944,6 +2734,14 @@ WGPUQueue wgpuDeviceGetQueue(WGPUDevice device){
     return device->queue;
     EXIT();
 }
+WGPUQueue wgpuDeviceGetAsyncComputeQueue(WGPUDevice device){
+    ENTRY();
+    if(device->asyncComputeQueue){
+        wgpuQueueAddRef(device->asyncComputeQueue);
+    }
+    return device->asyncComputeQueue;
+    EXIT();
+}
 typedef struct userdataformapbufferasync{
     WGPUBuffer buffer;
     WGPUMapMode mode;
@@ -1962,41 +2760,27 @@ void wgpuBufferMapSync(void* data){
     EXIT();
 }
 void wgpuBufferMap(WGPUBuffer buffer, WGPUMapMode mapmode, size_t offset, size_t size, void** data);
+static bool Fence_poll(WGPUFence fence);
 
-WGPUBuffer wgpuDeviceCreateBuffer(WGPUDevice device, const WGPUBufferDescriptor* desc){
-    ENTRY();
-    //vmaCreateAllocator(const VmaAllocatorCreateInfo * _Nonnull pCreateInfo, VmaAllocator  _Nullable * _Nonnull pAllocator)
+static bool wgpuBufferMapReady(void* data){
+    const userdataformapbufferasync* info = (const userdataformapbufferasync*)data;
+    return info->buffer->latestFence == NULL || Fence_poll(info->buffer->latestFence);
+}
+
+// Creates the VkBuffer and its memory for buffer->usage and buffer->capacity. Only writes to the buffer on success,
+// so wgpuQueueWriteBuffer can use it to swap the backing of a live buffer
+static bool Buffer_allocateBacking(WGPUDevice device, WGPUBuffer wgpuBuffer){
+    const VkBufferCreateInfo bufferDesc = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .size = wgpuBuffer->capacity,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        // Zero initialization fills buffers that were not created with WGPUBufferUsage_CopyDst
+        .usage = toVulkanBufferUsage(wgpuBuffer->usage) | (WGVK_ZERO_INITIALIZE_BUFFERS ? VK_BUFFER_USAGE_TRANSFER_DST_BIT : 0),
+    };
     
-    if(desc->usage & WGPUBufferUsage_MapRead){
-        if(desc->usage & ~(WGPUBufferUsage_CopyDst | WGPUBufferUsage_MapRead)){
-            DeviceCallback(device, WGPUErrorType_Validation, STRVIEW("WGPUBufferUsage_MapRead used with something other than WGPUBufferUsage_CopyDst"));
-        }
-    }
-    if(desc->usage & WGPUBufferUsage_MapWrite){
-        if(desc->usage & ~(WGPUBufferUsage_CopySrc | WGPUBufferUsage_MapWrite)){
-            DeviceCallback(device, WGPUErrorType_Validation, STRVIEW("WGPUBufferUsage_MapWrite used with something other than WGPUBufferUsage_CopySrc"));
-        }
-    }
-    WGPUBuffer wgpuBuffer = RL_CALLOC(1, sizeof(WGPUBufferImpl));
-
-    uint32_t cacheIndex = device->submittedFrames % framesInFlight;
-
-    wgpuBuffer->device = device;
-    wgpuBuffer->cacheIndex = cacheIndex;
-    wgpuBuffer->refCount = 1;
-    wgpuBuffer->usage = desc->usage;
-    
-    
-    const VkBufferCreateInfo bufferDesc = {
-        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
-        .size = desc->size,
-        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
-        .usage = toVulkanBufferUsage(desc->usage),
-    };
-    
-    VkMemoryPropertyFlags propertyToFind = 0;
-    if(desc->usage & (WGPUBufferUsage_MapRead | WGPUBufferUsage_MapWrite)){
-        propertyToFind = VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+    VkMemoryPropertyFlags propertyToFind = 0;
+    if(wgpuBuffer->usage & (WGPUBufferUsage_MapRead | WGPUBufferUsage_MapWrite)){
+        propertyToFind = VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
     }
     else{
         //propertyToFind = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
@@ -2007,48 +2791,116 @@ WGPUBuffer wgpuDeviceCreateBuffer(WGPUDevice device, const WGPUBufferDescriptor*
     VmaAllocationCreateInfo vallocInfo = {
         .preferredFlags = propertyToFind,
     };
+    VkBuffer vkBuffer = VK_NULL_HANDLE;
     VmaAllocation allocation zeroinit;
     VmaAllocationInfo allocationInfo zeroinit;
-    VkResult vmabufferCreateResult = vmaCreateBuffer(device->allocator, &bufferDesc, &vallocInfo, &wgpuBuffer->buffer, &allocation, &allocationInfo);
+    VkResult vmabufferCreateResult = vmaCreateBuffer(device->allocator, &bufferDesc, &vallocInfo, &vkBuffer, &allocation, &allocationInfo);
 
     if(vmabufferCreateResult != VK_SUCCESS){
         DeviceCallback(device, WGPUErrorType_OutOfMemory, STRVIEW("Failed to create allocator"));
         TRACELOG(WGPU_LOG_ERROR, "Could not allocate buffer: %s", vkErrorString(vmabufferCreateResult));
-        RL_FREE(wgpuBuffer);
-        return NULL;
+        return false;
     }
+    wgpuBuffer->buffer = vkBuffer;
     wgpuBuffer->vmaAllocation = allocation;
     wgpuBuffer->allocationType = AllocationTypeVMA;
     #else
-    device->functions.vkCreateBuffer(device->device, &bufferDesc, NULL, &wgpuBuffer->buffer);
+    VkBuffer vkBuffer = VK_NULL_HANDLE;
+    device->functions.vkCreateBuffer(device->device, &bufferDesc, NULL, &vkBuffer);
     wgvkAllocation allocation = {0};
     VkMemoryRequirements requirements = {0};
-    device->functions.vkGetBufferMemoryRequirements(device->device, wgpuBuffer->buffer, &requirements);
-    if(desc->usage & WGPUBufferUsage_Raytracing){
+    device->functions.vkGetBufferMemoryRequirements(device->device, vkBuffer, &requirements);
+    if(wgpuBuffer->usage & WGPUBufferUsage_Raytracing){
         requirements.alignment = 256;
     }
     bool ret = wgvkAllocator_alloc(&device->builtinAllocator, &requirements, propertyToFind, &allocation);
+    if(!ret){
+        device->functions.vkDestroyBuffer(device->device, vkBuffer, NULL);
+        DeviceCallback(device, WGPUErrorType_OutOfMemory, STRVIEW("Could not allocate buffer memory"));
+        return false;
+    }
+    wgpuBuffer->buffer = vkBuffer;
     wgpuBuffer->allocationType = AllocationTypeBuiltin;
     wgpuBuffer->builtinAllocation = allocation;
     device->functions.vkBindBufferMemory(device->device, wgpuBuffer->buffer, allocation.pool->chunks[allocation.chunk_index].memory, allocation.offset);
     #endif
     wgpuBuffer->memoryProperties = propertyToFind;
 
-    if(desc->usage & WGPUBufferUsage_ShaderDeviceAddress){
+    if(wgpuBuffer->usage & WGPUBufferUsage_ShaderDeviceAddress){
         const VkBufferDeviceAddressInfo bdai = {
             .sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO_KHR,
             .buffer = wgpuBuffer->buffer
         };
         wgpuBuffer->address = device->functions.vkGetBufferDeviceAddress(device->device, &bdai);
     }
+    return true;
+}
+
+static void Queue_enqueueZeroFill(WGPUQueue queue, WGPUBuffer buffer){
+    PendingBufferWrites* pending = &queue->pendingWrites;
+    wgpuBufferAddRef(buffer);
+    buffer->zeroFillPending = VK_TRUE;
+    wgvk_mutex_lock(pending->zeroFillsMutex);
+    WGPUBufferVector_push_back(&pending->zeroFills, buffer);
+    wgvk_mutex_unlock(pending->zeroFillsMutex);
+}
+
+// Internal staging and batch buffers are overwritten right away and skip zero initialization
+static WGPUBuffer Device_createBuffer(WGPUDevice device, const WGPUBufferDescriptor* desc, bool zeroInitialize){
+    ENTRY();
+    //vmaCreateAllocator(const VmaAllocatorCreateInfo * _Nonnull pCreateInfo, VmaAllocator  _Nullable * _Nonnull pAllocator)
+    
+    if(desc->usage & WGPUBufferUsage_MapRead){
+        if(desc->usage & ~(WGPUBufferUsage_CopyDst | WGPUBufferUsage_MapRead)){
+            DeviceCallback(device, WGPUErrorType_Validation, STRVIEW("WGPUBufferUsage_MapRead used with something other than WGPUBufferUsage_CopyDst"));
+        }
+    }
+    if(desc->usage & WGPUBufferUsage_MapWrite){
+        if(desc->usage & ~(WGPUBufferUsage_CopySrc | WGPUBufferUsage_MapWrite)){
+            DeviceCallback(device, WGPUErrorType_Validation, STRVIEW("WGPUBufferUsage_MapWrite used with something other than WGPUBufferUsage_CopySrc"));
+        }
+    }
+    WGPUBuffer wgpuBuffer = RL_CALLOC(1, sizeof(WGPUBufferImpl));
+
+    uint32_t cacheIndex = device->submittedFrames % framesInFlight;
+
+    wgpuBuffer->device = device;
+    wgpuBuffer->cacheIndex = cacheIndex;
+    wgpuBuffer->refCount = 1;
+    wgpuBuffer->usage = desc->usage;
+    
+    
+    wgpuBuffer->capacity = desc->size;
+    if(!Buffer_allocateBacking(device, wgpuBuffer)){
+        RL_FREE(wgpuBuffer);
+        return NULL;
+    }
     if(desc->mappedAtCreation){
         // TODO
         void* mapData = NULL;
         wgpuBufferMap(wgpuBuffer, (desc->usage & WGPUBufferUsage_MapWrite) ? WGPUMapMode_Write : WGPUMapMode_Read, 0, desc->size, &mapData);
-
+        if(zeroInitialize && mapData != NULL){
+            memset(mapData, 0, desc->size);
+        }
+    }
+    else if(zeroInitialize && desc->size > 0){
+        if(desc->usage & (WGPUBufferUsage_MapRead | WGPUBufferUsage_MapWrite)){
+            // Mapping a buffer nobody has used yet does not wait, and the GPU would only add a submit
+            void* mapData = NULL;
+            wgpuBufferMap(wgpuBuffer, WGPUMapMode_Write, 0, desc->size, &mapData);
+            memset(mapData, 0, desc->size);
+            wgpuBufferUnmap(wgpuBuffer);
+        }
+        else{
+            Queue_enqueueZeroFill(device->queue, wgpuBuffer);
+        }
     }
-    return wgpuBuffer;
     EXIT();
+    return wgpuBuffer;
+}
+
+WGPUBuffer wgpuDeviceCreateBuffer(WGPUDevice device, const WGPUBufferDescriptor* desc){
+    return Device_createBuffer(device, desc, WGVK_ZERO_INITIALIZE_BUFFERS);
 }
 
 void wgpuBufferMap(WGPUBuffer buffer, WGPUMapMode mapmode, size_t offset, size_t size, void** data){
@@ -2074,17 +2926,17 @@ void wgpuBufferMap(WGPUBuffer buffer, WGPUMapMode mapmode, size_t offset, size_t
                 wgvk_assert(mapResult == VK_SUCCESS, "Mapping memory failed: %s", vkErrorString(mapResult));
             }
             *data = (void*)(((uint8_t*)chunk->mapped) + allocation->offset + offset);
-            buffer->mappedRange = data;
+            buffer->mappedRange = *data;
         }break;
         #if USE_VMA_ALLOCATOR == 1
         case AllocationTypeVMA: {
             vmaMapMemory(buffer->device->allocator, buffer->vmaAllocation, data);
-            buffer->mappedRange = data;
+            buffer->mappedRange = *data;
         }break;
         #endif
         case AllocationTypeJustMemory: {
             device->functions.vkMapMemory(device->device, buffer->justMemory, offset, size, 0, data);
-            buffer->mappedRange = data;
+            buffer->mappedRange = *data;
         }break;
         default:
         rg_unreachable();
@@ -2133,10 +2985,12 @@ WGPUFuture wgpuBufferMapAsync(WGPUBuffer buffer, WGPUMapMode mode, size_t offset
     WGPUFutureImpl ret = {
         .userdataForFunction = info,
         .functionCalledOnWaitAny = wgpuBufferMapSync,
-        .freeUserData = RL_FREE
+        .freeUserData = RL_FREE,
+        .isReady = wgpuBufferMapReady,
+        .mode = callbackInfo.mode,
     };
     uint64_t id = atomic_fetch_add_explicit(&buffer->device->adapter->instance->currentFutureId, 1, memory_order_relaxed);
-    FutureIDMap_put(&buffer->device->adapter->instance->g_futureIDMap, id, ret);
+    Instance_putFuture(buffer->device->adapter->instance, id, ret);
     return (WGPUFuture){ id };
     EXIT();
 }
@@ -2166,11 +3020,260 @@ size_t wgpuBufferGetSize(WGPUBuffer buffer){
     EXIT();
 }
 
+// Staging copies run on the transfer queue unless the queue's presubmit cache already touches the destination.
+// The transfer queue is submitted ahead of the next submit to any other queue and would overtake those commands
+static WGPUCommandEncoder Queue_bufferStagingEncoder(WGPUQueue queue, WGPUBuffer buffer){
+    WGPUQueue transferQueue = queue->device->transferQueue;
+    if(transferQueue == NULL || BufferUsageRecordMap_get(&queue->presubmitCache->resourceUsage.referencedBuffers, buffer) != NULL){
+        return queue->presubmitCache;
+    }
+    return transferQueue->presubmitCache;
+}
+
+// Same as Queue_bufferStagingEncoder, the region also has to suit the transfer family's image transfer granularity
+static WGPUCommandEncoder Queue_textureStagingEncoder(WGPUQueue queue, const WGPUTexelCopyTextureInfo* destination, const WGPUExtent3D* writeSize){
+    WGPUQueue transferQueue = queue->device->transferQueue;
+    WGPUTexture texture = destination->texture;
+    if(transferQueue == NULL || ImageUsageRecordMap_get(&queue->presubmitCache->resourceUsage.referencedTextures, texture) != NULL){
+        return queue->presubmitCache;
+    }
+    const VkExtent3D granularity = transferQueue->imageTransferGranularity;
+    if(granularity.width == 1 && granularity.height == 1 && granularity.depth == 1){
+        return transferQueue->presubmitCache;
+    }
+    // Other granularities count texel blocks, copies of whole mip levels satisfy any of them
+    const uint32_t mipWidth  = MAX(texture->width  >> destination->mipLevel, 1u);
+    const uint32_t mipHeight = MAX(texture->height >> destination->mipLevel, 1u);
+    const uint32_t mipDepth  = texture->dimension == VK_IMAGE_TYPE_3D ? MAX(texture->depthOrArrayLayers >> destination->mipLevel, 1u) : writeSize->depthOrArrayLayers;
+    const bool wholeLevel = destination->origin.x == 0 && destination->origin.y == 0 && (texture->dimension != VK_IMAGE_TYPE_3D || destination->origin.z == 0) &&
+        writeSize->width == mipWidth && writeSize->height == mipHeight && writeSize->depthOrArrayLayers == mipDepth;
+    return wholeLevel ? transferQueue->presubmitCache : queue->presubmitCache;
+}
+
+static void Queue_writeBufferStaged(WGPUCommandEncoder encoder, WGPUQueue queue, WGPUBuffer buffer, uint64_t bufferOffset, const void* data, size_t size){
+    WGPUBufferDescriptor stDesc zeroinit;
+    stDesc.size = size;
+    stDesc.usage = WGPUBufferUsage_MapWrite | WGPUBufferUsage_CopySrc;
+    WGPUBuffer stagingBuffer = Device_createBuffer(queue->device, &stDesc, false);
+    void* mappedMemory = NULL;
+    wgpuBufferMap(stagingBuffer, WGPUMapMode_Write, 0, size, &mappedMemory);
+    if(mappedMemory != NULL){
+        memcpy(mappedMemory, data, size);
+        wgpuBufferUnmap(stagingBuffer);
+    }
+    wgpuCommandEncoderCopyBufferToBuffer(encoder, stagingBuffer, 0, buffer, bufferOffset, size);
+    wgpuBufferRelease(stagingBuffer);
+}
+
+static uint8_t* PendingBufferWrites_allocate(PendingBufferWrites* pending, size_t size){
+    if(pending->dataSize + size > pending->dataCapacity){
+        size_t newCapacity = pending->dataCapacity ? pending->dataCapacity * 2 : 4096;
+        while(newCapacity < pending->dataSize + size){
+            newCapacity *= 2;
+        }
+        pending->data = (uint8_t*)RL_REALLOC(pending->data, newCapacity);
+        pending->dataCapacity = newCapacity;
+    }
+    uint8_t* ret = pending->data + pending->dataSize;
+    pending->dataSize += size;
+    return ret;
+}
+
+// Records the writes collected since the last submit, merged writes larger than vkCmdUpdateBuffer allows go through a staging buffer.
+// Called before anything else is recorded into the presubmit cache so that the writes keep their order relative to it.
+static void CommandEncoder_flushCopies(WGPUCommandEncoder encoder);
+static void CommandEncoder_freeCopies(WGPUCommandEncoder encoder);
+
+// Makes transfer writes of the given stage visible to host reads of mapped buffers
+static void CommandEncoder_hostReadBarrier(WGPUCommandEncoder encoder, VkPipelineStageFlags2 writingStage){
+    const VkMemoryBarrier2 memoryBarrier = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+        .srcStageMask = writingStage,
+        .srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+        .dstStageMask = VK_PIPELINE_STAGE_2_HOST_BIT,
+        .dstAccessMask = VK_ACCESS_2_HOST_READ_BIT,
+    };
+    const VkDependencyInfo dependencyInfo = {
+        .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .memoryBarrierCount = 1,
+        .pMemoryBarriers = &memoryBarrier,
+    };
+    Device_pipelineBarrier(encoder->device, encoder->buffer, &dependencyInfo);
+}
+
+// Records vkCmdFillBuffer without validation, offset and size have to be multiples of 4
+static void CommandEncoder_fillBuffer(WGPUCommandEncoder encoder, WGPUBuffer buffer, uint64_t offset, uint64_t size){
+    CommandEncoder_flushCopies(encoder);
+    ++encoder->encodedCommandCount;
+    ce_trackBuffer(encoder, buffer, (BufferUsageSnap){
+        .stage = VK_PIPELINE_STAGE_2_CLEAR_BIT,
+        .access = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .offset = offset,
+        .size = size
+    });
+    CommandEncoder_flushBarriers(encoder);
+    encoder->device->functions.vkCmdFillBuffer(encoder->buffer, buffer->buffer, offset, size, 0);
+}
+
+static void Queue_flushPendingWrites(WGPUQueue queue){
+    PendingBufferWrites* pending = &queue->pendingWrites;
+    WGPUCommandEncoder pscache = queue->presubmitCache;
+    wgvk_mutex_lock(pending->zeroFillsMutex);
+    for(size_t i = 0;i < pending->zeroFills.size;i++){
+        WGPUBuffer buffer = pending->zeroFills.data[i];
+        // VK_WHOLE_SIZE rounds down to a multiple of 4, like the sizes ClearBuffer accepts
+        CommandEncoder_fillBuffer(pscache, buffer, 0, VK_WHOLE_SIZE);
+        wgpuBufferRelease(buffer);
+    }
+    WGPUBufferVector_clear(&pending->zeroFills);
+    wgvk_mutex_unlock(pending->zeroFillsMutex);
+    if(PendingBufferWriteVector_empty(&pending->writes)){
+        return;
+    }
+    for(size_t i = 0;i < pending->writes.size;i++){
+        const PendingBufferWrite* write = pending->writes.data + i;
+        const uint8_t* data = pending->data + write->dataOffset;
+        if(write->size <= WGVK_INLINE_BUFFER_UPDATE_SIZE){
+            CommandEncoder_flushCopies(pscache);
+            ++pscache->encodedCommandCount;
+            ce_trackBuffer(pscache, write->buffer, (BufferUsageSnap){
+                .stage = VK_PIPELINE_STAGE_2_CLEAR_BIT,
+                .access = VK_ACCESS_TRANSFER_WRITE_BIT,
+                .offset = write->offset,
+                .size = write->size
+            });
+            CommandEncoder_flushBarriers(pscache);
+            queue->device->functions.vkCmdUpdateBuffer(pscache->buffer, write->buffer->buffer, write->offset, write->size, data);
+        }
+        else{
+            Queue_writeBufferStaged(pscache, queue, write->buffer, write->offset, data, write->size);
+        }
+        wgpuBufferRelease(write->buffer);
+    }
+    PendingBufferWriteVector_clear(&pending->writes);
+    PendingBufferWriteMap_clear(&pending->lastWriteOfBuffer);
+    pending->dataSize = 0;
+}
+
+static void Queue_freePendingWrites(WGPUQueue queue){
+    PendingBufferWrites* pending = &queue->pendingWrites;
+    for(size_t i = 0;i < pending->zeroFills.size;i++){
+        wgpuBufferRelease(pending->zeroFills.data[i]);
+    }
+    WGPUBufferVector_free(&pending->zeroFills);
+    wgvk_mutex_destroy(pending->zeroFillsMutex);
+    for(size_t i = 0;i < pending->writes.size;i++){
+        wgpuBufferRelease(pending->writes.data[i].buffer);
+    }
+    PendingBufferWriteVector_free(&pending->writes);
+    PendingBufferWriteMap_free(&pending->lastWriteOfBuffer);
+    RL_FREE(pending->data);
+    memset(pending, 0, sizeof(PendingBufferWrites));
+}
+
+// Merges the write into the buffer's previous pending write if that one can hold it in place, otherwise appends a new one.
+// Writes that are not merged are still applied in order, so a later overlapping write wins either way.
+static void Queue_enqueueWrite(WGPUQueue queue, WGPUBuffer buffer, uint64_t bufferOffset, const void* data, size_t size){
+    PendingBufferWrites* pending = &queue->pendingWrites;
+    uint32_t* lastIndex = PendingBufferWriteMap_get(&pending->lastWriteOfBuffer, buffer);
+    if(lastIndex != NULL){
+        PendingBufferWrite* last = pending->writes.data + *lastIndex;
+        const uint64_t lastEnd = last->offset + last->size;
+        const uint64_t end = bufferOffset + size;
+        if(bufferOffset >= last->offset && end <= lastEnd){
+            memcpy(pending->data + last->dataOffset + (bufferOffset - last->offset), data, size);
+            return;
+        }
+        const bool touches = bufferOffset <= lastEnd && end >= last->offset;
+        const bool isTail = last->dataOffset + last->size == pending->dataSize;
+        if(touches && isTail){
+            const uint64_t mergedOffset = bufferOffset < last->offset ? bufferOffset : last->offset;
+            const uint64_t mergedEnd = end > lastEnd ? end : lastEnd;
+            PendingBufferWrites_allocate(pending, (size_t)(mergedEnd - mergedOffset - last->size));
+            uint8_t* merged = pending->data + last->dataOffset;
+            memmove(merged + (last->offset - mergedOffset), merged, last->size);
+            memcpy(merged + (bufferOffset - mergedOffset), data, size);
+            last->offset = mergedOffset;
+            last->size = mergedEnd - mergedOffset;
+            return;
+        }
+    }
+    const size_t dataOffset = pending->dataSize;
+    memcpy(PendingBufferWrites_allocate(pending, size), data, size);
+    wgpuBufferAddRef(buffer);
+    PendingBufferWriteVector_push_back(&pending->writes, (PendingBufferWrite){
+        .buffer = buffer,
+        .offset = bufferOffset,
+        .size = size,
+        .dataOffset = dataOffset
+    });
+    PendingBufferWriteMap_put(&pending->lastWriteOfBuffer, buffer, (uint32_t)(pending->writes.size - 1));
+}
+
+// Gives a host visible buffer that is still in use by the GPU a fresh backing, so that wgpuQueueWriteBuffer
+// can write to it right away instead of waiting for the fence. The old VkBuffer and memory are retired into
+// the current frame and destroyed once its fences are waited for. Only possible if nothing else holds on to the
+// VkBuffer handle itself: unsubmitted recordings, render bundles, mappings and device addresses.
+static bool Buffer_tryRename(WGPUBuffer buffer, uint64_t bufferOffset, size_t size){
+    WGPUDevice device = buffer->device;
+    const WGPUBufferUsage unrenameable = WGPUBufferUsage_MapRead | WGPUBufferUsage_MapWrite | WGPUBufferUsage_ShaderDeviceAddress | WGPUBufferUsage_AccelerationStructureInput | WGPUBufferUsage_AccelerationStructureStorage | WGPUBufferUsage_ShaderBindingTable;
+    if(buffer->latestFence == NULL || buffer->latestFence->state != WGPUFenceState_InUse){
+        return false;
+    }
+    if(buffer->unsubmittedUses != 0 || buffer->backingPinned || buffer->mapState != WGPUBufferMapState_Unmapped || (buffer->usage & unrenameable)){
+        return false;
+    }
+    const bool wholeBuffer = bufferOffset == 0 && size >= buffer->capacity;
+    if(buffer->latestFenceWrites && !wholeBuffer){
+        // The contents that survive the partial write are not final yet
+        return false;
+    }
+    WGPUBuffer retired = RL_MALLOC(sizeof(WGPUBufferImpl));
+    *retired = *buffer;
+    if(!Buffer_allocateBacking(device, buffer)){
+        RL_FREE(retired);
+        return false;
+    }
+    retired->refCount = 1;
+    retired->latestFence = NULL;
+    retired->unsubmittedUses = 0;
+    wgpuFenceRelease(buffer->latestFence);
+    buffer->latestFence = NULL;
+    buffer->latestFenceWrites = VK_FALSE;
+    // No queue family owns the fresh backing yet
+    buffer->lastQueue = NULL;
+    buffer->lastQueueValue = 0;
+
+    if(!wholeBuffer){
+        // The GPU only reads the old backing, so it can be copied while the fence is pending
+        void* oldContents = NULL;
+        void* newContents = NULL;
+        wgpuBufferMap(retired, WGPUMapMode_Read, 0, buffer->capacity, &oldContents);
+        wgpuBufferMap(buffer, WGPUMapMode_Write, 0, buffer->capacity, &newContents);
+        memcpy(newContents, oldContents, buffer->capacity);
+        wgpuBufferUnmap(buffer);
+        wgpuBufferUnmap(retired);
+    }
+    ++buffer->backingGeneration;
+
+    PerframeCache* frameCache = DeviceGetFIFCache(device, device->submittedFrames % framesInFlight);
+    wgvk_mutex_lock(device->backingRetireMutex);
+    WGPUBufferVector_push_back(&frameCache->retiredBuffers, retired);
+    wgvk_mutex_unlock(device->backingRetireMutex);
+    return true;
+}
+
 void wgpuQueueWriteBuffer(WGPUQueue cSelf, WGPUBuffer buffer, uint64_t bufferOffset, const void* data, size_t size){
     ENTRY();
-    void* mappedMemory = NULL;
-    if(buffer->memoryProperties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT){
+    if(size == 0){
+        EXIT();
+        return;
+    }
+    // A pending zero fill runs at the next submit, so the write has to be recorded after it instead of landing in memory now
+    if((buffer->memoryProperties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) && !buffer->zeroFillPending){
         void* mappedMemory = NULL;
+        // Falls back to wgpuBufferMap waiting for the buffer's fence
+        Buffer_tryRename(buffer, bufferOffset, size);
         wgpuBufferMap(buffer, WGPUMapMode_Write, bufferOffset, size, &mappedMemory);
         
         if (mappedMemory != NULL) {
@@ -2180,14 +3283,12 @@ void wgpuQueueWriteBuffer(WGPUQueue cSelf, WGPUBuffer buffer, uint64_t bufferOff
             
         }
     }
+    else if(size <= WGVK_INLINE_BUFFER_UPDATE_SIZE && (bufferOffset & 3) == 0 && (size & 3) == 0){
+        Queue_enqueueWrite(cSelf, buffer, bufferOffset, data, size);
+    }
     else{
-        WGPUBufferDescriptor stDesc zeroinit;
-        stDesc.size = size;
-        stDesc.usage = WGPUBufferUsage_MapWrite;
-        WGPUBuffer stagingBuffer = wgpuDeviceCreateBuffer(cSelf->device, &stDesc);
-        wgpuQueueWriteBuffer(cSelf, stagingBuffer, bufferOffset, data, size);
-        wgpuCommandEncoderCopyBufferToBuffer(cSelf->presubmitCache, stagingBuffer, 0, buffer, bufferOffset, size);
-        wgpuBufferRelease(stagingBuffer);
+        Queue_flushPendingWrites(cSelf);
+        Queue_writeBufferStaged(Queue_bufferStagingEncoder(cSelf, buffer), cSelf, buffer, bufferOffset, data, size);
     }
     EXIT();
 }
@@ -2198,7 +3299,7 @@ void wgpuQueueWriteTexture(WGPUQueue queue, const WGPUTexelCopyTextureInfo* dest
     WGPUBufferDescriptor bdesc zeroinit;
     bdesc.size = dataSize;
     bdesc.usage = WGPUBufferUsage_CopySrc | WGPUBufferUsage_MapWrite;
-    WGPUBuffer stagingBuffer = wgpuDeviceCreateBuffer(queue->device, &bdesc);
+    WGPUBuffer stagingBuffer = Device_createBuffer(queue->device, &bdesc, false);
     void* mappedMemory = NULL;
     wgpuBufferMap(stagingBuffer, WGPUMapMode_Write, 0, dataSize, &mappedMemory);
     if(mappedMemory != NULL){
@@ -2211,7 +3312,8 @@ void wgpuQueueWriteTexture(WGPUQueue queue, const WGPUTexelCopyTextureInfo* dest
         .layout = *dataLayout
     };
 
-    wgpuCommandEncoderCopyBufferToTexture(queue->presubmitCache, &source, destination, writeSize);
+    Queue_flushPendingWrites(queue);
+    wgpuCommandEncoderCopyBufferToTexture(Queue_textureStagingEncoder(queue, destination, writeSize), &source, destination, writeSize);
     //WGPUCommandBuffer puffer = wgpuCommandEncoderFinish(enkoder, NULL);
 
     //wgpuQueueSubmit(queue, 1, &puffer);
@@ -2221,32 +3323,497 @@ void wgpuQueueWriteTexture(WGPUQueue queue, const WGPUTexelCopyTextureInfo* dest
     EXIT();
 }
 
+typedef enum FileUploadSlotStatus{
+    FileUploadSlot_Idle,
+    FileUploadSlot_Reading,
+    FileUploadSlot_CopyRecorded,  // In the presubmitCache of copyQueue
+    FileUploadSlot_CopySubmitted, // Until copyFence completes
+}FileUploadSlotStatus;
+
+typedef struct FileUploadSlot{
+    struct FileUploadState* state;
+    WGPUBuffer stagingBuffer;
+    uint8_t* mappedMemory;
+    uint64_t fileOffset;
+    uint64_t size;
+    Atomar(uint32_t) status;
+    Atomar(uint32_t) failed;
+    wgvk_job_t* job;         // Kept until the slot reads its next chunk
+    uint32_t jobWaiters;     // Blocking waits sleeping on job
+    WGPUQueue copyQueue;
+    WGPUFence copyFence;
+}FileUploadSlot;
+
+typedef struct FileUploadState{
+    struct FileUploadState* next;
+    WGPUQueue queue;
+    WGPUBuffer buffer;
+    uint64_t bufferOffset;
+    int fd;
+    uint64_t fileOffset;
+    uint64_t size;
+    WGPUQueueWorkDoneCallbackInfo callbackInfo;
+    uint32_t chunkCount;
+    uint32_t nextChunk;
+    bool failed;
+    Atomar(uint32_t) completedCopies;
+    uint32_t slotCount;
+    FileUploadSlot slots[];
+}FileUploadState;
+
+// Runs on the thread pool and reads straight into the mapped staging buffer
+static void* FileUploadSlot_read(void* _slot){
+    FileUploadSlot* slot = (FileUploadSlot*)_slot;
+    uint64_t done = 0;
+    while(done < slot->size){
+        int64_t r = wgvk_file_pread(slot->state->fd, slot->mappedMemory + done, (size_t)(slot->size - done), slot->fileOffset + done);
+        if(r <= 0){
+            atomic_store_explicit(&slot->failed, 1, memory_order_release);
+            break;
+        }
+        done += (uint64_t)r;
+    }
+    return _slot;
+}
+
+// Attached to the fence of the submit containing the slot's copy, may run on any thread
+static void FileUploadSlot_copyDone(void* _slot){
+    FileUploadSlot* slot = (FileUploadSlot*)_slot;
+    atomic_fetch_add_explicit(&slot->state->completedCopies, 1, memory_order_release);
+    atomic_store_explicit(&slot->status, FileUploadSlot_Idle, memory_order_release);
+}
+
+static bool FileUpload_done(FileUploadState* state){
+    if(!state->failed){
+        return atomic_load_explicit(&state->completedCopies, memory_order_acquire) == state->chunkCount;
+    }
+    // Copies of earlier chunks still reference their slots
+    for(uint32_t i = 0;i < state->slotCount;i++){
+        if(atomic_load_explicit(&state->slots[i].status, memory_order_acquire) != FileUploadSlot_Idle){
+            return false;
+        }
+    }
+    return true;
+}
+
+// Records the copies of the chunks that finished reading and starts reading the next chunks into idle slots.
+// Callers hold device->fileUploadsMutex
+static void FileUpload_pump(FileUploadState* state){
+    WGPUDevice device = state->queue->device;
+    for(uint32_t i = 0;i < state->slotCount;i++){
+        FileUploadSlot* slot = &state->slots[i];
+        uint32_t status = atomic_load_explicit(&slot->status, memory_order_acquire);
+        if(status == FileUploadSlot_Reading && wgvk_job_completed(slot->job)){
+            wgpuBufferUnmap(slot->stagingBuffer);
+            slot->mappedMemory = NULL;
+            if(atomic_load_explicit(&slot->failed, memory_order_acquire)){
+                state->failed = true;
+                status = FileUploadSlot_Idle;
+            }
+            else{
+                Queue_flushPendingWrites(state->queue);
+                WGPUCommandEncoder stagingEncoder = Queue_bufferStagingEncoder(state->queue, state->buffer);
+                wgpuCommandEncoderCopyBufferToBuffer(stagingEncoder, slot->stagingBuffer, 0, state->buffer, state->bufferOffset + (slot->fileOffset - state->fileOffset), slot->size);
+                slot->copyQueue = (stagingEncoder == state->queue->presubmitCache) ? state->queue : device->transferQueue;
+                status = FileUploadSlot_CopyRecorded;
+            }
+            atomic_store_explicit(&slot->status, status, memory_order_release);
+        }
+        // A blocking wait may still sleep on the slot's previous job
+        if(status != FileUploadSlot_Idle || state->failed || state->nextChunk == state->chunkCount || slot->jobWaiters > 0){
+            continue;
+        }
+        const uint64_t chunkSize = WGVK_FILE_UPLOAD_CHUNK_SIZE;
+        if(slot->stagingBuffer == NULL){
+            // Staging buffers are created and mapped here since neither is safe to do from the workers
+            const WGPUBufferDescriptor stDesc = {
+                .size = state->size < chunkSize ? state->size : chunkSize,
+                .usage = WGPUBufferUsage_MapWrite | WGPUBufferUsage_CopySrc,
+            };
+            slot->stagingBuffer = Device_createBuffer(device, &stDesc, false);
+            if(slot->stagingBuffer == NULL){
+                state->failed = true;
+                continue;
+            }
+        }
+        if(slot->copyFence){
+            wgpuFenceRelease(slot->copyFence);
+            slot->copyFence = NULL;
+        }
+        wgvk_job_destroy(slot->job);
+        slot->job = NULL;
+        const uint64_t chunkOffset = (uint64_t)state->nextChunk * chunkSize;
+        slot->fileOffset = state->fileOffset + chunkOffset;
+        slot->size = (state->size - chunkOffset < chunkSize) ? state->size - chunkOffset : chunkSize;
+        wgpuBufferMap(slot->stagingBuffer, WGPUMapMode_Write, 0, slot->size, (void**)&slot->mappedMemory);
+        if(slot->mappedMemory == NULL){
+            state->failed = true;
+            continue;
+        }
+        ++state->nextChunk;
+        atomic_store_explicit(&slot->status, FileUploadSlot_Reading, memory_order_release);
+        slot->job = wgvk_job_enqueue(device->thread_pool, FileUploadSlot_read, slot);
+        if(slot->job == NULL){
+            FileUploadSlot_read(slot);
+        }
+    }
+}
+
+// Called by wgpuQueueSubmit before it records anything
+static void Device_pumpFileUploads(WGPUQueue queue){
+    WGPUDevice device = queue->device;
+    wgvk_mutex_lock(device->fileUploadsMutex);
+    for(FileUploadState* state = device->fileUploads;state;state = state->next){
+        if(state->queue == queue && !FileUpload_done(state)){
+            FileUpload_pump(state);
+        }
+    }
+    wgvk_mutex_unlock(device->fileUploadsMutex);
+}
+
+// Called by wgpuQueueSubmit with the fence of the submit that took queue's presubmitCache, NULL if it failed
+static void Device_fileUploadsSubmitted(WGPUQueue queue, WGPUFence fence){
+    WGPUDevice device = queue->device;
+    wgvk_mutex_lock(device->fileUploadsMutex);
+    for(FileUploadState* state = device->fileUploads;state;state = state->next){
+        for(uint32_t i = 0;i < state->slotCount;i++){
+            FileUploadSlot* slot = &state->slots[i];
+            if(slot->copyQueue != queue || atomic_load_explicit(&slot->status, memory_order_acquire) != FileUploadSlot_CopyRecorded){
+                continue;
+            }
+            if(fence == NULL){
+                state->failed = true;
+                atomic_store_explicit(&slot->status, FileUploadSlot_Idle, memory_order_release);
+                continue;
+            }
+            atomic_store_explicit(&slot->status, FileUploadSlot_CopySubmitted, memory_order_release);
+            slot->copyFence = fence;
+            wgpuFenceAddRef(fence);
+            wgpuFenceAttachCallback(fence, FileUploadSlot_copyDone, slot);
+        }
+    }
+    wgvk_mutex_unlock(device->fileUploadsMutex);
+}
+
+// Drives the upload to completion: waits for reads, submits recorded copies and waits for their fences
+static void processFileUploadFuture(void* userdata){
+    FileUploadState* state = (FileUploadState*)userdata;
+    WGPUDevice device = state->queue->device;
+    wgvk_mutex_lock(device->fileUploadsMutex);
+    for(;;){
+        FileUpload_pump(state);
+        if(FileUpload_done(state)){
+            break;
+        }
+        FileUploadSlot* reading = NULL;
+        bool recorded = false;
+        WGPUFence fences[WGVK_FILE_UPLOAD_MAX_CHUNKS_IN_FLIGHT];
+        uint32_t fenceCount = 0;
+        for(uint32_t i = 0;i < state->slotCount;i++){
+            FileUploadSlot* slot = &state->slots[i];
+            switch(atomic_load_explicit(&slot->status, memory_order_acquire)){
+                case FileUploadSlot_Reading: if(reading == NULL && slot->job) reading = slot; break;
+                case FileUploadSlot_CopyRecorded: recorded = true; break;
+                case FileUploadSlot_CopySubmitted: fences[fenceCount++] = slot->copyFence; break;
+                default: break;
+            }
+        }
+        // The lock is dropped while blocking, the job and fences are pinned so that a concurrent pump keeps them
+        if(reading){
+            wgvk_job_t* job = reading->job;
+            ++reading->jobWaiters;
+            wgvk_mutex_unlock(device->fileUploadsMutex);
+            wgvk_job_wait(job, NULL);
+            wgvk_mutex_lock(device->fileUploadsMutex);
+            --reading->jobWaiters;
+        }
+        else if(recorded){
+            wgvk_mutex_unlock(device->fileUploadsMutex);
+            wgpuQueueSubmit(state->queue, 0, NULL);
+            wgvk_mutex_lock(device->fileUploadsMutex);
+        }
+        else if(fenceCount > 0){
+            for(uint32_t i = 0;i < fenceCount;i++){
+                wgpuFenceAddRef(fences[i]);
+            }
+            wgvk_mutex_unlock(device->fileUploadsMutex);
+            wgpuFencesWaitEx(fences, fenceCount, 0, UINT64_MAX);
+            for(uint32_t i = 0;i < fenceCount;i++){
+                wgpuFenceRelease(fences[i]);
+            }
+            wgvk_mutex_lock(device->fileUploadsMutex);
+        }
+    }
+    const bool failed = state->failed;
+    wgvk_mutex_unlock(device->fileUploadsMutex);
+    if(failed){
+        DeviceCallback(device, WGPUErrorType_Internal, STRVIEW("WriteBufferFromFile: could not read the requested range of the file"));
+    }
+    if(state->callbackInfo.callback){
+        state->callbackInfo.callback(failed ? WGPUQueueWorkDoneStatus_Error : WGPUQueueWorkDoneStatus_Success, state->callbackInfo.userdata1, state->callbackInfo.userdata2);
+    }
+}
+
+// Advances the upload without blocking, so that wgpuInstanceProcessEvents alone finishes it: records the copies
+// of finished reads and starts the next ones, submits recorded copies and completes the fences of submitted ones
+static bool fileUploadFutureReady(void* userdata){
+    FileUploadState* state = (FileUploadState*)userdata;
+    wgvk_mutex_lock(state->queue->device->fileUploadsMutex);
+    FileUpload_pump(state);
+    bool recorded = false;
+    for(uint32_t i = 0;i < state->slotCount;i++){
+        switch(atomic_load_explicit(&state->slots[i].status, memory_order_acquire)){
+            case FileUploadSlot_CopyRecorded: recorded = true; break;
+            case FileUploadSlot_CopySubmitted: Fence_poll(state->slots[i].copyFence); break;
+            default: break;
+        }
+    }
+    const bool done = FileUpload_done(state);
+    wgvk_mutex_unlock(state->queue->device->fileUploadsMutex);
+    if(recorded){
+        wgpuQueueSubmit(state->queue, 0, NULL);
+    }
+    return done;
+}
+
+static void freeFileUploadState(void* userdata){
+    FileUploadState* state = (FileUploadState*)userdata;
+    WGPUDevice device = state->queue->device;
+    wgvk_mutex_lock(device->fileUploadsMutex);
+    FileUploadState** link = &device->fileUploads;
+    while(*link != state){
+        link = &(*link)->next;
+    }
+    *link = state->next;
+    wgvk_mutex_unlock(device->fileUploadsMutex);
+    for(uint32_t i = 0;i < state->slotCount;i++){
+        FileUploadSlot* slot = &state->slots[i];
+        if(slot->job){
+            wgvk_job_wait(slot->job, NULL);
+            wgvk_job_destroy(slot->job);
+        }
+        if(slot->copyFence){
+            wgpuFenceRelease(slot->copyFence);
+        }
+        if(slot->stagingBuffer){
+            if(slot->mappedMemory){
+                wgpuBufferUnmap(slot->stagingBuffer);
+            }
+            wgpuBufferRelease(slot->stagingBuffer);
+        }
+    }
+    wgpuBufferRelease(state->buffer);
+    RL_FREE(state);
+}
+
+WGPUFuture wgpuQueueWriteBufferFromFile(WGPUQueue queue, WGPUBuffer buffer, uint64_t bufferOffset, int fd, uint64_t fileOffset, uint64_t size, WGPUQueueWorkDoneCallbackInfo callbackInfo){
+    ENTRY();
+    WGPUDevice device = queue->device;
+    const char* error = NULL;
+    if(!(buffer->usage & WGPUBufferUsage_CopyDst)){
+        error = "WriteBufferFromFile: buffer was not created with WGPUBufferUsage_CopyDst";
+    }
+    else if((bufferOffset & 3) != 0 || (size & 3) != 0){
+        error = "WriteBufferFromFile: bufferOffset and size must be multiples of 4";
+    }
+    else if(bufferOffset > buffer->capacity || size > buffer->capacity - bufferOffset){
+        error = "WriteBufferFromFile: range exceeds the buffer size";
+    }
+    else if(fd < 0){
+        error = "WriteBufferFromFile: invalid file descriptor";
+    }
+    if(error){
+        DeviceCallback(device, WGPUErrorType_Validation, (WGPUStringView){error, strlen(error)});
+    }
+    if(error || size == 0){
+        if(callbackInfo.callback){
+            callbackInfo.callback(error ? WGPUQueueWorkDoneStatus_Error : WGPUQueueWorkDoneStatus_Success, callbackInfo.userdata1, callbackInfo.userdata2);
+        }
+        EXIT();
+        return (WGPUFuture){0};
+    }
+
+    const uint64_t chunkSize = WGVK_FILE_UPLOAD_CHUNK_SIZE;
+    const uint32_t chunkCount = (uint32_t)((size + chunkSize - 1) / chunkSize);
+    const uint32_t slotCount = chunkCount < WGVK_FILE_UPLOAD_MAX_CHUNKS_IN_FLIGHT ? chunkCount : WGVK_FILE_UPLOAD_MAX_CHUNKS_IN_FLIGHT;
+    FileUploadState* state = RL_CALLOC(1, sizeof(FileUploadState) + slotCount * sizeof(FileUploadSlot));
+    state->queue = queue;
+    state->buffer = buffer;
+    state->bufferOffset = bufferOffset;
+    state->fd = fd;
+    state->fileOffset = fileOffset;
+    state->size = size;
+    state->callbackInfo = callbackInfo;
+    state->chunkCount = chunkCount;
+    state->slotCount = slotCount;
+    for(uint32_t i = 0;i < slotCount;i++){
+        state->slots[i].state = state;
+    }
+    wgpuBufferAddRef(buffer);
+    wgvk_mutex_lock(device->fileUploadsMutex);
+    state->next = device->fileUploads;
+    device->fileUploads = state;
+    FileUpload_pump(state);
+    wgvk_mutex_unlock(device->fileUploadsMutex);
+
+    WGPUInstance instance = device->adapter->instance;
+    WGPUFutureImpl futureImpl = {
+        .userdataForFunction = state,
+        .functionCalledOnWaitAny = processFileUploadFuture,
+        .freeUserData = freeFileUploadState,
+        .isReady = fileUploadFutureReady,
+        .mode = callbackInfo.mode,
+    };
+    uint64_t futureID = atomic_fetch_add_explicit(&instance->currentFutureId, 1, memory_order_relaxed);
+    Instance_putFuture(instance, futureID, futureImpl);
+    EXIT();
+    return (WGPUFuture){ .id = futureID };
+}
+
 WGPUFence wgpuDeviceCreateFence(WGPUDevice device){
     ENTRY();
-    WGPUFence fence = RL_CALLOC(1, sizeof(WGPUFenceImpl));
+    // Released fences keep their synchronization primitives, so a submit allocates nothing once the cache is warm
+    WGPUFence fence = FenceCache_GetFenceObject(&device->fenceCache);
+    if(fence == NULL){
+        fence = RL_CALLOC(1, sizeof(WGPUFenceImpl));
+        CallbackWithUserdataVector_init(&fence->callbacksOnWaitComplete);
+
+        // Initialize the new synchronization primitives
+        fence->wait_mutex = wgvk_mutex_create(wgvk_locktype_kernel);
+        fence->wait_cond = wgvk_cond_create(wgvk_locktype_kernel);
+        if (!fence->wait_mutex || !fence->wait_cond) {
+            // Handle initialization failure
+            if (fence->wait_mutex) wgvk_mutex_destroy(fence->wait_mutex);
+            if (fence->wait_cond) wgvk_cond_destroy(fence->wait_cond);
+            RL_FREE(fence);
+            return NULL;
+        }
+    }
     fence->refCount = 1;
     fence->device = device;
-    CallbackWithUserdataVector_init(&fence->callbacksOnWaitComplete);
-    
-    // Initialize the new synchronization primitives
-    fence->wait_mutex = wgvk_mutex_create(wgvk_locktype_kernel);
-    fence->wait_cond = wgvk_cond_create(wgvk_locktype_kernel);
-    if (!fence->wait_mutex || !fence->wait_cond) {
-        // Handle initialization failure
-        if (fence->wait_mutex) wgvk_mutex_destroy(fence->wait_mutex);
-        if (fence->wait_cond) wgvk_cond_destroy(fence->wait_cond);
-        RL_FREE(fence);
-        return NULL;
-    }
+    fence->fence = VK_NULL_HANDLE;
+    fence->timelineSemaphore = VK_NULL_HANDLE;
+    fence->timelineValue = 0;
 
-    VkFenceCreateInfo createInfo = {VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
-    fence->fence = FenceCache_GetFence(&device->fenceCache);
+    // With timeline semaphores the fence is just a value, assigned when it is submitted
+    if(!device->capabilities.timelineSemaphore){
+        fence->fence = FenceCache_GetFence(&device->fenceCache);
+    }
     // The fence starts in a "reset" state, ready to be used.
     atomic_init(&fence->state, WGPUFenceState_Reset);
     return fence;
     EXIT();
 }
 
+// Blocks until the GPU reached the fence or timeoutNS passed. Timeline fences that already completed cost one counter query
+static VkResult Fence_waitDevice(WGPUFence fence, uint64_t timeoutNS){
+    WGPUDevice device = fence->device;
+    if(fence->fence != VK_NULL_HANDLE){
+        return device->functions.vkWaitForFences(device->device, 1, &fence->fence, VK_TRUE, timeoutNS);
+    }
+    if(fence->timelineValue == 0){
+        return VK_SUCCESS;
+    }
+    uint64_t completedValue = 0;
+    device->functions.vkGetSemaphoreCounterValue(device->device, fence->timelineSemaphore, &completedValue);
+    if(completedValue >= fence->timelineValue){
+        return VK_SUCCESS;
+    }
+    const VkSemaphoreWaitInfo waitInfo = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+        .semaphoreCount = 1,
+        .pSemaphores = &fence->timelineSemaphore,
+        .pValues = &fence->timelineValue,
+    };
+    return device->functions.vkWaitSemaphores(device->device, &waitInfo, timeoutNS);
+}
+
+static inline void Queue_lockVkQueue(WGPUQueue queue){
+    if(queue->vkQueueMutex){
+        wgvk_mutex_lock(queue->vkQueueMutex);
+    }
+}
+static inline void Queue_unlockVkQueue(WGPUQueue queue){
+    if(queue->vkQueueMutex){
+        wgvk_mutex_unlock(queue->vkQueueMutex);
+    }
+}
+
+static inline VkQueue Queue_vkQueue(WGPUQueue queue){
+    if(queue->graphicsQueue){
+        return queue->graphicsQueue;
+    }
+    return queue->computeQueue ? queue->computeQueue : queue->transferQueue;
+}
+
+// Submits one batch that signals fence when it completes. With timeline semaphores every batch signals the next value
+// of the queue's timeline, fence or not, and can wait for the timelines of the device's other queues through crossQueueWaits.
+// The batch's own semaphores stay binary (acquire, present)
+static VkResult Queue_submit(WGPUQueue queue, const VkSubmitInfo* submitInfo, const QueueTimelineWait* crossQueueWaits, uint32_t crossQueueWaitCount, WGPU_NULLABLE WGPUFence fence){
+    WGPUDevice device = queue->device;
+    if(queue->timelineSemaphore == VK_NULL_HANDLE){
+        wgvk_assert(crossQueueWaitCount == 0, "Cross queue waits need timeline semaphores");
+        Queue_lockVkQueue(queue);
+        const VkResult result = device->functions.vkQueueSubmit(Queue_vkQueue(queue), 1, submitInfo, fence ? fence->fence : VK_NULL_HANDLE);
+        Queue_unlockVkQueue(queue);
+        if(result == VK_SUCCESS && fence){
+            atomic_store_explicit(&fence->state, WGPUFenceState_InUse, memory_order_release);
+        }
+        return result;
+    }
+    VkSemaphore signalSemaphores[4];
+    uint64_t signalValues[4] = {0};
+    const uint32_t signalCount = submitInfo->signalSemaphoreCount + 1;
+    wgvk_assert(signalCount <= 4, "Too many signal semaphores");
+    for(uint32_t i = 0;i < submitInfo->signalSemaphoreCount;i++){
+        signalSemaphores[i] = submitInfo->pSignalSemaphores[i];
+    }
+    signalSemaphores[signalCount - 1] = queue->timelineSemaphore;
+    signalValues[signalCount - 1] = queue->timelineValue + 1;
+
+    VkSemaphore waitSemaphores[4];
+    VkPipelineStageFlags waitStages[4];
+    uint64_t waitValues[4] = {0};
+    const uint32_t waitCount = submitInfo->waitSemaphoreCount + crossQueueWaitCount;
+    wgvk_assert(waitCount <= 4, "Too many wait semaphores");
+    for(uint32_t i = 0;i < submitInfo->waitSemaphoreCount;i++){
+        waitSemaphores[i] = submitInfo->pWaitSemaphores[i];
+        waitStages[i] = submitInfo->pWaitDstStageMask[i];
+    }
+    for(uint32_t i = 0;i < crossQueueWaitCount;i++){
+        waitSemaphores[submitInfo->waitSemaphoreCount + i] = crossQueueWaits[i].queue->timelineSemaphore;
+        waitStages[submitInfo->waitSemaphoreCount + i] = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+        waitValues[submitInfo->waitSemaphoreCount + i] = crossQueueWaits[i].value;
+    }
+    const VkTimelineSemaphoreSubmitInfo timelineInfo = {
+        .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+        .pNext = submitInfo->pNext,
+        .waitSemaphoreValueCount = waitCount,
+        .pWaitSemaphoreValues = waitValues,
+        .signalSemaphoreValueCount = signalCount,
+        .pSignalSemaphoreValues = signalValues,
+    };
+    VkSubmitInfo timelineSubmit = *submitInfo;
+    timelineSubmit.pNext = &timelineInfo;
+    timelineSubmit.waitSemaphoreCount = waitCount;
+    timelineSubmit.pWaitSemaphores = waitSemaphores;
+    timelineSubmit.pWaitDstStageMask = waitStages;
+    timelineSubmit.signalSemaphoreCount = signalCount;
+    timelineSubmit.pSignalSemaphores = signalSemaphores;
+    Queue_lockVkQueue(queue);
+    const VkResult result = device->functions.vkQueueSubmit(Queue_vkQueue(queue), 1, &timelineSubmit, VK_NULL_HANDLE);
+    Queue_unlockVkQueue(queue);
+    if(result == VK_SUCCESS){
+        ++queue->timelineValue;
+        if(fence){
+            fence->timelineSemaphore = queue->timelineSemaphore;
+            fence->timelineValue = queue->timelineValue;
+            atomic_store_explicit(&fence->state, WGPUFenceState_InUse, memory_order_release);
+        }
+    }
+    return result;
+}
+
 static inline void wgpuFenceRunWaitCompleteCallbacks(WGPUFence fence) {
     const size_t n = fence->callbacksOnWaitComplete.size;
     for (size_t i = 0; i < n; i++) {
@@ -2257,6 +3824,48 @@ static inline void wgpuFenceRunWaitCompleteCallbacks(WGPUFence fence) {
     }
 }
 
+// Waits up to timeoutNS as the fence's designated waiter, which completes the fence and runs its callbacks.
+// Returns false without waiting if the fence is not in use or another thread is the designated waiter already
+static bool Fence_waitAsDesignatedWaiter(WGPUFence fence, uint64_t timeoutNS){
+    // Attempt to become the designated waiter. This is an atomic operation.
+    WGPUFenceState expected_state = WGPUFenceState_InUse;
+    if (!atomic_compare_exchange_strong_explicit(&fence->state, &expected_state, WGPUFenceState_Waiting, memory_order_acq_rel, memory_order_acquire)) {
+        return false;
+    }
+    VkResult waitResult = Fence_waitDevice(fence, timeoutNS);
+    
+    wgvk_assert(waitResult == VK_SUCCESS || waitResult == VK_TIMEOUT, "Waiting for a fence returned an unexpected error.");
+
+    // Lock the mutex to safely update state and signal followers.
+    wgvk_mutex_lock(fence->wait_mutex);
+    if (waitResult == VK_SUCCESS) {
+        wgpuFenceRunWaitCompleteCallbacks(fence);
+        atomic_store_explicit(&fence->state, WGPUFenceState_Finished, memory_order_release);
+    } else { // Timeout occurred
+        // Revert state to InUse so another thread can attempt to wait again.
+        atomic_store_explicit(&fence->state, WGPUFenceState_InUse, memory_order_release);
+    }
+    // Wake up ALL follower threads that might be waiting on the condition variable.
+    wgvk_cond_broadcast(fence->wait_cond);
+    wgvk_mutex_unlock(fence->wait_mutex);
+    return true;
+}
+
+// Non-blocking wgpuFenceWait: completes the fence if the GPU already reached it. A fence another thread
+// is waiting for counts as pending, a fence that was never submitted as complete.
+// The status is queried before claiming the designated waiter role, so a poll never hands an unfinished fence back
+static bool Fence_poll(WGPUFence fence){
+    const WGPUFenceState state = atomic_load_explicit(&fence->state, memory_order_acquire);
+    if(state == WGPUFenceState_Finished || state == WGPUFenceState_Reset){
+        return true;
+    }
+    if(state != WGPUFenceState_InUse || Fence_waitDevice(fence, 0) != VK_SUCCESS){
+        return false;
+    }
+    Fence_waitAsDesignatedWaiter(fence, 0);
+    return atomic_load_explicit(&fence->state, memory_order_acquire) == WGPUFenceState_Finished;
+}
+
 void wgpuFenceWait(WGPUFence fence, uint64_t timeoutNS) {
     ENTRY();
 
@@ -2270,52 +3879,178 @@ void wgpuFenceWait(WGPUFence fence, uint64_t timeoutNS) {
         return;
     }
 
-    bool is_designated_waiter = false;
-    
-    // Attempt to become the designated waiter. This is an atomic operation.
-    WGPUFenceState expected_state = WGPUFenceState_InUse;
-    if (atomic_compare_exchange_strong_explicit(&fence->state, &expected_state, WGPUFenceState_Waiting, memory_order_acq_rel, memory_order_acquire)) {
-        is_designated_waiter = true;
+    if (!Fence_waitAsDesignatedWaiter(fence, timeoutNS)) {
+        wgvk_mutex_lock(fence->wait_mutex);
+        for (;;) {
+            const WGPUFenceState state = atomic_load_explicit(&fence->state, memory_order_acquire);
+            if (state == WGPUFenceState_Finished || state == WGPUFenceState_Reset) {
+                break;
+            }
+            // The designated waiter timed out and handed the fence back, take over its wait
+            if (state == WGPUFenceState_InUse) {
+                wgvk_mutex_unlock(fence->wait_mutex);
+                if (Fence_waitAsDesignatedWaiter(fence, timeoutNS)) {
+                    EXIT();
+                    return;
+                }
+                wgvk_mutex_lock(fence->wait_mutex);
+                continue;
+            }
+            wgvk_cond_wait(fence->wait_cond, fence->wait_mutex);
+        }
+        wgvk_mutex_unlock(fence->wait_mutex);
     }
 
-    if (is_designated_waiter) {
-        VkResult waitResult = fence->device->functions.vkWaitForFences(
-            fence->device->device, 1, &fence->fence, VK_TRUE, timeoutNS);
-        
-        wgvk_assert(waitResult == VK_SUCCESS || waitResult == VK_TIMEOUT, "vkWaitForFences returned an unexpected error.");
+    EXIT();
+}
 
-        // Lock the mutex to safely update state and signal followers.
+static inline bool Fence_settled(WGPUFence fence){
+    const WGPUFenceState state = atomic_load_explicit(&fence->state, memory_order_acquire);
+    return state == WGPUFenceState_Finished || state == WGPUFenceState_Reset || (fence->fence == VK_NULL_HANDLE && fence->timelineValue == 0);
+}
+
+#define WGVK_MAX_WAIT_TIMELINES 4
+
+// Waits for all or any of the fences with a single vkWaitForFences or vkWaitSemaphores call. Timeline fences are grouped by
+// semaphore: waiting for all needs the highest value of each, waiting for any the lowest. Returns VK_TIMEOUT if timeoutNS passed
+static VkResult Device_waitFences(WGPUDevice device, const WGPUFence* fences, uint32_t fenceCount, bool waitAll, uint64_t timeoutNS){
+    if(!device->capabilities.timelineSemaphore){
+        VkFence inlineHandles[16];
+        VkFence* handles = fenceCount <= 16 ? inlineHandles : (VkFence*)RL_CALLOC(fenceCount, sizeof(VkFence));
+        for(uint32_t i = 0;i < fenceCount;i++){
+            handles[i] = fences[i]->fence;
+        }
+        const VkResult result = device->functions.vkWaitForFences(device->device, fenceCount, handles, waitAll ? VK_TRUE : VK_FALSE, timeoutNS);
+        if(handles != inlineHandles){
+            RL_FREE(handles);
+        }
+        return result;
+    }
+    VkSemaphore semaphores[WGVK_MAX_WAIT_TIMELINES];
+    uint64_t values[WGVK_MAX_WAIT_TIMELINES];
+    uint32_t semaphoreCount = 0;
+    for(uint32_t i = 0;i < fenceCount;i++){
+        uint32_t s = 0;
+        while(s < semaphoreCount && semaphores[s] != fences[i]->timelineSemaphore){
+            ++s;
+        }
+        if(s == semaphoreCount){
+            wgvk_assert(semaphoreCount < WGVK_MAX_WAIT_TIMELINES, "Fences of too many queues");
+            semaphores[semaphoreCount] = fences[i]->timelineSemaphore;
+            values[semaphoreCount++] = fences[i]->timelineValue;
+        }
+        else if(waitAll ? fences[i]->timelineValue > values[s] : fences[i]->timelineValue < values[s]){
+            values[s] = fences[i]->timelineValue;
+        }
+    }
+    const VkSemaphoreWaitInfo waitInfo = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+        .flags = waitAll ? 0 : VK_SEMAPHORE_WAIT_ANY_BIT,
+        .semaphoreCount = semaphoreCount,
+        .pSemaphores = semaphores,
+        .pValues = values,
+    };
+    return device->functions.vkWaitSemaphores(device->device, &waitInfo, timeoutNS);
+}
+
+WGPUWaitStatus wgpuFencesWaitEx(const WGPUFence* fences, uint32_t fenceCount, WGPUBool waitAll, uint64_t timeoutNS) {
+    ENTRY();
+    WGPUFenceVector pending;
+    WGPUFenceVector_init(&pending);
+    bool anySettled = false;
+    for (uint32_t i = 0; i < fenceCount; i++) {
+        if (fences[i] == NULL) {
+            continue;
+        }
+        if (Fence_settled(fences[i])) {
+            anySettled = true;
+            continue;
+        }
+        wgvk_assert(pending.size == 0 || fences[i]->device == pending.data[0]->device, "Fences of different devices");
+        WGPUFenceVector_push_back(&pending, fences[i]);
+    }
+    if (pending.size == 0 || (!waitAll && anySettled)) {
+        WGPUFenceVector_free(&pending);
+        EXIT();
+        return WGPUWaitStatus_Success;
+    }
+    WGPUDevice device = pending.data[0]->device;
+
+    // Fences another thread is the designated waiter of are waited on as well, but that thread completes them
+    bool* designated = RL_CALLOC(pending.size, sizeof(bool));
+    for (size_t i = 0; i < pending.size; i++) {
+        WGPUFenceState expected_state = WGPUFenceState_InUse;
+        designated[i] = atomic_compare_exchange_strong_explicit(&pending.data[i]->state, &expected_state, WGPUFenceState_Waiting, memory_order_acq_rel, memory_order_acquire);
+    }
+    const VkResult waitResult = Device_waitFences(device, pending.data, (uint32_t)pending.size, waitAll, timeoutNS);
+    wgvk_assert(waitResult == VK_SUCCESS || waitResult == VK_TIMEOUT, "Waiting for fences returned an unexpected error.");
+
+    // Unless all fences were waited for, the batched result does not say which ones signalled
+    uint64_t completedValues[WGVK_MAX_WAIT_TIMELINES];
+    VkSemaphore completedSemaphores[WGVK_MAX_WAIT_TIMELINES];
+    uint32_t completedCount = 0;
+    for (size_t i = 0; i < pending.size; i++) {
+        if (!designated[i]) {
+            continue;
+        }
+        WGPUFence fence = pending.data[i];
+        bool signalled = waitAll && waitResult == VK_SUCCESS;
+        if (!signalled && fence->fence != VK_NULL_HANDLE) {
+            signalled = device->functions.vkGetFenceStatus(device->device, fence->fence) == VK_SUCCESS;
+        }
+        else if (!signalled) {
+            uint32_t s = 0;
+            while (s < completedCount && completedSemaphores[s] != fence->timelineSemaphore) {
+                ++s;
+            }
+            if (s == completedCount) {
+                completedSemaphores[completedCount] = fence->timelineSemaphore;
+                device->functions.vkGetSemaphoreCounterValue(device->device, fence->timelineSemaphore, &completedValues[completedCount++]);
+            }
+            signalled = completedValues[s] >= fence->timelineValue;
+        }
+        // Same transitions as a designated waiter in wgpuFenceWait
         wgvk_mutex_lock(fence->wait_mutex);
-        if (waitResult == VK_SUCCESS) {
+        if (signalled) {
             wgpuFenceRunWaitCompleteCallbacks(fence);
             atomic_store_explicit(&fence->state, WGPUFenceState_Finished, memory_order_release);
-        } else { // Timeout occurred
-            // Revert state to InUse so another thread can attempt to wait again.
+        } else {
             atomic_store_explicit(&fence->state, WGPUFenceState_InUse, memory_order_release);
         }
-        // Wake up ALL follower threads that might be waiting on the condition variable.
         wgvk_cond_broadcast(fence->wait_cond);
         wgvk_mutex_unlock(fence->wait_mutex);
+    }
 
-    } else {
-        wgvk_mutex_lock(fence->wait_mutex);
-        while (atomic_load_explicit(&fence->state, memory_order_acquire) != WGPUFenceState_Finished) {
-            wgvk_cond_wait(fence->wait_cond, fence->wait_mutex);
+    // The GPU reached the other designated waiters' fences too, wait until they completed them.
+    // A waiter that timed out hands its fence back, which is then completed here without blocking
+    if (waitAll && waitResult == VK_SUCCESS) {
+        for (size_t i = 0; i < pending.size; i++) {
+            if (designated[i]) {
+                continue;
+            }
+            WGPUFence fence = pending.data[i];
+            for (;;) {
+                wgvk_mutex_lock(fence->wait_mutex);
+                while (atomic_load_explicit(&fence->state, memory_order_acquire) == WGPUFenceState_Waiting) {
+                    wgvk_cond_wait(fence->wait_cond, fence->wait_mutex);
+                }
+                const WGPUFenceState state = atomic_load_explicit(&fence->state, memory_order_acquire);
+                wgvk_mutex_unlock(fence->wait_mutex);
+                if (state != WGPUFenceState_InUse || Fence_waitAsDesignatedWaiter(fence, UINT64_MAX)) {
+                    break;
+                }
+            }
         }
-        wgvk_mutex_unlock(fence->wait_mutex);
     }
-
+    RL_FREE(designated);
+    WGPUFenceVector_free(&pending);
     EXIT();
+    return waitResult == VK_SUCCESS ? WGPUWaitStatus_Success : WGPUWaitStatus_TimedOut;
 }
 
 void wgpuFencesWait(const WGPUFence* fences, uint32_t fenceCount, uint64_t timeoutNS) {
     ENTRY();
-    if (!fences || fenceCount == 0) { EXIT(); return; }
-    for (uint32_t i = 0; i < fenceCount; i++) {
-        if (fences[i]) {
-            wgpuFenceWait(fences[i], timeoutNS);
-        }
-    }
+    wgpuFencesWaitEx(fences, fenceCount, 1, timeoutNS);
     EXIT();
 }
 
@@ -2337,18 +4072,21 @@ void wgpuFenceRelease(WGPUFence fence){
     ENTRY();
     wgvk_assert(fence->refCount > 0, "refCount already zero");
     if(--fence->refCount == 0){
-        wgvk_mutex_destroy(fence->wait_mutex);
-        wgvk_cond_destroy(fence->wait_cond);
-
-        FenceCache_PutFence(&fence->device->fenceCache, fence->fence);
+        if(fence->fence != VK_NULL_HANDLE){
+            // Fences go back into the cache unsignalled
+            if(atomic_load_explicit(&fence->state, memory_order_acquire) == WGPUFenceState_Finished){
+                fence->device->functions.vkResetFences(fence->device->device, 1, &fence->fence);
+            }
+            FenceCache_PutFence(&fence->device->fenceCache, fence->fence);
+        }
         for(uint32_t i = 0; i < CallbackWithUserdataVector_size(&fence->callbacksOnWaitComplete); i++){
             CallbackWithUserdata* cbu = CallbackWithUserdataVector_get(&fence->callbacksOnWaitComplete, i);
             if(cbu->freeUserData){
                 cbu->freeUserData(cbu->userdata);
             }
         }
-        CallbackWithUserdataVector_free(&fence->callbacksOnWaitComplete);
-        RL_FREE(fence);
+        CallbackWithUserdataVector_clear(&fence->callbacksOnWaitComplete);
+        FenceCache_PutFenceObject(&fence->device->fenceCache, fence);
     }
     EXIT();
 }
@@ -2425,7 +4163,7 @@ WGPUTexture wgpuDeviceCreateTexture(WGPUDevice device, const WGPUTextureDescript
     ret->format = toVulkanPixelFormat(descriptor->format);
     ret->sampleCount = descriptor->sampleCount;
     ret->depthOrArrayLayers = descriptor->size.depthOrArrayLayers;
-    ret->layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    SubresourceStateVector_init(&ret->states);
     ret->refCount = 1;
     ret->mipLevels = descriptor->mipLevelCount;
     ret->memory = imageMemory;
@@ -2622,20 +4360,9 @@ void wgpuWriteBindGroup(WGPUDevice device, WGPUBindGroup wvBindGroup, const WGPU
 
 
 
-WGPUBindGroup wgpuDeviceCreateBindGroup(WGPUDevice device, const WGPUBindGroupDescriptor* bgdesc){
-    ENTRY();
-    wgvk_assert(bgdesc->layout != NULL, "WGPUBindGroupDescriptor::layout is null");
-    
-    WGPUBindGroup ret = RL_CALLOC(1, sizeof(WGPUBindGroupImpl));
-    ret->refCount = 1;
-    ResourceUsage_init(&ret->resourceUsage);
-
-    ret->device = device;
-    ret->cacheIndex = device->submittedFrames % framesInFlight;
-
-    PerframeCache* fcache = DeviceGetFIFCache(device, ret->cacheIndex);
-
-    DescriptorSetAndPoolVector* dsap = BindGroupCacheMap_get(&fcache->bindGroupCache, bgdesc->layout);
+// Takes a descriptor set for the layout from the frame's bindGroupCache or allocates a new pool for it
+static void BindGroup_allocateSet(WGPUDevice device, PerframeCache* fcache, WGPUBindGroup group, WGPUBindGroupLayout layout){
+    DescriptorSetAndPoolVector* dsap = BindGroupCacheMap_get(&fcache->bindGroupCache, layout);
 
     if(dsap == NULL || dsap->size == 0){ //Cache miss
         //TRACELOG(WGPU_LOG_INFO, "Allocating new VkDescriptorPool and -Set");
@@ -2645,8 +4372,8 @@ WGPUBindGroup wgpuDeviceCreateBindGroup(WGPUDevice device, const WGPUBindGroupDe
 
         uint32_t counts[DESCRIPTOR_TYPE_UPPER_LIMIT] = {0};
 
-        for(uint32_t i = 0;i < bgdesc->layout->entryCount;i++){
-            ++counts[extractVkDescriptorType(bgdesc->layout->entries + i)];
+        for(uint32_t i = 0;i < layout->entryCount;i++){
+            ++counts[extractVkDescriptorType(layout->entries + i)];
         }
         VkDescriptorPoolSize sizes[DESCRIPTOR_TYPE_UPPER_LIMIT];
         uint32_t VkDescriptorPoolSizeCount = 0;
@@ -2662,30 +4389,91 @@ WGPUBindGroup wgpuDeviceCreateBindGroup(WGPUDevice device, const WGPUBindGroupDe
         dpci.poolSizeCount = VkDescriptorPoolSizeCount;
         dpci.pPoolSizes = sizes;
         dpci.maxSets = 1;
-        device->functions.vkCreateDescriptorPool(device->device, &dpci, NULL, &ret->pool);
+        device->functions.vkCreateDescriptorPool(device->device, &dpci, NULL, &group->pool);
 
         //VkCopyDescriptorSet copy{};
         //copy.sType = VK_STRUCTURE_TYPE_COPY_DESCRIPTOR_SET;
 
         VkDescriptorSetAllocateInfo dsai zeroinit;
         dsai.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-        dsai.descriptorPool = ret->pool;
+        dsai.descriptorPool = group->pool;
         dsai.descriptorSetCount = 1;
-        dsai.pSetLayouts = (VkDescriptorSetLayout*)&bgdesc->layout->layout;
-        device->functions.vkAllocateDescriptorSets(device->device, &dsai, &ret->set);
+        dsai.pSetLayouts = (VkDescriptorSetLayout*)&layout->layout;
+        device->functions.vkAllocateDescriptorSets(device->device, &dsai, &group->set);
     }
     else{
-        ret->pool = dsap->data[dsap->size - 1].pool;
-        ret->set  = dsap->data[dsap->size - 1].set;
+        group->pool = dsap->data[dsap->size - 1].pool;
+        group->set  = dsap->data[dsap->size - 1].set;
         --dsap->size;
     }
+}
+
+static void BindGroup_snapshotGenerations(WGPUBindGroup group){
+    for(uint32_t i = 0;i < group->entryCount;i++){
+        group->bufferGenerations[i] = group->entries[i].buffer ? group->entries[i].buffer->backingGeneration : 0;
+    }
+}
+
+static bool BindGroup_backingsChanged(WGPUBindGroup group){
+    for(uint32_t i = 0;i < group->entryCount;i++){
+        if(group->entries[i].buffer && group->entries[i].buffer->backingGeneration != group->bufferGenerations[i]){
+            return true;
+        }
+    }
+    return false;
+}
+
+// wgpuQueueWriteBuffer may have given one of the group's buffers a new backing. The old set can still be in use
+// by submitted work, so it is retired into the current frame and the group gets a freshly written one.
+static void BindGroup_refreshBackings(WGPUBindGroup group){
+    if(!BindGroup_backingsChanged(group)){
+        return;
+    }
+    WGPUDevice device = group->device;
+    wgvk_mutex_lock(device->backingRetireMutex);
+    if(BindGroup_backingsChanged(group)){
+        PerframeCache* fcache = DeviceGetFIFCache(device, device->submittedFrames % framesInFlight);
+        wgpuBindGroupLayoutAddRef(group->layout);
+        RetiredDescriptorSetVector_push_back(&fcache->retiredDescriptorSets, (RetiredDescriptorSet){
+            .layout = group->layout,
+            .setAndPool = {
+                .pool = group->pool,
+                .set = group->set
+            }
+        });
+        BindGroup_allocateSet(device, fcache, group, group->layout);
+        const WGPUBindGroupDescriptor rewrite = {
+            .layout = group->layout,
+            .entryCount = group->entryCount,
+            .entries = group->entries,
+        };
+        wgpuWriteBindGroup(device, group, &rewrite);
+        BindGroup_snapshotGenerations(group);
+    }
+    wgvk_mutex_unlock(device->backingRetireMutex);
+}
+
+WGPUBindGroup wgpuDeviceCreateBindGroup(WGPUDevice device, const WGPUBindGroupDescriptor* bgdesc){
+    ENTRY();
+    wgvk_assert(bgdesc->layout != NULL, "WGPUBindGroupDescriptor::layout is null");
+    
+    WGPUBindGroup ret = RL_CALLOC(1, sizeof(WGPUBindGroupImpl));
+    ret->refCount = 1;
+    ResourceUsage_init(&ret->resourceUsage);
+
+    ret->device = device;
+    ret->cacheIndex = device->submittedFrames % framesInFlight;
+
+    BindGroup_allocateSet(device, DeviceGetFIFCache(device, ret->cacheIndex), ret, bgdesc->layout);
     ret->entryCount = bgdesc->entryCount;
 
     ret->entries = RL_CALLOC(bgdesc->entryCount, sizeof(WGPUBindGroupEntry));
     if(bgdesc->entryCount > 0){
         memcpy(ret->entries, bgdesc->entries, bgdesc->entryCount * sizeof(WGPUBindGroupEntry));
     }
+    ret->bufferGenerations = RL_CALLOC(bgdesc->entryCount, sizeof(uint32_t));
     wgpuWriteBindGroup(device, ret, bgdesc);
+    BindGroup_snapshotGenerations(ret);
     ret->layout = bgdesc->layout;
     ++ret->layout->refCount;
     wgvk_assert(ret->layout != NULL, "ret->layout is NULL");
@@ -2867,27 +4655,17 @@ WGPUPipelineLayout wgpuDeviceCreatePipelineLayout(WGPUDevice device, const WGPUP
 WGPUCommandEncoder wgpuDeviceCreateCommandEncoder(WGPUDevice device, const WGPUCommandEncoderDescriptor* desc){
     ENTRY();
     WGPUCommandEncoder ret = RL_CALLOC(1, sizeof(WGPUCommandEncoderImpl));
+    ret->refCount = 1;
     ret->cacheIndex = device->submittedFrames % framesInFlight;
     PerframeCache* pfcache = DeviceGetFIFCache(device, ret->cacheIndex);
     ret->device = device;
     ret->movedFrom = 0;
-    //vkCreateCommandPool(device->device, &pci, NULL, &cache.commandPool);
-    if(VkCommandBufferVector_empty(&pfcache->commandBuffers)){
-        VkCommandBufferAllocateInfo bai = {
-            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
-            .commandPool = pfcache->commandPool,
-            .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-            .commandBufferCount = 1,
-        };
-        device->functions.vkAllocateCommandBuffers(device->device, &bai, &ret->buffer);
-        //printf("Allocating cb %p from pool %d\n", ret->buffer, (int)ret->cacheIndex);
-    }
-    else{
-        ret->buffer = pfcache->commandBuffers.data[pfcache->commandBuffers.size - 1];
-        //printf("Recycling cb %p from pool %d\n",  ret->buffer, (int)ret->cacheIndex);
-        VkCommandBufferVector_pop_back(&pfcache->commandBuffers);
-        //vkResetCommandBuffer(ret->buffer, 0);
+    uint32_t queueFamily = device->fifCache.queueFamily;
+    if(desc && desc->nextInChain && desc->nextInChain->sType == WGPUSType_CommandEncoderQueueSelection){
+        queueFamily = ((const WGPUCommandEncoderQueueSelection*)desc->nextInChain)->queue->familyIndex;
     }
+    ret->commandPool = PerframeCache_getThreadCommandPool(device, pfcache, queueFamily);
+    ret->buffer = ThreadCommandPool_acquire(device, ret->commandPool);
 
     const VkCommandBufferBeginInfo bbi = {
         .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
@@ -3032,6 +4810,37 @@ uint32_t wgpuTextureGetWidth(WGPUTexture texture) WGPU_FUNCTION_ATTRIBUTE{
     EXIT();
 }
 
+// Render passes start out with these, see wgpuRenderPassEncoderEnd
+static const float passDefaultBlendConstants[4] = {1, 1, 1, 1};
+
+static DefaultDynamicState passDefaultDynamicState(void){
+    DefaultDynamicState ret = {
+        .viewport = {
+            .minDepth = 0,
+            .maxDepth = 1,
+        },
+        .scissorRect = {
+            .offset = {UINT32_MAX, UINT32_MAX},
+            .extent = {UINT32_MAX, UINT32_MAX},
+        }
+    };
+    memcpy(ret.blendConstants, passDefaultBlendConstants, sizeof(ret.blendConstants));
+    return ret;
+}
+
+// Bundle secondaries inherit viewport and scissor, but set the blend constants
+// and stencil reference themselves and assume a [0, 1] depth range
+static bool RenderBundle_matchesDynamicState(const DefaultDynamicState* state){
+    return state->viewport.minDepth == 0.0f &&
+           state->viewport.maxDepth == 1.0f &&
+           state->stencilReference == 0 &&
+           memcmp(state->blendConstants, passDefaultBlendConstants, sizeof(passDefaultBlendConstants)) == 0;
+}
+
+#if RENDERBUNDLES_AS_SECONDARY_COMMANDBUFFERS == 1 && VULKAN_USE_DYNAMIC_RENDERING == 1
+static void RenderBundle_recordSecondary(WGPURenderBundle bundle);
+#endif
+
 static inline VkClearValue toVkCV(const WGPUColor c){
     return (VkClearValue){
         .color.float32 = {
@@ -3058,29 +4867,7 @@ WGPURenderBundleEncoder wgpuDeviceCreateRenderBundleEncoder(WGPUDevice device, c
     ret->colorAttachmentCount = descriptor->colorFormatCount;
     ret->colorAttachmentFormats = colorAttachmentFormats;
     ret->depthStencilFormat = toVulkanPixelFormat(descriptor->depthStencilFormat);
-    //if(VkCommandBufferVector_empty(&device->secondaryCommandBuffers)){
-    //VkCommandBufferAllocateInfo bai = {
-    //    .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
-    //    .commandPool = device->secondaryCommandPool,
-    //    .level = VK_COMMAND_BUFFER_LEVEL_SECONDARY,
-    //    .commandBufferCount = 1
-    //};
-    //device->functions.vkAllocateCommandBuffers(device->device, &bai, &ret->buffer);
-    //}
-    //else{
-    //    ret->buffer = device->frameCaches[ret->cacheIndex].secondaryCommandBuffers.data[device->frameCaches[ret->cacheIndex].secondaryCommandBuffers.size - 1];
-    //    VkCommandBufferVector_pop_back(&device->frameCaches[ret->cacheIndex].secondaryCommandBuffers);
-    //}
-
-
-    
-    //device->functions.vkCmdSetViewport(ret->buffer, 0, 1, &viewPort);
-    //device->functions.vkCmdSetScissor (ret->buffer, 0, 1, &scissor);
-    
-    //VkViewport dummy_viewport = { 0.0f, 0.0f, 1.0f, 1.0f, 0.0f, 1.0f };
-    //VkRect2D dummy_scissor = { {0, 0}, {1, 1} };
-    //vkCmdSetViewport(ret->buffer, 0, 1, &dummy_viewport);
-    //vkCmdSetScissor (ret->buffer, 0, 1, &dummy_scissor);
+    ret->sampleCount = descriptor->sampleCount;
     return ret;
 
     EXIT();
@@ -3095,8 +4882,11 @@ WGPURenderBundle wgpuRenderBundleEncoderFinish(WGPURenderBundleEncoder renderBun
     renderBundleEncoder->colorAttachmentFormats = NULL;
     ret->colorAttachmentCount = renderBundleEncoder->colorAttachmentCount;
     ret->depthStencilFormat = renderBundleEncoder->depthStencilFormat;
-    //ret->device->functions.vkEndCommandBuffer(ret->commandBuffer);
+    ret->sampleCount = renderBundleEncoder->sampleCount;
     ret->refCount = 1;
+    #if RENDERBUNDLES_AS_SECONDARY_COMMANDBUFFERS == 1 && VULKAN_USE_DYNAMIC_RENDERING == 1
+    RenderBundle_recordSecondary(ret);
+    #endif
     return ret;
     EXIT();
 }
@@ -3159,6 +4949,46 @@ void wgpuRenderBundleEncoderDrawIndirect(WGPURenderBundleEncoder renderBundleEnc
     EXIT();
 }
 
+void wgpuRenderBundleEncoderMultiDrawIndexedIndirect(WGPURenderBundleEncoder renderBundleEncoder, WGPUBuffer indirectBuffer, uint64_t indirectOffset, uint32_t maxDrawCount, WGPU_NULLABLE WGPUBuffer drawCountBuffer, uint64_t drawCountBufferOffset) WGPU_FUNCTION_ATTRIBUTE{
+    ENTRY();
+    if(drawCountBuffer && !renderBundleEncoder->device->capabilities.drawIndirectCount){
+        DeviceCallback(renderBundleEncoder->device, WGPUErrorType_Validation, STRVIEW("MultiDrawIndexedIndirect with a drawCountBuffer requires drawIndirectCount support"));
+        return;
+    }
+    RenderPassCommandGeneric cmd = {
+        .type = rp_command_type_multi_draw_indexed_indirect,
+        .multiDrawIndexedIndirect = {
+            .indirectBuffer = indirectBuffer,
+            .indirectOffset = indirectOffset,
+            .maxDrawCount = maxDrawCount,
+            .drawCountBuffer = drawCountBuffer,
+            .drawCountBufferOffset = drawCountBufferOffset
+        }
+    };
+    RenderPassCommandGenericVector_push_back(&renderBundleEncoder->bufferedCommands, cmd);
+    EXIT();
+}
+
+void wgpuRenderBundleEncoderMultiDrawIndirect(WGPURenderBundleEncoder renderBundleEncoder, WGPUBuffer indirectBuffer, uint64_t indirectOffset, uint32_t maxDrawCount, WGPU_NULLABLE WGPUBuffer drawCountBuffer, uint64_t drawCountBufferOffset) WGPU_FUNCTION_ATTRIBUTE{
+    ENTRY();
+    if(drawCountBuffer && !renderBundleEncoder->device->capabilities.drawIndirectCount){
+        DeviceCallback(renderBundleEncoder->device, WGPUErrorType_Validation, STRVIEW("MultiDrawIndirect with a drawCountBuffer requires drawIndirectCount support"));
+        return;
+    }
+    RenderPassCommandGeneric cmd = {
+        .type = rp_command_type_multi_draw_indirect,
+        .multiDrawIndirect = {
+            .indirectBuffer = indirectBuffer,
+            .indirectOffset = indirectOffset,
+            .maxDrawCount = maxDrawCount,
+            .drawCountBuffer = drawCountBuffer,
+            .drawCountBufferOffset = drawCountBufferOffset
+        }
+    };
+    RenderPassCommandGenericVector_push_back(&renderBundleEncoder->bufferedCommands, cmd);
+    EXIT();
+}
+
 void wgpuRenderBundleEncoderSetBindGroup(WGPURenderBundleEncoder renderBundleEncoder, uint32_t groupIndex, WGPU_NULLABLE WGPUBindGroup group, size_t dynamicOffsetCount, const uint32_t* dynamicOffsets) WGPU_FUNCTION_ATTRIBUTE{
     ENTRY();
     RenderPassCommandGeneric cmd = {
@@ -3245,8 +5075,87 @@ void wgpuRenderBundleEncoderRelease(WGPURenderBundleEncoder renderBundleEncoder)
 
 
 
+// Whether next can continue the rendering instance of open instead of ending and beginning another one:
+// same attachments, nothing cleared, stored the same way and no queries that have to cover exactly one pass.
+// A resolve then happens once when the instance ends, it would be overwritten by the second pass anyway
+static bool RenderPass_continuesRendering(const RenderPassCommandBegin* open, const RenderPassCommandBegin* next){
+    if(open->colorAttachmentCount != next->colorAttachmentCount || open->depthAttachmentPresent != next->depthAttachmentPresent){
+        return false;
+    }
+    if(open->occlusionQuerySet || next->occlusionQuerySet || open->timestampWritesPresent || next->timestampWritesPresent){
+        return false;
+    }
+    for(size_t i = 0;i < next->colorAttachmentCount;i++){
+        const WGPURenderPassColorAttachment* a = open->colorAttachments + i;
+        const WGPURenderPassColorAttachment* b = next->colorAttachments + i;
+        if(a->view != b->view || a->resolveTarget != b->resolveTarget || a->depthSlice != b->depthSlice || b->loadOp != WGPULoadOp_Load || a->storeOp != b->storeOp){
+            return false;
+        }
+    }
+    if(next->depthAttachmentPresent){
+        const WGPURenderPassDepthStencilAttachment* a = &open->depthStencilAttachment;
+        const WGPURenderPassDepthStencilAttachment* b = &next->depthStencilAttachment;
+        if(a->view != b->view || a->depthReadOnly != b->depthReadOnly || a->depthStoreOp != b->depthStoreOp || a->stencilStoreOp != b->stencilStoreOp){
+            return false;
+        }
+        if(b->depthLoadOp == WGPULoadOp_Clear || b->stencilLoadOp == WGPULoadOp_Clear){
+            return false;
+        }
+    }
+    return true;
+}
+
+static void RenderPassEncoder_trackAttachments(WGPURenderPassEncoder renderPassEncoder){
+    WGPUCommandEncoder enc = renderPassEncoder->cmdEncoder;
+    const RenderPassCommandBegin* beginInfo = &renderPassEncoder->beginInfo;
+    const ImageUsageSnap iur_color = {
+        .layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+        .access = VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+        .stage = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+        .subresource = {
+            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+            .baseMipLevel = 0,
+            .levelCount = 1,
+            .baseArrayLayer = 0,
+            .layerCount = 1
+        }
+    };
+
+    const ImageUsageSnap iur_resolve = iur_color;
+    
+    const ImageUsageSnap iur_depth = {
+        .layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+        .access = VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+        .stage = VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+        .subresource = {
+            .aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT,
+            .baseMipLevel = 0,
+            .levelCount = 1,
+            .baseArrayLayer = 0,
+            .layerCount = 1
+        }
+    };
+
+    
+    // Attachments are transitioned per view, so a pass can render into one mip level while sampling another
+    for(uint32_t i = 0;i < beginInfo->colorAttachmentCount;i++){
+        wgvk_assert(beginInfo->colorAttachments[i].view, "colorAttachments[%d].view is null", (int)i);
+        ce_trackTextureView(enc, beginInfo->colorAttachments[i].view, iur_color);
+        if(beginInfo->colorAttachments[i].resolveTarget){
+            ce_trackTextureView(enc, beginInfo->colorAttachments[i].resolveTarget, iur_resolve);
+        }
+    }
+
+    if(beginInfo->depthAttachmentPresent){
+        wgvk_assert(beginInfo->depthStencilAttachment.view, "depthStencilAttachment.view is null");
+        ce_trackTextureView(enc, beginInfo->depthStencilAttachment.view, iur_depth);
+    }
+}
+
 WGPURenderPassEncoder wgpuCommandEncoderBeginRenderPass(WGPUCommandEncoder enc, const WGPURenderPassDescriptor* rpdesc){
     ENTRY();
+    // Passes emit their barriers while they are encoded
+    CommandEncoder_flushCopies(enc);
     WGPURenderPassEncoder ret = RL_CALLOC(1, sizeof(WGPURenderPassEncoderImpl));
     PerframeCache* frameCache = DeviceGetFIFCache(enc->device, enc->cacheIndex);
     VkCommandPool pool = frameCache->commandPool;
@@ -3352,151 +5261,31 @@ WGPURenderPassEncoder wgpuCommandEncoderBeginRenderPass(WGPUCommandEncoder enc,
     }
     RenderPassCommandGenericVector_init(&ret->bufferedCommands);
 
-    const ImageUsageSnap iur_color = {
-        .layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-        .access = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
-        .stage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-        .subresource = {
-            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-            .baseMipLevel = 0,
-            .levelCount = 1,
-            .baseArrayLayer = 0,
-            .layerCount = 1
-        }
-    };
-
-    const ImageUsageSnap iur_resolve = iur_color;
-    
-    const ImageUsageSnap iur_depth = {
-        .layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
-        .access = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
-        .stage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-        .subresource = {
-            .aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT,
-            .baseMipLevel = 0,
-            .levelCount = 1,
-            .baseArrayLayer = 0,
-            .layerCount = 1
-        }
-    };
-
-    
-    //for(uint32_t i = 0;i < rpdesc->colorAttachmentCount;i++){
-    //    wgvk_assert(rpdesc->colorAttachments[i].view, "colorAttachments[%d].view is null", (int)i);
-    //    ce_trackTextureView(enc, rpdesc->colorAttachments[i].view, iur_color);
-    //}
-//
-    //for(uint32_t i = 0;i < rpdesc->colorAttachmentCount;i++){
-    //    if(rpdesc->colorAttachments[i].resolveTarget){
-    //        ce_trackTextureView(enc, rpdesc->colorAttachments[i].resolveTarget, iur_resolve);
-    //    }
-    //}
-
-    if(rpdesc->depthStencilAttachment){
-        wgvk_assert(rpdesc->depthStencilAttachment->view, "depthStencilAttachment.view is null");
-        ce_trackTextureView(enc, rpdesc->depthStencilAttachment->view, iur_depth);
+    #if VULKAN_USE_DYNAMIC_RENDERING == 1
+    ret->continuesRendering = enc->renderingOpen && RenderPass_continuesRendering(&enc->openRenderPass, &ret->beginInfo);
+    #endif
+    if(!ret->continuesRendering){
+        RenderPassEncoder_trackAttachments(ret);
     }
     //wgpuRenderPassEncoderSetViewport(ret, 0, 0, rpdesc->colorAttachments[0].view->width, rpdesc->colorAttachments[0].view->height, 0, 1);
     return ret;
     EXIT();
 }
 
-void wgpuRenderPassEncoderEnd(WGPURenderPassEncoder renderPassEncoder){
-    ENTRY();
-    
+static void RenderPassEncoder_beginRendering(WGPURenderPassEncoder renderPassEncoder, VkRenderingFlags renderingFlags){
     WGPUDevice device = renderPassEncoder->device;
     VkCommandBuffer destination = renderPassEncoder->cmdEncoder->buffer;
-    const size_t bufferSize = RenderPassCommandGenericVector_size(&renderPassEncoder->bufferedCommands);
-
     const RenderPassCommandBegin* beginInfo = &renderPassEncoder->beginInfo;
-
-    
-
-    VkImageView attachmentViews[2 * max_color_attachments + 2] = {0};// = (VkImageView* )RL_CALLOC(frp.allAttachments.size, sizeof(VkImageView) );
-    VkClearValue clearValues   [2 * max_color_attachments + 2] = {0};// = (VkClearValue*)RL_CALLOC(frp.allAttachments.size, sizeof(VkClearValue));
-
-    
-    
-
-    
-    VkRect2D renderPassRect = {
+    #if VULKAN_USE_DYNAMIC_RENDERING == 0
+    VkImageView attachmentViews[2 * max_color_attachments + 2] = {0};
+    VkClearValue clearValues   [2 * max_color_attachments + 2] = {0};
+    const VkRect2D renderPassRect = {
         .offset = {0, 0},
         .extent = {
-            beginInfo->colorAttachments[0].view->width, 
+            beginInfo->colorAttachments[0].view->width,
             beginInfo->colorAttachments[0].view->height
         }
     };
-
-    
-
-    
-
-
-    for(size_t i = 0;i < renderPassEncoder->bufferedCommands.size;i++){
-        const RenderPassCommandGeneric* cmd = &renderPassEncoder->bufferedCommands.data[i];
-        if(cmd->type == rp_command_type_set_bind_group){
-            const RenderPassCommandSetBindGroup* cmdSetBindGroup = &cmd->setBindGroup;
-            const WGPUBindGroup       group  = cmdSetBindGroup->group;
-            const WGPUBindGroupLayout layout = group->layout;
-            for(uint32_t bindingIndex = 0;bindingIndex < layout->entryCount;bindingIndex++){
-
-                wgvk_assert(group->entries[bindingIndex].binding == layout->entries[bindingIndex].binding, "Mismatch between layout and group, this will cause bugs.");
-                
-                const WGPUBindGroupEntry*       groupEntry  = &group ->entries[bindingIndex];
-                const WGPUBindGroupLayoutEntry* layoutEntry = &layout->entries[bindingIndex];
-
-                //uniform_type eType = layout->entries[bindingIndex].type;
-                if(layout->entries[bindingIndex].buffer.type != WGPUBufferBindingType_BindingNotUsed){
-                    wgvk_assert(group->entries[bindingIndex].buffer, "Layout indicates buffer but no buffer passed");
-                    WGPUShaderStage visibility = layout->entries[bindingIndex].visibility;
-                    wgvk_assert(visibility, "Empty visibility goddamnit");
-                    ce_trackBuffer(
-                        renderPassEncoder->cmdEncoder,
-                        group->entries[bindingIndex].buffer,
-                        (BufferUsageSnap){
-                            .access = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
-                            //.access = access_to_vk[layout->entries[bindingIndex].access], //TODO
-                            .stage = toVulkanPipelineStageBits(visibility)
-                        }
-                    );
-                }
-
-                else if(layout->entries[bindingIndex].texture.sampleType != WGPUTextureSampleType_BindingNotUsed){
-                    WGPUShaderStage visibility = layout->entries[bindingIndex].visibility;
-                    wgvk_assert(visibility, "Empty visibility goddamnit");
-                    if(visibility == 0){ //TODO: Get rid of this hack
-                        visibility = (WGPUShaderStage_Vertex | WGPUShaderStage_Fragment | WGPUShaderStage_Compute);
-                    }
-                    ce_trackTextureView(
-                        renderPassEncoder->cmdEncoder,
-                        group->entries[bindingIndex].textureView,
-                        (ImageUsageSnap){
-                            .layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-                            .access = VK_ACCESS_SHADER_READ_BIT,
-                            .stage = toVulkanPipelineStageBits(visibility)
-                        }
-                    );
-                }
-                else if(layout->entries[bindingIndex].storageTexture.access != WGPUStorageTextureAccess_BindingNotUsed){
-                    WGPUShaderStage visibility = layout->entries[bindingIndex].visibility;
-                    wgvk_assert(visibility, "Empty visibility goddamnit");
-                    if(visibility == 0){ //TODO: Get rid of this hack
-                        visibility = (WGPUShaderStage_Vertex | WGPUShaderStage_Fragment | WGPUShaderStage_Compute);
-                    }
-                    ce_trackTextureView(
-                        renderPassEncoder->cmdEncoder,
-                        group->entries[bindingIndex].textureView,
-                        (ImageUsageSnap){
-                            .layout = VK_IMAGE_LAYOUT_GENERAL,
-                            .access = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
-                            .stage = toVulkanPipelineStageBits(visibility)
-                        }
-                    );
-                }
-            }
-        }
-    }
-    #if VULKAN_USE_DYNAMIC_RENDERING == 0
     RenderPassLayout rplayout = GetRenderPassLayout2(beginInfo);
     LayoutedRenderPass frp = LoadRenderPassFromLayout(renderPassEncoder->device, rplayout);
     VkRenderPass vkrenderPass = frp.renderPass;
@@ -3564,7 +5353,7 @@ void wgpuRenderPassEncoderEnd(WGPURenderPassEncoder renderPassEncoder){
 
     const VkRenderingInfo info = {
         .sType = VK_STRUCTURE_TYPE_RENDERING_INFO,
-        //.flags = VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT | VK_RENDERING_CONTENTS_INLINE_BIT_KHR,
+        .flags = renderingFlags,
         .colorAttachmentCount = beginInfo->colorAttachmentCount,
         .pColorAttachments = colorAttachments,
         .pDepthAttachment = beginInfo->depthAttachmentPresent ? &(const VkRenderingAttachmentInfo){
@@ -3583,8 +5372,109 @@ void wgpuRenderPassEncoderEnd(WGPURenderPassEncoder renderPassEncoder){
     };
     device->functions.vkCmdBeginRendering(destination, &info);
     #endif
-    float ones[4] = {1,1,1,1};
-    device->functions.vkCmdSetBlendConstants(destination, ones);
+}
+
+void wgpuRenderPassEncoderEnd(WGPURenderPassEncoder renderPassEncoder){
+    ENTRY();
+    
+    WGPUDevice device = renderPassEncoder->device;
+    WGPUCommandEncoder encoder = renderPassEncoder->cmdEncoder;
+    CommandEncoder_flushCopies(encoder);
+    VkCommandBuffer destination = encoder->buffer;
+
+    const RenderPassCommandBegin* beginInfo = &renderPassEncoder->beginInfo;
+
+    for(size_t i = 0;i < renderPassEncoder->bufferedCommands.size;i++){
+        const RenderPassCommandGeneric* cmd = &renderPassEncoder->bufferedCommands.data[i];
+        if(cmd->type == rp_command_type_set_bind_group){
+            const RenderPassCommandSetBindGroup* cmdSetBindGroup = &cmd->setBindGroup;
+            const WGPUBindGroup       group  = cmdSetBindGroup->group;
+            const WGPUBindGroupLayout layout = group->layout;
+            for(uint32_t bindingIndex = 0;bindingIndex < layout->entryCount;bindingIndex++){
+
+                wgvk_assert(group->entries[bindingIndex].binding == layout->entries[bindingIndex].binding, "Mismatch between layout and group, this will cause bugs.");
+                
+                const WGPUBindGroupEntry*       groupEntry  = &group ->entries[bindingIndex];
+                const WGPUBindGroupLayoutEntry* layoutEntry = &layout->entries[bindingIndex];
+
+                //uniform_type eType = layout->entries[bindingIndex].type;
+                if(layout->entries[bindingIndex].buffer.type != WGPUBufferBindingType_BindingNotUsed){
+                    wgvk_assert(group->entries[bindingIndex].buffer, "Layout indicates buffer but no buffer passed");
+                    WGPUShaderStage visibility = layout->entries[bindingIndex].visibility;
+                    wgvk_assert(visibility, "Empty visibility goddamnit");
+                    ce_trackBuffer(
+                        renderPassEncoder->cmdEncoder,
+                        group->entries[bindingIndex].buffer,
+                        bindGroupBufferUsage(layoutEntry, group->entries + bindingIndex)
+                    );
+                }
+
+                else if(layout->entries[bindingIndex].texture.sampleType != WGPUTextureSampleType_BindingNotUsed){
+                    WGPUShaderStage visibility = layout->entries[bindingIndex].visibility;
+                    wgvk_assert(visibility, "Empty visibility goddamnit");
+                    if(visibility == 0){ //TODO: Get rid of this hack
+                        visibility = (WGPUShaderStage_Vertex | WGPUShaderStage_Fragment | WGPUShaderStage_Compute);
+                    }
+                    ce_trackTextureView(
+                        renderPassEncoder->cmdEncoder,
+                        group->entries[bindingIndex].textureView,
+                        (ImageUsageSnap){
+                            .layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                            .access = extractVkAccessFlags(layoutEntry),
+                            .stage = toVulkanPipelineStageBits(visibility)
+                        }
+                    );
+                }
+                else if(layout->entries[bindingIndex].storageTexture.access != WGPUStorageTextureAccess_BindingNotUsed){
+                    WGPUShaderStage visibility = layout->entries[bindingIndex].visibility;
+                    wgvk_assert(visibility, "Empty visibility goddamnit");
+                    if(visibility == 0){ //TODO: Get rid of this hack
+                        visibility = (WGPUShaderStage_Vertex | WGPUShaderStage_Fragment | WGPUShaderStage_Compute);
+                    }
+                    ce_trackTextureView(
+                        renderPassEncoder->cmdEncoder,
+                        group->entries[bindingIndex].textureView,
+                        (ImageUsageSnap){
+                            .layout = VK_IMAGE_LAYOUT_GENERAL,
+                            .access = extractVkAccessFlags(layoutEntry),
+                            .stage = toVulkanPipelineStageBits(visibility)
+                        }
+                    );
+                }
+            }
+        }
+    }
+    #if VULKAN_USE_DYNAMIC_RENDERING == 1
+    VkRenderingFlags renderingFlags = 0;
+    for(size_t i = 0;i < renderPassEncoder->bufferedCommands.size;i++){
+        const RenderPassCommandGeneric* cmd = renderPassEncoder->bufferedCommands.data + i;
+        if(cmd->type == rp_command_type_execute_renderbundle && cmd->executeRenderBundles.renderBundle->secondaryBuffer != VK_NULL_HANDLE){
+            renderingFlags = VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT | VK_RENDERING_CONTENTS_INLINE_BIT_KHR;
+            break;
+        }
+    }
+    // A pass that loads what the previous pass left in the same attachments continues its rendering instance
+    // if it needs no barrier, so the attachments do not have to be stored and loaded again in between
+    const bool merged = renderPassEncoder->continuesRendering
+        && encoder->renderingOpen
+        && (renderingFlags & ~encoder->openRenderingFlags) == 0
+        && CmdBarrierSet_empty(&encoder->pendingBarriers)
+        && encoder->pendingEventWaits.size == 0;
+    #else
+    const VkRenderingFlags renderingFlags = 0;
+    const bool merged = false;
+    #endif
+    if(!merged){
+        CommandEncoder_endRendering(encoder);
+        if(renderPassEncoder->continuesRendering){
+            RenderPassEncoder_trackAttachments(renderPassEncoder);
+        }
+        // Everything the pass tracked while it was encoded, recorded in front of it as one barrier
+        CommandEncoder_flushBarriers(encoder);
+        RenderPassEncoder_beginRendering(renderPassEncoder, renderingFlags);
+    }
+    device->functions.vkCmdSetBlendConstants(destination, passDefaultBlendConstants);
+    device->functions.vkCmdSetStencilReference(destination, VK_STENCIL_FACE_FRONT_AND_BACK, 0);
     const float vpWidth = (float)beginInfo->colorAttachments[0].view->width;
     const float vpHeight = (float)beginInfo->colorAttachments[0].view->height;
     
@@ -3631,7 +5521,12 @@ void wgpuRenderPassEncoderEnd(WGPURenderPassEncoder renderPassEncoder){
     //}
 
     #if VULKAN_USE_DYNAMIC_RENDERING == 1
-    device->functions.vkCmdEndRendering(destination);
+    // Ended by CommandEncoder_endRendering once something else is recorded
+    if(!merged){
+        encoder->renderingOpen = true;
+        encoder->openRenderPass = renderPassEncoder->beginInfo;
+        encoder->openRenderingFlags = renderingFlags;
+    }
     #else
     device->functions.vkCmdEndRenderPass(destination);
     #endif
@@ -3652,6 +5547,15 @@ WGPUCommandBuffer wgpuCommandEncoderFinish(WGPUCommandEncoder commandEncoder, co
     ret->refCount = 1;
     wgvk_assert(commandEncoder->movedFrom == 0, "Command encoder is already invalidated");
     commandEncoder->movedFrom = 1;
+    CommandEncoder_flushCopies(commandEncoder);
+    // Nothing follows the last command, so it needs no event
+    commandEncoder->previousWriteStages = 0;
+    CommandEncoder_flushBarriers(commandEncoder);
+    CommandEncoder_freeCopies(commandEncoder);
+    CmdBarrierSet_free(&commandEncoder->pendingBarriers);
+    SplitEventWaitVector_free(&commandEncoder->pendingEventWaits);
+    ret->splitEvents = commandEncoder->splitEvents;
+    SplitEventVector_init(&commandEncoder->splitEvents);
     commandEncoder->device->functions.vkEndCommandBuffer(commandEncoder->buffer);
 
     WGPURenderPassEncoderSet_move(&ret->referencedRPs, &commandEncoder->referencedRPs);
@@ -3659,6 +5563,7 @@ WGPUCommandBuffer wgpuCommandEncoderFinish(WGPUCommandEncoder commandEncoder, co
     WGPURaytracingPassEncoderSet_move(&ret->referencedRTs, &commandEncoder->referencedRTs);
     ResourceUsage_move(&ret->resourceUsage, &commandEncoder->resourceUsage);
     ret->cacheIndex = commandEncoder->cacheIndex;
+    ret->commandPool = commandEncoder->commandPool;
     ret->buffer = commandEncoder->buffer;
     ret->device = commandEncoder->device;
     commandEncoder->buffer = NULL;
@@ -3671,6 +5576,27 @@ WGPUCommandBuffer wgpuCommandEncoderFinish(WGPUCommandEncoder commandEncoder, co
     EXIT();
 }
 
+static void reapplyPassDynamicState(CommandBufferAndSomeState* destination, const RenderPassCommandBegin* beginInfo){
+    WGPUDevice device = destination->device;
+    const DefaultDynamicState* state = &destination->dynamicState;
+    const float vpWidth  = (float)beginInfo->colorAttachments[0].view->width;
+    const float vpHeight = (float)beginInfo->colorAttachments[0].view->height;
+    VkViewport viewport = state->viewport;
+    if(viewport.width == 0 && viewport.height == 0){
+        viewport = (VkViewport){0, vpHeight, vpWidth, -vpHeight, 0, 1};
+    }
+    VkRect2D scissor = state->scissorRect;
+    if(scissor.extent.width == UINT32_MAX){
+        scissor = (VkRect2D){{0, 0}, {(uint32_t)vpWidth, (uint32_t)vpHeight}};
+    }
+    for(uint32_t i = 0;i < beginInfo->colorAttachmentCount;i++){
+        device->functions.vkCmdSetViewport(destination->buffer, i, 1, &viewport);
+        device->functions.vkCmdSetScissor (destination->buffer, i, 1, &scissor);
+    }
+    device->functions.vkCmdSetBlendConstants(destination->buffer, state->blendConstants);
+    device->functions.vkCmdSetStencilReference(destination->buffer, VK_STENCIL_FACE_FRONT_AND_BACK, state->stencilReference);
+}
+
 void recordVkCommand(CommandBufferAndSomeState* destination_, const RenderPassCommandGeneric* command, const RenderPassCommandBegin *beginInfo){
     VkCommandBuffer destinationVk = destination_->buffer;
     WGPUDevice device = destination_->device;
@@ -3701,11 +5627,12 @@ void recordVkCommand(CommandBufferAndSomeState* destination_, const RenderPassCo
         break;
         case rp_command_type_set_stencil_reference: {
             const RenderPassCommandSetStencilReference* setStencilReference = &command->setStencilReference;
-            //device->functions.vkCmdSetStencilReference(
-            //    destinationVk,
-            //    VK_STENCIL_FACE_FRONT_BIT | VK_STENCIL_FACE_BACK_BIT,
-            //    setStencilReference->reference
-            //);
+            destination_->dynamicState.stencilReference = setStencilReference->reference;
+            device->functions.vkCmdSetStencilReference(
+                destinationVk,
+                VK_STENCIL_FACE_FRONT_AND_BACK,
+                setStencilReference->reference
+            );
         }break;
         case rp_command_type_set_blend_constant:{
             const RenderPassCommandSetBlendConstant* setBlendConstant = &command->setBlendConstant;
@@ -3715,6 +5642,7 @@ void recordVkCommand(CommandBufferAndSomeState* destination_, const RenderPassCo
                 (float)setBlendConstant->color.b,
                 (float)setBlendConstant->color.a,
             };
+            memcpy(destination_->dynamicState.blendConstants, buffer, sizeof(buffer));
             device->functions.vkCmdSetBlendConstants(
                 destinationVk,
                 buffer
@@ -3802,6 +5730,7 @@ void recordVkCommand(CommandBufferAndSomeState* destination_, const RenderPassCo
                 destination_->graphicsBindGroups[setBindGroup->groupIndex] = setBindGroup->group;
             else
                 destination_->computeBindGroups[setBindGroup->groupIndex] = setBindGroup->group;
+            BindGroup_refreshBackings(setBindGroup->group);
             if(destination_->lastLayout){
                 device->functions.vkCmdBindDescriptorSets(
                     destinationVk,
@@ -3909,70 +5838,21 @@ void recordVkCommand(CommandBufferAndSomeState* destination_, const RenderPassCo
         case rp_command_type_execute_renderbundle:{
             const RenderPassCommandExecuteRenderbundles* executeRenderBundles = &command->executeRenderBundles;
             WGPURenderBundle bundle = executeRenderBundles->renderBundle;
-            DefaultDynamicState ds = destination_->dynamicState;
-            VkCommandBuffer* maybeBuffer = DynamicStateCommandBufferMap_get(&bundle->encodedCommandBuffers, ds);
-            VkCommandBuffer executedBuffer;
-            #if RENDERBUNDLES_AS_SECONDARY_COMMANDBUFFERS == 1
-            if(maybeBuffer){
-                executedBuffer = *maybeBuffer;
+            if(bundle->secondaryBuffer != VK_NULL_HANDLE && RenderBundle_matchesDynamicState(&destination_->dynamicState)){
+                device->functions.vkCmdExecuteCommands(destinationVk, 1, &bundle->secondaryBuffer);
+                // The primary's bindings and dynamic state are undefined after vkCmdExecuteCommands
+                destination_->lastLayout = VK_NULL_HANDLE;
+                memset((void*)destination_->vertexBuffers, 0, sizeof(destination_->vertexBuffers));
+                destination_->indexBuffer = NULL;
+                memset((void*)destination_->graphicsBindGroups, 0, sizeof(destination_->graphicsBindGroups));
+                reapplyPassDynamicState(destination_, beginInfo);
             }
             else{
-                VkCommandBufferAllocateInfo bai = {
-                    .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
-                    .commandPool = device->secondaryCommandPool,
-                    .level = VK_COMMAND_BUFFER_LEVEL_SECONDARY,
-                    .commandBufferCount = 1
-                };
-                device->functions.vkAllocateCommandBuffers(device->device, &bai, &executedBuffer);
-                
-                VkCommandBufferInheritanceRenderingInfo renderingInfo = {
-                    .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO,
-                    .colorAttachmentCount = bundle->colorAttachmentCount,
-                    .pColorAttachmentFormats = bundle->colorAttachmentFormats,
-                    .depthAttachmentFormat = bundle->depthStencilFormat,
-                    .stencilAttachmentFormat = bundle->depthStencilFormat,
-                    .rasterizationSamples = 1 // todo
-                };
-            
-                VkCommandBufferInheritanceInfo inheritanceInfo = {
-                    .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
-                    .pNext = &renderingInfo,
-                };
-            
-                VkCommandBufferBeginInfo beginInfo = {
-                    .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-                    .flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT,
-                    .pInheritanceInfo = &inheritanceInfo
-                };
-                device->functions.vkBeginCommandBuffer(executedBuffer, &beginInfo);
                 RenderPassCommandBegin dummyBeginInfo = {
                     .colorAttachmentCount = bundle->colorAttachmentCount
                 };
-                
-                for(uint32_t ai = 0;ai < bundle->colorAttachmentCount;ai++){
-                    device->functions.vkCmdSetViewport(executedBuffer, 0, 1, &ds.viewport   );
-                    if(ds.scissorRect.extent.width != UINT32_MAX){
-                        device->functions.vkCmdSetScissor (executedBuffer, 0, 1, &ds.scissorRect);
-                    }
-                    else{
-                        VkRect2D defaultRect = {
-                            .offset = {0, 0},
-                            .extent = {ds.viewport.width, ds.viewport.height}
-                        };
-                        device->functions.vkCmdSetScissor (executedBuffer, 0, 1, &defaultRect);
-                    }
-                }
-                recordVkCommands(executedBuffer, device, &bundle->bufferedCommands, &dummyBeginInfo);
-                device->functions.vkEndCommandBuffer(executedBuffer);
-                DynamicStateCommandBufferMap_put(&bundle->encodedCommandBuffers, ds, executedBuffer);
+                recordVkCommands(destination_->cmdEncoder, device, &bundle->bufferedCommands, &dummyBeginInfo);
             }
-            device->functions.vkCmdExecuteCommands(destination, 1, &executedBuffer);
-            #else
-            RenderPassCommandBegin dummyBeginInfo = {
-                .colorAttachmentCount = bundle->colorAttachmentCount
-            };
-            recordVkCommands(destination_->cmdEncoder, device, &bundle->bufferedCommands, &dummyBeginInfo);
-            #endif
         }break;
         case cp_command_type_set_compute_pipeline: {
             const ComputePassCommandSetPipeline* setComputePipeline = &command->setComputePipeline;
@@ -3999,14 +5879,12 @@ void recordVkCommand(CommandBufferAndSomeState* destination_, const RenderPassCo
                             if(group->layout->entries[bglEntryIndex].binding == entry->binding)break;
                         }
                         if(entry->buffer){
-                            ce_trackBuffer(destination_->cmdEncoder, entry->buffer, (BufferUsageSnap){
-                                .access = extractVkAccessFlags(group->layout->entries + bglEntryIndex),
-                                .stage  = toVulkanPipelineStageBits(group->layout->entries[bglEntryIndex].visibility)
-                            });
+                            ce_trackBuffer(destination_->cmdEncoder, entry->buffer, bindGroupBufferUsage(group->layout->entries + bglEntryIndex, entry));
                         }
                     }
                 }
             }
+            CommandEncoder_flushBarriers(destination_->cmdEncoder);
             device->functions.vkCmdDispatch(
                 destinationVk, 
                 dispatch->x, 
@@ -4027,10 +5905,7 @@ void recordVkCommand(CommandBufferAndSomeState* destination_, const RenderPassCo
                             if(group->layout->entries[bglEntryIndex].binding == entry->binding)break;
                         }
                         if(entry->buffer){
-                            ce_trackBuffer(destination_->cmdEncoder, entry->buffer, (BufferUsageSnap){
-                                .access = extractVkAccessFlags(group->layout->entries + bglEntryIndex),
-                                .stage  = toVulkanPipelineStageBits(group->layout->entries[bglEntryIndex].visibility)
-                            });
+                            ce_trackBuffer(destination_->cmdEncoder, entry->buffer, bindGroupBufferUsage(group->layout->entries + bglEntryIndex, entry));
                         }
                     }
                 }
@@ -4040,9 +5915,9 @@ void recordVkCommand(CommandBufferAndSomeState* destination_, const RenderPassCo
 
             ce_trackBuffer(destination_->cmdEncoder, dispatch->buffer, (BufferUsageSnap){
                 .access = VK_ACCESS_INDIRECT_COMMAND_READ_BIT,
-                .stage  = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT
+                .stage  = VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT
             });
-            
+            CommandEncoder_flushBarriers(destination_->cmdEncoder);
             device->functions.vkCmdDispatchIndirect(
                 destinationVk,
                 dispatch->buffer->buffer,
@@ -4059,10 +5934,72 @@ void recordVkCommand(CommandBufferAndSomeState* destination_, const RenderPassCo
 
         }break;
         case rp_command_type_multi_draw_indexed_indirect:{
-
+            const RenderPassCommandMultiDrawIndexedIndirect* multiDraw = &command->multiDrawIndexedIndirect;
+            if(multiDraw->drawCountBuffer){
+                device->functions.vkCmdDrawIndexedIndirectCount(
+                    destinationVk,
+                    multiDraw->indirectBuffer->buffer,
+                    multiDraw->indirectOffset,
+                    multiDraw->drawCountBuffer->buffer,
+                    multiDraw->drawCountBufferOffset,
+                    multiDraw->maxDrawCount,
+                    sizeof(VkDrawIndexedIndirectCommand)
+                );
+            }
+            else if(device->capabilities.multiDrawIndirect){
+                device->functions.vkCmdDrawIndexedIndirect(
+                    destinationVk,
+                    multiDraw->indirectBuffer->buffer,
+                    multiDraw->indirectOffset,
+                    multiDraw->maxDrawCount,
+                    sizeof(VkDrawIndexedIndirectCommand)
+                );
+            }
+            else{
+                for(uint32_t i = 0;i < multiDraw->maxDrawCount;i++){
+                    device->functions.vkCmdDrawIndexedIndirect(
+                        destinationVk,
+                        multiDraw->indirectBuffer->buffer,
+                        multiDraw->indirectOffset + i * sizeof(VkDrawIndexedIndirectCommand),
+                        1,
+                        sizeof(VkDrawIndexedIndirectCommand)
+                    );
+                }
+            }
         }break;
         case rp_command_type_multi_draw_indirect:{
-
+            const RenderPassCommandMultiDrawIndirect* multiDraw = &command->multiDrawIndirect;
+            if(multiDraw->drawCountBuffer){
+                device->functions.vkCmdDrawIndirectCount(
+                    destinationVk,
+                    multiDraw->indirectBuffer->buffer,
+                    multiDraw->indirectOffset,
+                    multiDraw->drawCountBuffer->buffer,
+                    multiDraw->drawCountBufferOffset,
+                    multiDraw->maxDrawCount,
+                    sizeof(VkDrawIndirectCommand)
+                );
+            }
+            else if(device->capabilities.multiDrawIndirect){
+                device->functions.vkCmdDrawIndirect(
+                    destinationVk,
+                    multiDraw->indirectBuffer->buffer,
+                    multiDraw->indirectOffset,
+                    multiDraw->maxDrawCount,
+                    sizeof(VkDrawIndirectCommand)
+                );
+            }
+            else{
+                for(uint32_t i = 0;i < multiDraw->maxDrawCount;i++){
+                    device->functions.vkCmdDrawIndirect(
+                        destinationVk,
+                        multiDraw->indirectBuffer->buffer,
+                        multiDraw->indirectOffset + i * sizeof(VkDrawIndirectCommand),
+                        1,
+                        sizeof(VkDrawIndirectCommand)
+                    );
+                }
+            }
         }break;
     
         case rp_command_type_set_force32: // fallthrough
@@ -4071,137 +6008,591 @@ void recordVkCommand(CommandBufferAndSomeState* destination_, const RenderPassCo
     }
 }
 
+static WGPUBuffer PerframeCache_acquireBatchBuffer(WGPUDevice device, PerframeCache* pfcache){
+    WGPUBuffer ret = NULL;
+    wgvk_mutex_lock(pfcache->batchBuffersMutex);
+    if(!WGPUBufferVector_empty(&pfcache->unusedBatchBuffers)){
+        ret = pfcache->unusedBatchBuffers.data[pfcache->unusedBatchBuffers.size - 1];
+        WGPUBufferVector_pop_back(&pfcache->unusedBatchBuffers);
+    }
+    else{
+        const WGPUBufferDescriptor bdesc = {
+            .label = STRVIEW("Transient batch buffer"),
+            .size = WGVK_BATCH_BUFFER_SIZE,
+            .usage = WGPUBufferUsage_Indirect | WGPUBufferUsage_CopyDst,
+        };
+        ret = Device_createBuffer(device, &bdesc, false);
+    }
+    if(ret){
+        // Moved back to unusedBatchBuffers by wgpuDeviceTick once no command buffer references it anymore
+        WGPUBufferVector_push_back(&pfcache->usedBatchBuffers, ret);
+    }
+    wgvk_mutex_unlock(pfcache->batchBuffersMutex);
+    return ret;
+}
+
+/**
+ * @brief Length of the run of draws starting at commands[begin] that can be issued as one multi-draw
+ * @details Consecutive draws share all bound state by construction, since any state change is a command in between.
+ * vkCmdDrawMulti*EXT takes a single instanceCount/firstInstance, the indirect fallback needs drawIndirectFirstInstance for nonzero firstInstance.
+ */
+static size_t coalescableDrawRunLength(WGPUDevice device, const RenderPassCommandGenericVector* commands, size_t begin){
+    const RenderPassCommandGeneric* first = commands->data + begin;
+    if(first->type != rp_command_type_draw && first->type != rp_command_type_draw_indexed){
+        return 1;
+    }
+    const bool multiDraw = device->capabilities.multiDraw;
+    if(!multiDraw && !device->capabilities.multiDrawIndirect){
+        return 1;
+    }
+    const bool indexed = first->type == rp_command_type_draw_indexed;
+    const uint32_t instanceCount = indexed ? first->drawIndexed.instanceCount : first->draw.instanceCount;
+    const uint32_t firstInstance = indexed ? first->drawIndexed.firstInstance : first->draw.firstInstance;
+    if(!multiDraw && firstInstance != 0 && !device->capabilities.drawIndirectFirstInstance){
+        return 1;
+    }
+    size_t end = begin + 1;
+    for(;end < commands->size;end++){
+        const RenderPassCommandGeneric* cmd = commands->data + end;
+        if(cmd->type != first->type){
+            break;
+        }
+        const uint32_t ic = indexed ? cmd->drawIndexed.instanceCount : cmd->draw.instanceCount;
+        const uint32_t fi = indexed ? cmd->drawIndexed.firstInstance : cmd->draw.firstInstance;
+        if(multiDraw ? (ic != instanceCount || fi != firstInstance) : (fi != 0 && !device->capabilities.drawIndirectFirstInstance)){
+            break;
+        }
+    }
+    const size_t runLength = end - begin;
+    // Writing a transient indirect buffer only pays off for longer runs
+    if(!multiDraw && runLength < WGVK_MIN_INDIRECT_COALESCED_DRAWS){
+        return 1;
+    }
+    return runLength;
+}
+
+static void recordCoalescedDraws(CommandBufferAndSomeState* destination, const RenderPassCommandGeneric* draws, size_t drawCount, const RenderPassCommandBegin* beginInfo){
+    WGPUDevice device = destination->device;
+    VkCommandBuffer destinationVk = destination->buffer;
+    const bool indexed = draws[0].type == rp_command_type_draw_indexed;
+
+    if(device->capabilities.multiDraw){
+        #define MULTIDRAW_CHUNK 128
+        const uint32_t maxChunk = device->capabilities.maxMultiDrawCount < MULTIDRAW_CHUNK ? device->capabilities.maxMultiDrawCount : MULTIDRAW_CHUNK;
+        for(size_t base = 0;base < drawCount;base += maxChunk){
+            const uint32_t chunk = (uint32_t)((drawCount - base) < maxChunk ? (drawCount - base) : maxChunk);
+            if(indexed){
+                VkMultiDrawIndexedInfoEXT infos[MULTIDRAW_CHUNK];
+                for(uint32_t i = 0;i < chunk;i++){
+                    const RenderPassCommandDrawIndexed* di = &draws[base + i].drawIndexed;
+                    infos[i] = (VkMultiDrawIndexedInfoEXT){
+                        .firstIndex = di->firstIndex,
+                        .indexCount = di->indexCount,
+                        .vertexOffset = di->baseVertex
+                    };
+                }
+                device->functions.vkCmdDrawMultiIndexedEXT(destinationVk, chunk, infos, draws[base].drawIndexed.instanceCount, draws[base].drawIndexed.firstInstance, sizeof(VkMultiDrawIndexedInfoEXT), NULL);
+            }
+            else{
+                VkMultiDrawInfoEXT infos[MULTIDRAW_CHUNK];
+                for(uint32_t i = 0;i < chunk;i++){
+                    const RenderPassCommandDraw* d = &draws[base + i].draw;
+                    infos[i] = (VkMultiDrawInfoEXT){
+                        .firstVertex = d->firstVertex,
+                        .vertexCount = d->vertexCount
+                    };
+                }
+                device->functions.vkCmdDrawMultiEXT(destinationVk, chunk, infos, draws[base].draw.instanceCount, draws[base].draw.firstInstance, sizeof(VkMultiDrawInfoEXT));
+            }
+        }
+        #undef MULTIDRAW_CHUNK
+        return;
+    }
+
+    // Bundle secondaries outlive the per-frame batch buffers
+    if(destination->cmdEncoder == NULL){
+        for(size_t i = 0;i < drawCount;i++){
+            recordVkCommand(destination, draws + i, beginInfo);
+        }
+        return;
+    }
+    WGPUCommandEncoder encoder = destination->cmdEncoder;
+    const uint32_t stride = indexed ? sizeof(VkDrawIndexedIndirectCommand) : sizeof(VkDrawIndirectCommand);
+    for(size_t base = 0;base < drawCount;){
+        // Runs are sub-allocated from the encoder's batch buffer, a new one is only taken once it is full.
+        // Both strides are multiples of 4, as indirect offsets have to be
+        uint64_t offset = encoder->batchBufferOffset;
+        if(encoder->batchBuffer == NULL || offset + stride > WGVK_BATCH_BUFFER_SIZE){
+            encoder->batchBuffer = PerframeCache_acquireBatchBuffer(device, DeviceGetFIFCache(device, encoder->cacheIndex));
+            encoder->batchBufferOffset = 0;
+            offset = 0;
+            if(encoder->batchBuffer != NULL){
+                ru_trackBuffer(&encoder->resourceUsage, encoder->batchBuffer, (BufferUsageRecord){0});
+            }
+        }
+        WGPUBuffer batchBuffer = encoder->batchBuffer;
+        const size_t fitting = (size_t)((WGVK_BATCH_BUFFER_SIZE - offset) / stride);
+        const uint32_t chunk = (uint32_t)((drawCount - base) < fitting ? (drawCount - base) : fitting);
+        if(batchBuffer == NULL || !(batchBuffer->memoryProperties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)){
+            for(size_t i = base;i < drawCount;i++){
+                recordVkCommand(destination, draws + i, beginInfo);
+            }
+            return;
+        }
+        void* mappedBuffer = NULL;
+        wgpuBufferMap(batchBuffer, WGPUMapMode_Write, 0, WGPU_WHOLE_SIZE, &mappedBuffer);
+        void* mapped = (uint8_t*)mappedBuffer + offset;
+        if(indexed){
+            VkDrawIndexedIndirectCommand* out = (VkDrawIndexedIndirectCommand*)mapped;
+            for(uint32_t i = 0;i < chunk;i++){
+                const RenderPassCommandDrawIndexed* di = &draws[base + i].drawIndexed;
+                out[i] = (VkDrawIndexedIndirectCommand){di->indexCount, di->instanceCount, di->firstIndex, di->baseVertex, di->firstInstance};
+            }
+        }
+        else{
+            VkDrawIndirectCommand* out = (VkDrawIndirectCommand*)mapped;
+            for(uint32_t i = 0;i < chunk;i++){
+                const RenderPassCommandDraw* d = &draws[base + i].draw;
+                out[i] = (VkDrawIndirectCommand){d->vertexCount, d->instanceCount, d->firstVertex, d->firstInstance};
+            }
+        }
+        wgpuBufferUnmap(batchBuffer);
+        // Host writes before vkQueueSubmit are visible to the device, so no barrier is needed here
+        if(indexed){
+            device->functions.vkCmdDrawIndexedIndirect(destinationVk, batchBuffer->buffer, offset, chunk, stride);
+        }
+        else{
+            device->functions.vkCmdDrawIndirect(destinationVk, batchBuffer->buffer, offset, chunk, stride);
+        }
+        encoder->batchBufferOffset = offset + (uint64_t)chunk * stride;
+        base += chunk;
+    }
+}
+
+static void recordVkCommandsInto(CommandBufferAndSomeState* cal, const RenderPassCommandGenericVector* commands, const RenderPassCommandBegin WGPU_NULLABLE *beginInfo){
+    for(size_t i = 0;i < commands->size;){
+        const size_t runLength = coalescableDrawRunLength(cal->device, commands, i);
+        if(runLength > 1){
+            recordCoalescedDraws(cal, commands->data + i, runLength, beginInfo);
+            i += runLength;
+            continue;
+        }
+        const RenderPassCommandGeneric* cmd = RenderPassCommandGenericVector_get((RenderPassCommandGenericVector*)commands, i);
+        recordVkCommand(cal, cmd, beginInfo);
+        ++i;
+    }
+}
+
 void recordVkCommands(WGPUCommandEncoder destination, WGPUDevice device, const RenderPassCommandGenericVector* commands, const RenderPassCommandBegin WGPU_NULLABLE *beginInfo){
     CommandBufferAndSomeState cal = {
         .cmdEncoder = destination,
         .buffer = destination->buffer,
         .device = device,
         .lastLayout = VK_NULL_HANDLE,
-        .dynamicState.scissorRect = {
-            .offset = {UINT32_MAX, UINT32_MAX},
-            .extent = {UINT32_MAX, UINT32_MAX},
-        }
+        .dynamicState = passDefaultDynamicState(),
     };
+    recordVkCommandsInto(&cal, commands, beginInfo);
+}
+
+#if RENDERBUNDLES_AS_SECONDARY_COMMANDBUFFERS == 1 && VULKAN_USE_DYNAMIC_RENDERING == 1
+// The secondary command buffer bakes in VkBuffer handles, so wgpuQueueWriteBuffer must not swap their backings anymore
+static void RenderBundle_pinBackings(WGPURenderBundle bundle){
+    for(size_t i = 0;i < bundle->bufferedCommands.size;i++){
+        const RenderPassCommandGeneric* cmd = bundle->bufferedCommands.data + i;
+        switch(cmd->type){
+            case rp_command_type_set_vertex_buffer: cmd->setVertexBuffer.buffer->backingPinned = VK_TRUE; break;
+            case rp_command_type_set_index_buffer: cmd->setIndexBuffer.buffer->backingPinned = VK_TRUE; break;
+            case rp_command_type_draw_indirect: cmd->drawIndirect.indirectBuffer->backingPinned = VK_TRUE; break;
+            case rp_command_type_draw_indexed_indirect: cmd->drawIndexedIndirect.indirectBuffer->backingPinned = VK_TRUE; break;
+            case rp_command_type_multi_draw_indirect:
+                cmd->multiDrawIndirect.indirectBuffer->backingPinned = VK_TRUE;
+                if(cmd->multiDrawIndirect.drawCountBuffer)
+                    cmd->multiDrawIndirect.drawCountBuffer->backingPinned = VK_TRUE;
+            break;
+            case rp_command_type_multi_draw_indexed_indirect:
+                cmd->multiDrawIndexedIndirect.indirectBuffer->backingPinned = VK_TRUE;
+                if(cmd->multiDrawIndexedIndirect.drawCountBuffer)
+                    cmd->multiDrawIndexedIndirect.drawCountBuffer->backingPinned = VK_TRUE;
+            break;
+            case rp_command_type_set_bind_group:{
+                const WGPUBindGroup group = cmd->setBindGroup.group;
+                for(uint32_t e = 0;e < group->entryCount;e++){
+                    if(group->entries[e].buffer)
+                        group->entries[e].buffer->backingPinned = VK_TRUE;
+                }
+            }break;
+            default: break;
+        }
+    }
+}
 
-    for(size_t i = 0;i < commands->size;i++){
-        const RenderPassCommandGeneric* cmd = RenderPassCommandGenericVector_get((RenderPassCommandGenericVector*)commands, i);
-        recordVkCommand(&cal, cmd, beginInfo);
+static void RenderBundle_recordSecondary(WGPURenderBundle bundle){
+    WGPUDevice device = bundle->device;
+    if(!device->capabilities.inheritedViewportScissor || !device->capabilities.mixedRenderingContents){
+        return;
+    }
+    // Only this thread ever allocates from or records into its pool, so bundles can be finished on any number of threads
+    bundle->secondaryPool = Device_getBundleCommandPool(device);
+    bundle->secondaryBuffer = ThreadCommandPool_acquire(device, bundle->secondaryPool);
+    if(bundle->secondaryBuffer == VK_NULL_HANDLE){
+        ThreadCommandPool_release(bundle->secondaryPool, VK_NULL_HANDLE);
+        bundle->secondaryPool = NULL;
+        return;
     }
+    const uint32_t viewportCount = bundle->colorAttachmentCount ? bundle->colorAttachmentCount : 1;
+    VkViewport viewportDepths[MAX_COLOR_ATTACHMENTS];
+    for(uint32_t i = 0;i < MAX_COLOR_ATTACHMENTS;i++){
+        viewportDepths[i] = (VkViewport){.minDepth = 0, .maxDepth = 1};
+    }
+    const VkCommandBufferInheritanceViewportScissorInfoNV viewportScissorInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_VIEWPORT_SCISSOR_INFO_NV,
+        .viewportScissor2D = VK_TRUE,
+        .viewportDepthCount = viewportCount,
+        .pViewportDepths = viewportDepths,
+    };
+    const VkCommandBufferInheritanceRenderingInfo renderingInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO,
+        .pNext = &viewportScissorInfo,
+        .colorAttachmentCount = bundle->colorAttachmentCount,
+        .pColorAttachmentFormats = bundle->colorAttachmentFormats,
+        .depthAttachmentFormat = bundle->depthStencilFormat,
+        // Render passes never bind a separate stencil attachment
+        .stencilAttachmentFormat = VK_FORMAT_UNDEFINED,
+        .rasterizationSamples = (VkSampleCountFlagBits)(bundle->sampleCount ? bundle->sampleCount : 1),
+    };
+    const VkCommandBufferInheritanceInfo inheritanceInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+        .pNext = &renderingInfo,
+    };
+    const VkCommandBufferBeginInfo beginInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT,
+        .pInheritanceInfo = &inheritanceInfo
+    };
+    device->functions.vkBeginCommandBuffer(bundle->secondaryBuffer, &beginInfo);
+    device->functions.vkCmdSetBlendConstants(bundle->secondaryBuffer, passDefaultBlendConstants);
+    device->functions.vkCmdSetStencilReference(bundle->secondaryBuffer, VK_STENCIL_FACE_FRONT_AND_BACK, 0);
+
+    const RenderPassCommandBegin dummyBeginInfo = {
+        .colorAttachmentCount = bundle->colorAttachmentCount
+    };
+    CommandBufferAndSomeState cal = {
+        .cmdEncoder = NULL,
+        .buffer = bundle->secondaryBuffer,
+        .device = device,
+        .lastLayout = VK_NULL_HANDLE,
+        .dynamicState = passDefaultDynamicState(),
+    };
+    RenderBundle_pinBackings(bundle);
+    recordVkCommandsInto(&cal, &bundle->bufferedCommands, &dummyBeginInfo);
+    device->functions.vkEndCommandBuffer(bundle->secondaryBuffer);
 }
+#endif
 
-void registerTransitionCallback(void* texture_, ImageUsageRecord* record, void* pscache_){
-    WGPUTexture texture = (WGPUTexture)texture_;
-    WGPUDevice device = texture->device;
-    WGPUCommandEncoder pscache = (WGPUCommandEncoder)pscache_;
-    VkImageMemoryBarrier barrier = {
-        VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
-        NULL,
-        VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT,
-        VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT,
-        texture->layout,
-        record->initialLayout,
-        pscache->device->adapter->queueIndices.graphicsIndex,
-        pscache->device->adapter->queueIndices.graphicsIndex,
-        texture->image,
-        (VkImageSubresourceRange){
-            is__depthVk(texture->format) ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT,
-            0,
-            VK_REMAINING_MIP_LEVELS,
-            0,
-            VK_REMAINING_ARRAY_LAYERS
-        }
+DEFINE_VECTOR_WITH_INLINE_STORAGE(static inline, SubresourceState, SubresourceStateILVector, 8);
+
+static inline uint32_t Texture_arrayLayerCount(WGPUTexture texture){
+    return texture->dimension == VK_IMAGE_TYPE_3D ? 1 : texture->depthOrArrayLayers;
+}
+
+// The block of subresources a range covers, with VK_REMAINING_* resolved against the texture
+static SubresourceState Texture_subresources(WGPUTexture texture, const VkImageSubresourceRange* range){
+    return (SubresourceState){
+        .baseMipLevel = range->baseMipLevel,
+        .levelCount = range->levelCount == VK_REMAINING_MIP_LEVELS ? texture->mipLevels - range->baseMipLevel : range->levelCount,
+        .baseArrayLayer = range->baseArrayLayer,
+        .layerCount = range->layerCount == VK_REMAINING_ARRAY_LAYERS ? Texture_arrayLayerCount(texture) - range->baseArrayLayer : range->layerCount,
     };
-    device->functions.vkCmdPipelineBarrier(
-        pscache->buffer,
-        VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
-        VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
-        0,
-        0, NULL,
-        0, NULL,
-        1, &barrier
-    );
-    //ce_trackTexture(pscache, texture, artificial);
 }
 
+static VkImageSubresourceRange Texture_subresourceRange(WGPUTexture texture, const SubresourceState* block){
+    return (VkImageSubresourceRange){
+        .aspectMask = toVulkanAspectMaskVk(WGPUTextureAspect_All, texture->format),
+        .baseMipLevel = block->baseMipLevel,
+        .levelCount = block->levelCount,
+        .baseArrayLayer = block->baseArrayLayer,
+        .layerCount = block->layerCount,
+    };
+}
 
-DEFINE_VECTOR(static inline, VkBufferMemoryBarrier, VkBufferMemoryBarrierVector)
-DEFINE_VECTOR(static inline, VkMemoryBarrier, VkMemoryBarrierVector)
-DEFINE_VECTOR(static inline, VkImageMemoryBarrier, VkImageMemoryBarrierVector)
-typedef struct CmdBarrierSet{
-    VkPipelineStageFlags srcStage;
-    VkPipelineStageFlags dstStage;
-    VkBufferMemoryBarrierVector bufferBarriers;
-    VkMemoryBarrierVector memoryBarriers;
-    VkImageMemoryBarrierVector imageBarriers;
-}CmdBarrierSet;
+static inline bool SubresourceState_sameUse(const SubresourceState* a, const SubresourceState* b){
+    return a->layout == b->layout && a->stage == b->stage && a->access == b->access;
+}
 
-static void CmdBarrierSet_init(CmdBarrierSet* set){
-    VkBufferMemoryBarrierVector_init(&set->bufferBarriers);
-    VkMemoryBarrierVector_init(&set->memoryBarriers);
-    VkImageMemoryBarrierVector_init(&set->imageBarriers);
+static inline bool SubresourceState_overlaps(const SubresourceState* a, const SubresourceState* b){
+    return a->baseMipLevel   < b->baseMipLevel   + b->levelCount && b->baseMipLevel   < a->baseMipLevel   + a->levelCount
+        && a->baseArrayLayer < b->baseArrayLayer + b->layerCount && b->baseArrayLayer < a->baseArrayLayer + a->layerCount;
 }
 
-static void CmdBarrierSet_free(CmdBarrierSet* set){
-    VkBufferMemoryBarrierVector_free(&set->bufferBarriers);
-    VkMemoryBarrierVector_free(&set->memoryBarriers);
-    VkImageMemoryBarrierVector_free(&set->imageBarriers);
+// The part of a inside b, in the state of a
+static SubresourceState SubresourceState_intersect(const SubresourceState* a, const SubresourceState* b){
+    SubresourceState ret = *a;
+    const uint32_t mipEnd   = MIN(a->baseMipLevel   + a->levelCount, b->baseMipLevel   + b->levelCount);
+    const uint32_t layerEnd = MIN(a->baseArrayLayer + a->layerCount, b->baseArrayLayer + b->layerCount);
+    ret.baseMipLevel   = MAX(a->baseMipLevel, b->baseMipLevel);
+    ret.baseArrayLayer = MAX(a->baseArrayLayer, b->baseArrayLayer);
+    ret.levelCount = mipEnd - ret.baseMipLevel;
+    ret.layerCount = layerEnd - ret.baseArrayLayer;
+    return ret;
 }
 
-static void CmdBarrierSet_encode(WGPUCommandEncoder encoder, CmdBarrierSet* set){
-    struct VolkDeviceTable* functions = &encoder->device->functions;
-    functions->vkCmdPipelineBarrier(
-        encoder->buffer,
-        VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
-        VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
-        0,
-        set->memoryBarriers.size, set->memoryBarriers.data,
-        set->bufferBarriers.size, set->bufferBarriers.data,
-        set->imageBarriers.size, set->imageBarriers.data
-    );
+// Appends the up to four blocks that remain of a after cutting out b
+static void SubresourceState_subtract(const SubresourceState* a, const SubresourceState* b, SubresourceStateILVector* out){
+    const uint32_t aMipEnd   = a->baseMipLevel   + a->levelCount;
+    const uint32_t bMipEnd   = b->baseMipLevel   + b->levelCount;
+    const uint32_t aLayerEnd = a->baseArrayLayer + a->layerCount;
+    const uint32_t bLayerEnd = b->baseArrayLayer + b->layerCount;
+    if(a->baseMipLevel < b->baseMipLevel){
+        SubresourceState below = *a;
+        below.levelCount = b->baseMipLevel - a->baseMipLevel;
+        SubresourceStateILVector_push_back(out, below);
+    }
+    if(bMipEnd < aMipEnd){
+        SubresourceState above = *a;
+        above.baseMipLevel = bMipEnd;
+        above.levelCount = aMipEnd - bMipEnd;
+        SubresourceStateILVector_push_back(out, above);
+    }
+    const uint32_t sharedMipBase = MAX(a->baseMipLevel, b->baseMipLevel);
+    const uint32_t sharedMipEnd  = MIN(aMipEnd, bMipEnd);
+    if(a->baseArrayLayer < b->baseArrayLayer){
+        SubresourceState front = *a;
+        front.baseMipLevel = sharedMipBase;
+        front.levelCount = sharedMipEnd - sharedMipBase;
+        front.layerCount = b->baseArrayLayer - a->baseArrayLayer;
+        SubresourceStateILVector_push_back(out, front);
+    }
+    if(bLayerEnd < aLayerEnd){
+        SubresourceState back = *a;
+        back.baseMipLevel = sharedMipBase;
+        back.levelCount = sharedMipEnd - sharedMipBase;
+        back.baseArrayLayer = bLayerEnd;
+        back.layerCount = aLayerEnd - bLayerEnd;
+        SubresourceStateILVector_push_back(out, back);
+    }
+}
+
+static void SubresourceStates_merge(SubresourceStateVector* states){
+    bool merged;
+    do{
+        merged = false;
+        for(size_t i = 0;i < states->size;i++){
+            for(size_t j = i + 1;j < states->size;j++){
+                SubresourceState* a = states->data + i;
+                const SubresourceState* b = states->data + j;
+                if(!SubresourceState_sameUse(a, b)){
+                    continue;
+                }
+                if(a->baseArrayLayer == b->baseArrayLayer && a->layerCount == b->layerCount
+                && (a->baseMipLevel + a->levelCount == b->baseMipLevel || b->baseMipLevel + b->levelCount == a->baseMipLevel)){
+                    a->baseMipLevel = MIN(a->baseMipLevel, b->baseMipLevel);
+                    a->levelCount += b->levelCount;
+                }
+                else if(a->baseMipLevel == b->baseMipLevel && a->levelCount == b->levelCount
+                && (a->baseArrayLayer + a->layerCount == b->baseArrayLayer || b->baseArrayLayer + b->layerCount == a->baseArrayLayer)){
+                    a->baseArrayLayer = MIN(a->baseArrayLayer, b->baseArrayLayer);
+                    a->layerCount += b->layerCount;
+                }
+                else{
+                    continue;
+                }
+                states->data[j--] = states->data[--states->size];
+                merged = true;
+            }
+        }
+    // A grown block can border blocks it was compared against already
+    }while(merged);
 }
 
-static CmdBarrierSet GetCompatibilityBarriers(WGPUCommandBuffer srcBuffer, WGPUCommandBuffer dstBuffer){
-    CmdBarrierSet ret;
-    CmdBarrierSet_init(&ret);
-    for(size_t i = 0;i < srcBuffer->resourceUsage.referencedTextures.current_capacity;i++){
-        const ImageUsageRecordMap_kv_pair* srcPair = srcBuffer->resourceUsage.referencedTextures.table + i;
-        const ImageUsageRecord* dstValue = ImageUsageRecordMap_get(&dstBuffer->resourceUsage.referencedTextures, srcPair->key);
-        if(dstValue){
-            VkImageMemoryBarrier insert = {
-                .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
-                .image = ((WGPUTexture)srcPair->key)->image,
-                .srcQueueFamilyIndex = srcBuffer->device->adapter->queueIndices.graphicsIndex,
-                .dstQueueFamilyIndex = srcBuffer->device->adapter->queueIndices.graphicsIndex,
-                .oldLayout = srcPair->value.lastLayout,
-                .newLayout = dstValue->initialLayout,
-                .srcAccessMask = srcPair->value.lastAccess,
-                .dstAccessMask = dstValue->initialAccess,
-                .subresourceRange = dstValue->initiallyAccessedSubresource
-            };
-            VkImageMemoryBarrierVector_push_back(&ret.imageBarriers, insert);
-        }
-    }
-    for(size_t i = 0;i < srcBuffer->resourceUsage.referencedBuffers.current_capacity;i++){
-        const BufferUsageRecordMap_kv_pair* srcPair = srcBuffer->resourceUsage.referencedBuffers.table + i;
-        const BufferUsageRecord* dstValue = BufferUsageRecordMap_get(&dstBuffer->resourceUsage.referencedBuffers, srcPair->key);
-        if(dstValue){
-            VkBufferMemoryBarrier insert = {
-                .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
-                .buffer = ((WGPUBuffer)srcPair->key)->buffer,
-                .offset = 0,
-                .size = ((WGPUBuffer)srcPair->key)->capacity,
-                .srcQueueFamilyIndex = srcBuffer->device->adapter->queueIndices.graphicsIndex,
-                .dstQueueFamilyIndex = srcBuffer->device->adapter->queueIndices.graphicsIndex,
-                .srcAccessMask = srcPair->value.lastAccess,
-                .dstAccessMask = dstValue->initialAccess
+typedef void (*SubresourceVisitor)(const SubresourceState* before, bool tracked, void* userdata);
+
+// Puts the subresources of next into its state. visit, if given, sees every part of them with the state
+// it had before, parts without a block are passed with tracked == false and a zeroed state.
+static void SubresourceStates_transition(SubresourceStateVector* states, const SubresourceState* next, SubresourceVisitor visit, void* userdata){
+    SubresourceStateILVector remainders;
+    SubresourceStateILVector uncovered[2]; // Parts of next no block covers, cut down block by block
+    uint32_t current = 0;
+    SubresourceStateILVector_init(&remainders);
+    SubresourceStateILVector_init(uncovered + 0);
+    SubresourceStateILVector_init(uncovered + 1);
+    SubresourceStateILVector_push_back(uncovered + current, *next);
+
+    size_t kept = 0;
+    for(size_t i = 0;i < states->size;i++){
+        const SubresourceState block = states->data[i];
+        if(!SubresourceState_overlaps(&block, next)){
+            states->data[kept++] = block;
+            continue;
+        }
+        if(visit){
+            const SubresourceState before = SubresourceState_intersect(&block, next);
+            visit(&before, true, userdata);
+        }
+        SubresourceState_subtract(&block, next, &remainders);
+        SubresourceStateILVector* from = uncovered + current;
+        SubresourceStateILVector* to   = uncovered + (current ^ 1);
+        SubresourceStateILVector_clear(to);
+        for(size_t u = 0;u < from->size;u++){
+            if(SubresourceState_overlaps(from->data + u, &block)){
+                SubresourceState_subtract(from->data + u, &block, to);
+            }
+            else{
+                SubresourceStateILVector_push_back(to, from->data[u]);
+            }
+        }
+        current ^= 1;
+    }
+    states->size = kept;
+    if(visit){
+        for(size_t u = 0;u < uncovered[current].size;u++){
+            const SubresourceState* part = uncovered[current].data + u;
+            const SubresourceState before = {
+                .baseMipLevel = part->baseMipLevel,
+                .levelCount = part->levelCount,
+                .baseArrayLayer = part->baseArrayLayer,
+                .layerCount = part->layerCount,
+                .layout = VK_IMAGE_LAYOUT_UNDEFINED,
             };
-            VkBufferMemoryBarrierVector_push_back(&ret.bufferBarriers, insert);
+            visit(&before, false, userdata);
         }
     }
+    for(size_t i = 0;i < remainders.size;i++){
+        SubresourceStateVector_push_back(states, remainders.data[i]);
+    }
+    SubresourceStateVector_push_back(states, *next);
+    SubresourceStates_merge(states);
 
-    return ret;
+    SubresourceStateILVector_free(&remainders);
+    SubresourceStateILVector_free(uncovered + 0);
+    SubresourceStateILVector_free(uncovered + 1);
+}
+
+static void ImageUsageRecord_free(ImageUsageRecord* record){
+    SubresourceStateVector_free(&record->initialStates);
+    SubresourceStateVector_free(&record->lastStates);
+}
+
+typedef struct PrologueImageTransition{
+    WGPUTexture texture;
+    CmdBarrierSet* barriers;
+    const SubresourceState* next;
+}PrologueImageTransition;
+
+static void prologueImageTransitionVisitor(const SubresourceState* before, bool tracked, void* userdata){
+    (void)tracked;
+    const PrologueImageTransition* transition = (const PrologueImageTransition*)userdata;
+    const SubresourceState* next = transition->next;
+    if(before->layout == next->layout && before->stage == 0){
+        return;
+    }
+    WGPUDevice device = transition->texture->device;
+    const VkImageMemoryBarrier2 imageBarrier = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+        .image = transition->texture->image,
+        // Not used since its creation or an acquire, the semaphore wait covers all stages
+        .srcStageMask = before->stage ? before->stage : VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+        .srcAccessMask = writingAccesses(before->access),
+        .dstStageMask = next->stage,
+        .dstAccessMask = next->access,
+        .oldLayout = before->layout,
+        .newLayout = next->layout,
+        .srcQueueFamilyIndex = device->adapter->queueIndices.graphicsIndex,
+        .dstQueueFamilyIndex = device->adapter->queueIndices.graphicsIndex,
+        .subresourceRange = Texture_subresourceRange(transition->texture, before)
+    };
+    VkImageMemoryBarrierVector_push_back(&transition->barriers->imageBarriers, imageBarrier);
 }
-void generateInterspersedCompatibilityBarriers(WGPUCommandBuffer* buffers, uint32_t bufferCount, CmdBarrierSet* barrierSets){
+
+static void imageUsageRecordFreeCallback(void* texture, ImageUsageRecord* record, void* unused){
+    (void)texture;
+    (void)unused;
+    ImageUsageRecord_free(record);
+}
+
+// Resources whose last use was a submit to another queue of the device. The submit waits for that queue's timeline
+// and, across queue families, the other queue first runs the releases of the ownership transfers
+typedef struct QueueHandover{
+    WGPUQueue from;
+    uint64_t waitValue;
+    CmdBarrierSet releases;
+}QueueHandover;
+
+// The default, async compute and transfer queue: a submit has at most two other queues to hand over from
+#define WGVK_MAX_HANDOVER_QUEUES 2
+
+// The entry of handovers[WGVK_MAX_HANDOVER_QUEUES] for resources last used on from, unused entries have no queue
+static QueueHandover* QueueHandover_get(QueueHandover* handovers, WGPUQueue from){
+    for(uint32_t i = 0;i < WGVK_MAX_HANDOVER_QUEUES;i++){
+        if(handovers[i].from == NULL){
+            handovers[i].from = from;
+        }
+        if(handovers[i].from == from){
+            return handovers + i;
+        }
+    }
+    rg_unreachable();
+    return handovers;
+}
+
+// Hands a resource over from the queue of its last use to queue. The acquire barrier makes everything visible,
+// so the caller drops the previous use as a source scope, it would name stages of the other queue family
+static void QueueHandover_buffer(QueueHandover* handover, WGPUQueue queue, WGPUBuffer buffer, CmdBarrierSet* acquires, const BufferUsageRecord* next){
+    handover->waitValue = MAX(handover->waitValue, buffer->lastQueueValue);
+    VkBufferMemoryBarrier2 release = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2,
+        .buffer = buffer->buffer,
+        .srcStageMask = buffer->lastStage ? buffer->lastStage : VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+        .srcAccessMask = writingAccesses(buffer->lastAccess),
+        .dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+        .srcQueueFamilyIndex = buffer->lastQueue->familyIndex,
+        .dstQueueFamilyIndex = queue->familyIndex,
+        .size = VK_WHOLE_SIZE
+    };
+    VkBufferMemoryBarrierVector_push_back(&handover->releases.bufferBarriers, release);
+    VkBufferMemoryBarrier2 acquire = release;
+    acquire.srcStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+    acquire.srcAccessMask = 0;
+    acquire.dstStageMask = next->initialStage;
+    acquire.dstAccessMask = next->initialAccess;
+    VkBufferMemoryBarrierVector_push_back(&acquires->bufferBarriers, acquire);
+}
+
+// All subresources change owner, their layouts stay. Subresources without contents are left to the new queue family
+static void QueueHandover_texture(QueueHandover* handover, WGPUQueue queue, WGPUTexture texture, CmdBarrierSet* acquires, SubresourceStateVector* states){
+    handover->waitValue = MAX(handover->waitValue, texture->lastQueueValue);
+    for(size_t i = 0;i < states->size;i++){
+        SubresourceState* state = states->data + i;
+        if(state->layout == VK_IMAGE_LAYOUT_UNDEFINED){
+            continue;
+        }
+        VkImageMemoryBarrier2 release = {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+            .image = texture->image,
+            .srcStageMask = state->stage ? state->stage : VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+            .srcAccessMask = writingAccesses(state->access),
+            .dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+            .oldLayout = state->layout,
+            .newLayout = state->layout,
+            .srcQueueFamilyIndex = texture->lastQueue->familyIndex,
+            .dstQueueFamilyIndex = queue->familyIndex,
+            .subresourceRange = Texture_subresourceRange(texture, state)
+        };
+        VkImageMemoryBarrierVector_push_back(&handover->releases.imageBarriers, release);
+        VkImageMemoryBarrier2 acquire = release;
+        acquire.srcStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+        acquire.srcAccessMask = 0;
+        acquire.dstAccessMask = VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT;
+        VkImageMemoryBarrierVector_push_back(&acquires->imageBarriers, acquire);
+        state->stage = 0;
+        state->access = 0;
+    }
+}
+
+// Builds the barriers that go in front of each submitted command buffer. The source scope of a resource is its last
+// use earlier in the same submit or, for its first use, the last use in a previous submit, which the queue's
+// submission order covers as well. Resources the GPU never touched need no barrier unless their layout changes.
+// Resources last used on another queue of the device are collected in handovers, one entry per queue
+void generateInterspersedCompatibilityBarriers(WGPUQueue queue, WGPUCommandBuffer* buffers, uint32_t bufferCount, CmdBarrierSet* barrierSets, QueueHandover handovers[WGVK_MAX_HANDOVER_QUEUES]){
     ImageUsageRecordMap referencedImages;
     BufferUsageRecordMap referencedBuffers;
     if(bufferCount == 0)return;
@@ -4213,83 +6604,78 @@ void generateInterspersedCompatibilityBarriers(WGPUCommandBuffer* buffers, uint3
         ImageUsageRecordMap* imageUsage = &buffers[bufferIndex]->resourceUsage.referencedTextures;
         for(size_t i = 0;i < imageUsage->current_capacity;i++){
             const ImageUsageRecordMap_kv_pair* kvp = imageUsage->table + i;
-            if(kvp->key != PHM_EMPTY_SLOT_KEY){
+            if(kvp->key != PHM_EMPTY_SLOT_KEY && kvp->key != PHM_DELETED_SLOT_KEY){
                 WGPUTexture tex = (WGPUTexture)kvp->key;
-                VkImageLayout srcLayout;
-                VkAccessFlags srcAccess = 0;
-                VkPipelineStageFlags srcStage;
                 ImageUsageRecord* knowledge = ImageUsageRecordMap_get(&referencedImages, tex);
-                if(knowledge){
-                    srcLayout = knowledge->lastLayout;
-                    srcAccess = knowledge->lastAccess;
-                    srcStage  = knowledge->lastStage;
-                }
-                else{
-                    srcLayout = tex->layout;
-                    srcStage  = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
-                    srcAccess = VK_ACCESS_MEMORY_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+                if(knowledge == NULL){
+                    ImageUsageRecord fromTexture zeroinit;
+                    SubresourceStateVector_copy(&fromTexture.lastStates, &tex->states);
+                    if(tex->lastQueue != NULL && tex->lastQueue != queue){
+                        QueueHandover* handover = QueueHandover_get(handovers, tex->lastQueue);
+                        if(tex->lastQueue->familyIndex != queue->familyIndex){
+                            QueueHandover_texture(handover, queue, tex, barrierSets + bufferIndex, &fromTexture.lastStates);
+                        }
+                        else{
+                            handover->waitValue = MAX(handover->waitValue, tex->lastQueueValue);
+                        }
+                    }
+                    ImageUsageRecordMap_put(&referencedImages, tex, fromTexture);
+                    knowledge = ImageUsageRecordMap_get(&referencedImages, tex);
                 }
-                VkImageMemoryBarrier imageBarrier = {
-                    .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
-                    .image = tex->image,
-                    .srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
-                    .dstAccessMask = kvp->value.initialAccess,
-                    .oldLayout = srcLayout,
-                    .newLayout = kvp->value.initialLayout,
-                    .srcQueueFamilyIndex = device->adapter->queueIndices.graphicsIndex,
-                    .dstQueueFamilyIndex = device->adapter->queueIndices.graphicsIndex,
-                    .subresourceRange = kvp->value.initiallyAccessedSubresource
+                PrologueImageTransition transition = {
+                    .texture = tex,
+                    .barriers = barrierSets + bufferIndex,
                 };
-                barrierSets[bufferIndex].srcStage |= srcStage;
-                barrierSets[bufferIndex].dstStage |= kvp->value.initialStage;
-                VkImageMemoryBarrierVector_push_back(&barrierSets[bufferIndex].imageBarriers, imageBarrier);
-                if(knowledge){ 
-                    knowledge->lastAccess              = kvp->value.lastAccess;
-                    knowledge->lastStage               = kvp->value.lastStage;
-                    knowledge->lastLayout              = kvp->value.lastLayout;
-                    knowledge->lastAccessedSubresource = kvp->value.lastAccessedSubresource;
+                for(size_t j = 0;j < kvp->value.initialStates.size;j++){
+                    transition.next = kvp->value.initialStates.data + j;
+                    SubresourceStates_transition(&knowledge->lastStates, transition.next, prologueImageTransitionVisitor, &transition);
                 }
-                else{
-                    ImageUsageRecord newRecord = {
-                        .initialAccess = kvp->value.lastAccess,
-                        .lastAccess = kvp->value.lastAccess,
-                        .initiallyAccessedSubresource = kvp->value.lastAccessedSubresource,
-                        .lastAccessedSubresource = kvp->value.lastAccessedSubresource,
-                        .initialLayout = kvp->value.lastLayout,
-                        .lastLayout = kvp->value.lastLayout,
-                        .initialStage = kvp->value.lastStage,
-                        .lastStage = kvp->value.lastStage
-                    };
-                    ImageUsageRecordMap_put(&referencedImages, tex, newRecord);
+                for(size_t j = 0;j < kvp->value.lastStates.size;j++){
+                    SubresourceStates_transition(&knowledge->lastStates, kvp->value.lastStates.data + j, NULL, NULL);
                 }
             }
         }
         BufferUsageRecordMap* bufferUsage = &buffers[bufferIndex]->resourceUsage.referencedBuffers;
         for(size_t i = 0;i < bufferUsage->current_capacity;i++){
             const BufferUsageRecordMap_kv_pair* kvp = bufferUsage->table + i;
-            if(kvp->key != PHM_EMPTY_SLOT_KEY){
+            if(kvp->key != PHM_EMPTY_SLOT_KEY && kvp->key != PHM_DELETED_SLOT_KEY){
                 WGPUBuffer buf = (WGPUBuffer)kvp->key;
-                VkAccessFlags srcAccess = 0;
-                VkPipelineStageFlags srcStage;
+                VkAccessFlags2 srcAccess;
+                VkPipelineStageFlags2 srcStage;
                 BufferUsageRecord* knowledge = BufferUsageRecordMap_get(&referencedBuffers, buf);
                 if(knowledge){
                     srcAccess = knowledge->lastAccess;
                     srcStage  = knowledge->lastStage;
                 }
                 else{
-                    srcStage  = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
-                    srcAccess = VK_ACCESS_MEMORY_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+                    srcAccess = buf->lastAccess;
+                    srcStage  = buf->lastStage;
+                    if(buf->lastQueue != NULL && buf->lastQueue != queue){
+                        QueueHandover* handover = QueueHandover_get(handovers, buf->lastQueue);
+                        if(buf->lastQueue->familyIndex != queue->familyIndex){
+                            QueueHandover_buffer(handover, queue, buf, barrierSets + bufferIndex, &kvp->value);
+                            srcStage = 0;
+                        }
+                        else{
+                            handover->waitValue = MAX(handover->waitValue, buf->lastQueueValue);
+                        }
+                    }
+                }
+                // Host writes are made visible by the submission itself
+                if(srcStage != 0){
+                    VkBufferMemoryBarrier2 bufferBarrier = {
+                        .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2,
+                        .buffer = buf->buffer,
+                        .srcStageMask = srcStage,
+                        .srcAccessMask = writingAccesses(srcAccess),
+                        .dstStageMask = kvp->value.initialStage,
+                        .dstAccessMask = kvp->value.initialAccess,
+                        .srcQueueFamilyIndex = device->adapter->queueIndices.graphicsIndex,
+                        .dstQueueFamilyIndex = device->adapter->queueIndices.graphicsIndex,
+                        .size = VK_WHOLE_SIZE
+                    };
+                    VkBufferMemoryBarrierVector_push_back(&barrierSets[bufferIndex].bufferBarriers, bufferBarrier);
                 }
-                VkBufferMemoryBarrier bufferBarrier = {
-                    .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
-                    .buffer = buf->buffer,
-                    .srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT,
-                    .dstAccessMask = kvp->value.initialAccess,
-                    .srcQueueFamilyIndex = device->adapter->queueIndices.graphicsIndex,
-                    .dstQueueFamilyIndex = device->adapter->queueIndices.graphicsIndex,
-                    .size = VK_WHOLE_SIZE
-                };
-                VkBufferMemoryBarrierVector_push_back(&barrierSets[bufferIndex].bufferBarriers, bufferBarrier);
                 if(knowledge){ 
                     knowledge->lastAccess              = kvp->value.lastAccess;
                     knowledge->lastStage               = kvp->value.lastStage;
@@ -4308,14 +6694,20 @@ void generateInterspersedCompatibilityBarriers(WGPUCommandBuffer* buffers, uint3
         }
 
     }
+    ImageUsageRecordMap_for_each(&referencedImages, imageUsageRecordFreeCallback, NULL);
     ImageUsageRecordMap_free(&referencedImages);
     BufferUsageRecordMap_free(&referencedBuffers);
 
 }
 
-void updateLayoutCallback(void* texture_, ImageUsageRecord* record, void* unused){
+void updateLayoutCallback(void* texture_, ImageUsageRecord* record, void* queue_){
     WGPUTexture texture = (WGPUTexture)texture_;
-    texture->layout = record->lastLayout;
+    WGPUQueue queue = (WGPUQueue)queue_;
+    texture->lastQueue = queue;
+    texture->lastQueueValue = queue->timelineValue;
+    for(size_t i = 0;i < record->lastStates.size;i++){
+        SubresourceStates_transition(&texture->states, record->lastStates.data + i, NULL, NULL);
+    }
 }
 
 void releaseCommandBuffersDependingOnFence(void* userdata){
@@ -4328,19 +6720,36 @@ void releaseCommandBuffersDependingOnFence(void* userdata){
 }
 void wgpuQueueWaitIdle(WGPUQueue queue){
     ENTRY();
-    queue->device->functions.vkQueueWaitIdle(queue->graphicsQueue);
+    Queue_lockVkQueue(queue);
+    queue->device->functions.vkQueueWaitIdle(Queue_vkQueue(queue));
+    Queue_unlockVkQueue(queue);
     EXIT();
 }
 DEFINE_VECTOR_WITH_INLINE_STORAGE(static inline, CmdBarrierSet, CmdBarrierSetILVector, 4);
 const int use_single_submit = 1;
 void wgpuQueueSubmit(WGPUQueue queue, size_t commandCount, const WGPUCommandBuffer* buffers){
     ENTRY();
+    for(size_t i = 0;i < commandCount;i++){
+        if(buffers[i]->commandPool->queueFamily != queue->familyIndex){
+            DeviceCallback(queue->device, WGPUErrorType_Validation, STRVIEW("Command buffer was encoded for a queue of another family, see WGPUCommandEncoderQueueSelection"));
+            return;
+        }
+    }
+
+    Device_pumpFileUploads(queue);
+
+    // Staging copies recorded since the last submit go first, this submit waits for them where it uses their destinations
+    WGPUQueue transferQueue = queue->device->transferQueue;
+    if(transferQueue && queue != transferQueue && transferQueue->presubmitCache->encodedCommandCount > 0){
+        wgpuQueueSubmit(transferQueue, 0, NULL);
+    }
 
     //VkCommandBufferVector submittable;
     WGPUCommandBufferVector submittableWGPU;
 
     //VkCommandBufferVector_initWithSize(&submittable, commandCount + 1);
     
+    Queue_flushPendingWrites(queue);
     WGPUCommandEncoder pscache = queue->presubmitCache;
     const uint32_t cacheBufferNonEmpty = ((pscache->encodedCommandCount > 0) ? 1 : 0);
     WGPUCommandBufferVector_initWithSize(&submittableWGPU, commandCount + cacheBufferNonEmpty);
@@ -4377,90 +6786,108 @@ void wgpuQueueSubmit(WGPUQueue queue, size_t commandCount, const WGPUCommandBuff
     PerframeCache* perFrameCache = DeviceGetFIFCache(queue->device, cacheIndex);
     
     VkResult submitResult = 0;
-    WGPUCommandBufferVector interspersedBuffers;
-    WGPUCommandBufferVector_init(&interspersedBuffers);
     if(use_single_submit && submittableWGPU.size > 0){
         CmdBarrierSetILVector compatibilityBarrierSets;
         CmdBarrierSetILVector_initWithSize(&compatibilityBarrierSets, submittableWGPU.size);
-        
-        generateInterspersedCompatibilityBarriers(submittableWGPU.data, submittableWGPU.size, compatibilityBarrierSets.data);
-        for(uint32_t i = 0;i < submittableWGPU.size;i++){
-            const CmdBarrierSet* cbs = CmdBarrierSetILVector_get(&compatibilityBarrierSets, i);
-            //printf("cbs size: %lu\n", cbs->bufferBarriers.size);
-            WGPUCommandEncoder iencoder = wgpuDeviceCreateCommandEncoder(queue->device, NULL);
-            queue->device->functions.vkCmdPipelineBarrier(
-                iencoder->buffer,
-                VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
-                VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
-                0,
-                cbs->memoryBarriers.size, cbs->memoryBarriers.data,
-                cbs->bufferBarriers.size, cbs->bufferBarriers.data,
-                cbs->imageBarriers.size,  cbs->imageBarriers.data
-            );
-            WGPUCommandBuffer buffer = wgpuCommandEncoderFinish(iencoder, NULL);
-            WGPUCommandBufferVector_push_back(&interspersedBuffers, buffer);
-            wgpuCommandEncoderRelease(iencoder);
+        QueueHandover handovers[WGVK_MAX_HANDOVER_QUEUES] = {0};
+        for(uint32_t h = 0;h < WGVK_MAX_HANDOVER_QUEUES;h++){
+            CmdBarrierSet_init(&handovers[h].releases);
+        }
+        generateInterspersedCompatibilityBarriers(queue, submittableWGPU.data, submittableWGPU.size, compatibilityBarrierSets.data, handovers);
+        QueueTimelineWait crossQueueWaits[WGVK_MAX_HANDOVER_QUEUES];
+        uint32_t crossQueueWaitCount = 0;
+        for(uint32_t h = 0;h < WGVK_MAX_HANDOVER_QUEUES;h++){
+            QueueHandover* handover = handovers + h;
+            if(!CmdBarrierSet_empty(&handover->releases)){
+                // The releases have to run on the queue that owns the resources, before this submit acquires them
+                ThreadCommandPool* releasePool = PerframeCache_getThreadCommandPool(queue->device, perFrameCache, handover->from->familyIndex);
+                VkCommandBuffer releaseBuffer = ThreadCommandPool_acquire(queue->device, releasePool);
+                const VkCommandBufferBeginInfo bbi = {
+                    .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+                    .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+                };
+                queue->device->functions.vkBeginCommandBuffer(releaseBuffer, &bbi);
+                CmdBarrierSet_encodeVk(queue->device, releaseBuffer, &handover->releases);
+                queue->device->functions.vkEndCommandBuffer(releaseBuffer);
+                ThreadCommandPool_retire(releasePool, releaseBuffer);
+                const VkSubmitInfo releaseSubmit = {
+                    .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+                    .commandBufferCount = 1,
+                    .pCommandBuffers = &releaseBuffer,
+                };
+                if(Queue_submit(handover->from, &releaseSubmit, NULL, 0, NULL) == VK_SUCCESS){
+                    handover->waitValue = handover->from->timelineValue;
+                }
+            }
+            CmdBarrierSet_free(&handover->releases);
+            if(handover->waitValue > 0){
+                crossQueueWaits[crossQueueWaitCount++] = (QueueTimelineWait){
+                    .queue = handover->from,
+                    .value = handover->waitValue,
+                };
+            }
         }
+        // Only command buffers that need barriers in front of them get a prologue. The prologues are plain
+        // command buffers from this thread's pool, which is reset once the frame's fences have been waited for
+        ThreadCommandPool* prologuePool = PerframeCache_getThreadCommandPool(queue->device, perFrameCache, queue->familyIndex);
+        VkCommandBufferVector finalSubmittable = {0};
+        VkCommandBufferVector_init(&finalSubmittable);
+        VkCommandBufferVector_reserve(&finalSubmittable, submittableWGPU.size * 2);
         for(size_t i = 0;i < submittableWGPU.size;i++){
-            CmdBarrierSet_free(CmdBarrierSetILVector_get(&compatibilityBarrierSets, i));
+            CmdBarrierSet* cbs = CmdBarrierSetILVector_get(&compatibilityBarrierSets, i);
+            if(cbs->bufferBarriers.size + cbs->imageBarriers.size + cbs->memoryBarriers.size > 0){
+                VkCommandBuffer prologue = ThreadCommandPool_acquire(queue->device, prologuePool);
+                const VkCommandBufferBeginInfo bbi = {
+                    .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+                    .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+                };
+                queue->device->functions.vkBeginCommandBuffer(prologue, &bbi);
+                CmdBarrierSet_encodeVk(queue->device, prologue, cbs);
+                queue->device->functions.vkEndCommandBuffer(prologue);
+                ThreadCommandPool_retire(prologuePool, prologue);
+                VkCommandBufferVector_push_back(&finalSubmittable, prologue);
+            }
+            VkCommandBufferVector_push_back(&finalSubmittable, submittableWGPU.data[i]->buffer);
+            CmdBarrierSet_free(cbs);
         }
         CmdBarrierSetILVector_free(&compatibilityBarrierSets);
         VkSemaphoreVector waitSemaphores;
         VkSemaphoreVector_init(&waitSemaphores);
         SyncState* syncState = DeviceGetSyncState(queue->device, cacheIndex);
 
-        if(syncState->acquireImageSemaphoreSignalled){
+        // Swapchain images are only rendered to on the default queue
+        if(syncState->acquireImageSemaphoreSignalled && queue == queue->device->queue){
             VkSemaphoreVector_push_back(&waitSemaphores, syncState->acquireImageSemaphore);
             syncState->acquireImageSemaphoreSignalled = false;
         }
-        if(syncState->submits > 0){
+        // Binary semaphores chain the submits of a frame only without a timeline, otherwise submission order does
+        const bool chained = !queue->device->capabilities.timelineSemaphore;
+        if(chained && syncState->submits > 0){
             VkSemaphoreVector_push_back(&waitSemaphores, syncState->semaphores.data[syncState->submits]);
         }
-        uint32_t submits = syncState->submits;
         VkPipelineStageFlags* waitFlags = (VkPipelineStageFlags*)RL_CALLOC(waitSemaphores.size, sizeof(VkPipelineStageFlags));
         for(uint32_t i = 0;i < waitSemaphores.size;i++){
             waitFlags[i] = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
         }
-        VkCommandBufferVector finalSubmittable = {0};
-        VkCommandBufferVector_init(&finalSubmittable);
-        VkCommandBufferVector_reserve(&finalSubmittable, submittableWGPU.size * 2);
-        for(size_t i = 0;i < submittableWGPU.size;i++){
-            VkCommandBufferVector_push_back(&finalSubmittable, interspersedBuffers.data[i]->buffer);
-            VkCommandBufferVector_push_back(&finalSubmittable, submittableWGPU.data[i]->buffer);
-        }
         const VkSubmitInfo submitInfo = {
             .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
             .commandBufferCount = finalSubmittable.size,
             .waitSemaphoreCount = waitSemaphores.size,
             .pWaitSemaphores = waitSemaphores.data,
             .pWaitDstStageMask = waitFlags,
-            .signalSemaphoreCount = 1,
-            .pSignalSemaphores = syncState->semaphores.data + syncState->submits + 1,
+            .signalSemaphoreCount = chained ? 1 : 0,
+            .pSignalSemaphores = chained ? syncState->semaphores.data + syncState->submits + 1 : NULL,
             .pCommandBuffers = finalSubmittable.data,
         };
-        if(finalSubmittable.size){
-            //printf("Submitting:\n");
-            //for(uint32_t i = 0;i < finalSubmittable.size;i++){
-            //    printf("  %p\n", finalSubmittable.data[i]);
-            //}
-            //printf("with fence %p\n", fence);
-        }
-        ++syncState->submits;
-        WGPUFence submitFence = fence;
-        submitResult = queue->device->functions.vkQueueSubmit(queue->graphicsQueue, 1, &submitInfo, submitFence ? submitFence->fence : VK_NULL_HANDLE);
-        if(submitResult == VK_SUCCESS){
-            submitFence->state = WGPUFenceState_InUse;
+        if(chained){
+            ++syncState->submits;
         }
+        submitResult = Queue_submit(queue, &submitInfo, crossQueueWaits, crossQueueWaitCount, fence);
         for(uint32_t i = 0;i < submittableWGPU.size;i++){
-            ImageUsageRecordMap_for_each(&submittableWGPU.data[i]->resourceUsage.referencedTextures, updateLayoutCallback, NULL);
+            ImageUsageRecordMap_for_each(&submittableWGPU.data[i]->resourceUsage.referencedTextures, updateLayoutCallback, queue);
         }
         VkSemaphoreVector_free(&waitSemaphores);
         VkCommandBufferVector_free(&finalSubmittable);
-        for(size_t i = 0;i < interspersedBuffers.size;i++){
-            // compensated by not calling addRef below
-            // wgpuCommandBufferRelease(interspersedBuffers.data[i]);
-        }
-        
         RL_FREE(waitFlags);
     }
     else{
@@ -4508,6 +6935,7 @@ void wgpuQueueSubmit(WGPUQueue queue, size_t commandCount, const WGPUCommandBuff
         //}
     }
 
+    Device_fileUploadsSubmitted(queue, submitResult == VK_SUCCESS ? fence : NULL);
     if(submitResult == VK_SUCCESS){
 
         for(uint32_t i = 0;i < submittableWGPU.size;i++){
@@ -4516,11 +6944,31 @@ void wgpuQueueSubmit(WGPUQueue queue, size_t commandCount, const WGPUCommandBuff
             for(size_t refbEntry = 0;refbEntry < map.current_capacity;refbEntry++){
                 BufferUsageRecordMap_kv_pair* kv_pair = &map.table[refbEntry];
                 WGPUBuffer keybuffer = (WGPUBuffer)kv_pair->key;
-                if((kv_pair->key != PHM_DELETED_SLOT_KEY && kv_pair->key != PHM_EMPTY_SLOT_KEY) && kv_pair->value.everWrittenTo != VK_FALSE && (keybuffer->usage & (WGPUBufferUsage_MapWrite | WGPUBufferUsage_MapRead))){
-                    if(keybuffer->latestFence)
-                        wgpuFenceRelease(keybuffer->latestFence);
-                    keybuffer->latestFence = fence;
-                    wgpuFenceAddRef(fence);
+                if(kv_pair->key == PHM_DELETED_SLOT_KEY || kv_pair->key == PHM_EMPTY_SLOT_KEY){
+                    continue;
+                }
+                if(kv_pair->value.unsubmitted){
+                    kv_pair->value.unsubmitted = VK_FALSE;
+                    --keybuffer->unsubmittedUses;
+                }
+                if(submittedBuffer == cachebuffer){
+                    keybuffer->zeroFillPending = VK_FALSE;
+                }
+                keybuffer->lastStage = kv_pair->value.lastStage;
+                keybuffer->lastAccess = kv_pair->value.lastAccess;
+                keybuffer->lastQueue = queue;
+                keybuffer->lastQueueValue = queue->timelineValue;
+                // Host visible buffers remember the fence of their last use so that host writes
+                // (mapping or wgpuQueueWriteBuffer) know whether the GPU might still read or write them
+                if(keybuffer->memoryProperties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT){
+                    if(keybuffer->latestFence != fence){
+                        if(keybuffer->latestFence)
+                            wgpuFenceRelease(keybuffer->latestFence);
+                        keybuffer->latestFence = fence;
+                        keybuffer->latestFenceWrites = VK_FALSE;
+                        wgpuFenceAddRef(fence);
+                    }
+                    keybuffer->latestFenceWrites |= kv_pair->value.everWrittenTo;
                     //CallbackWithUserdataVector_push_back(
                     //    &fence->callbacksOnWaitComplete
                     //);
@@ -4540,16 +6988,7 @@ void wgpuQueueSubmit(WGPUQueue queue, size_t commandCount, const WGPUCommandBuff
             WGPUCommandBufferVector_push_back(&insert, buffers[i]);
             //wgpuCommandBufferAddRef(buffers[i]);
         }
-        for(size_t i = 0;i < interspersedBuffers.size;i++){
-            WGPUCommandBufferVector_push_back(&insert, interspersedBuffers.data[i]);
-        }
-
         PerframeCache_pushFenceDependencies(perFrameCache, fence, &insert);
-
-        for(size_t i = 0;i < interspersedBuffers.size;i++){
-            wgpuCommandBufferRelease(interspersedBuffers.data[i]);
-        }
-        WGPUCommandBufferVector_free(&interspersedBuffers);
         uint32_t cacheIndex = frameCount % framesInFlight;
         //PendingCommandBufferMap* pcm = &DeviceGetFIFCache(queue->device, cacheIndex)->pendingCommandBuffers;
         //WGPUCommandBufferVector* fence_iterator = PendingCommandBufferMap_get(pcm, (void*)fence);
@@ -4580,8 +7019,7 @@ void wgpuQueueSubmit(WGPUQueue queue, size_t commandCount, const WGPUCommandBuff
     }
     wgpuCommandEncoderRelease(queue->presubmitCache);
     wgpuCommandBufferRelease(cachebuffer);
-    WGPUCommandEncoderDescriptor cedesc zeroinit;
-    queue->presubmitCache = wgpuDeviceCreateCommandEncoder(queue->device, &cedesc);
+    queue->presubmitCache = Queue_createPresubmitCache(queue);
     //VkCommandBufferVector_free(&submittable);
     WGPUCommandBufferVector_free(&submittableWGPU);
     EXIT();
@@ -4718,10 +7156,10 @@ void wgpuSurfaceConfigure(WGPUSurface surface, const WGPUSurfaceConfiguration* c
     createInfo.imageArrayLayers = 1;
     createInfo.imageUsage = toVulkanTextureUsage(config->usage, config->format);
 
-    // Queue family indices
+    // Queue family indices, the transfer queue never touches swapchain images
     uint32_t queueFamilyIndices[2] = {
         device->adapter->queueIndices.graphicsIndex, 
-        device->adapter->queueIndices.transferIndex
+        device->adapter->queueIndices.presentIndex
     };
 
     if (queueFamilyIndices[0] != queueFamilyIndices[1]) {
@@ -4759,6 +7197,7 @@ void wgpuSurfaceConfigure(WGPUSurface surface, const WGPUSurfaceConfiguration* c
         surface->images[i]->width = correctedWidth;
         surface->images[i]->height = correctedHeight;
         surface->images[i]->depthOrArrayLayers = 1;
+        surface->images[i]->mipLevels = 1;
         surface->images[i]->refCount = 1;
         surface->images[i]->sampleCount = 1;
         surface->images[i]->image = tmpImages[i];
@@ -4828,16 +7267,18 @@ void wgpuCommandEncoderRelease(WGPUCommandEncoder commandEncoder) {
             WGPURenderPassEncoderSet_free(&commandBuffer->referencedRPs);
             WGPUComputePassEncoderSet_free(&commandBuffer->referencedCPs);
             WGPURaytracingPassEncoderSet_free(&commandBuffer->referencedRTs);
+            CommandEncoder_freeCopies(commandEncoder);
+            CmdBarrierSet_free(&commandEncoder->pendingBarriers);
+            SplitEventWaitVector_free(&commandEncoder->pendingEventWaits);
+            Device_releaseSplitEvents(commandEncoder->device, &commandEncoder->splitEvents);
         }
         if(commandEncoder->buffer){
-            VkCommandBufferVector_push_back(
-                &DeviceGetFIFCache(commandEncoder->device, commandEncoder->cacheIndex)->commandBuffers,
-                commandEncoder->buffer
-            );
+            // Never finished: leave the recording state so the buffer can be begun again after recycling
+            commandEncoder->device->functions.vkEndCommandBuffer(commandEncoder->buffer);
+            ThreadCommandPool_retire(commandEncoder->commandPool, commandEncoder->buffer);
         }
+        RL_FREE(commandEncoder);
     }
-    
-    RL_FREE(commandEncoder);
     EXIT();
 }
 
@@ -4857,9 +7298,8 @@ void wgpuCommandBufferRelease(WGPUCommandBuffer commandBuffer) {
         WGPUComputePassEncoderSet_free(&commandBuffer->referencedCPs);
         WGPURaytracingPassEncoderSet_free(&commandBuffer->referencedRTs);
         
-        PerframeCache* frameCache = DeviceGetFIFCache(commandBuffer->device, commandBuffer->cacheIndex);
-        device->functions.vkFreeCommandBuffers(device->device, device->fifCache.frameCaches[commandBuffer->cacheIndex].commandPool, 1, &commandBuffer->buffer);
-        //VkCommandBufferVector_push_back(&frameCache->commandBuffers, commandBuffer->buffer);
+        ThreadCommandPool_retire(commandBuffer->commandPool, commandBuffer->buffer);
+        Device_releaseSplitEvents(device, &commandBuffer->splitEvents);
         if(commandBuffer->label.data){
             WGPUStringFree(commandBuffer->label);
         }
@@ -5002,24 +7442,14 @@ void wgpuBindGroupRelease(WGPUBindGroup dshandle) {
                 .pool = dshandle->pool,
                 .set = dshandle->set
             };
-            DescriptorSetAndPoolVector* maybeAlreadyThere = BindGroupCacheMap_get(bgcm, dshandle->layout);
-            if(maybeAlreadyThere == NULL){
-                DescriptorSetAndPoolVector empty zeroinit;
-                BindGroupCacheMap_put(bgcm, dshandle->layout, empty);
-                maybeAlreadyThere = BindGroupCacheMap_get(bgcm, dshandle->layout);
-                wgvk_assert(maybeAlreadyThere != NULL, "Still null after insert");
-                DescriptorSetAndPoolVector_init(maybeAlreadyThere);
-            }
-
-            if(maybeAlreadyThere){
-                DescriptorSetAndPoolVector_push_back(maybeAlreadyThere, insertValue);
-            }
+            BindGroupCache_return(bgcm, dshandle->layout, insertValue);
         }
         else{
             //dshandle->device->functions.vkFreeDescriptorSets(dshandle->device->device, dshandle->pool, 1, &dshandle->set);
             dshandle->device->functions.vkDestroyDescriptorPool(dshandle->device->device, dshandle->pool, NULL);
         }
         RL_FREE(dshandle->entries);
+        RL_FREE(dshandle->bufferGenerations);
 
         // DONT delete them, they are cached
         // vkFreeDescriptorSets(dshandle->device->device, dshandle->pool, 1, &dshandle->set);
@@ -5056,6 +7486,7 @@ void wgpuInstanceRelease                      (WGPUInstance instance){
         vkDestroyDebugUtilsMessengerEXT(instance->instance, instance->debugMessenger, NULL);
         vkDestroyInstance(instance->instance, NULL);
         FutureIDMap_free(&instance->g_futureIDMap);
+        wgvk_mutex_destroy(instance->futureMutex);
         RL_FREE(instance);
     }
     EXIT();
@@ -5077,26 +7508,57 @@ void wgpuDeviceRelease(WGPUDevice device){
             .label = STRVIEW("PresubmitCache"),
         };
         wgvk_thread_pool_destroy(device->thread_pool);
-        WGPUCommandBuffer cBuffer = wgpuCommandEncoderFinish(device->queue->presubmitCache, &cbd);
-        wgpuCommandEncoderRelease(device->queue->presubmitCache);
-        wgpuCommandBufferRelease(cBuffer);
+        WGPUQueue queues[3] = {device->queue, device->asyncComputeQueue, device->transferQueue};
+        for(uint32_t q = 0;q < 3;q++){
+            if(queues[q] == NULL){
+                continue;
+            }
+            Queue_freePendingWrites(queues[q]);
+            WGPUCommandBuffer cBuffer = wgpuCommandEncoderFinish(queues[q]->presubmitCache, &cbd);
+            wgpuCommandEncoderRelease(queues[q]->presubmitCache);
+            wgpuCommandBufferRelease(cBuffer);
+        }
         FIFCache_destroy(&device->fifCache);
         {  // Destroy PerframeCaches
             
             FenceCache_Destroy(&device->fenceCache);
+            for(uint32_t q = 0;q < 3;q++){
+                if(queues[q] && queues[q]->timelineSemaphore != VK_NULL_HANDLE){
+                    device->functions.vkDestroySemaphore(device->device, queues[q]->timelineSemaphore, NULL);
+                }
+            }
             #if USE_VMA_ALLOCATOR == 1
             vmaDestroyPool(device->allocator, device->aligned_hostVisiblePool);
             vmaDestroyAllocator(device->allocator);
             #endif
             wgvkAllocator_destroy(&device->builtinAllocator);
         }
-        device->functions.vkDestroyCommandPool(device->device, device->secondaryCommandPool, NULL);
+        for(size_t i = 0;i < device->bundleCommandPools.current_capacity;i++){
+            const ThreadCommandPoolMap_kv_pair* kvp = device->bundleCommandPools.table + i;
+            if(kvp->key != PHM_EMPTY_SLOT_KEY && kvp->key != PHM_DELETED_SLOT_KEY){
+                ThreadCommandPool_destroy(device, kvp->value);
+            }
+        }
+        ThreadCommandPoolMap_free(&device->bundleCommandPools);
+        wgvk_mutex_destroy(device->bundleCommandPoolsMutex);
+        for(size_t i = 0;i < device->spareEvents.size;i++){
+            device->functions.vkDestroyEvent(device->device, device->spareEvents.data[i], NULL);
+        }
+        VkEventVector_free(&device->spareEvents);
+        wgvk_mutex_destroy(device->spareEventsMutex);
+        wgvk_mutex_destroy(device->backingRetireMutex);
+        wgvk_mutex_destroy(device->fileUploadsMutex);
+        if(device->queue->vkQueueMutex){
+            wgvk_mutex_destroy(device->queue->vkQueueMutex);
+        }
         
         wgpuQueueRelease(device->queue);
         wgpuAdapterRelease(device->adapter);
         device->functions.vkDestroyDevice(device->device, NULL);
         
         // Still a lot to do
+        RL_FREE(device->asyncComputeQueue);
+        RL_FREE(device->transferQueue);
         RL_FREE(device->queue);
         RL_FREE(device);
     }
@@ -5528,6 +7990,7 @@ void wgpuTextureRelease(WGPUTexture texture){
             }
         }
         Texture_ViewCache_free(&texture->viewCache);
+        SubresourceStateVector_free(&texture->states);
         RL_FREE(texture);
     }
     EXIT();
@@ -5544,23 +8007,139 @@ void wgpuTextureViewRelease(WGPUTextureView view){
     EXIT();
 }
 
+static inline bool boxesDisjoint(VkOffset3D aBegin, VkOffset3D aEnd, VkOffset3D bBegin, VkOffset3D bEnd){
+    return aEnd.x <= bBegin.x || bEnd.x <= aBegin.x
+        || aEnd.y <= bBegin.y || bEnd.y <= aBegin.y
+        || aEnd.z <= bBegin.z || bEnd.z <= aBegin.z;
+}
+
+// Returns true if a copy of the given kind can join the pending batch, otherwise records the batch so the caller starts a new one
+static bool CommandEncoder_continueCopies(WGPUCommandEncoder encoder, const PendingCopies* key, VkOffset3D boxBegin, VkOffset3D boxEnd, uint64_t bufferBegin, uint64_t bufferEnd){
+    PendingCopies* pending = &encoder->pendingCopies;
+    const bool sameKey = pending->type == key->type
+        && pending->source == key->source
+        && pending->destination == key->destination
+        && pending->sourceMipLevel == key->sourceMipLevel
+        && pending->sourceLayer == key->sourceLayer
+        && pending->destinationMipLevel == key->destinationMipLevel
+        && pending->sourceAspect == key->sourceAspect
+        && pending->destinationAspect == key->destinationAspect;
+    // Only the first copy's layer is tracked, so texture batches stay on that layer.
+    // Copying within one resource would need the source regions checked against the destinations as well
+    const bool sameLayers = key->type == pending_copy_buffer_to_buffer || (boxBegin.z == pending->boxBegin.z && boxEnd.z == pending->boxEnd.z);
+    if(sameKey && sameLayers && key->source != key->destination){
+        const bool disjoint = key->type == pending_copy_buffer_to_buffer
+            ? (bufferEnd <= pending->bufferBegin || pending->bufferEnd <= bufferBegin)
+            : boxesDisjoint(boxBegin, boxEnd, pending->boxBegin, pending->boxEnd);
+        if(disjoint){
+            pending->bufferBegin = pending->bufferBegin < bufferBegin ? pending->bufferBegin : bufferBegin;
+            pending->bufferEnd   = pending->bufferEnd   > bufferEnd   ? pending->bufferEnd   : bufferEnd;
+            pending->boxBegin = (VkOffset3D){
+                pending->boxBegin.x < boxBegin.x ? pending->boxBegin.x : boxBegin.x,
+                pending->boxBegin.y < boxBegin.y ? pending->boxBegin.y : boxBegin.y,
+                pending->boxBegin.z < boxBegin.z ? pending->boxBegin.z : boxBegin.z,
+            };
+            pending->boxEnd = (VkOffset3D){
+                pending->boxEnd.x > boxEnd.x ? pending->boxEnd.x : boxEnd.x,
+                pending->boxEnd.y > boxEnd.y ? pending->boxEnd.y : boxEnd.y,
+                pending->boxEnd.z > boxEnd.z ? pending->boxEnd.z : boxEnd.z,
+            };
+            return true;
+        }
+    }
+    CommandEncoder_flushCopies(encoder);
+    pending->type = key->type;
+    pending->source = key->source;
+    pending->destination = key->destination;
+    pending->sourceMipLevel = key->sourceMipLevel;
+    pending->sourceLayer = key->sourceLayer;
+    pending->destinationMipLevel = key->destinationMipLevel;
+    pending->sourceAspect = key->sourceAspect;
+    pending->destinationAspect = key->destinationAspect;
+    pending->bufferBegin = bufferBegin;
+    pending->bufferEnd = bufferEnd;
+    pending->boxBegin = boxBegin;
+    pending->boxEnd = boxEnd;
+    return false;
+}
+
+static void CommandEncoder_flushCopies(WGPUCommandEncoder encoder){
+    PendingCopies* pending = &encoder->pendingCopies;
+    WGPUDevice device = encoder->device;
+    if(pending->type == pending_copy_none){
+        return;
+    }
+    CommandEncoder_flushBarriers(encoder);
+    switch(pending->type){
+        case pending_copy_none: break;
+        case pending_copy_buffer_to_buffer:{
+            WGPUBuffer source = pending->source;
+            WGPUBuffer destination = pending->destination;
+            device->functions.vkCmdCopyBuffer(encoder->buffer, source->buffer, destination->buffer, (uint32_t)pending->bufferCopies.size, pending->bufferCopies.data);
+            if(destination->usage & (WGPUBufferUsage_MapWrite | WGPUBufferUsage_MapRead)){
+                CommandEncoder_hostReadBarrier(encoder, VK_PIPELINE_STAGE_2_COPY_BIT);
+            }
+            VkBufferCopyVector_clear(&pending->bufferCopies);
+        }break;
+        case pending_copy_buffer_to_texture:{
+            WGPUBuffer source = pending->source;
+            WGPUTexture destination = pending->destination;
+            device->functions.vkCmdCopyBufferToImage(encoder->buffer, source->buffer, destination->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, (uint32_t)pending->bufferImageCopies.size, pending->bufferImageCopies.data);
+            VkBufferImageCopyVector_clear(&pending->bufferImageCopies);
+        }break;
+        case pending_copy_texture_to_texture:{
+            WGPUTexture source = pending->source;
+            WGPUTexture destination = pending->destination;
+            device->functions.vkCmdBlitImage(
+                encoder->buffer,
+                source->image,
+                VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                destination->image,
+                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                (uint32_t)pending->blits.size, pending->blits.data,
+                VK_FILTER_NEAREST
+            );
+            VkImageBlitVector_clear(&pending->blits);
+        }break;
+    }
+    pending->type = pending_copy_none;
+}
+
+static void CommandEncoder_freeCopies(WGPUCommandEncoder encoder){
+    VkBufferCopyVector_free(&encoder->pendingCopies.bufferCopies);
+    VkBufferImageCopyVector_free(&encoder->pendingCopies.bufferImageCopies);
+    VkImageBlitVector_free(&encoder->pendingCopies.blits);
+}
+
 void wgpuCommandEncoderCopyBufferToBuffer  (WGPUCommandEncoder commandEncoder, WGPUBuffer source, uint64_t sourceOffset, WGPUBuffer destination, uint64_t destinationOffset, uint64_t size){
     ENTRY();
     ++commandEncoder->encodedCommandCount;
+    const PendingCopies key = {
+        .type = pending_copy_buffer_to_buffer,
+        .source = source,
+        .destination = destination,
+    };
+    const VkOffset3D noBox = {0, 0, 0};
+    CommandEncoder_continueCopies(commandEncoder, &key, noBox, noBox, destinationOffset, destinationOffset + size);
+    // Every copy in a batch is tracked for its own range; barriers it needs are flushed before the batch is recorded
     ce_trackBuffer(
         commandEncoder,
         source,
         (BufferUsageSnap){
-            .stage = VK_PIPELINE_STAGE_TRANSFER_BIT,
-            .access = VK_ACCESS_TRANSFER_READ_BIT
+            .stage = VK_PIPELINE_STAGE_2_COPY_BIT,
+            .access = VK_ACCESS_TRANSFER_READ_BIT,
+            .offset = sourceOffset,
+            .size = size
         }
     );
     ce_trackBuffer(
         commandEncoder,
         destination,
         (BufferUsageSnap){
-            .stage = VK_PIPELINE_STAGE_TRANSFER_BIT,
-            .access = VK_ACCESS_TRANSFER_WRITE_BIT
+            .stage = VK_PIPELINE_STAGE_2_COPY_BIT,
+            .access = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .offset = destinationOffset,
+            .size = size
         }
     );
 
@@ -5569,25 +8148,7 @@ void wgpuCommandEncoderCopyBufferToBuffer  (WGPUCommandEncoder commandEncoder, W
         .dstOffset = destinationOffset,
         .size = size
     };
-
-    commandEncoder->device->functions.vkCmdCopyBuffer(commandEncoder->buffer, source->buffer, destination->buffer, 1, &copy);
-    if(destination->usage & (WGPUBufferUsage_MapWrite | WGPUBufferUsage_MapRead)){
-        const VkMemoryBarrier memoryBarrier = {
-            VK_STRUCTURE_TYPE_MEMORY_BARRIER,
-            NULL,
-            VK_ACCESS_TRANSFER_WRITE_BIT,
-            VK_ACCESS_HOST_READ_BIT
-        };
-        commandEncoder->device->functions.vkCmdPipelineBarrier(
-            commandEncoder->buffer,
-            VK_PIPELINE_STAGE_TRANSFER_BIT,
-            VK_PIPELINE_STAGE_HOST_BIT,
-            0,
-            1, &memoryBarrier, 
-            0, NULL, 
-            0, NULL
-        );
-    }
+    VkBufferCopyVector_push_back(&commandEncoder->pendingCopies.bufferCopies, copy);
     EXIT();
 }
 void wgpuCommandEncoderCopyBufferToTexture (WGPUCommandEncoder commandEncoder, WGPUTexelCopyBufferInfo const * source, WGPUTexelCopyTextureInfo const * destination, WGPUExtent3D const * copySize){
@@ -5595,12 +8156,12 @@ void wgpuCommandEncoderCopyBufferToTexture (WGPUCommandEncoder commandEncoder, W
     
     VkBufferImageCopy region zeroinit;
     ++commandEncoder->encodedCommandCount;
-    region.bufferOffset = 0;
+    region.bufferOffset = source->layout.offset;
     region.bufferRowLength = 0;
     region.bufferImageHeight = 0;
 
     region.imageSubresource.aspectMask = toVulkanAspectMaskVk(destination->aspect, destination->texture->format);
-    region.imageSubresource.mipLevel = 0;
+    region.imageSubresource.mipLevel = destination->mipLevel;
     region.imageSubresource.baseArrayLayer = 0;
     region.imageSubresource.layerCount = 1;
 
@@ -5616,32 +8177,46 @@ void wgpuCommandEncoderCopyBufferToTexture (WGPUCommandEncoder commandEncoder, W
         copySize->depthOrArrayLayers
     };
     
-    ce_trackBuffer(commandEncoder, source->buffer, (BufferUsageSnap){VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT});
-    ce_trackTexture(commandEncoder, destination->texture, (ImageUsageSnap){
-        .layout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-        .stage = VK_PIPELINE_STAGE_TRANSFER_BIT,
-        .access = VK_ACCESS_TRANSFER_WRITE_BIT,
-        .subresource = {
-            .aspectMask = destination->aspect,
-            .baseMipLevel = destination->mipLevel,
-            .levelCount = 1,
-            .baseArrayLayer = destination->origin.z,
-            .layerCount = 1
-        }
-    });
-
-    commandEncoder->device->functions.vkCmdCopyBufferToImage(commandEncoder->buffer, source->buffer->buffer, destination->texture->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+    const PendingCopies key = {
+        .type = pending_copy_buffer_to_texture,
+        .source = source->buffer,
+        .destination = destination->texture,
+        .destinationMipLevel = destination->mipLevel,
+        .destinationAspect = destination->aspect,
+    };
+    const VkOffset3D boxEnd = {
+        region.imageOffset.x + (int32_t)copySize->width,
+        region.imageOffset.y + (int32_t)copySize->height,
+        region.imageOffset.z + (int32_t)copySize->depthOrArrayLayers,
+    };
+    if(!CommandEncoder_continueCopies(commandEncoder, &key, region.imageOffset, boxEnd, 0, 0)){
+        ce_trackBuffer(commandEncoder, source->buffer, (BufferUsageSnap){VK_PIPELINE_STAGE_2_COPY_BIT, VK_ACCESS_TRANSFER_READ_BIT});
+        ce_trackTexture(commandEncoder, destination->texture, (ImageUsageSnap){
+            .layout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            .stage = VK_PIPELINE_STAGE_2_COPY_BIT,
+            .access = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .subresource = {
+                .aspectMask = destination->aspect,
+                .baseMipLevel = destination->mipLevel,
+                .levelCount = 1,
+                .baseArrayLayer = destination->origin.z,
+                .layerCount = 1
+            }
+        });
+    }
+    VkBufferImageCopyVector_push_back(&commandEncoder->pendingCopies.bufferImageCopies, region);
     EXIT();
 }
 void wgpuCommandEncoderCopyTextureToBuffer (WGPUCommandEncoder commandEncoder, const WGPUTexelCopyTextureInfo* source, const WGPUTexelCopyBufferInfo* destination, const WGPUExtent3D* copySize){
     ENTRY();
+    CommandEncoder_flushCopies(commandEncoder);
     ++commandEncoder->encodedCommandCount;
     ce_trackTexture(
         commandEncoder,
         source->texture,
         (ImageUsageSnap){
             .layout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-            .stage  = VK_PIPELINE_STAGE_TRANSFER_BIT,
+            .stage  = VK_PIPELINE_STAGE_2_COPY_BIT,
             .access = VK_ACCESS_TRANSFER_READ_BIT,
             .subresource = {
                 .aspectMask     = toVulkanAspectMaskVk(source->aspect, source->texture->format),
@@ -5651,7 +8226,7 @@ void wgpuCommandEncoderCopyTextureToBuffer (WGPUCommandEncoder commandEncoder, c
                 .levelCount     = 1,
             }
     });
-    ce_trackBuffer(commandEncoder, destination->buffer, (BufferUsageSnap){VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT});
+    ce_trackBuffer(commandEncoder, destination->buffer, (BufferUsageSnap){VK_PIPELINE_STAGE_2_COPY_BIT, VK_ACCESS_TRANSFER_WRITE_BIT});
     
     
     VkBufferImageCopy region = {
@@ -5675,6 +8250,7 @@ void wgpuCommandEncoderCopyTextureToBuffer (WGPUCommandEncoder commandEncoder, c
             .depth = copySize->depthOrArrayLayers
         }
     };
+    CommandEncoder_flushBarriers(commandEncoder);
     commandEncoder->device->functions.vkCmdCopyImageToBuffer(
         commandEncoder->buffer,
         source->texture->image,
@@ -5687,37 +8263,54 @@ void wgpuCommandEncoderCopyTextureToBuffer (WGPUCommandEncoder commandEncoder, c
 void wgpuCommandEncoderCopyTextureToTexture(WGPUCommandEncoder commandEncoder, const WGPUTexelCopyTextureInfo* source, const WGPUTexelCopyTextureInfo* destination, const WGPUExtent3D* copySize){
     ENTRY();
     ++commandEncoder->encodedCommandCount;
-    ce_trackTexture(
-        commandEncoder,
-        source->texture,
-        (ImageUsageSnap){
-            .layout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-            .stage  = VK_PIPELINE_STAGE_TRANSFER_BIT,
-            .access = VK_ACCESS_TRANSFER_READ_BIT,
-            .subresource = {
-                .aspectMask     = source->aspect,
-                .baseMipLevel   = source->mipLevel,
-                .baseArrayLayer = source->origin.z, // ?
-                .layerCount     = 1,
-                .levelCount     = 1,
-            }
-    });
-    ce_trackTexture(
-        commandEncoder,
-        destination->texture,
-        (ImageUsageSnap){
-            .layout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-            .stage  = VK_PIPELINE_STAGE_TRANSFER_BIT,
-            .access = VK_ACCESS_TRANSFER_WRITE_BIT,
-            .subresource = {
-                .aspectMask     = destination->aspect,
-                .baseMipLevel   = destination->mipLevel,
-                .baseArrayLayer = destination->origin.z, // ?
-                .layerCount     = 1,
-                .levelCount     = 1,
-            }
-    });
-
+    const PendingCopies key = {
+        .type = pending_copy_texture_to_texture,
+        .source = source->texture,
+        .destination = destination->texture,
+        .sourceMipLevel = source->mipLevel,
+        .sourceLayer = source->origin.z,
+        .destinationMipLevel = destination->mipLevel,
+        .sourceAspect = source->aspect,
+        .destinationAspect = destination->aspect,
+    };
+    const VkOffset3D boxBegin = {(int32_t)destination->origin.x, (int32_t)destination->origin.y, (int32_t)destination->origin.z};
+    const VkOffset3D boxEnd = {
+        boxBegin.x + (int32_t)copySize->width,
+        boxBegin.y + (int32_t)copySize->height,
+        boxBegin.z + (int32_t)copySize->depthOrArrayLayers,
+    };
+    if(!CommandEncoder_continueCopies(commandEncoder, &key, boxBegin, boxEnd, 0, 0)){
+        ce_trackTexture(
+            commandEncoder,
+            source->texture,
+            (ImageUsageSnap){
+                .layout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                .stage  = VK_PIPELINE_STAGE_2_BLIT_BIT,
+                .access = VK_ACCESS_TRANSFER_READ_BIT,
+                .subresource = {
+                    .aspectMask     = source->aspect,
+                    .baseMipLevel   = source->mipLevel,
+                    .baseArrayLayer = source->origin.z, // ?
+                    .layerCount     = 1,
+                    .levelCount     = 1,
+                }
+        });
+        ce_trackTexture(
+            commandEncoder,
+            destination->texture,
+            (ImageUsageSnap){
+                .layout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                .stage  = VK_PIPELINE_STAGE_2_BLIT_BIT,
+                .access = VK_ACCESS_TRANSFER_WRITE_BIT,
+                .subresource = {
+                    .aspectMask     = destination->aspect,
+                    .baseMipLevel   = destination->mipLevel,
+                    .baseArrayLayer = destination->origin.z, // ?
+                    .layerCount     = 1,
+                    .levelCount     = 1,
+                }
+        });
+    }
     VkImageBlit region = {
         .srcSubresource = {
             .aspectMask = source->aspect,
@@ -5738,17 +8331,58 @@ void wgpuCommandEncoderCopyTextureToTexture(WGPUCommandEncoder commandEncoder, c
         .dstOffsets[0] = {destination->origin.x,                   destination->origin.y,                    destination->origin.z},
         .dstOffsets[1] = {destination->origin.x + copySize->width, destination->origin.y + copySize->height, destination->origin.z + copySize->depthOrArrayLayers}
     };
-    commandEncoder->device->functions.vkCmdBlitImage(
-        commandEncoder->buffer,
-        source->texture->image,
-        VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-        destination->texture->image,
-        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-        1, &region,
-        VK_FILTER_NEAREST
-    );
+    VkImageBlitVector_push_back(&commandEncoder->pendingCopies.blits, region);
     EXIT();
 }
+static void ce_trackIndirectBuffers(WGPUCommandEncoder encoder, WGPUBuffer indirectBuffer, WGPUBuffer drawCountBuffer){
+    const BufferUsageSnap indirectRead = {
+        .stage = VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+        .access = VK_ACCESS_INDIRECT_COMMAND_READ_BIT
+    };
+    ce_trackBuffer(encoder, indirectBuffer, indirectRead);
+    if(drawCountBuffer){
+        ce_trackBuffer(encoder, drawCountBuffer, indirectRead);
+    }
+}
+
+// Bundles are recorded without a command encoder, so the buffers their draws
+// consume only get their barriers once the bundle is executed in a pass.
+static void ce_trackRenderBundleBuffers(WGPUCommandEncoder encoder, WGPURenderBundle bundle){
+    for(size_t i = 0;i < bundle->bufferedCommands.size;i++){
+        const RenderPassCommandGeneric* cmd = bundle->bufferedCommands.data + i;
+        switch(cmd->type){
+            case rp_command_type_set_bind_group:{
+                const WGPUBindGroup group = cmd->setBindGroup.group;
+                for(uint32_t entryIndex = 0;entryIndex < group->layout->entryCount;entryIndex++){
+                    const WGPUBindGroupLayoutEntry* layoutEntry = group->layout->entries + entryIndex;
+                    if(layoutEntry->buffer.type != WGPUBufferBindingType_BindingNotUsed && group->entries[entryIndex].buffer){
+                        ce_trackBuffer(encoder, group->entries[entryIndex].buffer, bindGroupBufferUsage(layoutEntry, group->entries + entryIndex));
+                    }
+                }
+            }break;
+            case rp_command_type_set_vertex_buffer:
+                ce_trackBuffer(encoder, cmd->setVertexBuffer.buffer, (BufferUsageSnap){VK_PIPELINE_STAGE_2_VERTEX_ATTRIBUTE_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, cmd->setVertexBuffer.offset, WGPU_WHOLE_SIZE});
+            break;
+            case rp_command_type_set_index_buffer:
+                ce_trackBuffer(encoder, cmd->setIndexBuffer.buffer, (BufferUsageSnap){VK_PIPELINE_STAGE_2_INDEX_INPUT_BIT, VK_ACCESS_INDEX_READ_BIT, cmd->setIndexBuffer.offset, WGPU_WHOLE_SIZE});
+            break;
+            case rp_command_type_draw_indirect:
+                ce_trackIndirectBuffers(encoder, cmd->drawIndirect.indirectBuffer, NULL);
+            break;
+            case rp_command_type_draw_indexed_indirect:
+                ce_trackIndirectBuffers(encoder, cmd->drawIndexedIndirect.indirectBuffer, NULL);
+            break;
+            case rp_command_type_multi_draw_indirect:
+                ce_trackIndirectBuffers(encoder, cmd->multiDrawIndirect.indirectBuffer, cmd->multiDrawIndirect.drawCountBuffer);
+            break;
+            case rp_command_type_multi_draw_indexed_indirect:
+                ce_trackIndirectBuffers(encoder, cmd->multiDrawIndexedIndirect.indirectBuffer, cmd->multiDrawIndexedIndirect.drawCountBuffer);
+            break;
+            default: break;
+        }
+    }
+}
+
 void RenderPassEncoder_PushCommand(WGPURenderPassEncoder encoder, const RenderPassCommandGeneric* cmd){
     if(cmd->type == rp_command_type_set_render_pipeline){
         encoder->lastLayout = cmd->setRenderPipeline.pipeline->layout;
@@ -5850,17 +8484,12 @@ void wgpuRenderPassEncoderSetBindGroup(WGPURenderPassEncoder rpe, uint32_t group
         const WGPUBindGroupEntry* entry = &group->entries[i];
 
         if(entry->buffer){
-            const VkAccessFlags accessFlags = extractVkAccessFlags(group->layout->entries + i);
-            const VkPipelineStageFlags stage = toVulkanPipelineStageBits(group->layout->entries[i].visibility);
-            ce_trackBuffer(rpe->cmdEncoder, entry->buffer, (BufferUsageSnap){
-                .stage = stage,
-                .access = accessFlags
-            });
+            ce_trackBuffer(rpe->cmdEncoder, entry->buffer, bindGroupBufferUsage(group->layout->entries + i, entry));
         }
 
         if(entry->textureView){
-            const VkAccessFlags accessFlags = extractVkAccessFlags(group->layout->entries + i);
-            const VkPipelineStageFlags stage = toVulkanPipelineStageBits(group->layout->entries[i].visibility) | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+            const VkAccessFlags2 accessFlags = extractVkAccessFlags(group->layout->entries + i);
+            const VkPipelineStageFlags2 stage = toVulkanPipelineStageBits(group->layout->entries[i].visibility) | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT;
             
             //VkImageLayout layout = (extractVkDescriptorType(group->layout->entries + i) == VK_DESCRIPTOR_TYPE_STORAGE_IMAGE) ? VK_IMAGE_LAYOUT_GENERAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 
@@ -5922,6 +8551,7 @@ void wgpuComputePassEncoderSetBindGroup(WGPUComputePassEncoder cpe, uint32_t gro
 
 WGPUComputePassEncoder wgpuCommandEncoderBeginComputePass(WGPUCommandEncoder commandEncoder, const WGPUComputePassDescriptor* cpdesc){
     ENTRY();
+    CommandEncoder_flushCopies(commandEncoder);
     WGPUComputePassEncoder ret = RL_CALLOC(1, sizeof(WGPUComputePassEncoderImpl));
     ++commandEncoder->encodedCommandCount;
     ret->refCount = 2;
@@ -5936,6 +8566,8 @@ WGPUComputePassEncoder wgpuCommandEncoderBeginComputePass(WGPUCommandEncoder com
 }
 void wgpuComputePassEncoderEnd(WGPUComputePassEncoder commandEncoder){
     ENTRY();
+    CommandEncoder_flushCopies(commandEncoder->cmdEncoder);
+    CommandEncoder_endRendering(commandEncoder->cmdEncoder);
     recordVkCommands(commandEncoder->cmdEncoder, commandEncoder->device, &commandEncoder->bufferedCommands, NULL);
     EXIT();
 }
@@ -5972,6 +8604,7 @@ void pcmNonnullFlattenCallback(void* fence_, WGPUCommandBufferVector* key, void*
 
 WGPURaytracingPassEncoder wgpuCommandEncoderBeginRaytracingPass(WGPUCommandEncoder enc, const WGPURayTracingPassDescriptor* rtDesc){
     ENTRY();
+    CommandEncoder_flushCopies(enc);
     WGPURaytracingPassEncoder rtenc = RL_CALLOC(1, sizeof(WGPURaytracingPassEncoderImpl));
     rtenc->device = enc->device;
     rtenc->refCount = 2;
@@ -5984,13 +8617,18 @@ WGPURaytracingPassEncoder wgpuCommandEncoderBeginRaytracingPass(WGPUCommandEncod
 
 void wgpuRaytracingPassEncoderEnd(WGPURaytracingPassEncoder commandEncoder){
     ENTRY();
+    CommandEncoder_flushCopies(commandEncoder->cmdEncoder);
+    CommandEncoder_endRendering(commandEncoder->cmdEncoder);
     recordVkCommands(commandEncoder->cmdEncoder, commandEncoder->device, &commandEncoder->bufferedCommands, NULL);
     EXIT();
 }
 void wgpuFenceReset(WGPUFence fence){
     wgvk_assert(atomic_load_explicit(&fence->state, memory_order_acquire) == WGPUFenceState_Finished, "Fence must be finished");
-    fence->device->functions.vkResetFences(fence->device->device, 1, &fence->fence);
-    atomic_store_explicit(&fence->state, memory_order_release, WGPUFenceState_Reset);
+    if(fence->fence != VK_NULL_HANDLE){
+        fence->device->functions.vkResetFences(fence->device->device, 1, &fence->fence);
+    }
+    fence->timelineValue = 0;
+    atomic_store_explicit(&fence->state, WGPUFenceState_Reset, memory_order_release);
 }
 
 
@@ -5998,7 +8636,10 @@ void resetFenceAndReleaseBuffers(void* fence_, WGPUCommandBufferVector* cBuffers
     WGPUDevice device = (WGPUDevice)wgpudevice;
     if(fence_){
         WGPUFence fence = fence_;
-        device->functions.vkResetFences(device->device, 1, &fence->fence);
+        if(fence->fence != VK_NULL_HANDLE){
+            device->functions.vkResetFences(device->device, 1, &fence->fence);
+        }
+        fence->timelineValue = 0;
         fence->state = WGPUFenceState_Reset;
         wgpuFenceRelease(fence);
     }
@@ -6007,11 +8648,13 @@ void resetFenceAndReleaseBuffers(void* fence_, WGPUCommandBufferVector* cBuffers
         BufferUsageRecordMap* bmap = &relBuffer->resourceUsage.referencedBuffers;
         for(size_t bi = 0; bi < bmap->current_capacity;bi++){
             BufferUsageRecordMap_kv_pair* kvp = bmap->table + bi;
-            if(kvp->key != PHM_EMPTY_SLOT_KEY){
+            if(kvp->key != PHM_EMPTY_SLOT_KEY && kvp->key != PHM_DELETED_SLOT_KEY){
                 WGPUBuffer buffer = (WGPUBuffer)kvp->key;
-                if(buffer->latestFence){
+                // A later submission may have replaced the buffer's fence already
+                if(buffer->latestFence == fence_ && fence_ != NULL){
                     wgpuFenceRelease(buffer->latestFence);
                     buffer->latestFence = VK_NULL_HANDLE;
+                    buffer->latestFenceWrites = VK_FALSE;
                 }
             }
         }
@@ -6070,9 +8713,23 @@ void wgpuSurfaceGetCurrentTexture(WGPUSurface surface, WGPUSurfaceTexture* surfa
     EXIT();
 }
 
+// Work the queue recorded on its own (zero fills, staged writes) must not wait for a wgpuQueueSubmit that may never come
+static void Queue_submitPresubmitCache(WGPUQueue queue){
+    Queue_flushPendingWrites(queue);
+    if(queue->presubmitCache->encodedCommandCount > 0){
+        wgpuQueueSubmit(queue, 0, NULL);
+    }
+}
+
+static void storeLayoutVisitor(const SubresourceState* before, bool tracked, void* layout){
+    (void)tracked;
+    *(VkImageLayout*)layout = before->layout;
+}
+
 void wgpuSurfacePresent(WGPUSurface surface){
     ENTRY();
     WGPUDevice device = surface->device;
+    Queue_submitPresubmitCache(device->queue);
     uint32_t cacheIndex = surface->device->submittedFrames % framesInFlight;
     PerframeCache* frameCache = DeviceGetFIFCache(surface->device, cacheIndex);
     PendingCommandBufferMap* pcm = &frameCache->pendingCommandBuffers;
@@ -6086,52 +8743,65 @@ void wgpuSurfacePresent(WGPUSurface surface){
 
     device->functions.vkBeginCommandBuffer(transitionBuffer, &transitionBufferBeginInfo);
 
-    VkImageMemoryBarrier finalBarrier = {
-        VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
-        NULL,
-        VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
-        VK_ACCESS_MEMORY_READ_BIT,
-        surface->images[surface->activeImageIndex]->layout,
-        VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
-        surface->device->adapter->queueIndices.graphicsIndex,
-        surface->device->adapter->queueIndices.graphicsIndex,
-        surface->images[surface->activeImageIndex]->image,
-        {
+    WGPUTexture presentedImage = surface->images[surface->activeImageIndex];
+    // The acquire semaphore orders the next use of the image, which waits on it in all stages
+    const SubresourceState presentState = {
+        .levelCount = 1,
+        .layerCount = 1,
+        .layout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+    };
+    VkImageLayout renderedLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    SubresourceStates_transition(&presentedImage->states, &presentState, storeLayoutVisitor, &renderedLayout);
+    const VkImageMemoryBarrier2 finalBarrier = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+        .srcStageMask = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+        .srcAccessMask = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+        .dstStageMask = VK_PIPELINE_STAGE_2_NONE,
+        .dstAccessMask = VK_ACCESS_2_NONE,
+        .oldLayout = renderedLayout,
+        .newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+        .srcQueueFamilyIndex = surface->device->adapter->queueIndices.graphicsIndex,
+        .dstQueueFamilyIndex = surface->device->adapter->queueIndices.graphicsIndex,
+        .image = presentedImage->image,
+        .subresourceRange = {
             VK_IMAGE_ASPECT_COLOR_BIT,
             0, VK_REMAINING_MIP_LEVELS,
             0, VK_REMAINING_ARRAY_LAYERS
         }
     };
-    device->functions.vkCmdPipelineBarrier(
-        transitionBuffer,
-        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-        VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
-        0,
-        0, NULL,
-        0, NULL,
-        1, &finalBarrier  
-    );
-    surface->images[surface->activeImageIndex]->layout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    const VkDependencyInfo finalDependency = {
+        .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .imageMemoryBarrierCount = 1,
+        .pImageMemoryBarriers = &finalBarrier,
+    };
+    Device_pipelineBarrier(device, transitionBuffer, &finalDependency);
     device->functions.vkEndCommandBuffer(transitionBuffer);
     VkPipelineStageFlags wsmask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    // Without a timeline the transition waits for the last submit of the frame. With one, submission order
+    // covers that and only an acquire no submit has waited for yet is left
+    VkSemaphore waitSemaphore = VK_NULL_HANDLE;
+    if(!device->capabilities.timelineSemaphore){
+        waitSemaphore = syncState->semaphores.data[syncState->submits];
+    }
+    else if(syncState->acquireImageSemaphoreSignalled){
+        waitSemaphore = syncState->acquireImageSemaphore;
+        syncState->acquireImageSemaphoreSignalled = false;
+    }
     const VkSubmitInfo cbsinfo = {
         .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
         .pNext = NULL,
         .commandBufferCount = 1,
         .pCommandBuffers = &transitionBuffer,
         .signalSemaphoreCount = 1,
-        .waitSemaphoreCount = 1,
+        .waitSemaphoreCount = waitSemaphore != VK_NULL_HANDLE ? 1 : 0,
         .pWaitDstStageMask = &wsmask,
-        .pWaitSemaphores = &syncState->semaphores.data[syncState->submits],
+        .pWaitSemaphores = &waitSemaphore,
         .pSignalSemaphores = surface->presentSemaphores + surface->activeImageIndex
     };
     
     WGPUFence finalTransitionFence = frameCache->finalTransitionFence;
     wgpuFenceAddRef(finalTransitionFence);
-    //printf("Submitting %p with fence %p\n", transitionBuffer, finalTransitionFence);
-    device->functions.vkQueueSubmit(surface->device->queue->graphicsQueue, 1, &cbsinfo, finalTransitionFence->fence);
-    
-    finalTransitionFence->state = WGPUFenceState_InUse;
+    Queue_submit(device->queue, &cbsinfo, NULL, 0, finalTransitionFence);
     
     WGPUCommandBufferVector* cmdBuffers = PendingCommandBufferMap_get(pcm, (void*)finalTransitionFence);
     
@@ -6151,22 +8821,36 @@ void wgpuSurfacePresent(WGPUSurface surface){
         .pImageIndices = &surface->activeImageIndex,
     };
 
+    Queue_lockVkQueue(surface->device->queue);
     VkResult presentRes = device->functions.vkQueuePresentKHR(surface->device->queue->presentQueue, &presentInfo);
+    Queue_unlockVkQueue(surface->device->queue);
     if(presentRes != VK_SUCCESS){
         fprintf(stderr, "vkQueuePresentKHR returned %s\n", vkErrorString(presentRes));
     }
     wgpuDeviceTick(surface->device);
     EXIT();
 }
-void wgpuDeviceTick(WGPUDevice device){
-    ENTRY();
-    WGPUQueue queue = device->queue;
+// Submits what the queue recorded on its own and drops its presubmitCache, which belongs to the ending frame
+static void Queue_finishPresubmitCache(WGPUQueue queue){
     WGPUCommandBufferDescriptor cbd = {
         .label = STRVIEW("PresubmitCache"),
     };
+    Queue_submitPresubmitCache(queue);
     WGPUCommandBuffer buffer = wgpuCommandEncoderFinish(queue->presubmitCache, &cbd);
     wgpuCommandEncoderRelease(queue->presubmitCache);
     wgpuCommandBufferRelease(buffer);
+}
+
+void wgpuDeviceTick(WGPUDevice device){
+    ENTRY();
+    Queue_finishPresubmitCache(device->queue);
+    if(device->asyncComputeQueue){
+        Queue_finishPresubmitCache(device->asyncComputeQueue);
+    }
+    // Last, submits to the other queues flush it and read its presubmit cache
+    if(device->transferQueue){
+        Queue_finishPresubmitCache(device->transferQueue);
+    }
     
     {
         const uint32_t toBeFinishedCacheIndex = device->submittedFrames % framesInFlight;
@@ -6178,16 +8862,16 @@ void wgpuDeviceTick(WGPUDevice device){
         const uint32_t tsubmits = syncStatetbf->submits;
         WGPUCommandBufferVector* pendingForFTF = PendingCommandBufferMap_get(pcmtbf, frameCachetbf->finalTransitionFence);
         
-        if(pendingForFTF == NULL){
+        // Only the binary chain has to be consumed and fenced, timeline fences of the frame's submits already cover it
+        if(pendingForFTF == NULL && !device->capabilities.timelineSemaphore){
             VkSubmitInfo emptySubmit = {
                 .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
                 .waitSemaphoreCount = 1,
                 .pWaitSemaphores = VkSemaphoreVector_get(&syncStatetbf->semaphores, tsubmits),
                 .pWaitDstStageMask = &waitmask
             };
-            device->functions.vkQueueSubmit(device->queue->graphicsQueue, 1, &emptySubmit, frameCachetbf->finalTransitionFence->fence);
+            Queue_submit(device->queue, &emptySubmit, NULL, 0, frameCachetbf->finalTransitionFence);
             wgpuFenceAddRef(frameCachetbf->finalTransitionFence);
-            frameCachetbf->finalTransitionFence->state = WGPUFenceState_InUse;
             WGPUCommandBufferVector insert;
             WGPUCommandBufferVector_init(&insert);
             WGPUFence ftf = frameCachetbf->finalTransitionFence;
@@ -6222,7 +8906,7 @@ void wgpuDeviceTick(WGPUDevice device){
     if(pcmNew->current_size > 0){
         PendingCommandBufferMap_for_each(pcmNew, pcmNonnullFlattenCallback, (void*)&fences);
         if(fences.size > 0){
-            wgpuFencesWait(fences.data, fences.size, UINT32_MAX);
+            wgpuFencesWait(fences.data, fences.size, UINT64_MAX);
             //printf("Waiting for fences:\n");
             //for(uint32_t i = 0;i < fences.size;i++){
             //    printf("  %p\n", fences.data[i]);
@@ -6235,42 +8919,89 @@ void wgpuDeviceTick(WGPUDevice device){
 
     PendingCommandBufferMap_for_each(pcmNew, resetFenceAndReleaseBuffers, device);    
     WGPUFenceVector_free(&fences);
+    PerframeCache_releaseRetired(device, frameCacheMew);
 
+    // Batch buffers are recycled once the cache holds the only reference. Encoders and command buffers that
+    // outlive the frame, or were submitted in another one, keep theirs until they are released
+    wgvk_mutex_lock(frameCacheMew->batchBuffersMutex);
     WGPUBufferVector* usedBuffers = &frameCacheMew->usedBatchBuffers;
-    WGPUBufferVector* unusedBuffers = &frameCacheMew->unusedBatchBuffers;
-    if(unusedBuffers->capacity < unusedBuffers->size + usedBuffers->size){
-        size_t newcap = (unusedBuffers->size + usedBuffers->size);
-        WGPUBufferVector_reserve(unusedBuffers, newcap);
-    }
-    if(usedBuffers->size > 0){
-        memcpy(unusedBuffers->data + unusedBuffers->size, usedBuffers->data, usedBuffers->size * sizeof(WGPUBuffer));
+    size_t stillUsed = 0;
+    for(size_t i = 0;i < usedBuffers->size;i++){
+        WGPUBuffer batchBuffer = usedBuffers->data[i];
+        if(batchBuffer->refCount == 1){
+            WGPUBufferVector_push_back(&frameCacheMew->unusedBatchBuffers, batchBuffer);
+        }
+        else{
+            usedBuffers->data[stillUsed++] = batchBuffer;
+        }
     }
-    unusedBuffers->size += usedBuffers->size;
-    WGPUBufferVector_clear(usedBuffers);//(WGPUBufferVector *dest, const WGPUBufferVector *source)
+    usedBuffers->size = stillUsed;
+    wgvk_mutex_unlock(frameCacheMew->batchBuffersMutex);
     
+    PerframeCache_recycleCommandPools(device, frameCacheMew);
 
-    VkCommandPool poolToClear = frameCacheMew->commandPool;
+    PendingCommandBufferMap_clear(pcmNew);
 
-    // This line is currently commented out because they cause an 
-    // issue with CommandEncoders living across wgpuDeviceTick (and wgpuSurfacePresent) calls
-    //
-    // device->functions.vkResetCommandPool(device->device, poolToClear, 0);
+    device->queue->presubmitCache = Queue_createPresubmitCache(device->queue);
+    if(device->asyncComputeQueue){
+        device->asyncComputeQueue->presubmitCache = Queue_createPresubmitCache(device->asyncComputeQueue);
+    }
+    if(device->transferQueue){
+        device->transferQueue->presubmitCache = Queue_createPresubmitCache(device->transferQueue);
+    }
+    syncStateMew->submits = 0;
+    EXIT();
+}
 
-    for(size_t i = 0;i < pcmNew->current_capacity;i++){
-        PendingCommandBufferMap_kv_pair* entry_pair = pcmNew->table + i;
-        if(entry_pair->key){
-            const WGPUCommandBufferVector* vector = &entry_pair->value;
-            for(size_t j = 0;j < vector->size;j++){
-                //device->functions.vkFreeCommandBuffers(device->device, poolToClear, 1, &vector->data[j]->buffer);
-            }
-        }
+typedef struct RetireSignalledState{
+    WGPUDevice device;
+    PendingCommandBufferMap pending;
+}RetireSignalledState;
+
+static void retireSignalledCallback(void* fence_, WGPUCommandBufferVector* cBuffers, void* userdata){
+    RetireSignalledState* state = (RetireSignalledState*)userdata;
+    if(fence_ != NULL && Fence_poll((WGPUFence)fence_)){
+        resetFenceAndReleaseBuffers(fence_, cBuffers, state->device);
     }
-    PendingCommandBufferMap_clear(pcmNew);
+    else{
+        PendingCommandBufferMap_put(&state->pending, fence_, *cBuffers);
+    }
+}
 
-    WGPUCommandEncoderDescriptor cedesc zeroinit;
-    device->queue->presubmitCache = wgpuDeviceCreateCommandEncoder(device, &cedesc);
-    syncStateMew->submits = 0;
+// Retires the submissions of the frame whose fences the GPU already reached, the others stay for wgpuDeviceTick.
+// Returns whether none are left
+static bool PerframeCache_retireSignalled(WGPUDevice device, PerframeCache* cache){
+    PendingCommandBufferMap* pcm = &cache->pendingCommandBuffers;
+    if(pcm->current_size == 0 && !pcm->has_null_key){
+        return true;
+    }
+    RetireSignalledState state = {
+        .device = device,
+    };
+    PendingCommandBufferMap_init(&state.pending);
+    PendingCommandBufferMap_for_each(pcm, retireSignalledCallback, &state);
+    PendingCommandBufferMap_move(pcm, &state.pending);
+    return pcm->current_size == 0 && !pcm->has_null_key;
+}
+
+WGPUBool wgpuDevicePoll(WGPUDevice device){
+    ENTRY();
+    // The current frame's cache is left alone, wgpuDeviceTick still adds its final transition to it
+    const uint32_t currentCacheIndex = device->submittedFrames % framesInFlight;
+    const uint32_t nextCacheIndex = (device->submittedFrames + 1) % framesInFlight;
+    // With a single frame in flight wgpuDeviceTick waits for the current one
+    bool nextFrameRetired = nextCacheIndex != currentCacheIndex || DeviceGetFIFCache(device, currentCacheIndex)->pendingCommandBuffers.current_size == 0;
+    for(uint32_t i = 0;i < framesInFlight;i++){
+        if(i == currentCacheIndex){
+            continue;
+        }
+        const bool retired = PerframeCache_retireSignalled(device, DeviceGetFIFCache(device, i));
+        if(i == nextCacheIndex){
+            nextFrameRetired = retired;
+        }
+    }
     EXIT();
+    return nextFrameRetired;
 }
 
 WGPUSampler wgpuDeviceCreateSampler(WGPUDevice device, const WGPUSamplerDescriptor* descriptor){
@@ -6313,7 +9044,7 @@ void wgpuRenderPassEncoderSetVertexBuffer(WGPURenderPassEncoder rpe, uint32_t bi
 
     RenderPassEncoder_PushCommand(rpe, &insert);
     
-    ce_trackBuffer(rpe->cmdEncoder, buffer, (BufferUsageSnap){VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT});
+    ce_trackBuffer(rpe->cmdEncoder, buffer, (BufferUsageSnap){VK_PIPELINE_STAGE_2_VERTEX_ATTRIBUTE_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, offset, size});
     EXIT();
 }
 
@@ -6329,6 +9060,7 @@ void wgpuRenderPassEncoderExecuteBundles(WGPURenderPassEncoder renderPassEncoder
         };
         RenderPassCommandGenericVector_push_back(&renderPassEncoder->bufferedCommands, insert);
         ru_trackRenderBundle(&renderPassEncoder->resourceUsage, bundles[i]);
+        ce_trackRenderBundleBuffers(renderPassEncoder->cmdEncoder, bundles[i]);
     }
     EXIT();
 }
@@ -6344,6 +9076,7 @@ void wgpuRenderPassEncoderDrawIndexedIndirect(WGPURenderPassEncoder renderPassEn
         }
     };
     RenderPassEncoder_PushCommand(renderPassEncoder, &insert);
+    ce_trackIndirectBuffers(renderPassEncoder->cmdEncoder, indirectBuffer, NULL);
     EXIT();
 }
 void wgpuRenderPassEncoderDrawIndirect           (WGPURenderPassEncoder renderPassEncoder, WGPUBuffer indirectBuffer, uint64_t indirectOffset) WGPU_FUNCTION_ATTRIBUTE{
@@ -6356,6 +9089,7 @@ void wgpuRenderPassEncoderDrawIndirect           (WGPURenderPassEncoder renderPa
         }
     };
     RenderPassEncoder_PushCommand(renderPassEncoder, &insert);
+    ce_trackIndirectBuffers(renderPassEncoder->cmdEncoder, indirectBuffer, NULL);
     EXIT();
 }
 void wgpuRenderPassEncoderSetBlendConstant       (WGPURenderPassEncoder renderPassEncoder, const WGPUColor* color) WGPU_FUNCTION_ATTRIBUTE{
@@ -6415,8 +9149,10 @@ void wgpuRenderPassEncoderSetIndexBuffer(WGPURenderPassEncoder rpe, WGPUBuffer b
     RenderPassEncoder_PushCommand(rpe, &insert);
     
     ce_trackBuffer(rpe->cmdEncoder, buffer, (BufferUsageSnap){
-        .stage = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 
-        .access = VK_ACCESS_INDEX_READ_BIT
+        .stage = VK_PIPELINE_STAGE_2_INDEX_INPUT_BIT, 
+        .access = VK_ACCESS_INDEX_READ_BIT,
+        .offset = offset,
+        .size = size
     });
     EXIT();
 }
@@ -6532,249 +9268,233 @@ RGAPI void ru_trackSampler         (ResourceUsage* resourceUsage, WGPUSampler sa
     }
 }
 
-typedef enum barrierType{
-    bt_no_barrier = 0,
-    bt_buffer_barrier = 1,
-    bt_memory_barrier = 2,
-    bt_image_barrier = 3,
-    bt_force32 = 0x7fffffff
-} barrierType;
-
-typedef struct OptionalBarrier{
-    barrierType type;
-    VkPipelineStageFlags srcStage;
-    VkPipelineStageFlags dstStage;
-    union{
-        VkBufferMemoryBarrier bufferBarrier;
-        VkMemoryBarrier memoryBarrier;
-        VkImageMemoryBarrier imageBarrier;
-    };
-}OptionalBarrier;
-
-static OptionalBarrier ru_trackTextureAndEmit(ResourceUsage* resourceUsage, WGPUTexture texture, ImageUsageSnap usage){
-    ImageUsageRecord* alreadyThere = ImageUsageRecordMap_get(&resourceUsage->referencedTextures, texture);
-    if(alreadyThere){
-        const VkImageMemoryBarrier barr = {
-            VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
-            NULL,
-            alreadyThere->lastAccess,
-            usage.access,
-            alreadyThere->lastLayout,
-            usage.layout,
-            texture->device->adapter->queueIndices.graphicsIndex,
-            texture->device->adapter->queueIndices.graphicsIndex,
-            texture->image,
-            usage.subresource
-        };
-        alreadyThere->lastStage  = usage.stage;
-        alreadyThere->lastAccess = usage.access;
-        alreadyThere->lastLayout = usage.layout;
-        const OptionalBarrier ret = {
-            .srcStage = alreadyThere->lastStage,
-            .dstStage = usage.stage,
-            .type = bt_image_barrier,
-            .imageBarrier = barr
-        };
-        return ret;
-    }
-    else{
-        const ImageUsageRecord record = {
-            .initialAccess = usage.access,
-            .initialStage = usage.stage,
-            .initialLayout = usage.layout,
-            .lastLayout = usage.layout,
-            .lastStage = usage.stage,
-            .lastAccess = usage.access,
-            .initiallyAccessedSubresource = usage.subresource,
-            .lastAccessedSubresource = usage.subresource
-        };
-        int newEntry = ImageUsageRecordMap_put(&resourceUsage->referencedTextures, texture, record);
-        wgvk_assert(newEntry != 0, "_get failed, but _put did not return 1");
-        if(newEntry)
-            ++texture->refCount;
+DEFINE_VECTOR_WITH_INLINE_STORAGE(static inline, BufferRangeState, BufferRangeStateILVector, 8);
 
-        return (OptionalBarrier){
-            .type = bt_no_barrier
-        };
+static void BufferRangeStates_push(BufferRangeStateILVector* ranges, BufferRangeState range){
+    if(ranges->size > 0){
+        BufferRangeState* previous = ranges->data + ranges->size - 1;
+        const bool sameProducer = !isWritingAccess(range.access) || previous->producer == range.producer;
+        if(previous->offset + previous->size == range.offset && previous->stage == range.stage && previous->access == range.access && sameProducer){
+            previous->size += range.size;
+            return;
+        }
     }
+    BufferRangeStateILVector_push_back(ranges, range);
 }
 
-static OptionalBarrier ru_trackTextureViewAndEmit(ResourceUsage* resourceUsage, WGPUTextureView view, ImageUsageSnap usage){
-    ru_trackTextureView(resourceUsage, view);
-    
-    ImageUsageRecord* alreadyThere = ImageUsageRecordMap_get(&resourceUsage->referencedTextures, view->texture);
-    if(alreadyThere){
-        const VkImageMemoryBarrier barr = {
-            VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
-            NULL,
-            alreadyThere->lastAccess,
-            usage.access,
-            alreadyThere->lastLayout,
-            usage.layout, 
-            view->texture->device->adapter->queueIndices.graphicsIndex,
-            view->texture->device->adapter->queueIndices.graphicsIndex,
-            view->texture->image,
-            view->subresourceRange
-        };
-        alreadyThere->lastStage  = usage.stage;
-        alreadyThere->lastAccess = usage.access;
-        alreadyThere->lastLayout = usage.layout;
-        const OptionalBarrier ret = {
-            .srcStage = alreadyThere->lastStage,
-            .dstStage = usage.stage,
-            .type = bt_image_barrier,
-            .imageBarrier = barr
-        };
-        return ret;
+typedef struct BufferRangeTransition{
+    WGPUCommandEncoder encoder;
+    WGPUBuffer buffer;
+    BufferUsageRecord* record;
+    BufferRangeStateILVector* result;
+    const BufferUsageSnap* usage;
+}BufferRangeTransition;
+
+// Bytes [offset, offset + size) were used as before and are now used as described by usage
+static void bufferRangeTransition(const BufferRangeTransition* transition, uint64_t offset, uint64_t size, const BufferRangeState* before){
+    const BufferUsageSnap* usage = transition->usage;
+    WGPUCommandEncoder encoder = transition->encoder;
+    const BufferRangeState next = {offset, size, usage->stage, usage->access, encoder->commandSerial};
+    if(before == NULL){
+        // First use in this command buffer, ordered against earlier submits by the submit prologue
+        transition->record->initialStage  |= usage->stage;
+        transition->record->initialAccess |= usage->access;
+        BufferRangeStates_push(transition->result, next);
+        return;
+    }
+    const bool readAfterRead = !isWritingAccess(before->access) && !isWritingAccess(usage->access);
+    if(readAfterRead && (usage->stage & ~before->stage) == 0 && (usage->access & ~before->access) == 0){
+        // The barrier in front of the earlier reads made the data visible to this one as well
+        BufferRangeStates_push(transition->result, (BufferRangeState){offset, size, before->stage, before->access, before->producer});
+        return;
+    }
+    if(isWritingAccess(before->access)){
+        if(before->producer == encoder->commandSerial - 1){
+            // Directly follows the write, an event would not let anything run in between
+            encoder->previousWritesConsumed = true;
+        }
+        else if(before->producer != encoder->commandSerial && CommandEncoder_waitForProducer(encoder, before->producer)){
+            BufferRangeStates_push(transition->result, next);
+            return;
+        }
+    }
+    const VkBufferMemoryBarrier2 bufferBarrier = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2,
+        .srcStageMask = before->stage,
+        .srcAccessMask = writingAccesses(before->access),
+        .dstStageMask = usage->stage,
+        .dstAccessMask = usage->access,
+        .srcQueueFamilyIndex = transition->buffer->device->adapter->queueIndices.graphicsIndex,
+        .dstQueueFamilyIndex = transition->buffer->device->adapter->queueIndices.graphicsIndex,
+        .buffer = transition->buffer->buffer,
+        .offset = offset,
+        .size = size
+    };
+    CommandEncoder_queueBufferBarrier(encoder, &bufferBarrier);
+    if(readAfterRead){
+        // A later write has to wait for all of the reads
+        BufferRangeStates_push(transition->result, (BufferRangeState){offset, size, before->stage | usage->stage, before->access | usage->access, before->producer});
     }
     else{
-        const ImageUsageRecord record = {
-            .initialAccess = usage.access,
-            .initialStage = usage.stage,
-            .initialLayout = usage.layout,
-            .lastLayout = usage.layout,
-            .lastStage = usage.stage,
-            .lastAccess = usage.access,
-            .initiallyAccessedSubresource = view->subresourceRange,
-            .lastAccessedSubresource = view->subresourceRange
-        };
-        int newEntry = ImageUsageRecordMap_put(&resourceUsage->referencedTextures, view->texture, record);
-        wgvk_assert(newEntry != 0, "_get failed, but _put did not return 1");
-        if(newEntry)
-            ++view->texture->refCount;
-
-        return (OptionalBarrier){
-            .type = bt_no_barrier
-        };
+        BufferRangeStates_push(transition->result, next);
     }
 }
-static OptionalBarrier ru_trackBufferAndEmit(ResourceUsage* resourceUsage, WGPUBuffer buffer, BufferUsageSnap usage){
-    BufferUsageRecord* rec = BufferUsageRecordMap_get(&resourceUsage->referencedBuffers, buffer);
-    
-    if(rec != NULL){
-        const VkBufferMemoryBarrier bufferBarrier = {
-            VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
-            NULL,
-            rec->lastAccess,
-            usage.access, 
-            buffer->device->adapter->queueIndices.graphicsIndex,
-            buffer->device->adapter->queueIndices.graphicsIndex,
-            buffer->buffer,
-            0,
-            VK_WHOLE_SIZE
-        };
-        const OptionalBarrier ret = {
-            .type = bt_buffer_barrier,
-            .bufferBarrier = bufferBarrier,
-            .srcStage = rec->lastStage,
-            .dstStage = usage.stage,
-        };
-        rec->lastAccess = usage.access;
-        rec->lastStage = usage.stage;
-        rec->everWrittenTo |= isWritingAccess(usage.access);
-        
-        return ret;
+
+// Barriers are only emitted for the parts of the range where the previous use or this one writes
+static void ce_trackBufferRange(WGPUCommandEncoder encoder, WGPUBuffer buffer, BufferUsageSnap usage){
+    if(usage.offset >= buffer->capacity){
+        return;
     }
-    else{
+    const uint64_t begin = usage.offset;
+    const uint64_t end = (usage.size == 0 || usage.size == WGPU_WHOLE_SIZE || usage.size > buffer->capacity - begin) ? buffer->capacity : begin + usage.size;
+    BufferUsageRecord* rec = BufferUsageRecordMap_get(&encoder->resourceUsage.referencedBuffers, buffer);
+    if(rec == NULL){
         const BufferUsageRecord record = {
-            .initialStage = usage.stage,
-            .initialAccess = usage.access,
-            .lastStage = usage.stage,
-            .lastAccess = usage.access,
-            .everWrittenTo = isWritingAccess(usage.access)
+            .unsubmitted = VK_TRUE,
         };
-        ru_trackBuffer(resourceUsage, buffer, record);
-        return (OptionalBarrier){bt_no_barrier};
-    }
-}
-
-static void encoderOptionalBarrierVk(VkCommandBuffer buffer, PFN_vkCmdPipelineBarrier barrier_fn, OptionalBarrier barrier){
-    uint32_t bufferBarriers = 0;
-    uint32_t memoryBarriers = 0;
-    uint32_t imageBarriers  = 0;
-    VkBufferMemoryBarrier* bufferBarrier = NULL;
-    VkMemoryBarrier*       memoryBarrier = NULL;
-    VkImageMemoryBarrier*  imageBarrier  = NULL;
-    switch(barrier.type){
-        case bt_buffer_barrier:{
-            bufferBarrier = &barrier.bufferBarrier;
-            ++bufferBarriers;
-        }break;
-        case bt_image_barrier:{
-            imageBarrier = &barrier.imageBarrier;
-            ++imageBarriers;
-        }break;
-        case bt_memory_barrier:{
-            memoryBarrier = &barrier.memoryBarrier;
-            ++memoryBarriers;
-        }break;
-
-        default: return;
+        ++buffer->unsubmittedUses;
+        ru_trackBuffer(&encoder->resourceUsage, buffer, record);
+        rec = BufferUsageRecordMap_get(&encoder->resourceUsage.referencedBuffers, buffer);
+    }
+    rec->everWrittenTo |= isWritingAccess(usage.access);
+    if(isWritingAccess(usage.access)){
+        encoder->currentWriteStages   |= usage.stage;
+        encoder->currentWriteAccesses |= writingAccesses(usage.access);
+    }
+
+    BufferRangeStateILVector result;
+    BufferRangeStateILVector_init(&result);
+    const BufferRangeTransition transition = {
+        .encoder = encoder,
+        .buffer = buffer,
+        .record = rec,
+        .result = &result,
+        .usage = &usage,
+    };
+    uint64_t cursor = begin;
+    for(size_t i = 0;i < rec->ranges.size;i++){
+        const BufferRangeState range = rec->ranges.data[i];
+        const uint64_t rangeEnd = range.offset + range.size;
+        if(rangeEnd <= begin || range.offset >= end){
+            if(range.offset >= end && cursor < end){
+                bufferRangeTransition(&transition, cursor, end - cursor, NULL);
+                cursor = end;
+            }
+            BufferRangeStates_push(&result, range);
+            continue;
+        }
+        if(range.offset < begin){
+            BufferRangeStates_push(&result, (BufferRangeState){range.offset, begin - range.offset, range.stage, range.access, range.producer});
+        }
+        const uint64_t overlapBegin = MAX(range.offset, begin);
+        const uint64_t overlapEnd = MIN(rangeEnd, end);
+        if(cursor < overlapBegin){
+            bufferRangeTransition(&transition, cursor, overlapBegin - cursor, NULL);
+        }
+        bufferRangeTransition(&transition, overlapBegin, overlapEnd - overlapBegin, &range);
+        cursor = overlapEnd;
+        if(rangeEnd > end){
+            BufferRangeStates_push(&result, (BufferRangeState){end, rangeEnd - end, range.stage, range.access, range.producer});
+        }
+    }
+    if(cursor < end){
+        bufferRangeTransition(&transition, cursor, end - cursor, NULL);
+    }
+
+    BufferRangeStateVector_clear(&rec->ranges);
+    rec->lastStage = 0;
+    rec->lastAccess = 0;
+    for(size_t i = 0;i < result.size;i++){
+        BufferRangeStateVector_push_back(&rec->ranges, result.data[i]);
+        rec->lastStage  |= result.data[i].stage;
+        rec->lastAccess |= result.data[i].access;
+    }
+    BufferRangeStateILVector_free(&result);
+}
+
+typedef struct EncoderImageTransition{
+    WGPUCommandEncoder encoder;
+    WGPUTexture texture;
+    ImageUsageRecord* record;
+    const SubresourceState* next;
+}EncoderImageTransition;
+
+// Parts used before in this command buffer get a barrier from that use, parts used for the first time
+// become part of the record's initial state, which the submit transitions them into.
+static void encoderImageTransitionVisitor(const SubresourceState* before, bool tracked, void* userdata){
+    const EncoderImageTransition* transition = (const EncoderImageTransition*)userdata;
+    const SubresourceState* next = transition->next;
+    if(!tracked){
+        SubresourceState first = *before;
+        first.layout = next->layout;
+        first.stage  = next->stage;
+        first.access = next->access;
+        SubresourceStates_transition(&transition->record->initialStates, &first, NULL, NULL);
+        return;
     }
-    barrier_fn(
-        buffer,
-        barrier.srcStage ? barrier.srcStage : VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
-        barrier.dstStage,
-        0,
-        memoryBarriers, memoryBarrier,
-        bufferBarriers, bufferBarrier,
-        imageBarriers,  imageBarrier
-    );
-}
-static void encoderOptionalBarrier(WGPUCommandEncoder encoder, OptionalBarrier barrier){
-    encoderOptionalBarrierVk(encoder->buffer, encoder->device->functions.vkCmdPipelineBarrier, barrier);
-}
-static void ru_trackAndEncodeTexture(WGPUCommandEncoder encoder, ResourceUsage* resourceUsage, WGPUTexture texture, ImageUsageSnap usage){
-    OptionalBarrier barrier = ru_trackTextureAndEmit(resourceUsage, texture, usage);
-    encoderOptionalBarrier(encoder, barrier);
-}
-
-static void ru_trackAndEncodeTextureView(WGPUCommandEncoder encoder, ResourceUsage* resourceUsage, WGPUTextureView view, ImageUsageSnap usage){
-    OptionalBarrier barrier = ru_trackTextureViewAndEmit(resourceUsage, view, usage);
-    encoderOptionalBarrier(encoder, barrier);
-}
-
-static void ru_trackAndEncodeBuffer(WGPUCommandEncoder encoder, ResourceUsage* resourceUsage, WGPUBuffer buffer, BufferUsageSnap usage){
-    OptionalBarrier barrier = ru_trackBufferAndEmit(resourceUsage, buffer, usage);
-    encoderOptionalBarrier(encoder, barrier);
-}
-
-static void ru_trackAndEncodeTextureVk(VkCommandBuffer buffer, ResourceUsage* resourceUsage, WGPUTexture texture, ImageUsageSnap usage){
-    OptionalBarrier barrier = ru_trackTextureAndEmit(resourceUsage, texture, usage);
-    encoderOptionalBarrierVk(buffer, texture->device->functions.vkCmdPipelineBarrier, barrier);
-}
-
-static void ru_trackAndEncodeTextureViewVk(VkCommandBuffer buffer, ResourceUsage* resourceUsage, WGPUTextureView view, ImageUsageSnap usage){
-    OptionalBarrier barrier = ru_trackTextureViewAndEmit(resourceUsage, view, usage);
-    encoderOptionalBarrierVk(buffer, view->texture->device->functions.vkCmdPipelineBarrier, barrier);
+    const VkImageMemoryBarrier2 barrier = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+        .srcStageMask = before->stage,
+        .srcAccessMask = writingAccesses(before->access),
+        .dstStageMask = next->stage,
+        .dstAccessMask = next->access,
+        .oldLayout = before->layout,
+        .newLayout = next->layout,
+        .srcQueueFamilyIndex = transition->texture->device->adapter->queueIndices.graphicsIndex,
+        .dstQueueFamilyIndex = transition->texture->device->adapter->queueIndices.graphicsIndex,
+        .image = transition->texture->image,
+        .subresourceRange = Texture_subresourceRange(transition->texture, before),
+    };
+    CommandEncoder_queueImageBarrier(transition->encoder, &barrier);
 }
 
-static void ru_trackAndEncodeBufferVk(VkCommandBuffer buffer, ResourceUsage* resourceUsage, WGPUBuffer wbuffer, BufferUsageSnap usage){
-    OptionalBarrier barrier = ru_trackBufferAndEmit(resourceUsage, wbuffer, usage);
-    encoderOptionalBarrierVk(buffer, wbuffer->device->functions.vkCmdPipelineBarrier, barrier);
+static void ce_trackTextureSubresources(WGPUCommandEncoder encoder, WGPUTexture texture, const VkImageSubresourceRange* range, ImageUsageSnap usage){
+    SubresourceState next = Texture_subresources(texture, range);
+    next.layout = usage.layout;
+    next.stage  = usage.stage;
+    next.access = usage.access;
+    if(next.levelCount == 0 || next.layerCount == 0){
+        return;
+    }
+    ImageUsageRecord* record = ImageUsageRecordMap_get(&encoder->resourceUsage.referencedTextures, texture);
+    if(record == NULL){
+        const ImageUsageRecord empty zeroinit;
+        ru_trackTexture(&encoder->resourceUsage, texture, empty);
+        record = ImageUsageRecordMap_get(&encoder->resourceUsage.referencedTextures, texture);
+    }
+    const EncoderImageTransition transition = {
+        .encoder = encoder,
+        .texture = texture,
+        .record = record,
+        .next = &next,
+    };
+    SubresourceStates_transition(&record->lastStates, &next, encoderImageTransitionVisitor, (void*)&transition);
 }
 
 RGAPI void ce_trackTexture(WGPUCommandEncoder encoder, WGPUTexture texture, ImageUsageSnap usage){
-    ru_trackAndEncodeTexture(encoder, &encoder->resourceUsage, texture, usage);
+    ce_trackTextureSubresources(encoder, texture, &usage.subresource, usage);
 }
 
+// Only the subresources of the view are transitioned
 RGAPI void ce_trackTextureView(WGPUCommandEncoder encoder, WGPUTextureView view, ImageUsageSnap usage){
-    
-    //ru_trackTextureView(&enc->resourceUsage, view); TODO verify if that is actually taken care of
-    
-    ru_trackAndEncodeTextureView(encoder, &encoder->resourceUsage, view, usage);
+    ru_trackTextureView(&encoder->resourceUsage, view);
+    ce_trackTextureSubresources(encoder, view->texture, &view->subresourceRange, usage);
 }
 RGAPI void ce_trackBuffer(WGPUCommandEncoder encoder, WGPUBuffer buffer, BufferUsageSnap usage){
-    
-    ru_trackAndEncodeBuffer(encoder, &encoder->resourceUsage, buffer, usage);
+    ce_trackBufferRange(encoder, buffer, usage);
 }
 
 
 static inline void bufferReleaseCallback(void* buffer, BufferUsageRecord* bu_record, void* unused){
+    if(bu_record->unsubmitted){
+        --((WGPUBuffer)buffer)->unsubmittedUses;
+    }
+    BufferRangeStateVector_free(&bu_record->ranges);
     wgpuBufferRelease(buffer);
 }
 static inline void textureReleaseCallback(void* texture, ImageUsageRecord* iur, void* unused){
     (void)unused;
+    ImageUsageRecord_free(iur);
     wgpuTextureRelease(texture);
 }
 static inline void textureViewReleaseCallback(WGPUTextureView textureView, void* unused){
@@ -7217,12 +9937,13 @@ WGPUFuture wgpuShaderModuleGetReflectionInfo(WGPUShaderModule shaderModule, WGPU
     WGPUFutureImpl ret = {
         .functionCalledOnWaitAny = wgpuShaderModuleGetReflectionInfo_sync,
         .userdataForFunction = udff,
-        .freeUserData = RL_FREE
+        .freeUserData = RL_FREE,
+        .mode = callbackInfo.mode,
     };
     WGPUFuture rete = { 
         atomic_fetch_add_explicit(&shaderModule->device->adapter->instance->currentFutureId, 1, memory_order_relaxed)
     };
-    FutureIDMap_put(&instance->g_futureIDMap, rete.id, ret);
+    Instance_putFuture(instance, rete.id, ret);
     return rete;
     EXIT();
 }
@@ -7422,7 +10143,33 @@ void wgpuCommandBufferAddRef(WGPUCommandBuffer commandBuffer) {
 // Stubs for missing Methods of CommandEncoder
 void wgpuCommandEncoderClearBuffer(WGPUCommandEncoder commandEncoder, WGPUBuffer buffer, uint64_t offset, uint64_t size) {
     ENTRY();
-
+    WGPUDevice device = commandEncoder->device;
+    if(size == WGPU_WHOLE_SIZE){
+        size = offset <= buffer->capacity ? buffer->capacity - offset : 0;
+    }
+    if(!(buffer->usage & WGPUBufferUsage_CopyDst)){
+        DeviceCallback(device, WGPUErrorType_Validation, STRVIEW("ClearBuffer: buffer was not created with WGPUBufferUsage_CopyDst"));
+        EXIT();
+        return;
+    }
+    if((offset & 3) != 0 || (size & 3) != 0){
+        DeviceCallback(device, WGPUErrorType_Validation, STRVIEW("ClearBuffer: offset and size must be multiples of 4"));
+        EXIT();
+        return;
+    }
+    if(offset > buffer->capacity || size > buffer->capacity - offset){
+        DeviceCallback(device, WGPUErrorType_Validation, STRVIEW("ClearBuffer: range exceeds the buffer size"));
+        EXIT();
+        return;
+    }
+    if(size == 0){
+        EXIT();
+        return;
+    }
+    CommandEncoder_fillBuffer(commandEncoder, buffer, offset, size);
+    if(buffer->usage & WGPUBufferUsage_MapRead){
+        CommandEncoder_hostReadBarrier(commandEncoder, VK_PIPELINE_STAGE_2_CLEAR_BIT);
+    }
     EXIT();
 }
 void wgpuCommandEncoderInsertDebugMarker(WGPUCommandEncoder commandEncoder, WGPUStringView markerLabel) {
@@ -7442,12 +10189,16 @@ void wgpuCommandEncoderPushDebugGroup(WGPUCommandEncoder commandEncoder, WGPUStr
 }
 void wgpuCommandEncoderResolveQuerySet(WGPUCommandEncoder commandEncoder, WGPUQuerySet querySet, uint32_t firstQuery, uint32_t queryCount, WGPUBuffer destination, uint64_t destinationOffset) {
     ENTRY();
+    CommandEncoder_flushCopies(commandEncoder);
     const BufferUsageSnap usage = {
         .access = VK_ACCESS_TRANSFER_WRITE_BIT,
-        .stage = VK_PIPELINE_STAGE_TRANSFER_BIT
+        .stage = VK_PIPELINE_STAGE_2_COPY_BIT,
+        .offset = destinationOffset,
+        .size = (uint64_t)queryCount * sizeof(uint64_t)
     };
     ce_trackBuffer(commandEncoder, destination, usage);
     ru_trackQuerySet(&commandEncoder->resourceUsage, querySet);
+    CommandEncoder_flushBarriers(commandEncoder);
     commandEncoder->device->functions.vkCmdCopyQueryPoolResults(
         commandEncoder->buffer,
         querySet->queryPool,
@@ -7467,6 +10218,8 @@ void wgpuCommandEncoderSetLabel(WGPUCommandEncoder commandEncoder, WGPUStringVie
 }
 void wgpuCommandEncoderWriteTimestamp(WGPUCommandEncoder commandEncoder, WGPUQuerySet querySet, uint32_t queryIndex) {
     ENTRY();
+    CommandEncoder_flushCopies(commandEncoder);
+    CommandEncoder_endRendering(commandEncoder);
     ru_trackQuerySet(&commandEncoder->resourceUsage, querySet);
     commandEncoder->device->functions.vkCmdWriteTimestamp(commandEncoder->buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, querySet->queryPool, queryIndex);
     EXIT();
@@ -7556,7 +10309,7 @@ WGPUFuture wgpuDeviceCreateComputePipelineAsync(WGPUDevice device, WGPUComputePi
     ENTRY();
     uint64_t futureID = ++device->adapter->instance->currentFutureId;
     WGPUFutureImpl futureImpl = {0}; // = RL_CALLOC(1, sizeof(WGPUFutureImpl));
-    FutureIDMap_put(&device->adapter->instance->g_futureIDMap, futureID, futureImpl);
+    Instance_putFuture(device->adapter->instance, futureID, futureImpl);
     CreateComputePipelineAsyncState* crps = RL_CALLOC(1, sizeof(CreateComputePipelineAsyncState));
     crps->callbackInfo = callbackInfo;
     crps->completed = 0;
@@ -7904,8 +10657,41 @@ WGPUBool wgpuInstanceHasWGSLLanguageFeature(WGPUInstance instance, WGPUWGSLLangu
     EXIT();
     return 0;
 }
+DEFINE_VECTOR(static inline, uint64_t, FutureIDVector);
+
+static void collectReadyFuture(uint64_t id, WGPUFutureImpl* future, void* readyIDs){
+    const bool processable = future->mode == WGPUCallbackMode_AllowProcessEvents || future->mode == WGPUCallbackMode_AllowSpontaneous;
+    if(future->functionCalledOnWaitAny && processable && (future->isReady == NULL || future->isReady(future->userdataForFunction))){
+        FutureIDVector_push_back((FutureIDVector*)readyIDs, id);
+    }
+}
+
+static void keepPendingFuture(uint64_t id, WGPUFutureImpl* future, void* pending){
+    if(future->functionCalledOnWaitAny){
+        FutureIDMap_put((FutureIDMap*)pending, id, *future);
+    }
+}
+
 void wgpuInstanceProcessEvents(WGPUInstance instance) {
-    ENTRY()
+    ENTRY();
+    // Callbacks may start new futures, so the ready ones are collected before any of them runs
+    FutureIDVector readyIDs;
+    FutureIDVector_init(&readyIDs);
+    wgvk_mutex_lock(instance->futureMutex);
+    FutureIDMap_for_each(&instance->g_futureIDMap, collectReadyFuture, &readyIDs);
+    wgvk_mutex_unlock(instance->futureMutex);
+    for(size_t i = 0;i < readyIDs.size;i++){
+        Instance_completeFuture(instance, readyIDs.data[i]);
+    }
+    FutureIDVector_free(&readyIDs);
+
+    // Drops the completed futures, including those wgpuInstanceWaitAny completed
+    FutureIDMap pending;
+    FutureIDMap_init(&pending);
+    wgvk_mutex_lock(instance->futureMutex);
+    FutureIDMap_for_each(&instance->g_futureIDMap, keepPendingFuture, &pending);
+    FutureIDMap_move(&instance->g_futureIDMap, &pending);
+    wgvk_mutex_unlock(instance->futureMutex);
     EXIT();
 }
 
@@ -7969,6 +10755,10 @@ static void processWorkDoneFuture(void* userdata) {
     }
 }
 
+static bool workDoneFutureReady(void* userdata) {
+    return Fence_poll(((WorkDoneFutureState*)userdata)->fence);
+}
+
 static void freeWorkDoneFutureState(void* userdata) {
     if (!userdata) return;
     WorkDoneFutureState* state = (WorkDoneFutureState*)userdata;
@@ -7991,17 +10781,25 @@ WGPUFuture wgpuQueueOnSubmittedWorkDone(WGPUQueue queue, WGPUQueueWorkDoneCallba
     }
 
     
-    // TODO: This function works correctly as-is, but it is suboptimal so submit an empty batch
-    // Just to get a fence. One could also reuse the latest fence used from that queue
-    const VkSubmitInfo submitInfo = {
-        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-        .commandBufferCount = 0,    // No command buffers
-        .pCommandBuffers = NULL,
-        .waitSemaphoreCount = 0,
-        .signalSemaphoreCount = 0,
-    };
-
-    VkResult result = queue->device->functions.vkQueueSubmit(queue->graphicsQueue, 1, &submitInfo, fence->fence);
+    VkResult result = VK_SUCCESS;
+    if(queue->device->capabilities.timelineSemaphore){
+        // Done once the timeline reaches the value of the latest submit
+        fence->timelineSemaphore = queue->timelineSemaphore;
+        fence->timelineValue = queue->timelineValue;
+    }
+    else{
+        // Without a timeline an empty batch is submitted just to get a fence
+        const VkSubmitInfo submitInfo = {
+            .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+            .commandBufferCount = 0,    // No command buffers
+            .pCommandBuffers = NULL,
+            .waitSemaphoreCount = 0,
+            .signalSemaphoreCount = 0,
+        };
+        Queue_lockVkQueue(queue);
+        result = queue->device->functions.vkQueueSubmit(Queue_vkQueue(queue), 1, &submitInfo, fence->fence);
+        Queue_unlockVkQueue(queue);
+    }
 
     if (result != VK_SUCCESS) {
         wgpuFenceRelease(fence);
@@ -8022,16 +10820,31 @@ WGPUFuture wgpuQueueOnSubmittedWorkDone(WGPUQueue queue, WGPUQueueWorkDoneCallba
     WGPUFutureImpl futureImpl = {
         .userdataForFunction = futureState,
         .functionCalledOnWaitAny = processWorkDoneFuture,
-        .freeUserData = freeWorkDoneFutureState
+        .freeUserData = freeWorkDoneFutureState,
+        .isReady = workDoneFutureReady,
+        .mode = callbackInfo.mode,
     };
     
     uint64_t futureID = atomic_fetch_add_explicit(&instance->currentFutureId, 1, memory_order_relaxed);
-    FutureIDMap_put(&instance->g_futureIDMap, futureID, futureImpl);
+    Instance_putFuture(instance, futureID, futureImpl);
     
     EXIT();
     return (WGPUFuture){ .id = futureID };
 }
 
+void wgpuQueueSignalFence(WGPUQueue queue, WGPUFence fence) {
+    ENTRY();
+    wgvk_assert(atomic_load_explicit(&fence->state, memory_order_acquire) == WGPUFenceState_Reset, "Fence is in use already");
+    const VkSubmitInfo submitInfo = {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+    };
+    const VkResult result = Queue_submit(queue, &submitInfo, NULL, 0, fence);
+    if (result != VK_SUCCESS) {
+        DeviceCallback(queue->device, WGPUErrorType_Internal, STRVIEW("vkQueueSubmit failed"));
+    }
+    EXIT();
+}
+
 void wgpuQueueSetLabel(WGPUQueue queue, WGPUStringView label) {
     ENTRY();
 
@@ -8046,12 +10859,20 @@ void wgpuRenderBundleSetLabel(WGPURenderBundle renderBundle, WGPUStringView labe
 }
 void wgpuRenderBundleAddRef(WGPURenderBundle renderBundle) {
     ENTRY();
-
+    ++renderBundle->refCount;
     EXIT();
 }
 void wgpuRenderBundleRelease(WGPURenderBundle renderBundle) {
     ENTRY();
-
+    if(--renderBundle->refCount == 0){
+        WGPUDevice device = renderBundle->device;
+        if(renderBundle->secondaryBuffer != VK_NULL_HANDLE){
+            ThreadCommandPool_release(renderBundle->secondaryPool, renderBundle->secondaryBuffer);
+        }
+        RenderPassCommandGenericVector_free(&renderBundle->bufferedCommands);
+        RL_FREE(renderBundle->colorAttachmentFormats);
+        RL_FREE(renderBundle);
+    }
     EXIT();
 }
 
@@ -8119,6 +10940,10 @@ void wgpuRenderPassEncoderInsertDebugMarker(WGPURenderPassEncoder renderPassEnco
 
 void wgpuRenderPassEncoderMultiDrawIndexedIndirect(WGPURenderPassEncoder renderPassEncoder, WGPUBuffer indirectBuffer, uint64_t indirectOffset, uint32_t maxDrawCount, WGPU_NULLABLE WGPUBuffer drawCountBuffer, uint64_t drawCountBufferOffset) {
     ENTRY();
+    if(drawCountBuffer && !renderPassEncoder->device->capabilities.drawIndirectCount){
+        DeviceCallback(renderPassEncoder->device, WGPUErrorType_Validation, STRVIEW("MultiDrawIndexedIndirect with a drawCountBuffer requires drawIndirectCount support"));
+        return;
+    }
     RenderPassCommandGeneric insert = {
         .type = rp_command_type_multi_draw_indexed_indirect,
         .multiDrawIndexedIndirect = {
@@ -8129,13 +10954,17 @@ void wgpuRenderPassEncoderMultiDrawIndexedIndirect(WGPURenderPassEncoder renderP
             .drawCountBufferOffset = drawCountBufferOffset
         }
     };
-    RenderPassCommandGenericVector_push_back(&renderPassEncoder->bufferedCommands, insert);
+    RenderPassEncoder_PushCommand(renderPassEncoder, &insert);
+    ce_trackIndirectBuffers(renderPassEncoder->cmdEncoder, indirectBuffer, drawCountBuffer);
     EXIT();
 }
 
 void wgpuRenderPassEncoderMultiDrawIndirect(WGPURenderPassEncoder renderPassEncoder, WGPUBuffer indirectBuffer, uint64_t indirectOffset, uint32_t maxDrawCount, WGPU_NULLABLE WGPUBuffer drawCountBuffer, uint64_t drawCountBufferOffset) {
     ENTRY();
-    // Assumes RenderPassCommandMultiDrawIndirect has fields for all parameters.
+    if(drawCountBuffer && !renderPassEncoder->device->capabilities.drawIndirectCount){
+        DeviceCallback(renderPassEncoder->device, WGPUErrorType_Validation, STRVIEW("MultiDrawIndirect with a drawCountBuffer requires drawIndirectCount support"));
+        return;
+    }
     RenderPassCommandGeneric insert = {
         .type = rp_command_type_multi_draw_indirect,
         .multiDrawIndirect = {
@@ -8146,7 +10975,8 @@ void wgpuRenderPassEncoderMultiDrawIndirect(WGPURenderPassEncoder renderPassEnco
             .drawCountBufferOffset = drawCountBufferOffset
         }
     };
-    RenderPassCommandGenericVector_push_back(&renderPassEncoder->bufferedCommands, insert);
+    RenderPassEncoder_PushCommand(renderPassEncoder, &insert);
+    ce_trackIndirectBuffers(renderPassEncoder->cmdEncoder, indirectBuffer, drawCountBuffer);
     EXIT();
 }
 
@@ -8185,9 +11015,6 @@ void wgpuRenderPassEncoderSetStencilReference(WGPURenderPassEncoder renderPassEn
         .setStencilReference = setStencilReference,
     };
     RenderPassEncoder_PushCommand(renderPassEncoder, &cmd);
-    // This sets state on the encoder for subsequent draws. It is not a recorded command.
-    // Assumes the WGPURenderPassEncoder struct has a 'stencilReference' member.
-    //renderPassEncoder->stencilReference = reference;
     EXIT();
 }
 // Stubs for missing Methods of RenderPipeline
@@ -8235,7 +11062,6 @@ void wgpuSurfaceUnconfigure(WGPUSurface surface) {
     ENTRY();
     WGPUDevice device = surface->device;
     uint32_t cacheIndex = surface->device->submittedFrames % framesInFlight;
-    PerframeCache* fcache = DeviceGetFIFCache(device, cacheIndex);
     SyncState* syncState = DeviceGetSyncState(device, cacheIndex);
 
     device->functions.vkDeviceWaitIdle(device->device);
@@ -8248,10 +11074,11 @@ void wgpuSurfaceUnconfigure(WGPUSurface surface) {
             .pWaitSemaphores = &syncState->acquireImageSemaphore,
             .waitSemaphoreCount = 1
         };
-        device->functions.vkQueueSubmit(surface->device->queue->graphicsQueue, 1, &sinfo, fcache->finalTransitionFence->fence);
+        Queue_lockVkQueue(surface->device->queue);
+        device->functions.vkQueueSubmit(surface->device->queue->graphicsQueue, 1, &sinfo, VK_NULL_HANDLE);
         syncState->acquireImageSemaphoreSignalled = false;
-        device->functions.vkWaitForFences(surface->device->device, 1, &fcache->finalTransitionFence->fence, VK_TRUE, UINT64_MAX);
-        device->functions.vkResetFences(surface->device->device, 1, &fcache->finalTransitionFence->fence);
+        device->functions.vkQueueWaitIdle(surface->device->queue->graphicsQueue);
+        Queue_unlockVkQueue(surface->device->queue);
     }
     if(surface->presentSemaphores){
         for (uint32_t i = 0; i < surface->imagecount; i++) {
@@ -8272,6 +11099,7 @@ void wgpuSurfaceUnconfigure(WGPUSurface surface) {
 
                 //wgpuTextureViewRelease(swapchainTexture->viewCache.table[j].value);
             }
+            SubresourceStateVector_free(&swapchainTexture->states);
         }
         RL_FREE((void*)surface->images);
         device->functions.vkDestroySwapchainKHR(device->device, surface->swapchain, NULL);
@@ -8623,6 +11451,7 @@ RGAPI void wgvkAllocator_free(const wgvkAllocation* allocation) {
 #if defined(_WIN32) || defined(_WIN64)
   #define WGVK_OS_WINDOWS 1
   #include <windows.h>
+  #include <io.h>
 #else
   #define WGVK_OS_POSIX 1
   #include <pthread.h>
@@ -8771,12 +11600,20 @@ void wgvk_thread_yield(void) {
     SwitchToThread();
 }
 
+uint64_t wgvk_thread_current_id(void) {
+    return (uint64_t)GetCurrentThreadId();
+}
+
 #else /* POSIX */
 
 void wgvk_thread_yield(void) {
     sched_yield();
 }
 
+uint64_t wgvk_thread_current_id(void) {
+    return (uint64_t)(uintptr_t)pthread_self();
+}
+
 int wgvk_thread_create(wgvk_thread_t* thread, wgvk_thread_func_t func, void* arg) {
     if (!thread || !func) { errno = EINVAL; return -1; }
     int e = pthread_create(&thread->handle, NULL, func, arg);
@@ -9216,6 +12053,14 @@ wgvk_job_t* wgvk_job_enqueue(wgvk_thread_pool_t* pool, wgvk_thread_func_t func,
     return job;
 }
 
+int wgvk_job_completed(wgvk_job_t* job) {
+    if (!job) return 1;
+    wgvk_mutex_lock(job->status_mutex);
+    const int completed = job->status == WGVK_JOB_COMPLETED;
+    wgvk_mutex_unlock(job->status_mutex);
+    return completed;
+}
+
 int wgvk_job_wait(wgvk_job_t* job, void** result) {
     if (!job) return EINVAL;
     wgvk_mutex_lock(job->status_mutex);
@@ -9234,6 +12079,30 @@ void wgvk_job_destroy(wgvk_job_t* job) {
     free(job);
 }
 
+/* ------------------------ positioned file reads ------------------------ */
+
+int64_t wgvk_file_pread(int fd, void* buffer, size_t size, uint64_t offset) {
+#if defined(WGVK_OS_POSIX)
+    ssize_t r;
+    do {
+        r = pread(fd, buffer, size, (off_t)offset);
+    } while (r < 0 && errno == EINTR);
+    return (int64_t)r;
+#else
+    HANDLE file = (HANDLE)_get_osfhandle(fd);
+    if (file == INVALID_HANDLE_VALUE) return -1;
+    OVERLAPPED overlapped = {0};
+    overlapped.Offset = (DWORD)offset;
+    overlapped.OffsetHigh = (DWORD)(offset >> 32);
+    DWORD toRead = size > 0x7fffffffu ? 0x7fffffffu : (DWORD)size;
+    DWORD read = 0;
+    if (!ReadFile(file, buffer, toRead, &read, &overlapped)) {
+        return GetLastError() == ERROR_HANDLE_EOF ? 0 : -1;
+    }
+    return (int64_t)read;
+#endif
+}
+
 
 
 RGAPI void releaseAllAndClear(ResourceUsage* resourceUsage){
@@ -9881,6 +12750,8 @@ WGPURayTracingAccelerationContainer wgpuDeviceCreateRayTracingAccelerationContai
 
 void wgpuCommandEncoderBuildRayTracingAccelerationContainer(WGPUCommandEncoder encoder, WGPURayTracingAccelerationContainer container){
     ENTRY();
+    CommandEncoder_flushCopies(encoder);
+    CommandEncoder_endRendering(encoder);
     
     WGPUDevice device = encoder->device;
     
@@ -9928,6 +12799,7 @@ void wgpuCommandEncoderBuildRayTracingAccelerationContainer(WGPUCommandEncoder e
             ce_trackBuffer(encoder, container->inputGeometryBuffers[i], inBufferSnap);
         }
         ce_trackBuffer(encoder, container->accelerationStructureBuffer, asBufferSnap);
+        CommandEncoder_flushBarriers(encoder);
 
         device->functions.vkCmdBuildAccelerationStructuresKHR(
             encoder->buffer,
@@ -0,0 +1,1289 @@
+/*
+ * wgvk_capture.c - Capture layer recording the calls that create GPU objects and work into a binary trace
+ *
+ * Only built with WGVK_ENABLE_CAPTURE. wgvk.c is then compiled with the wrapped entry points renamed
+ * to wgvkCore_* (see wgvk_capture.h), so every wrapper here is entered once per application call
+ * and calls wgvk makes internally never show up in the trace.
+ * The format is documented in wgvk_capture.h, tools/wgvk_replay.c plays a trace back.
+ */
+#include <wgvk.h>
+#include <wgvk_structs_impl.h>
+#include <wgvk_capture.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define WGVK_CORE(Name) extern __typeof__(wgpu##Name) wgvkCore_##Name
+
+typedef struct CaptureBufferState{
+    uint64_t size;
+    WGPUMapMode mapMode;
+    uint64_t mapOffset;
+    uint64_t mapSize;
+}CaptureBufferState;
+
+DEFINE_PTR_HASH_MAP(static inline, CaptureIdMap, uint64_t)
+DEFINE_PTR_HASH_MAP(static inline, CaptureBufferStateMap, CaptureBufferState)
+
+static struct{
+    atomic_bool active;
+    wgvk_mutex_t* mutex;
+    FILE* file;
+    uint64_t nextId;
+    uint64_t startTime;
+    CaptureIdMap ids;
+    CaptureBufferStateMap buffers;
+    WGVKCaptureOp op;
+    uint8_t* scratch;
+    size_t scratchSize;
+    size_t scratchCapacity;
+}capture;
+
+static uint64_t cap_nanoTime(void){
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return ((uint64_t)ts.tv_sec) * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void cap_finish(void){
+    if(!atomic_load_explicit(&capture.active, memory_order_acquire)){
+        return;
+    }
+    wgvk_mutex_lock(capture.mutex);
+    atomic_store_explicit(&capture.active, false, memory_order_release);
+    fclose(capture.file);
+    capture.file = NULL;
+    CaptureIdMap_free(&capture.ids);
+    CaptureBufferStateMap_free(&capture.buffers);
+    RL_FREE(capture.scratch);
+    capture.scratch = NULL;
+    capture.scratchSize = capture.scratchCapacity = 0;
+    wgvk_mutex_unlock(capture.mutex);
+}
+
+static void cap_start(const char* path){
+    FILE* file = fopen(path, "wb");
+    if(file == NULL){
+        fprintf(stderr, "wgvk capture: could not open %s\n", path);
+        return;
+    }
+    WGVKCaptureHeader header = {
+        .magic = WGVK_CAPTURE_MAGIC,
+        .version = WGVK_CAPTURE_VERSION,
+        .pointerSize = (uint32_t)sizeof(void*),
+    };
+    fwrite(&header, sizeof(header), 1, file);
+    capture.mutex = wgvk_mutex_create(wgvk_locktype_kernel);
+    capture.file = file;
+    capture.nextId = 1;
+    capture.startTime = cap_nanoTime();
+    CaptureIdMap_init(&capture.ids);
+    CaptureBufferStateMap_init(&capture.buffers);
+    atomic_store_explicit(&capture.active, true, memory_order_release);
+    atexit(cap_finish);
+}
+
+// Takes the capture lock if a trace is being written
+static bool cap_lock(void){
+    if(!atomic_load_explicit(&capture.active, memory_order_acquire)){
+        return false;
+    }
+    wgvk_mutex_lock(capture.mutex);
+    if(capture.file == NULL){
+        wgvk_mutex_unlock(capture.mutex);
+        return false;
+    }
+    return true;
+}
+
+static bool cap_begin(WGVKCaptureOp op){
+    if(!cap_lock()){
+        return false;
+    }
+    capture.op = op;
+    capture.scratchSize = 0;
+    return true;
+}
+
+static void cap_end(void){
+    const uint32_t header[2] = {(uint32_t)capture.op, (uint32_t)capture.scratchSize};
+    fwrite(header, sizeof(header), 1, capture.file);
+    fwrite(capture.scratch, 1, capture.scratchSize, capture.file);
+    // Frame boundaries flush, so a trace of an application that crashes or gets killed is still usable
+    if(capture.op == WGVKCaptureOp_SurfacePresent || capture.op == WGVKCaptureOp_DeviceTick){
+        fflush(capture.file);
+    }
+    wgvk_mutex_unlock(capture.mutex);
+}
+
+static void cap_bytes(const void* data, size_t size){
+    if(capture.scratchSize + size > capture.scratchCapacity){
+        size_t newCapacity = capture.scratchCapacity ? capture.scratchCapacity * 2 : 4096;
+        while(newCapacity < capture.scratchSize + size){
+            newCapacity *= 2;
+        }
+        capture.scratch = (uint8_t*)RL_REALLOC(capture.scratch, newCapacity);
+        capture.scratchCapacity = newCapacity;
+    }
+    if(size){
+        memcpy(capture.scratch + capture.scratchSize, data, size);
+    }
+    capture.scratchSize += size;
+}
+
+static void cap_u32(uint32_t value){ cap_bytes(&value, sizeof(value)); }
+static void cap_i32(int32_t value){ cap_bytes(&value, sizeof(value)); }
+static void cap_u64(uint64_t value){ cap_bytes(&value, sizeof(value)); }
+static void cap_f32(float value){ cap_bytes(&value, sizeof(value)); }
+static void cap_f64(double value){ cap_bytes(&value, sizeof(value)); }
+
+static void cap_blob(const void* data, size_t size){
+    cap_u64(size);
+    cap_bytes(data, size);
+}
+
+static void cap_string(WGPUStringView view){
+    size_t length = view.data == NULL ? 0 : (view.length == WGPU_STRLEN ? strlen(view.data) : view.length);
+    cap_u32((uint32_t)length);
+    cap_bytes(view.data, length);
+}
+
+static void cap_timestamp(void){
+    cap_u64(cap_nanoTime() - capture.startTime);
+}
+
+// Id of an object created while capturing, 0 for NULL and for objects the trace has never seen
+static void cap_object(const void* object){
+    uint64_t* id = object ? CaptureIdMap_get(&capture.ids, (void*)object) : NULL;
+    cap_u64(id ? *id : 0);
+}
+
+// Assigns a fresh id, also when the address belonged to an object that has since been freed
+static void cap_new(const void* object){
+    const uint64_t id = capture.nextId++;
+    CaptureIdMap_put(&capture.ids, (void*)object, id);
+    cap_u64(id);
+}
+
+// Devices, queues and surfaces are not created through captured calls, they get their id when first referenced
+static void cap_implicit(const void* object){
+    uint64_t* id = CaptureIdMap_get(&capture.ids, (void*)object);
+    if(id == NULL){
+        cap_new(object);
+    }
+    else{
+        cap_u64(*id);
+    }
+}
+
+static void cap_lifetime(WGVKCaptureOp op, WGVKCaptureObjectType type, const void* object){
+    if(object && cap_begin(op)){
+        cap_u32(type);
+        cap_object(object);
+        cap_end();
+    }
+}
+
+static void cap_constants(size_t count, const WGPUConstantEntry* constants){
+    cap_u32((uint32_t)count);
+    for(size_t i = 0;i < count;i++){
+        cap_string(constants[i].key);
+        cap_f64(constants[i].value);
+    }
+}
+
+static void cap_extent(const WGPUExtent3D* extent){
+    cap_u32(extent->width);
+    cap_u32(extent->height);
+    cap_u32(extent->depthOrArrayLayers);
+}
+
+static void cap_texelCopyTexture(const WGPUTexelCopyTextureInfo* info){
+    cap_object(info->texture);
+    cap_u32(info->mipLevel);
+    cap_u32(info->origin.x);
+    cap_u32(info->origin.y);
+    cap_u32(info->origin.z);
+    cap_u32(info->aspect);
+}
+
+static void cap_texelCopyBufferLayout(const WGPUTexelCopyBufferLayout* layout){
+    cap_u64(layout->offset);
+    cap_u32(layout->bytesPerRow);
+    cap_u32(layout->rowsPerImage);
+}
+
+static void cap_texelCopyBuffer(const WGPUTexelCopyBufferInfo* info){
+    cap_texelCopyBufferLayout(&info->layout);
+    cap_object(info->buffer);
+}
+
+static void cap_bindGroupOffsets(uint32_t groupIndex, WGPUBindGroup group, size_t dynamicOffsetCount, const uint32_t* dynamicOffsets){
+    cap_u32(groupIndex);
+    cap_object(group);
+    cap_u32((uint32_t)dynamicOffsetCount);
+    cap_bytes(dynamicOffsets, dynamicOffsetCount * sizeof(uint32_t));
+}
+
+static void cap_multiDraw(WGPUBuffer indirectBuffer, uint64_t indirectOffset, uint32_t maxDrawCount, WGPUBuffer drawCountBuffer, uint64_t drawCountBufferOffset){
+    cap_object(indirectBuffer);
+    cap_u64(indirectOffset);
+    cap_u32(maxDrawCount);
+    cap_object(drawCountBuffer);
+    cap_u64(drawCountBufferOffset);
+}
+
+static CaptureBufferState* cap_bufferState(WGPUBuffer buffer){
+    CaptureBufferState* state = CaptureBufferStateMap_get(&capture.buffers, buffer);
+    if(state == NULL){
+        CaptureBufferStateMap_put(&capture.buffers, buffer, (CaptureBufferState){.size = wgpuBufferGetSize(buffer)});
+        state = CaptureBufferStateMap_get(&capture.buffers, buffer);
+    }
+    return state;
+}
+
+// Instance
+
+WGVK_CORE(CreateInstance);
+WGPUInstance wgpuCreateInstance(const WGPUInstanceDescriptor* descriptor){
+    const char* path = getenv("WGVK_CAPTURE_FILE");
+    if(path && *path && !atomic_load_explicit(&capture.active, memory_order_acquire)){
+        cap_start(path);
+    }
+    return wgvkCore_CreateInstance(descriptor);
+}
+
+// Object creation
+
+WGVK_CORE(DeviceCreateBuffer);
+WGPUBuffer wgpuDeviceCreateBuffer(WGPUDevice device, const WGPUBufferDescriptor* desc){
+    WGPUBuffer ret = wgvkCore_DeviceCreateBuffer(device, desc);
+    if(ret && cap_begin(WGVKCaptureOp_CreateBuffer)){
+        cap_implicit(device);
+        cap_new(ret);
+        cap_u64(desc->usage);
+        cap_u64(desc->size);
+        cap_u32(desc->mappedAtCreation);
+        // Whatever the application writes before the first unmap is part of the upload
+        CaptureBufferStateMap_put(&capture.buffers, ret, (CaptureBufferState){
+            .size = desc->size,
+            .mapMode = desc->mappedAtCreation ? WGPUMapMode_Write : WGPUMapMode_None,
+            .mapSize = desc->mappedAtCreation ? desc->size : 0,
+        });
+        cap_end();
+    }
+    return ret;
+}
+
+WGVK_CORE(DeviceCreateTexture);
+WGPUTexture wgpuDeviceCreateTexture(WGPUDevice device, const WGPUTextureDescriptor* descriptor){
+    WGPUTexture ret = wgvkCore_DeviceCreateTexture(device, descriptor);
+    if(ret && cap_begin(WGVKCaptureOp_CreateTexture)){
+        cap_implicit(device);
+        cap_new(ret);
+        cap_u64(descriptor->usage);
+        cap_u32(descriptor->dimension);
+        cap_u32(descriptor->size.width);
+        cap_u32(descriptor->size.height);
+        cap_u32(descriptor->size.depthOrArrayLayers);
+        cap_u32(descriptor->format);
+        cap_u32(descriptor->mipLevelCount);
+        cap_u32(descriptor->sampleCount);
+        cap_u32((uint32_t)descriptor->viewFormatCount);
+        for(size_t i = 0;i < descriptor->viewFormatCount;i++){
+            cap_u32(descriptor->viewFormats[i]);
+        }
+        cap_end();
+    }
+    return ret;
+}
+
+WGVK_CORE(TextureCreateView);
+WGPUTextureView wgpuTextureCreateView(WGPUTexture texture, const WGPUTextureViewDescriptor* descriptor){
+    WGPUTextureView ret = wgvkCore_TextureCreateView(texture, descriptor);
+    if(ret && cap_begin(WGVKCaptureOp_TextureCreateView)){
+        cap_object(texture);
+        cap_new(ret);
+        cap_u32(descriptor != NULL);
+        if(descriptor){
+            cap_u32(descriptor->format);
+            cap_u32(descriptor->dimension);
+            cap_u32(descriptor->baseMipLevel);
+            cap_u32(descriptor->mipLevelCount);
+            cap_u32(descriptor->baseArrayLayer);
+            cap_u32(descriptor->arrayLayerCount);
+            cap_u32(descriptor->aspect);
+            cap_u64(descriptor->usage);
+            const WGPUChainedStruct* chain = descriptor->nextInChain;
+            const bool hasSwizzle = chain && chain->sType == WGPUSType_TextureComponentSwizzleDescriptor;
+            cap_u32(hasSwizzle);
+            if(hasSwizzle){
+                const WGPUTextureComponentSwizzle* swizzle = &((const WGPUTextureComponentSwizzleDescriptor*)chain)->swizzle;
+                cap_u32(swizzle->r);
+                cap_u32(swizzle->g);
+                cap_u32(swizzle->b);
+                cap_u32(swizzle->a);
+            }
+        }
+        cap_end();
+    }
+    return ret;
+}
+
+WGVK_CORE(DeviceCreateSampler);
+WGPUSampler wgpuDeviceCreateSampler(WGPUDevice device, const WGPUSamplerDescriptor* descriptor){
+    WGPUSampler ret = wgvkCore_DeviceCreateSampler(device, descriptor);
+    if(ret && cap_begin(WGVKCaptureOp_CreateSampler)){
+        cap_implicit(device);
+        cap_new(ret);
+        cap_u32(descriptor->addressModeU);
+        cap_u32(descriptor->addressModeV);
+        cap_u32(descriptor->addressModeW);
+        cap_u32(descriptor->magFilter);
+        cap_u32(descriptor->minFilter);
+        cap_u32(descriptor->mipmapFilter);
+        cap_f32(descriptor->lodMinClamp);
+        cap_f32(descriptor->lodMaxClamp);
+        cap_u32(descriptor->compare);
+        cap_u32(descriptor->maxAnisotropy);
+        cap_end();
+    }
+    return ret;
+}
+
+WGVK_CORE(DeviceCreateShaderModule);
+WGPUShaderModule wgpuDeviceCreateShaderModule(WGPUDevice device, const WGPUShaderModuleDescriptor* descriptor){
+    WGPUShaderModule ret = wgvkCore_DeviceCreateShaderModule(device, descriptor);
+    if(ret && cap_begin(WGVKCaptureOp_CreateShaderModule)){
+        cap_implicit(device);
+        cap_new(ret);
+        const WGPUChainedStruct* source = descriptor->nextInChain;
+        switch(source ? source->sType : 0){
+            case WGPUSType_ShaderSourceSPIRV:{
+                const WGPUShaderSourceSPIRV* spirv = (const WGPUShaderSourceSPIRV*)source;
+                cap_u32(WGPUSType_ShaderSourceSPIRV);
+                cap_u32(0);
+                cap_blob(spirv->code, spirv->codeSize);
+            }break;
+            case WGPUSType_ShaderSourceWGSL:{
+                const WGPUShaderSourceWGSL* wgsl = (const WGPUShaderSourceWGSL*)source;
+                const size_t length = wgsl->code.length == WGPU_STRLEN ? strlen(wgsl->code.data) : wgsl->code.length;
+                cap_u32(WGPUSType_ShaderSourceWGSL);
+                cap_u32(0);
+                cap_blob(wgsl->code.data, length);
+            }break;
+            case WGPUSType_ShaderSourceGLSL:{
+                const WGPUShaderSourceGLSL* glsl = (const WGPUShaderSourceGLSL*)source;
+                const size_t length = glsl->code.length == WGPU_STRLEN ? strlen(glsl->code.data) : glsl->code.length;
+                cap_u32(WGPUSType_ShaderSourceGLSL);
+                cap_u32(glsl->stage);
+                cap_blob(glsl->code.data, length);
+            }break;
+            default:
+                cap_u32(0);
+                cap_u32(0);
+                cap_blob(NULL, 0);
+        }
+        cap_end();
+    }
+    return ret;
+}
+
+WGVK_CORE(DeviceCreateBindGroupLayout);
+WGPUBindGroupLayout wgpuDeviceCreateBindGroupLayout(WGPUDevice device, const WGPUBindGroupLayoutDescriptor* bindGroupLayoutDescriptor){
+    WGPUBindGroupLayout ret = wgvkCore_DeviceCreateBindGroupLayout(device, bindGroupLayoutDescriptor);
+    if(ret && cap_begin(WGVKCaptureOp_CreateBindGroupLayout)){
+        cap_implicit(device);
+        cap_new(ret);
+        cap_u32((uint32_t)bindGroupLayoutDescriptor->entryCount);
+        for(size_t i = 0;i < bindGroupLayoutDescriptor->entryCount;i++){
+            const WGPUBindGroupLayoutEntry* entry = bindGroupLayoutDescriptor->entries + i;
+            cap_u32(entry->binding);
+            cap_u64(entry->visibility);
+            cap_u32(entry->buffer.type);
+            cap_u32(entry->buffer.hasDynamicOffset);
+            cap_u64(entry->buffer.minBindingSize);
+            cap_u32(entry->sampler.type);
+            cap_u32(entry->texture.sampleType);
+            cap_u32(entry->texture.viewDimension);
+            cap_u32(entry->texture.multisampled);
+            cap_u32(entry->storageTexture.access);
+            cap_u32(entry->storageTexture.format);
+            cap_u32(entry->storageTexture.viewDimension);
+            cap_u32(entry->accelerationStructure);
+        }
+        cap_end();
+    }
+    return ret;
+}
+
+WGVK_CORE(DeviceCreatePipelineLayout);
+WGPUPipelineLayout wgpuDeviceCreatePipelineLayout(WGPUDevice device, const WGPUPipelineLayoutDescriptor* pldesc){
+    WGPUPipelineLayout ret = wgvkCore_DeviceCreatePipelineLayout(device, pldesc);
+    if(ret && cap_begin(WGVKCaptureOp_CreatePipelineLayout)){
+        cap_implicit(device);
+        cap_new(ret);
+        cap_u32((uint32_t)pldesc->bindGroupLayoutCount);
+        for(size_t i = 0;i < pldesc->bindGroupLayoutCount;i++){
+            cap_object(pldesc->bindGroupLayouts[i]);
+        }
+        cap_u32(pldesc->immediateDataRangeByteSize);
+        cap_end();
+    }
+    return ret;
+}
+
+WGVK_CORE(DeviceCreateBindGroup);
+WGPUBindGroup wgpuDeviceCreateBindGroup(WGPUDevice device, const WGPUBindGroupDescriptor* bgdesc){
+    WGPUBindGroup ret = wgvkCore_DeviceCreateBindGroup(device, bgdesc);
+    if(ret && cap_begin(WGVKCaptureOp_CreateBindGroup)){
+        cap_implicit(device);
+        cap_new(ret);
+        cap_object(bgdesc->layout);
+        cap_u32((uint32_t)bgdesc->entryCount);
+        for(size_t i = 0;i < bgdesc->entryCount;i++){
+            const WGPUBindGroupEntry* entry = bgdesc->entries + i;
+            cap_u32(entry->binding);
+            cap_object(entry->buffer);
+            cap_u64(entry->offset);
+            cap_u64(entry->size);
+            cap_object(entry->sampler);
+            cap_object(entry->textureView);
+        }
+        cap_end();
+    }
+    return ret;
+}
+
+WGVK_CORE(DeviceCreateRenderPipeline);
+WGPURenderPipeline wgpuDeviceCreateRenderPipeline(WGPUDevice device, const WGPURenderPipelineDescriptor* descriptor){
+    WGPURenderPipeline ret = wgvkCore_DeviceCreateRenderPipeline(device, descriptor);
+    if(ret && cap_begin(WGVKCaptureOp_CreateRenderPipeline)){
+        cap_implicit(device);
+        cap_new(ret);
+        cap_object(descriptor->layout);
+
+        const WGPUVertexState* vertex = &descriptor->vertex;
+        cap_object(vertex->module);
+        cap_string(vertex->entryPoint);
+        cap_constants(vertex->constantCount, vertex->constants);
+        cap_u32((uint32_t)vertex->bufferCount);
+        for(size_t i = 0;i < vertex->bufferCount;i++){
+            const WGPUVertexBufferLayout* layout = vertex->buffers + i;
+            cap_u32(layout->stepMode);
+            cap_u64(layout->arrayStride);
+            cap_u32((uint32_t)layout->attributeCount);
+            for(size_t a = 0;a < layout->attributeCount;a++){
+                cap_u32(layout->attributes[a].format);
+                cap_u64(layout->attributes[a].offset);
+                cap_u32(layout->attributes[a].shaderLocation);
+            }
+        }
+
+        const WGPUPrimitiveState* primitive = &descriptor->primitive;
+        cap_u32(primitive->topology);
+        cap_u32(primitive->stripIndexFormat);
+        cap_u32(primitive->frontFace);
+        cap_u32(primitive->cullMode);
+        cap_u32(primitive->unclippedDepth);
+        const bool hasLineWidth = primitive->nextInChain && primitive->nextInChain->sType == WGPUSType_PrimitiveLineWidthInfo;
+        cap_u32(hasLineWidth ? ((const WGPUPrimitiveLineWidthInfo*)primitive->nextInChain)->lineWidth : 0);
+
+        const WGPUDepthStencilState* depthStencil = descriptor->depthStencil;
+        cap_u32(depthStencil != NULL);
+        if(depthStencil){
+            cap_u32(depthStencil->format);
+            cap_u32(depthStencil->depthWriteEnabled);
+            cap_u32(depthStencil->depthCompare);
+            const WGPUStencilFaceState* faces[2] = {&depthStencil->stencilFront, &depthStencil->stencilBack};
+            for(uint32_t f = 0;f < 2;f++){
+                cap_u32(faces[f]->compare);
+                cap_u32(faces[f]->failOp);
+                cap_u32(faces[f]->depthFailOp);
+                cap_u32(faces[f]->passOp);
+            }
+            cap_u32(depthStencil->stencilReadMask);
+            cap_u32(depthStencil->stencilWriteMask);
+            cap_i32(depthStencil->depthBias);
+            cap_f32(depthStencil->depthBiasSlopeScale);
+            cap_f32(depthStencil->depthBiasClamp);
+        }
+
+        cap_u32(descriptor->multisample.count);
+        cap_u32(descriptor->multisample.mask);
+        cap_u32(descriptor->multisample.alphaToCoverageEnabled);
+
+        const WGPUFragmentState* fragment = descriptor->fragment;
+        cap_u32(fragment != NULL);
+        if(fragment){
+            cap_object(fragment->module);
+            cap_string(fragment->entryPoint);
+            cap_constants(fragment->constantCount, fragment->constants);
+            cap_u32((uint32_t)fragment->targetCount);
+            for(size_t i = 0;i < fragment->targetCount;i++){
+                const WGPUColorTargetState* target = fragment->targets + i;
+                cap_u32(target->format);
+                cap_u64(target->writeMask);
+                cap_u32(target->blend != NULL);
+                if(target->blend){
+                    const WGPUBlendComponent* components[2] = {&target->blend->color, &target->blend->alpha};
+                    for(uint32_t c = 0;c < 2;c++){
+                        cap_u32(components[c]->operation);
+                        cap_u32(components[c]->srcFactor);
+                        cap_u32(components[c]->dstFactor);
+                    }
+                }
+            }
+        }
+        cap_end();
+    }
+    return ret;
+}
+
+WGVK_CORE(DeviceCreateComputePipeline);
+WGPUComputePipeline wgpuDeviceCreateComputePipeline(WGPUDevice device, const WGPUComputePipelineDescriptor* descriptor){
+    WGPUComputePipeline ret = wgvkCore_DeviceCreateComputePipeline(device, descriptor);
+    if(ret && cap_begin(WGVKCaptureOp_CreateComputePipeline)){
+        cap_implicit(device);
+        cap_new(ret);
+        cap_object(descriptor->layout);
+        cap_object(descriptor->compute.module);
+        cap_string(descriptor->compute.entryPoint);
+        cap_constants(descriptor->compute.constantCount, descriptor->compute.constants);
+        cap_end();
+    }
+    return ret;
+}
+
+WGVK_CORE(RenderPipelineGetBindGroupLayout);
+WGPUBindGroupLayout wgpuRenderPipelineGetBindGroupLayout(WGPURenderPipeline renderPipeline, uint32_t groupIndex){
+    WGPUBindGroupLayout ret = wgvkCore_RenderPipelineGetBindGroupLayout(renderPipeline, groupIndex);
+    if(ret && cap_begin(WGVKCaptureOp_RenderPipelineGetBindGroupLayout)){
+        cap_object(renderPipeline);
+        cap_u32(groupIndex);
+        cap_new(ret);
+        cap_end();
+    }
+    return ret;
+}
+
+WGVK_CORE(ComputePipelineGetBindGroupLayout);
+WGPUBindGroupLayout wgpuComputePipelineGetBindGroupLayout(WGPUComputePipeline computePipeline, uint32_t groupIndex){
+    WGPUBindGroupLayout ret = wgvkCore_ComputePipelineGetBindGroupLayout(computePipeline, groupIndex);
+    if(ret && cap_begin(WGVKCaptureOp_ComputePipelineGetBindGroupLayout)){
+        cap_object(computePipeline);
+        cap_u32(groupIndex);
+        cap_new(ret);
+        cap_end();
+    }
+    return ret;
+}
+
+WGVK_CORE(DeviceCreateCommandEncoder);
+WGPUCommandEncoder wgpuDeviceCreateCommandEncoder(WGPUDevice device, const WGPUCommandEncoderDescriptor* cdesc){
+    WGPUCommandEncoder ret = wgvkCore_DeviceCreateCommandEncoder(device, cdesc);
+    if(ret && cap_begin(WGVKCaptureOp_CreateCommandEncoder)){
+        cap_implicit(device);
+        cap_new(ret);
+        cap_end();
+    }
+    return ret;
+}
+
+WGVK_CORE(DeviceCreateRenderBundleEncoder);
+WGPURenderBundleEncoder wgpuDeviceCreateRenderBundleEncoder(WGPUDevice device, const WGPURenderBundleEncoderDescriptor* descriptor){
+    WGPURenderBundleEncoder ret = wgvkCore_DeviceCreateRenderBundleEncoder(device, descriptor);
+    if(ret && cap_begin(WGVKCaptureOp_CreateRenderBundleEncoder)){
+        cap_implicit(device);
+        cap_new(ret);
+        cap_u32((uint32_t)descriptor->colorFormatCount);
+        for(size_t i = 0;i < descriptor->colorFormatCount;i++){
+            cap_u32(descriptor->colorFormats[i]);
+        }
+        cap_u32(descriptor->depthStencilFormat);
+        cap_u32(descriptor->sampleCount);
+        cap_u32(descriptor->depthReadOnly);
+        cap_u32(descriptor->stencilReadOnly);
+        cap_end();
+    }
+    return ret;
+}
+
+// Object lifetime
+
+#define CAPTURE_LIFETIME(Type)                                                                          \
+    WGVK_CORE(Type##AddRef);                                                                            \
+    WGVK_CORE(Type##Release);                                                                           \
+    void wgpu##Type##AddRef(WGPU##Type object){                                                         \
+        cap_lifetime(WGVKCaptureOp_AddRef, WGVKCaptureObjectType_##Type, object);                       \
+        wgvkCore_##Type##AddRef(object);                                                                \
+    }                                                                                                   \
+    void wgpu##Type##Release(WGPU##Type object){                                                        \
+        cap_lifetime(WGVKCaptureOp_Release, WGVKCaptureObjectType_##Type, object);                      \
+        wgvkCore_##Type##Release(object);                                                               \
+    }
+
+CAPTURE_LIFETIME(Buffer)
+CAPTURE_LIFETIME(Texture)
+CAPTURE_LIFETIME(TextureView)
+CAPTURE_LIFETIME(Sampler)
+CAPTURE_LIFETIME(ShaderModule)
+CAPTURE_LIFETIME(BindGroupLayout)
+CAPTURE_LIFETIME(PipelineLayout)
+CAPTURE_LIFETIME(BindGroup)
+CAPTURE_LIFETIME(RenderPipeline)
+CAPTURE_LIFETIME(ComputePipeline)
+CAPTURE_LIFETIME(CommandEncoder)
+CAPTURE_LIFETIME(CommandBuffer)
+CAPTURE_LIFETIME(RenderPassEncoder)
+CAPTURE_LIFETIME(ComputePassEncoder)
+CAPTURE_LIFETIME(RenderBundleEncoder)
+CAPTURE_LIFETIME(RenderBundle)
+
+WGVK_CORE(BufferDestroy);
+void wgpuBufferDestroy(WGPUBuffer buffer){
+    if(cap_begin(WGVKCaptureOp_BufferDestroy)){
+        cap_object(buffer);
+        cap_end();
+    }
+    wgvkCore_BufferDestroy(buffer);
+}
+
+WGVK_CORE(TextureDestroy);
+void wgpuTextureDestroy(WGPUTexture texture){
+    if(cap_begin(WGVKCaptureOp_TextureDestroy)){
+        cap_object(texture);
+        cap_end();
+    }
+    wgvkCore_TextureDestroy(texture);
+}
+
+// Mapping. Maps are remembered and emitted as a single record on unmap, together with what was written
+
+static void cap_rememberMap(WGPUBuffer buffer, WGPUMapMode mode, size_t offset, size_t size){
+    if(cap_lock()){
+        CaptureBufferState* state = cap_bufferState(buffer);
+        state->mapMode = mode;
+        state->mapOffset = offset;
+        state->mapSize = (size == WGPU_WHOLE_SIZE || size == WGPU_WHOLE_MAP_SIZE) ? state->size - offset : size;
+        wgvk_mutex_unlock(capture.mutex);
+    }
+}
+
+WGVK_CORE(BufferMap);
+void wgpuBufferMap(WGPUBuffer buffer, WGPUMapMode mapmode, size_t offset, size_t size, void** data){
+    wgvkCore_BufferMap(buffer, mapmode, offset, size, data);
+    cap_rememberMap(buffer, mapmode, offset, size);
+}
+
+WGVK_CORE(BufferMapAsync);
+WGPUFuture wgpuBufferMapAsync(WGPUBuffer buffer, WGPUMapMode mode, size_t offset, size_t size, WGPUBufferMapCallbackInfo callbackInfo){
+    cap_rememberMap(buffer, mode, offset, size);
+    return wgvkCore_BufferMapAsync(buffer, mode, offset, size, callbackInfo);
+}
+
+WGVK_CORE(BufferUnmap);
+void wgpuBufferUnmap(WGPUBuffer buffer){
+    if(cap_begin(WGVKCaptureOp_BufferUnmap)){
+        CaptureBufferState* state = cap_bufferState(buffer);
+        cap_object(buffer);
+        cap_u32((uint32_t)state->mapMode);
+        cap_u64(state->mapOffset);
+        cap_u64(state->mapSize);
+        if((state->mapMode & WGPUMapMode_Write) && wgpuBufferGetMapState(buffer) == WGPUBufferMapState_Mapped){
+            cap_blob(wgpuBufferGetMappedRange(buffer, 0, state->mapSize), state->mapSize);
+        }
+        else{
+            cap_blob(NULL, 0);
+        }
+        state->mapMode = WGPUMapMode_None;
+        cap_end();
+    }
+    wgvkCore_BufferUnmap(buffer);
+}
+
+// Queue
+
+WGVK_CORE(QueueWriteBuffer);
+void wgpuQueueWriteBuffer(WGPUQueue queue, WGPUBuffer buffer, uint64_t bufferOffset, const void* data, size_t size){
+    if(cap_begin(WGVKCaptureOp_QueueWriteBuffer)){
+        cap_implicit(queue);
+        cap_object(buffer);
+        cap_u64(bufferOffset);
+        cap_blob(data, size);
+        cap_end();
+    }
+    wgvkCore_QueueWriteBuffer(queue, buffer, bufferOffset, data, size);
+}
+
+WGVK_CORE(QueueWriteTexture);
+void wgpuQueueWriteTexture(WGPUQueue queue, const WGPUTexelCopyTextureInfo* destination, const void* data, size_t dataSize, const WGPUTexelCopyBufferLayout* dataLayout, const WGPUExtent3D* writeSize){
+    if(cap_begin(WGVKCaptureOp_QueueWriteTexture)){
+        cap_implicit(queue);
+        cap_texelCopyTexture(destination);
+        cap_texelCopyBufferLayout(dataLayout);
+        cap_extent(writeSize);
+        cap_blob(data, dataSize);
+        cap_end();
+    }
+    wgvkCore_QueueWriteTexture(queue, destination, data, dataSize, dataLayout, writeSize);
+}
+
+WGVK_CORE(QueueSubmit);
+void wgpuQueueSubmit(WGPUQueue queue, size_t commandCount, const WGPUCommandBuffer* buffers){
+    if(cap_begin(WGVKCaptureOp_QueueSubmit)){
+        cap_implicit(queue);
+        cap_u32((uint32_t)commandCount);
+        for(size_t i = 0;i < commandCount;i++){
+            cap_object(buffers[i]);
+        }
+        cap_timestamp();
+        cap_end();
+    }
+    wgvkCore_QueueSubmit(queue, commandCount, buffers);
+}
+
+// Command encoder
+
+WGVK_CORE(CommandEncoderBeginRenderPass);
+WGPURenderPassEncoder wgpuCommandEncoderBeginRenderPass(WGPUCommandEncoder enc, const WGPURenderPassDescriptor* rpdesc){
+    WGPURenderPassEncoder ret = wgvkCore_CommandEncoderBeginRenderPass(enc, rpdesc);
+    if(ret && cap_begin(WGVKCaptureOp_BeginRenderPass)){
+        cap_object(enc);
+        cap_new(ret);
+        cap_u32((uint32_t)rpdesc->colorAttachmentCount);
+        for(size_t i = 0;i < rpdesc->colorAttachmentCount;i++){
+            const WGPURenderPassColorAttachment* attachment = rpdesc->colorAttachments + i;
+            cap_object(attachment->view);
+            cap_object(attachment->resolveTarget);
+            cap_u32(attachment->depthSlice);
+            cap_u32(attachment->loadOp);
+            cap_u32(attachment->storeOp);
+            cap_f64(attachment->clearValue.r);
+            cap_f64(attachment->clearValue.g);
+            cap_f64(attachment->clearValue.b);
+            cap_f64(attachment->clearValue.a);
+        }
+        const WGPURenderPassDepthStencilAttachment* depthStencil = rpdesc->depthStencilAttachment;
+        cap_u32(depthStencil != NULL);
+        if(depthStencil){
+            cap_object(depthStencil->view);
+            cap_u32(depthStencil->depthLoadOp);
+            cap_u32(depthStencil->depthStoreOp);
+            cap_f32(depthStencil->depthClearValue);
+            cap_u32(depthStencil->depthReadOnly);
+            cap_u32(depthStencil->stencilLoadOp);
+            cap_u32(depthStencil->stencilStoreOp);
+            cap_u32(depthStencil->stencilClearValue);
+            cap_u32(depthStencil->stencilReadOnly);
+        }
+        cap_end();
+    }
+    return ret;
+}
+
+WGVK_CORE(CommandEncoderBeginComputePass);
+WGPUComputePassEncoder wgpuCommandEncoderBeginComputePass(WGPUCommandEncoder enc, const WGPUComputePassDescriptor* cpdesc){
+    WGPUComputePassEncoder ret = wgvkCore_CommandEncoderBeginComputePass(enc, cpdesc);
+    if(ret && cap_begin(WGVKCaptureOp_BeginComputePass)){
+        cap_object(enc);
+        cap_new(ret);
+        cap_end();
+    }
+    return ret;
+}
+
+WGVK_CORE(CommandEncoderCopyBufferToBuffer);
+void wgpuCommandEncoderCopyBufferToBuffer(WGPUCommandEncoder commandEncoder, WGPUBuffer source, uint64_t sourceOffset, WGPUBuffer destination, uint64_t destinationOffset, uint64_t size){
+    if(cap_begin(WGVKCaptureOp_CopyBufferToBuffer)){
+        cap_object(commandEncoder);
+        cap_object(source);
+        cap_u64(sourceOffset);
+        cap_object(destination);
+        cap_u64(destinationOffset);
+        cap_u64(size);
+        cap_end();
+    }
+    wgvkCore_CommandEncoderCopyBufferToBuffer(commandEncoder, source, sourceOffset, destination, destinationOffset, size);
+}
+
+WGVK_CORE(CommandEncoderCopyBufferToTexture);
+void wgpuCommandEncoderCopyBufferToTexture(WGPUCommandEncoder commandEncoder, const WGPUTexelCopyBufferInfo* source, const WGPUTexelCopyTextureInfo* destination, const WGPUExtent3D* copySize){
+    if(cap_begin(WGVKCaptureOp_CopyBufferToTexture)){
+        cap_object(commandEncoder);
+        cap_texelCopyBuffer(source);
+        cap_texelCopyTexture(destination);
+        cap_extent(copySize);
+        cap_end();
+    }
+    wgvkCore_CommandEncoderCopyBufferToTexture(commandEncoder, source, destination, copySize);
+}
+
+WGVK_CORE(CommandEncoderCopyTextureToBuffer);
+void wgpuCommandEncoderCopyTextureToBuffer(WGPUCommandEncoder commandEncoder, const WGPUTexelCopyTextureInfo* source, const WGPUTexelCopyBufferInfo* destination, const WGPUExtent3D* copySize){
+    if(cap_begin(WGVKCaptureOp_CopyTextureToBuffer)){
+        cap_object(commandEncoder);
+        cap_texelCopyTexture(source);
+        cap_texelCopyBuffer(destination);
+        cap_extent(copySize);
+        cap_end();
+    }
+    wgvkCore_CommandEncoderCopyTextureToBuffer(commandEncoder, source, destination, copySize);
+}
+
+WGVK_CORE(CommandEncoderCopyTextureToTexture);
+void wgpuCommandEncoderCopyTextureToTexture(WGPUCommandEncoder commandEncoder, const WGPUTexelCopyTextureInfo* source, const WGPUTexelCopyTextureInfo* destination, const WGPUExtent3D* copySize){
+    if(cap_begin(WGVKCaptureOp_CopyTextureToTexture)){
+        cap_object(commandEncoder);
+        cap_texelCopyTexture(source);
+        cap_texelCopyTexture(destination);
+        cap_extent(copySize);
+        cap_end();
+    }
+    wgvkCore_CommandEncoderCopyTextureToTexture(commandEncoder, source, destination, copySize);
+}
+
+WGVK_CORE(CommandEncoderClearBuffer);
+void wgpuCommandEncoderClearBuffer(WGPUCommandEncoder commandEncoder, WGPUBuffer buffer, uint64_t offset, uint64_t size){
+    if(cap_begin(WGVKCaptureOp_ClearBuffer)){
+        cap_object(commandEncoder);
+        cap_object(buffer);
+        cap_u64(offset);
+        cap_u64(size);
+        cap_end();
+    }
+    wgvkCore_CommandEncoderClearBuffer(commandEncoder, buffer, offset, size);
+}
+
+WGVK_CORE(CommandEncoderFinish);
+WGPUCommandBuffer wgpuCommandEncoderFinish(WGPUCommandEncoder commandEncoder, const WGPUCommandBufferDescriptor* descriptor){
+    WGPUCommandBuffer ret = wgvkCore_CommandEncoderFinish(commandEncoder, descriptor);
+    if(ret && cap_begin(WGVKCaptureOp_CommandEncoderFinish)){
+        cap_object(commandEncoder);
+        cap_new(ret);
+        cap_end();
+    }
+    return ret;
+}
+
+// Render pass encoder
+
+WGVK_CORE(RenderPassEncoderSetPipeline);
+void wgpuRenderPassEncoderSetPipeline(WGPURenderPassEncoder rpenc, WGPURenderPipeline renderPipeline){
+    if(cap_begin(WGVKCaptureOp_RenderPassSetPipeline)){
+        cap_object(rpenc);
+        cap_object(renderPipeline);
+        cap_end();
+    }
+    wgvkCore_RenderPassEncoderSetPipeline(rpenc, renderPipeline);
+}
+
+WGVK_CORE(RenderPassEncoderSetBindGroup);
+void wgpuRenderPassEncoderSetBindGroup(WGPURenderPassEncoder rpenc, uint32_t groupIndex, WGPUBindGroup group, size_t dynamicOffsetCount, const uint32_t* dynamicOffsets){
+    if(cap_begin(WGVKCaptureOp_RenderPassSetBindGroup)){
+        cap_object(rpenc);
+        cap_bindGroupOffsets(groupIndex, group, dynamicOffsetCount, dynamicOffsets);
+        cap_end();
+    }
+    wgvkCore_RenderPassEncoderSetBindGroup(rpenc, groupIndex, group, dynamicOffsetCount, dynamicOffsets);
+}
+
+WGVK_CORE(RenderPassEncoderSetVertexBuffer);
+void wgpuRenderPassEncoderSetVertexBuffer(WGPURenderPassEncoder rpe, uint32_t binding, WGPUBuffer buffer, size_t offset, uint64_t size){
+    if(cap_begin(WGVKCaptureOp_RenderPassSetVertexBuffer)){
+        cap_object(rpe);
+        cap_u32(binding);
+        cap_object(buffer);
+        cap_u64(offset);
+        cap_u64(size);
+        cap_end();
+    }
+    wgvkCore_RenderPassEncoderSetVertexBuffer(rpe, binding, buffer, offset, size);
+}
+
+WGVK_CORE(RenderPassEncoderSetIndexBuffer);
+void wgpuRenderPassEncoderSetIndexBuffer(WGPURenderPassEncoder renderPassEncoder, WGPUBuffer buffer, WGPUIndexFormat format, uint64_t offset, uint64_t size){
+    if(cap_begin(WGVKCaptureOp_RenderPassSetIndexBuffer)){
+        cap_object(renderPassEncoder);
+        cap_object(buffer);
+        cap_u32(format);
+        cap_u64(offset);
+        cap_u64(size);
+        cap_end();
+    }
+    wgvkCore_RenderPassEncoderSetIndexBuffer(renderPassEncoder, buffer, format, offset, size);
+}
+
+WGVK_CORE(RenderPassEncoderSetViewport);
+void wgpuRenderPassEncoderSetViewport(WGPURenderPassEncoder renderPassEncoder, float x, float y, float width, float height, float minDepth, float maxDepth){
+    if(cap_begin(WGVKCaptureOp_RenderPassSetViewport)){
+        cap_object(renderPassEncoder);
+        cap_f32(x);
+        cap_f32(y);
+        cap_f32(width);
+        cap_f32(height);
+        cap_f32(minDepth);
+        cap_f32(maxDepth);
+        cap_end();
+    }
+    wgvkCore_RenderPassEncoderSetViewport(renderPassEncoder, x, y, width, height, minDepth, maxDepth);
+}
+
+WGVK_CORE(RenderPassEncoderSetScissorRect);
+void wgpuRenderPassEncoderSetScissorRect(WGPURenderPassEncoder renderPassEncoder, uint32_t x, uint32_t y, uint32_t width, uint32_t height){
+    if(cap_begin(WGVKCaptureOp_RenderPassSetScissorRect)){
+        cap_object(renderPassEncoder);
+        cap_u32(x);
+        cap_u32(y);
+        cap_u32(width);
+        cap_u32(height);
+        cap_end();
+    }
+    wgvkCore_RenderPassEncoderSetScissorRect(renderPassEncoder, x, y, width, height);
+}
+
+WGVK_CORE(RenderPassEncoderSetBlendConstant);
+void wgpuRenderPassEncoderSetBlendConstant(WGPURenderPassEncoder renderPassEncoder, const WGPUColor* color){
+    if(cap_begin(WGVKCaptureOp_RenderPassSetBlendConstant)){
+        cap_object(renderPassEncoder);
+        cap_f64(color->r);
+        cap_f64(color->g);
+        cap_f64(color->b);
+        cap_f64(color->a);
+        cap_end();
+    }
+    wgvkCore_RenderPassEncoderSetBlendConstant(renderPassEncoder, color);
+}
+
+WGVK_CORE(RenderPassEncoderSetStencilReference);
+void wgpuRenderPassEncoderSetStencilReference(WGPURenderPassEncoder renderPassEncoder, uint32_t reference){
+    if(cap_begin(WGVKCaptureOp_RenderPassSetStencilReference)){
+        cap_object(renderPassEncoder);
+        cap_u32(reference);
+        cap_end();
+    }
+    wgvkCore_RenderPassEncoderSetStencilReference(renderPassEncoder, reference);
+}
+
+WGVK_CORE(RenderPassEncoderDraw);
+void wgpuRenderPassEncoderDraw(WGPURenderPassEncoder rpenc, uint32_t vertices, uint32_t instances, uint32_t firstvertex, uint32_t firstinstance){
+    if(cap_begin(WGVKCaptureOp_RenderPassDraw)){
+        cap_object(rpenc);
+        cap_u32(vertices);
+        cap_u32(instances);
+        cap_u32(firstvertex);
+        cap_u32(firstinstance);
+        cap_end();
+    }
+    wgvkCore_RenderPassEncoderDraw(rpenc, vertices, instances, firstvertex, firstinstance);
+}
+
+WGVK_CORE(RenderPassEncoderDrawIndexed);
+void wgpuRenderPassEncoderDrawIndexed(WGPURenderPassEncoder rpenc, uint32_t indices, uint32_t instances, uint32_t firstindex, int32_t basevertex, uint32_t firstinstance){
+    if(cap_begin(WGVKCaptureOp_RenderPassDrawIndexed)){
+        cap_object(rpenc);
+        cap_u32(indices);
+        cap_u32(instances);
+        cap_u32(firstindex);
+        cap_i32(basevertex);
+        cap_u32(firstinstance);
+        cap_end();
+    }
+    wgvkCore_RenderPassEncoderDrawIndexed(rpenc, indices, instances, firstindex, basevertex, firstinstance);
+}
+
+WGVK_CORE(RenderPassEncoderDrawIndirect);
+void wgpuRenderPassEncoderDrawIndirect(WGPURenderPassEncoder renderPassEncoder, WGPUBuffer indirectBuffer, uint64_t indirectOffset){
+    if(cap_begin(WGVKCaptureOp_RenderPassDrawIndirect)){
+        cap_object(renderPassEncoder);
+        cap_object(indirectBuffer);
+        cap_u64(indirectOffset);
+        cap_end();
+    }
+    wgvkCore_RenderPassEncoderDrawIndirect(renderPassEncoder, indirectBuffer, indirectOffset);
+}
+
+WGVK_CORE(RenderPassEncoderDrawIndexedIndirect);
+void wgpuRenderPassEncoderDrawIndexedIndirect(WGPURenderPassEncoder renderPassEncoder, WGPUBuffer indirectBuffer, uint64_t indirectOffset){
+    if(cap_begin(WGVKCaptureOp_RenderPassDrawIndexedIndirect)){
+        cap_object(renderPassEncoder);
+        cap_object(indirectBuffer);
+        cap_u64(indirectOffset);
+        cap_end();
+    }
+    wgvkCore_RenderPassEncoderDrawIndexedIndirect(renderPassEncoder, indirectBuffer, indirectOffset);
+}
+
+WGVK_CORE(RenderPassEncoderMultiDrawIndirect);
+void wgpuRenderPassEncoderMultiDrawIndirect(WGPURenderPassEncoder renderPassEncoder, WGPUBuffer indirectBuffer, uint64_t indirectOffset, uint32_t maxDrawCount, WGPUBuffer drawCountBuffer, uint64_t drawCountBufferOffset){
+    if(cap_begin(WGVKCaptureOp_RenderPassMultiDrawIndirect)){
+        cap_object(renderPassEncoder);
+        cap_multiDraw(indirectBuffer, indirectOffset, maxDrawCount, drawCountBuffer, drawCountBufferOffset);
+        cap_end();
+    }
+    wgvkCore_RenderPassEncoderMultiDrawIndirect(renderPassEncoder, indirectBuffer, indirectOffset, maxDrawCount, drawCountBuffer, drawCountBufferOffset);
+}
+
+WGVK_CORE(RenderPassEncoderMultiDrawIndexedIndirect);
+void wgpuRenderPassEncoderMultiDrawIndexedIndirect(WGPURenderPassEncoder renderPassEncoder, WGPUBuffer indirectBuffer, uint64_t indirectOffset, uint32_t maxDrawCount, WGPUBuffer drawCountBuffer, uint64_t drawCountBufferOffset){
+    if(cap_begin(WGVKCaptureOp_RenderPassMultiDrawIndexedIndirect)){
+        cap_object(renderPassEncoder);
+        cap_multiDraw(indirectBuffer, indirectOffset, maxDrawCount, drawCountBuffer, drawCountBufferOffset);
+        cap_end();
+    }
+    wgvkCore_RenderPassEncoderMultiDrawIndexedIndirect(renderPassEncoder, indirectBuffer, indirectOffset, maxDrawCount, drawCountBuffer, drawCountBufferOffset);
+}
+
+WGVK_CORE(RenderPassEncoderExecuteBundles);
+void wgpuRenderPassEncoderExecuteBundles(WGPURenderPassEncoder renderPassEncoder, size_t bundleCount, const WGPURenderBundle* bundles){
+    if(cap_begin(WGVKCaptureOp_RenderPassExecuteBundles)){
+        cap_object(renderPassEncoder);
+        cap_u32((uint32_t)bundleCount);
+        for(size_t i = 0;i < bundleCount;i++){
+            cap_object(bundles[i]);
+        }
+        cap_end();
+    }
+    wgvkCore_RenderPassEncoderExecuteBundles(renderPassEncoder, bundleCount, bundles);
+}
+
+WGVK_CORE(RenderPassEncoderEnd);
+void wgpuRenderPassEncoderEnd(WGPURenderPassEncoder rrpenc){
+    if(cap_begin(WGVKCaptureOp_RenderPassEnd)){
+        cap_object(rrpenc);
+        cap_end();
+    }
+    wgvkCore_RenderPassEncoderEnd(rrpenc);
+}
+
+// Compute pass encoder
+
+WGVK_CORE(ComputePassEncoderSetPipeline);
+void wgpuComputePassEncoderSetPipeline(WGPUComputePassEncoder cpe, WGPUComputePipeline computePipeline){
+    if(cap_begin(WGVKCaptureOp_ComputePassSetPipeline)){
+        cap_object(cpe);
+        cap_object(computePipeline);
+        cap_end();
+    }
+    wgvkCore_ComputePassEncoderSetPipeline(cpe, computePipeline);
+}
+
+WGVK_CORE(ComputePassEncoderSetBindGroup);
+void wgpuComputePassEncoderSetBindGroup(WGPUComputePassEncoder cpe, uint32_t groupIndex, WGPUBindGroup group, size_t dynamicOffsetCount, const uint32_t* dynamicOffsets){
+    if(cap_begin(WGVKCaptureOp_ComputePassSetBindGroup)){
+        cap_object(cpe);
+        cap_bindGroupOffsets(groupIndex, group, dynamicOffsetCount, dynamicOffsets);
+        cap_end();
+    }
+    wgvkCore_ComputePassEncoderSetBindGroup(cpe, groupIndex, group, dynamicOffsetCount, dynamicOffsets);
+}
+
+WGVK_CORE(ComputePassEncoderDispatchWorkgroups);
+void wgpuComputePassEncoderDispatchWorkgroups(WGPUComputePassEncoder cpe, uint32_t x, uint32_t y, uint32_t z){
+    if(cap_begin(WGVKCaptureOp_ComputePassDispatchWorkgroups)){
+        cap_object(cpe);
+        cap_u32(x);
+        cap_u32(y);
+        cap_u32(z);
+        cap_end();
+    }
+    wgvkCore_ComputePassEncoderDispatchWorkgroups(cpe, x, y, z);
+}
+
+WGVK_CORE(ComputePassEncoderDispatchWorkgroupsIndirect);
+void wgpuComputePassEncoderDispatchWorkgroupsIndirect(WGPUComputePassEncoder computePassEncoder, WGPUBuffer indirectBuffer, uint64_t indirectOffset){
+    if(cap_begin(WGVKCaptureOp_ComputePassDispatchWorkgroupsIndirect)){
+        cap_object(computePassEncoder);
+        cap_object(indirectBuffer);
+        cap_u64(indirectOffset);
+        cap_end();
+    }
+    wgvkCore_ComputePassEncoderDispatchWorkgroupsIndirect(computePassEncoder, indirectBuffer, indirectOffset);
+}
+
+WGVK_CORE(ComputePassEncoderEnd);
+void wgpuComputePassEncoderEnd(WGPUComputePassEncoder commandEncoder){
+    if(cap_begin(WGVKCaptureOp_ComputePassEnd)){
+        cap_object(commandEncoder);
+        cap_end();
+    }
+    wgvkCore_ComputePassEncoderEnd(commandEncoder);
+}
+
+// Render bundle encoder
+
+WGVK_CORE(RenderBundleEncoderSetPipeline);
+void wgpuRenderBundleEncoderSetPipeline(WGPURenderBundleEncoder renderBundleEncoder, WGPURenderPipeline pipeline){
+    if(cap_begin(WGVKCaptureOp_RenderBundleSetPipeline)){
+        cap_object(renderBundleEncoder);
+        cap_object(pipeline);
+        cap_end();
+    }
+    wgvkCore_RenderBundleEncoderSetPipeline(renderBundleEncoder, pipeline);
+}
+
+WGVK_CORE(RenderBundleEncoderSetBindGroup);
+void wgpuRenderBundleEncoderSetBindGroup(WGPURenderBundleEncoder renderBundleEncoder, uint32_t groupIndex, WGPUBindGroup group, size_t dynamicOffsetCount, const uint32_t* dynamicOffsets){
+    if(cap_begin(WGVKCaptureOp_RenderBundleSetBindGroup)){
+        cap_object(renderBundleEncoder);
+        cap_bindGroupOffsets(groupIndex, group, dynamicOffsetCount, dynamicOffsets);
+        cap_end();
+    }
+    wgvkCore_RenderBundleEncoderSetBindGroup(renderBundleEncoder, groupIndex, group, dynamicOffsetCount, dynamicOffsets);
+}
+
+WGVK_CORE(RenderBundleEncoderSetVertexBuffer);
+void wgpuRenderBundleEncoderSetVertexBuffer(WGPURenderBundleEncoder renderBundleEncoder, uint32_t slot, WGPUBuffer buffer, uint64_t offset, uint64_t size){
+    if(cap_begin(WGVKCaptureOp_RenderBundleSetVertexBuffer)){
+        cap_object(renderBundleEncoder);
+        cap_u32(slot);
+        cap_object(buffer);
+        cap_u64(offset);
+        cap_u64(size);
+        cap_end();
+    }
+    wgvkCore_RenderBundleEncoderSetVertexBuffer(renderBundleEncoder, slot, buffer, offset, size);
+}
+
+WGVK_CORE(RenderBundleEncoderSetIndexBuffer);
+void wgpuRenderBundleEncoderSetIndexBuffer(WGPURenderBundleEncoder renderBundleEncoder, WGPUBuffer buffer, WGPUIndexFormat format, uint64_t offset, uint64_t size){
+    if(cap_begin(WGVKCaptureOp_RenderBundleSetIndexBuffer)){
+        cap_object(renderBundleEncoder);
+        cap_object(buffer);
+        cap_u32(format);
+        cap_u64(offset);
+        cap_u64(size);
+        cap_end();
+    }
+    wgvkCore_RenderBundleEncoderSetIndexBuffer(renderBundleEncoder, buffer, format, offset, size);
+}
+
+WGVK_CORE(RenderBundleEncoderDraw);
+void wgpuRenderBundleEncoderDraw(WGPURenderBundleEncoder renderBundleEncoder, uint32_t vertexCount, uint32_t instanceCount, uint32_t firstVertex, uint32_t firstInstance){
+    if(cap_begin(WGVKCaptureOp_RenderBundleDraw)){
+        cap_object(renderBundleEncoder);
+        cap_u32(vertexCount);
+        cap_u32(instanceCount);
+        cap_u32(firstVertex);
+        cap_u32(firstInstance);
+        cap_end();
+    }
+    wgvkCore_RenderBundleEncoderDraw(renderBundleEncoder, vertexCount, instanceCount, firstVertex, firstInstance);
+}
+
+WGVK_CORE(RenderBundleEncoderDrawIndexed);
+void wgpuRenderBundleEncoderDrawIndexed(WGPURenderBundleEncoder renderBundleEncoder, uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex, int32_t baseVertex, uint32_t firstInstance){
+    if(cap_begin(WGVKCaptureOp_RenderBundleDrawIndexed)){
+        cap_object(renderBundleEncoder);
+        cap_u32(indexCount);
+        cap_u32(instanceCount);
+        cap_u32(firstIndex);
+        cap_i32(baseVertex);
+        cap_u32(firstInstance);
+        cap_end();
+    }
+    wgvkCore_RenderBundleEncoderDrawIndexed(renderBundleEncoder, indexCount, instanceCount, firstIndex, baseVertex, firstInstance);
+}
+
+WGVK_CORE(RenderBundleEncoderDrawIndirect);
+void wgpuRenderBundleEncoderDrawIndirect(WGPURenderBundleEncoder renderBundleEncoder, WGPUBuffer indirectBuffer, uint64_t indirectOffset){
+    if(cap_begin(WGVKCaptureOp_RenderBundleDrawIndirect)){
+        cap_object(renderBundleEncoder);
+        cap_object(indirectBuffer);
+        cap_u64(indirectOffset);
+        cap_end();
+    }
+    wgvkCore_RenderBundleEncoderDrawIndirect(renderBundleEncoder, indirectBuffer, indirectOffset);
+}
+
+WGVK_CORE(RenderBundleEncoderDrawIndexedIndirect);
+void wgpuRenderBundleEncoderDrawIndexedIndirect(WGPURenderBundleEncoder renderBundleEncoder, WGPUBuffer indirectBuffer, uint64_t indirectOffset){
+    if(cap_begin(WGVKCaptureOp_RenderBundleDrawIndexedIndirect)){
+        cap_object(renderBundleEncoder);
+        cap_object(indirectBuffer);
+        cap_u64(indirectOffset);
+        cap_end();
+    }
+    wgvkCore_RenderBundleEncoderDrawIndexedIndirect(renderBundleEncoder, indirectBuffer, indirectOffset);
+}
+
+WGVK_CORE(RenderBundleEncoderMultiDrawIndirect);
+void wgpuRenderBundleEncoderMultiDrawIndirect(WGPURenderBundleEncoder renderBundleEncoder, WGPUBuffer indirectBuffer, uint64_t indirectOffset, uint32_t maxDrawCount, WGPUBuffer drawCountBuffer, uint64_t drawCountBufferOffset){
+    if(cap_begin(WGVKCaptureOp_RenderBundleMultiDrawIndirect)){
+        cap_object(renderBundleEncoder);
+        cap_multiDraw(indirectBuffer, indirectOffset, maxDrawCount, drawCountBuffer, drawCountBufferOffset);
+        cap_end();
+    }
+    wgvkCore_RenderBundleEncoderMultiDrawIndirect(renderBundleEncoder, indirectBuffer, indirectOffset, maxDrawCount, drawCountBuffer, drawCountBufferOffset);
+}
+
+WGVK_CORE(RenderBundleEncoderMultiDrawIndexedIndirect);
+void wgpuRenderBundleEncoderMultiDrawIndexedIndirect(WGPURenderBundleEncoder renderBundleEncoder, WGPUBuffer indirectBuffer, uint64_t indirectOffset, uint32_t maxDrawCount, WGPUBuffer drawCountBuffer, uint64_t drawCountBufferOffset){
+    if(cap_begin(WGVKCaptureOp_RenderBundleMultiDrawIndexedIndirect)){
+        cap_object(renderBundleEncoder);
+        cap_multiDraw(indirectBuffer, indirectOffset, maxDrawCount, drawCountBuffer, drawCountBufferOffset);
+        cap_end();
+    }
+    wgvkCore_RenderBundleEncoderMultiDrawIndexedIndirect(renderBundleEncoder, indirectBuffer, indirectOffset, maxDrawCount, drawCountBuffer, drawCountBufferOffset);
+}
+
+WGVK_CORE(RenderBundleEncoderFinish);
+WGPURenderBundle wgpuRenderBundleEncoderFinish(WGPURenderBundleEncoder renderBundleEncoder, const WGPURenderBundleDescriptor* descriptor){
+    WGPURenderBundle ret = wgvkCore_RenderBundleEncoderFinish(renderBundleEncoder, descriptor);
+    if(ret && cap_begin(WGVKCaptureOp_RenderBundleFinish)){
+        cap_object(renderBundleEncoder);
+        cap_new(ret);
+        cap_end();
+    }
+    return ret;
+}
+
+// Surfaces and frame boundaries
+
+WGVK_CORE(SurfaceConfigure);
+void wgpuSurfaceConfigure(WGPUSurface surface, const WGPUSurfaceConfiguration* config){
+    wgvkCore_SurfaceConfigure(surface, config);
+    if(cap_begin(WGVKCaptureOp_SurfaceConfigure)){
+        cap_implicit(surface);
+        cap_u32(config->format);
+        cap_u64(config->usage);
+        cap_u32(config->width);
+        cap_u32(config->height);
+        cap_u32((uint32_t)config->viewFormatCount);
+        for(size_t i = 0;i < config->viewFormatCount;i++){
+            cap_u32(config->viewFormats[i]);
+        }
+        cap_end();
+    }
+}
+
+WGVK_CORE(SurfaceGetCurrentTexture);
+void wgpuSurfaceGetCurrentTexture(WGPUSurface surface, WGPUSurfaceTexture* surfaceTexture){
+    wgvkCore_SurfaceGetCurrentTexture(surface, surfaceTexture);
+    if(surfaceTexture->texture && cap_begin(WGVKCaptureOp_SurfaceGetCurrentTexture)){
+        cap_implicit(surface);
+        cap_new(surfaceTexture->texture);
+        cap_end();
+    }
+}
+
+WGVK_CORE(SurfacePresent);
+void wgpuSurfacePresent(WGPUSurface surface){
+    wgvkCore_SurfacePresent(surface);
+    if(cap_begin(WGVKCaptureOp_SurfacePresent)){
+        cap_implicit(surface);
+        cap_timestamp();
+        cap_end();
+    }
+}
+
+WGVK_CORE(DeviceTick);
+void wgpuDeviceTick(WGPUDevice device){
+    wgvkCore_DeviceTick(device);
+    if(cap_begin(WGVKCaptureOp_DeviceTick)){
+        cap_implicit(device);
+        cap_timestamp();
+        cap_end();
+    }
+}
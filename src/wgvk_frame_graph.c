@@ -0,0 +1,440 @@
+/*
+ * wgvk_frame_graph.c - Frame graph layer: culls, orders and records passes declared with their resource uses
+ *
+ * Only built with WGVK_ENABLE_FRAME_GRAPH, the API and its semantics are documented in wgvk_frame_graph.h.
+ * Everything up to wgvkFrameGraphCompile is plain CPU work on indices, the GPU is only touched by
+ * wgvkFrameGraphExecute, which creates transient textures and calls back into the passes.
+ */
+#include <wgvk.h>
+#include <wgvk_structs_impl.h>
+#include <wgvk_frame_graph.h>
+#include <stdlib.h>
+#include <string.h>
+
+DEFINE_VECTOR(static inline, uint32_t, FGIndexVector)
+
+typedef enum FGResourceType{
+    fg_resource_imported_buffer,
+    fg_resource_imported_texture,
+    fg_resource_transient_texture,
+}FGResourceType;
+
+typedef struct FGResource{
+    FGResourceType type;
+    WGPUBuffer buffer;
+    WGPUTexture texture;
+    WGPUTextureDescriptor descriptor; // Transient textures only, without label and view formats
+    bool output;
+    uint32_t slot;                    // Index into the graph's texture pool
+    uint32_t firstUse;                // Positions in the schedule
+    uint32_t lastUse;
+    // Dependency building
+    uint32_t lastWriter;
+    FGIndexVector readersSinceWrite;
+}FGResource;
+
+typedef struct FGPass{
+    WGPUString label;
+    FGIndexVector reads;
+    FGIndexVector writes;
+    FGIndexVector predecessors;
+    bool hasSideEffects;
+    bool needed;
+    WGVKFrameGraphExecuteCallback execute;
+    void* userdata;
+}FGPass;
+
+typedef struct FGPooledTexture{
+    WGPUTextureDescriptor descriptor;
+    WGPUTexture texture;              // Created by the first execute that needs it
+    uint32_t busyUntil;               // Last schedule position using it in the current plan, UINT32_MAX if free
+}FGPooledTexture;
+
+DEFINE_VECTOR(static inline, FGResource, FGResourceVector)
+DEFINE_VECTOR(static inline, FGPass, FGPassVector)
+DEFINE_VECTOR(static inline, FGPooledTexture, FGPooledTextureVector)
+
+typedef struct WGVKFrameGraphImpl{
+    WGPUDevice device;
+    FGResourceVector resources;       // Handle h is resources.data[h - 1]
+    FGPassVector passes;
+    FGPooledTextureVector texturePool;
+    FGIndexVector schedule;
+    bool compiled;
+    WGVKFrameGraphStats stats;
+}WGVKFrameGraphImpl;
+
+#define FG_NONE UINT32_MAX
+
+static FGResource* fg_resource(WGVKFrameGraph graph, WGVKFrameGraphResource handle){
+    wgvk_assert(handle != 0 && handle <= graph->resources.size, "Invalid frame graph resource");
+    return graph->resources.data + handle - 1;
+}
+
+static WGVKFrameGraphResource fg_addResource(WGVKFrameGraph graph, FGResource resource){
+    resource.slot = FG_NONE;
+    resource.lastWriter = FG_NONE;
+    FGIndexVector_init(&resource.readersSinceWrite);
+    FGResourceVector_push_back(&graph->resources, resource);
+    graph->compiled = false;
+    return (WGVKFrameGraphResource)graph->resources.size;
+}
+
+static void fg_pushUnique(FGIndexVector* v, uint32_t value){
+    for(size_t i = 0;i < v->size;i++){
+        if(v->data[i] == value){
+            return;
+        }
+    }
+    FGIndexVector_push_back(v, value);
+}
+
+static bool fg_sameTextureDescriptor(const WGPUTextureDescriptor* a, const WGPUTextureDescriptor* b){
+    return a->usage == b->usage
+        && a->dimension == b->dimension
+        && a->size.width == b->size.width
+        && a->size.height == b->size.height
+        && a->size.depthOrArrayLayers == b->size.depthOrArrayLayers
+        && a->format == b->format
+        && a->mipLevelCount == b->mipLevelCount
+        && a->sampleCount == b->sampleCount;
+}
+
+WGVKFrameGraph wgvkFrameGraphCreate(WGPUDevice device){
+    WGVKFrameGraph ret = RL_CALLOC(1, sizeof(WGVKFrameGraphImpl));
+    ret->device = device;
+    FGResourceVector_init(&ret->resources);
+    FGPassVector_init(&ret->passes);
+    FGPooledTextureVector_init(&ret->texturePool);
+    FGIndexVector_init(&ret->schedule);
+    return ret;
+}
+
+void wgvkFrameGraphReset(WGVKFrameGraph graph){
+    for(size_t i = 0;i < graph->resources.size;i++){
+        FGResource* resource = graph->resources.data + i;
+        if(resource->type == fg_resource_imported_buffer){
+            wgpuBufferRelease(resource->buffer);
+        }
+        else if(resource->type == fg_resource_imported_texture){
+            wgpuTextureRelease(resource->texture);
+        }
+        FGIndexVector_free(&resource->readersSinceWrite);
+    }
+    for(size_t i = 0;i < graph->passes.size;i++){
+        FGPass* pass = graph->passes.data + i;
+        WGPUStringFree(pass->label);
+        FGIndexVector_free(&pass->reads);
+        FGIndexVector_free(&pass->writes);
+        FGIndexVector_free(&pass->predecessors);
+    }
+    FGResourceVector_clear(&graph->resources);
+    FGPassVector_clear(&graph->passes);
+    FGIndexVector_clear(&graph->schedule);
+    graph->compiled = false;
+    memset(&graph->stats, 0, sizeof(graph->stats));
+}
+
+void wgvkFrameGraphRelease(WGVKFrameGraph graph){
+    wgvkFrameGraphReset(graph);
+    for(size_t i = 0;i < graph->texturePool.size;i++){
+        if(graph->texturePool.data[i].texture){
+            wgpuTextureRelease(graph->texturePool.data[i].texture);
+        }
+    }
+    FGResourceVector_free(&graph->resources);
+    FGPassVector_free(&graph->passes);
+    FGPooledTextureVector_free(&graph->texturePool);
+    FGIndexVector_free(&graph->schedule);
+    RL_FREE(graph);
+}
+
+WGVKFrameGraphResource wgvkFrameGraphImportBuffer(WGVKFrameGraph graph, WGPUBuffer buffer){
+    wgpuBufferAddRef(buffer);
+    return fg_addResource(graph, (FGResource){
+        .type = fg_resource_imported_buffer,
+        .buffer = buffer,
+    });
+}
+
+WGVKFrameGraphResource wgvkFrameGraphImportTexture(WGVKFrameGraph graph, WGPUTexture texture){
+    wgpuTextureAddRef(texture);
+    return fg_addResource(graph, (FGResource){
+        .type = fg_resource_imported_texture,
+        .texture = texture,
+    });
+}
+
+WGVKFrameGraphResource wgvkFrameGraphCreateTexture(WGVKFrameGraph graph, const WGPUTextureDescriptor* descriptor){
+    FGResource resource = {
+        .type = fg_resource_transient_texture,
+        .descriptor = *descriptor,
+    };
+    resource.descriptor.nextInChain = NULL;
+    resource.descriptor.label = (WGPUStringView){0};
+    resource.descriptor.viewFormatCount = 0;
+    resource.descriptor.viewFormats = NULL;
+    return fg_addResource(graph, resource);
+}
+
+void wgvkFrameGraphMarkOutput(WGVKFrameGraph graph, WGVKFrameGraphResource resource){
+    fg_resource(graph, resource)->output = true;
+    graph->compiled = false;
+}
+
+uint32_t wgvkFrameGraphAddPass(WGVKFrameGraph graph, const WGVKFrameGraphPassDescriptor* descriptor){
+    FGPass pass = {
+        .label = WGPUStringFromView(descriptor->label),
+        .hasSideEffects = descriptor->hasSideEffects,
+        .execute = descriptor->execute,
+        .userdata = descriptor->userdata,
+    };
+    FGIndexVector_init(&pass.reads);
+    FGIndexVector_init(&pass.writes);
+    FGIndexVector_init(&pass.predecessors);
+    const uint32_t passIndex = (uint32_t)graph->passes.size;
+
+    // A read depends on the last write, a write on the last write and every read since
+    for(size_t i = 0;i < descriptor->readCount;i++){
+        FGResource* resource = fg_resource(graph, descriptor->reads[i]);
+        fg_pushUnique(&pass.reads, descriptor->reads[i]);
+        if(resource->lastWriter != FG_NONE){
+            fg_pushUnique(&pass.predecessors, resource->lastWriter);
+        }
+    }
+    for(size_t i = 0;i < descriptor->writeCount;i++){
+        FGResource* resource = fg_resource(graph, descriptor->writes[i]);
+        fg_pushUnique(&pass.writes, descriptor->writes[i]);
+        if(resource->lastWriter != FG_NONE){
+            fg_pushUnique(&pass.predecessors, resource->lastWriter);
+        }
+        for(size_t j = 0;j < resource->readersSinceWrite.size;j++){
+            fg_pushUnique(&pass.predecessors, resource->readersSinceWrite.data[j]);
+        }
+    }
+    for(size_t i = 0;i < pass.reads.size;i++){
+        fg_pushUnique(&fg_resource(graph, pass.reads.data[i])->readersSinceWrite, passIndex);
+    }
+    for(size_t i = 0;i < pass.writes.size;i++){
+        FGResource* resource = fg_resource(graph, pass.writes.data[i]);
+        resource->lastWriter = passIndex;
+        FGIndexVector_clear(&resource->readersSinceWrite);
+    }
+    FGPassVector_push_back(&graph->passes, pass);
+    graph->compiled = false;
+    return passIndex;
+}
+
+static void fg_cull(WGVKFrameGraph graph){
+    // Predecessors always come first, so one walk from the back propagates needed-ness to all producers
+    for(size_t p = graph->passes.size;p-- > 0;){
+        FGPass* pass = graph->passes.data + p;
+        pass->needed = pass->needed || pass->hasSideEffects;
+        for(size_t i = 0;i < pass->writes.size && !pass->needed;i++){
+            const FGResource* resource = fg_resource(graph, pass->writes.data[i]);
+            pass->needed = resource->output || resource->type != fg_resource_transient_texture;
+        }
+        if(pass->needed){
+            for(size_t i = 0;i < pass->predecessors.size;i++){
+                graph->passes.data[pass->predecessors.data[i]].needed = true;
+            }
+        }
+    }
+}
+
+static bool fg_dependsOn(const FGPass* pass, uint32_t other){
+    for(size_t i = 0;i < pass->predecessors.size;i++){
+        if(pass->predecessors.data[i] == other){
+            return true;
+        }
+    }
+    return false;
+}
+
+// Topological order of the needed passes. Among the passes that are ready, one that does not depend
+// on the pass scheduled right before it goes first, ties keep the order the passes were added in
+static void fg_schedule(WGVKFrameGraph graph){
+    const size_t passCount = graph->passes.size;
+    uint32_t* pendingPredecessors = RL_CALLOC(passCount ? passCount : 1, sizeof(uint32_t));
+    bool* scheduled = RL_CALLOC(passCount ? passCount : 1, sizeof(bool));
+    size_t neededCount = 0;
+    for(size_t p = 0;p < passCount;p++){
+        const FGPass* pass = graph->passes.data + p;
+        if(!pass->needed){
+            continue;
+        }
+        ++neededCount;
+        pendingPredecessors[p] = (uint32_t)pass->predecessors.size;
+    }
+    FGIndexVector_clear(&graph->schedule);
+    uint32_t previous = FG_NONE;
+    while(graph->schedule.size < neededCount){
+        uint32_t pick = FG_NONE;
+        for(size_t p = 0;p < passCount;p++){
+            const FGPass* pass = graph->passes.data + p;
+            if(!pass->needed || scheduled[p] || pendingPredecessors[p] != 0){
+                continue;
+            }
+            if(pick == FG_NONE){
+                pick = (uint32_t)p;
+            }
+            if(previous == FG_NONE || !fg_dependsOn(pass, previous)){
+                pick = (uint32_t)p;
+                break;
+            }
+        }
+        wgvk_assert(pick != FG_NONE, "Frame graph dependencies form a cycle");
+        if(previous != FG_NONE && fg_dependsOn(graph->passes.data + pick, previous)){
+            ++graph->stats.adjacentDependencies;
+        }
+        scheduled[pick] = true;
+        FGIndexVector_push_back(&graph->schedule, pick);
+        for(size_t p = 0;p < passCount;p++){
+            if(graph->passes.data[p].needed && !scheduled[p] && fg_dependsOn(graph->passes.data + p, pick)){
+                --pendingPredecessors[p];
+            }
+        }
+        previous = pick;
+    }
+    RL_FREE(pendingPredecessors);
+    RL_FREE(scheduled);
+}
+
+static void fg_touch(FGResource* resource, uint32_t position){
+    if(resource->firstUse == FG_NONE){
+        resource->firstUse = position;
+    }
+    resource->lastUse = position;
+}
+
+// Transient textures are handed the first pooled texture with the same descriptor that is free by their first use
+static void fg_assignTextures(WGVKFrameGraph graph){
+    for(size_t i = 0;i < graph->resources.size;i++){
+        graph->resources.data[i].firstUse = FG_NONE;
+        graph->resources.data[i].lastUse = FG_NONE;
+        graph->resources.data[i].slot = FG_NONE;
+    }
+    for(uint32_t position = 0;position < graph->schedule.size;position++){
+        const FGPass* pass = graph->passes.data + graph->schedule.data[position];
+        for(size_t i = 0;i < pass->reads.size;i++){
+            fg_touch(fg_resource(graph, pass->reads.data[i]), position);
+        }
+        for(size_t i = 0;i < pass->writes.size;i++){
+            fg_touch(fg_resource(graph, pass->writes.data[i]), position);
+        }
+    }
+    for(size_t i = 0;i < graph->texturePool.size;i++){
+        graph->texturePool.data[i].busyUntil = FG_NONE;
+    }
+    uint32_t physicalCount = 0;
+    for(uint32_t position = 0;position < graph->schedule.size;position++){
+        for(size_t r = 0;r < graph->resources.size;r++){
+            FGResource* resource = graph->resources.data + r;
+            if(resource->type != fg_resource_transient_texture || resource->firstUse != position){
+                continue;
+            }
+            ++graph->stats.transientTextureCount;
+            uint32_t slot = FG_NONE;
+            for(size_t s = 0;s < graph->texturePool.size;s++){
+                const FGPooledTexture* pooled = graph->texturePool.data + s;
+                if((pooled->busyUntil == FG_NONE || pooled->busyUntil < position) && fg_sameTextureDescriptor(&pooled->descriptor, &resource->descriptor)){
+                    slot = (uint32_t)s;
+                    break;
+                }
+            }
+            if(slot == FG_NONE){
+                FGPooledTextureVector_push_back(&graph->texturePool, (FGPooledTexture){
+                    .descriptor = resource->descriptor,
+                    .busyUntil = FG_NONE,
+                });
+                slot = (uint32_t)graph->texturePool.size - 1;
+            }
+            if(graph->texturePool.data[slot].busyUntil == FG_NONE){
+                ++physicalCount;
+            }
+            graph->texturePool.data[slot].busyUntil = resource->lastUse;
+            resource->slot = slot;
+        }
+    }
+    graph->stats.physicalTextureCount = physicalCount;
+}
+
+void wgvkFrameGraphCompile(WGVKFrameGraph graph){
+    memset(&graph->stats, 0, sizeof(graph->stats));
+    for(size_t p = 0;p < graph->passes.size;p++){
+        graph->passes.data[p].needed = false;
+    }
+    fg_cull(graph);
+    fg_schedule(graph);
+    fg_assignTextures(graph);
+    graph->stats.passCount = (uint32_t)graph->passes.size;
+    graph->stats.scheduledPassCount = (uint32_t)graph->schedule.size;
+    graph->compiled = true;
+}
+
+size_t wgvkFrameGraphGetSchedule(WGVKFrameGraph graph, uint32_t* passes, size_t capacity){
+    if(!graph->compiled){
+        wgvkFrameGraphCompile(graph);
+    }
+    const size_t count = graph->schedule.size < capacity ? graph->schedule.size : capacity;
+    if(count > 0){
+        memcpy(passes, graph->schedule.data, count * sizeof(uint32_t));
+    }
+    return graph->schedule.size;
+}
+
+uint32_t wgvkFrameGraphGetTextureSlot(WGVKFrameGraph graph, WGVKFrameGraphResource resource){
+    if(!graph->compiled){
+        wgvkFrameGraphCompile(graph);
+    }
+    return fg_resource(graph, resource)->slot;
+}
+
+void wgvkFrameGraphGetStats(WGVKFrameGraph graph, WGVKFrameGraphStats* stats){
+    if(!graph->compiled){
+        wgvkFrameGraphCompile(graph);
+    }
+    *stats = graph->stats;
+}
+
+void wgvkFrameGraphExecute(WGVKFrameGraph graph, WGPUCommandEncoder encoder){
+    if(!graph->compiled){
+        wgvkFrameGraphCompile(graph);
+    }
+    wgvk_assert(graph->device != NULL, "Executing a frame graph that was created without a device");
+    for(size_t r = 0;r < graph->resources.size;r++){
+        FGResource* resource = graph->resources.data + r;
+        if(resource->type != fg_resource_transient_texture || resource->slot == FG_NONE){
+            continue;
+        }
+        FGPooledTexture* pooled = graph->texturePool.data + resource->slot;
+        if(pooled->texture == NULL){
+            pooled->texture = wgpuDeviceCreateTexture(graph->device, &pooled->descriptor);
+        }
+        resource->texture = pooled->texture;
+    }
+    for(size_t i = 0;i < graph->schedule.size;i++){
+        const FGPass* pass = graph->passes.data + graph->schedule.data[i];
+        if(pass->label.length){
+            wgpuCommandEncoderPushDebugGroup(encoder, (WGPUStringView){pass->label.data, pass->label.length});
+        }
+        if(pass->execute){
+            pass->execute(graph, encoder, pass->userdata);
+        }
+        if(pass->label.length){
+            wgpuCommandEncoderPopDebugGroup(encoder);
+        }
+    }
+}
+
+WGPUTexture wgvkFrameGraphGetTexture(WGVKFrameGraph graph, WGVKFrameGraphResource resource){
+    const FGResource* res = fg_resource(graph, resource);
+    wgvk_assert(res->type != fg_resource_imported_buffer, "Frame graph resource is a buffer");
+    return res->texture;
+}
+
+WGPUBuffer wgvkFrameGraphGetBuffer(WGVKFrameGraph graph, WGVKFrameGraphResource resource){
+    const FGResource* res = fg_resource(graph, resource);
+    wgvk_assert(res->type == fg_resource_imported_buffer, "Frame graph resource is not a buffer");
+    return res->buffer;
+}
@@ -0,0 +1,1187 @@
+// Replays a trace written by the capture layer (WGVK_ENABLE_CAPTURE, see wgvk_capture.h) and reports the CPU time of every frame.
+// By default the replay runs on a software adapter such as lavapipe, so that traces taken on customer
+// machines can be compared on any box. Frames end at wgpuSurfacePresent and wgpuDeviceTick,
+// traces without either are split at every wgpuQueueSubmit instead.
+//
+// Usage: wgvk_replay [--gpu] [--quiet] [--csv <file>] <trace>
+#include <wgvk.h>
+#include <wgvk_capture.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>
+#ifndef STRVIEW
+    #define STRVIEW(X) (WGPUStringView){X, sizeof(X) - 1}
+#endif
+
+typedef struct Reader{
+    const uint8_t* data;
+    size_t size;
+    size_t offset;
+    bool overflow;
+}Reader;
+
+// Surfaces are replaced by a texture with the configured size and format
+typedef struct ReplaySurface{
+    WGPUTexture texture;
+}ReplaySurface;
+
+typedef struct FrameTimes{
+    double* replayMs;
+    double* capturedMs;
+    size_t count;
+    size_t capacity;
+    uint64_t replayStart;
+    uint64_t capturedStart;
+}FrameTimes;
+
+static struct{
+    WGPUDevice device;
+    WGPUQueue queue;
+    void** objects;
+    size_t objectCapacity;
+    // Per record allocations for strings and descriptor arrays
+    void** scratch;
+    size_t scratchCount;
+    size_t scratchCapacity;
+}replay;
+
+static uint64_t nanoTime(void){
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return ((uint64_t)ts.tv_sec) * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void* scratchAlloc(size_t size){
+    if(replay.scratchCount == replay.scratchCapacity){
+        replay.scratchCapacity = replay.scratchCapacity ? replay.scratchCapacity * 2 : 64;
+        replay.scratch = (void**)realloc(replay.scratch, replay.scratchCapacity * sizeof(void*));
+    }
+    void* ret = calloc(1, size ? size : 1);
+    replay.scratch[replay.scratchCount++] = ret;
+    return ret;
+}
+
+static void scratchReset(void){
+    for(size_t i = 0;i < replay.scratchCount;i++){
+        free(replay.scratch[i]);
+    }
+    replay.scratchCount = 0;
+}
+
+static const void* rd_view(Reader* r, size_t size){
+    if(r->overflow || size > r->size - r->offset){
+        r->overflow = true;
+        return NULL;
+    }
+    const void* ret = r->data + r->offset;
+    r->offset += size;
+    return ret;
+}
+
+static void rd_bytes(Reader* r, void* out, size_t size){
+    const void* src = rd_view(r, size);
+    if(src){
+        memcpy(out, src, size);
+    }
+    else{
+        memset(out, 0, size);
+    }
+}
+
+static uint32_t rd_u32(Reader* r){ uint32_t v; rd_bytes(r, &v, sizeof(v)); return v; }
+static int32_t  rd_i32(Reader* r){ int32_t v;  rd_bytes(r, &v, sizeof(v)); return v; }
+static uint64_t rd_u64(Reader* r){ uint64_t v; rd_bytes(r, &v, sizeof(v)); return v; }
+static float    rd_f32(Reader* r){ float v;    rd_bytes(r, &v, sizeof(v)); return v; }
+static double   rd_f64(Reader* r){ double v;   rd_bytes(r, &v, sizeof(v)); return v; }
+
+static const void* rd_blob(Reader* r, size_t* size){
+    *size = (size_t)rd_u64(r);
+    const void* ret = rd_view(r, *size);
+    if(ret == NULL){
+        *size = 0;
+    }
+    return ret;
+}
+
+// Copied and null terminated, wgvk hands entry points straight to Vulkan
+static WGPUStringView rd_string(Reader* r){
+    const uint32_t length = rd_u32(r);
+    const char* src = (const char*)rd_view(r, length);
+    if(src == NULL || length == 0){
+        return (WGPUStringView){NULL, 0};
+    }
+    char* copy = (char*)scratchAlloc(length + 1);
+    memcpy(copy, src, length);
+    return (WGPUStringView){copy, length};
+}
+
+static void* rd_object(Reader* r){
+    const uint64_t id = rd_u64(r);
+    return id < replay.objectCapacity ? replay.objects[id] : NULL;
+}
+
+static void setObject(uint64_t id, void* object){
+    if(id >= replay.objectCapacity){
+        size_t newCapacity = replay.objectCapacity ? replay.objectCapacity : 1024;
+        while(newCapacity <= id){
+            newCapacity *= 2;
+        }
+        replay.objects = (void**)realloc(replay.objects, newCapacity * sizeof(void*));
+        memset(replay.objects + replay.objectCapacity, 0, (newCapacity - replay.objectCapacity) * sizeof(void*));
+        replay.objectCapacity = newCapacity;
+    }
+    replay.objects[id] = object;
+}
+
+// Devices and queues in the trace all map to the replay device
+static void rd_device(Reader* r){ (void)rd_u64(r); }
+static void rd_queue(Reader* r){ (void)rd_u64(r); }
+
+static ReplaySurface* rd_surface(Reader* r){
+    const uint64_t id = rd_u64(r);
+    ReplaySurface* surface = id < replay.objectCapacity ? (ReplaySurface*)replay.objects[id] : NULL;
+    if(surface == NULL){
+        surface = (ReplaySurface*)calloc(1, sizeof(ReplaySurface));
+        setObject(id, surface);
+    }
+    return surface;
+}
+
+static WGPUConstantEntry* rd_constants(Reader* r, size_t* count){
+    *count = rd_u32(r);
+    WGPUConstantEntry* constants = (WGPUConstantEntry*)scratchAlloc(*count * sizeof(WGPUConstantEntry));
+    for(size_t i = 0;i < *count && !r->overflow;i++){
+        constants[i].key = rd_string(r);
+        constants[i].value = rd_f64(r);
+    }
+    return constants;
+}
+
+static WGPUExtent3D rd_extent(Reader* r){
+    WGPUExtent3D ret;
+    ret.width = rd_u32(r);
+    ret.height = rd_u32(r);
+    ret.depthOrArrayLayers = rd_u32(r);
+    return ret;
+}
+
+static WGPUTexelCopyTextureInfo rd_texelCopyTexture(Reader* r){
+    WGPUTexelCopyTextureInfo ret;
+    ret.texture = (WGPUTexture)rd_object(r);
+    ret.mipLevel = rd_u32(r);
+    ret.origin.x = rd_u32(r);
+    ret.origin.y = rd_u32(r);
+    ret.origin.z = rd_u32(r);
+    ret.aspect = (WGPUTextureAspect)rd_u32(r);
+    return ret;
+}
+
+static WGPUTexelCopyBufferLayout rd_texelCopyBufferLayout(Reader* r){
+    WGPUTexelCopyBufferLayout ret;
+    ret.offset = rd_u64(r);
+    ret.bytesPerRow = rd_u32(r);
+    ret.rowsPerImage = rd_u32(r);
+    return ret;
+}
+
+static WGPUTexelCopyBufferInfo rd_texelCopyBuffer(Reader* r){
+    WGPUTexelCopyBufferInfo ret;
+    ret.layout = rd_texelCopyBufferLayout(r);
+    ret.buffer = (WGPUBuffer)rd_object(r);
+    return ret;
+}
+
+typedef struct BindGroupOffsets{
+    uint32_t groupIndex;
+    WGPUBindGroup group;
+    size_t count;
+    uint32_t* offsets;
+}BindGroupOffsets;
+
+static BindGroupOffsets rd_bindGroupOffsets(Reader* r){
+    BindGroupOffsets ret;
+    ret.groupIndex = rd_u32(r);
+    ret.group = (WGPUBindGroup)rd_object(r);
+    ret.count = rd_u32(r);
+    ret.offsets = (uint32_t*)scratchAlloc(ret.count * sizeof(uint32_t));
+    rd_bytes(r, ret.offsets, ret.count * sizeof(uint32_t));
+    return ret;
+}
+
+typedef struct MultiDraw{
+    WGPUBuffer indirectBuffer;
+    uint64_t indirectOffset;
+    uint32_t maxDrawCount;
+    WGPUBuffer drawCountBuffer;
+    uint64_t drawCountBufferOffset;
+}MultiDraw;
+
+static MultiDraw rd_multiDraw(Reader* r){
+    MultiDraw ret;
+    ret.indirectBuffer = (WGPUBuffer)rd_object(r);
+    ret.indirectOffset = rd_u64(r);
+    ret.maxDrawCount = rd_u32(r);
+    ret.drawCountBuffer = (WGPUBuffer)rd_object(r);
+    ret.drawCountBufferOffset = rd_u64(r);
+    return ret;
+}
+
+static void frameEnd(FrameTimes* times, uint64_t capturedTimestamp){
+    const uint64_t now = nanoTime();
+    if(times->count == times->capacity){
+        times->capacity = times->capacity ? times->capacity * 2 : 256;
+        times->replayMs = (double*)realloc(times->replayMs, times->capacity * sizeof(double));
+        times->capturedMs = (double*)realloc(times->capturedMs, times->capacity * sizeof(double));
+    }
+    times->replayMs[times->count] = (double)(now - times->replayStart) / 1e6;
+    times->capturedMs[times->count] = (double)(capturedTimestamp - times->capturedStart) / 1e6;
+    times->count++;
+    times->replayStart = now;
+    times->capturedStart = capturedTimestamp;
+}
+
+static void replayAddRef(WGVKCaptureObjectType type, void* object){
+    switch(type){
+        case WGVKCaptureObjectType_Buffer:              wgpuBufferAddRef((WGPUBuffer)object); break;
+        case WGVKCaptureObjectType_Texture:             wgpuTextureAddRef((WGPUTexture)object); break;
+        case WGVKCaptureObjectType_TextureView:         wgpuTextureViewAddRef((WGPUTextureView)object); break;
+        case WGVKCaptureObjectType_Sampler:             wgpuSamplerAddRef((WGPUSampler)object); break;
+        case WGVKCaptureObjectType_ShaderModule:        wgpuShaderModuleAddRef((WGPUShaderModule)object); break;
+        case WGVKCaptureObjectType_BindGroupLayout:     wgpuBindGroupLayoutAddRef((WGPUBindGroupLayout)object); break;
+        case WGVKCaptureObjectType_PipelineLayout:      wgpuPipelineLayoutAddRef((WGPUPipelineLayout)object); break;
+        case WGVKCaptureObjectType_BindGroup:           wgpuBindGroupAddRef((WGPUBindGroup)object); break;
+        case WGVKCaptureObjectType_RenderPipeline:      wgpuRenderPipelineAddRef((WGPURenderPipeline)object); break;
+        case WGVKCaptureObjectType_ComputePipeline:     wgpuComputePipelineAddRef((WGPUComputePipeline)object); break;
+        case WGVKCaptureObjectType_CommandEncoder:      wgpuCommandEncoderAddRef((WGPUCommandEncoder)object); break;
+        case WGVKCaptureObjectType_CommandBuffer:       wgpuCommandBufferAddRef((WGPUCommandBuffer)object); break;
+        case WGVKCaptureObjectType_RenderPassEncoder:   wgpuRenderPassEncoderAddRef((WGPURenderPassEncoder)object); break;
+        case WGVKCaptureObjectType_ComputePassEncoder:  wgpuComputePassEncoderAddRef((WGPUComputePassEncoder)object); break;
+        case WGVKCaptureObjectType_RenderBundleEncoder: wgpuRenderBundleEncoderAddRef((WGPURenderBundleEncoder)object); break;
+        case WGVKCaptureObjectType_RenderBundle:        wgpuRenderBundleAddRef((WGPURenderBundle)object); break;
+        default: fprintf(stderr, "Unknown object type %u\n", (unsigned)type);
+    }
+}
+
+static void replayRelease(WGVKCaptureObjectType type, void* object){
+    switch(type){
+        case WGVKCaptureObjectType_Buffer:              wgpuBufferRelease((WGPUBuffer)object); break;
+        case WGVKCaptureObjectType_Texture:             wgpuTextureRelease((WGPUTexture)object); break;
+        case WGVKCaptureObjectType_TextureView:         wgpuTextureViewRelease((WGPUTextureView)object); break;
+        case WGVKCaptureObjectType_Sampler:             wgpuSamplerRelease((WGPUSampler)object); break;
+        case WGVKCaptureObjectType_ShaderModule:        wgpuShaderModuleRelease((WGPUShaderModule)object); break;
+        case WGVKCaptureObjectType_BindGroupLayout:     wgpuBindGroupLayoutRelease((WGPUBindGroupLayout)object); break;
+        case WGVKCaptureObjectType_PipelineLayout:      wgpuPipelineLayoutRelease((WGPUPipelineLayout)object); break;
+        case WGVKCaptureObjectType_BindGroup:           wgpuBindGroupRelease((WGPUBindGroup)object); break;
+        case WGVKCaptureObjectType_RenderPipeline:      wgpuRenderPipelineRelease((WGPURenderPipeline)object); break;
+        case WGVKCaptureObjectType_ComputePipeline:     wgpuComputePipelineRelease((WGPUComputePipeline)object); break;
+        case WGVKCaptureObjectType_CommandEncoder:      wgpuCommandEncoderRelease((WGPUCommandEncoder)object); break;
+        case WGVKCaptureObjectType_CommandBuffer:       wgpuCommandBufferRelease((WGPUCommandBuffer)object); break;
+        case WGVKCaptureObjectType_RenderPassEncoder:   wgpuRenderPassEncoderRelease((WGPURenderPassEncoder)object); break;
+        case WGVKCaptureObjectType_ComputePassEncoder:  wgpuComputePassEncoderRelease((WGPUComputePassEncoder)object); break;
+        case WGVKCaptureObjectType_RenderBundleEncoder: wgpuRenderBundleEncoderRelease((WGPURenderBundleEncoder)object); break;
+        case WGVKCaptureObjectType_RenderBundle:        wgpuRenderBundleRelease((WGPURenderBundle)object); break;
+        default: fprintf(stderr, "Unknown object type %u\n", (unsigned)type);
+    }
+}
+
+static void replayCreateRenderPipeline(Reader* r){
+    rd_device(r);
+    const uint64_t id = rd_u64(r);
+    WGPURenderPipelineDescriptor desc = {0};
+    desc.layout = (WGPUPipelineLayout)rd_object(r);
+
+    desc.vertex.module = (WGPUShaderModule)rd_object(r);
+    desc.vertex.entryPoint = rd_string(r);
+    desc.vertex.constants = rd_constants(r, &desc.vertex.constantCount);
+    desc.vertex.bufferCount = rd_u32(r);
+    WGPUVertexBufferLayout* buffers = (WGPUVertexBufferLayout*)scratchAlloc(desc.vertex.bufferCount * sizeof(WGPUVertexBufferLayout));
+    for(size_t i = 0;i < desc.vertex.bufferCount && !r->overflow;i++){
+        buffers[i].stepMode = (WGPUVertexStepMode)rd_u32(r);
+        buffers[i].arrayStride = rd_u64(r);
+        buffers[i].attributeCount = rd_u32(r);
+        WGPUVertexAttribute* attributes = (WGPUVertexAttribute*)scratchAlloc(buffers[i].attributeCount * sizeof(WGPUVertexAttribute));
+        for(size_t a = 0;a < buffers[i].attributeCount && !r->overflow;a++){
+            attributes[a].format = (WGPUVertexFormat)rd_u32(r);
+            attributes[a].offset = rd_u64(r);
+            attributes[a].shaderLocation = rd_u32(r);
+        }
+        buffers[i].attributes = attributes;
+    }
+    desc.vertex.buffers = buffers;
+
+    desc.primitive.topology = (WGPUPrimitiveTopology)rd_u32(r);
+    desc.primitive.stripIndexFormat = (WGPUIndexFormat)rd_u32(r);
+    desc.primitive.frontFace = (WGPUFrontFace)rd_u32(r);
+    desc.primitive.cullMode = (WGPUCullMode)rd_u32(r);
+    desc.primitive.unclippedDepth = rd_u32(r);
+    WGPUPrimitiveLineWidthInfo lineWidth = {
+        .chain.sType = WGPUSType_PrimitiveLineWidthInfo,
+        .lineWidth = rd_u32(r),
+    };
+    if(lineWidth.lineWidth){
+        desc.primitive.nextInChain = &lineWidth.chain;
+    }
+
+    WGPUDepthStencilState depthStencil = {0};
+    if(rd_u32(r)){
+        depthStencil.format = (WGPUTextureFormat)rd_u32(r);
+        depthStencil.depthWriteEnabled = rd_u32(r);
+        depthStencil.depthCompare = (WGPUCompareFunction)rd_u32(r);
+        WGPUStencilFaceState* faces[2] = {&depthStencil.stencilFront, &depthStencil.stencilBack};
+        for(uint32_t f = 0;f < 2;f++){
+            faces[f]->compare = (WGPUCompareFunction)rd_u32(r);
+            faces[f]->failOp = (WGPUStencilOperation)rd_u32(r);
+            faces[f]->depthFailOp = (WGPUStencilOperation)rd_u32(r);
+            faces[f]->passOp = (WGPUStencilOperation)rd_u32(r);
+        }
+        depthStencil.stencilReadMask = rd_u32(r);
+        depthStencil.stencilWriteMask = rd_u32(r);
+        depthStencil.depthBias = rd_i32(r);
+        depthStencil.depthBiasSlopeScale = rd_f32(r);
+        depthStencil.depthBiasClamp = rd_f32(r);
+        desc.depthStencil = &depthStencil;
+    }
+
+    desc.multisample.count = rd_u32(r);
+    desc.multisample.mask = rd_u32(r);
+    desc.multisample.alphaToCoverageEnabled = rd_u32(r);
+
+    WGPUFragmentState fragment = {0};
+    if(rd_u32(r)){
+        fragment.module = (WGPUShaderModule)rd_object(r);
+        fragment.entryPoint = rd_string(r);
+        fragment.constants = rd_constants(r, &fragment.constantCount);
+        fragment.targetCount = rd_u32(r);
+        WGPUColorTargetState* targets = (WGPUColorTargetState*)scratchAlloc(fragment.targetCount * sizeof(WGPUColorTargetState));
+        for(size_t i = 0;i < fragment.targetCount && !r->overflow;i++){
+            targets[i].format = (WGPUTextureFormat)rd_u32(r);
+            targets[i].writeMask = (WGPUColorWriteMask)rd_u64(r);
+            if(rd_u32(r)){
+                WGPUBlendState* blend = (WGPUBlendState*)scratchAlloc(sizeof(WGPUBlendState));
+                WGPUBlendComponent* components[2] = {&blend->color, &blend->alpha};
+                for(uint32_t c = 0;c < 2;c++){
+                    components[c]->operation = (WGPUBlendOperation)rd_u32(r);
+                    components[c]->srcFactor = (WGPUBlendFactor)rd_u32(r);
+                    components[c]->dstFactor = (WGPUBlendFactor)rd_u32(r);
+                }
+                targets[i].blend = blend;
+            }
+        }
+        fragment.targets = targets;
+        desc.fragment = &fragment;
+    }
+    if(!r->overflow){
+        setObject(id, wgpuDeviceCreateRenderPipeline(replay.device, &desc));
+    }
+}
+
+static void replayBeginRenderPass(Reader* r){
+    WGPUCommandEncoder encoder = (WGPUCommandEncoder)rd_object(r);
+    const uint64_t id = rd_u64(r);
+    WGPURenderPassDescriptor desc = {0};
+    desc.colorAttachmentCount = rd_u32(r);
+    WGPURenderPassColorAttachment* colorAttachments = (WGPURenderPassColorAttachment*)scratchAlloc(desc.colorAttachmentCount * sizeof(WGPURenderPassColorAttachment));
+    for(size_t i = 0;i < desc.colorAttachmentCount && !r->overflow;i++){
+        colorAttachments[i].view = (WGPUTextureView)rd_object(r);
+        colorAttachments[i].resolveTarget = (WGPUTextureView)rd_object(r);
+        colorAttachments[i].depthSlice = rd_u32(r);
+        colorAttachments[i].loadOp = (WGPULoadOp)rd_u32(r);
+        colorAttachments[i].storeOp = (WGPUStoreOp)rd_u32(r);
+        colorAttachments[i].clearValue.r = rd_f64(r);
+        colorAttachments[i].clearValue.g = rd_f64(r);
+        colorAttachments[i].clearValue.b = rd_f64(r);
+        colorAttachments[i].clearValue.a = rd_f64(r);
+    }
+    desc.colorAttachments = colorAttachments;
+    WGPURenderPassDepthStencilAttachment depthStencil = {0};
+    if(rd_u32(r)){
+        depthStencil.view = (WGPUTextureView)rd_object(r);
+        depthStencil.depthLoadOp = (WGPULoadOp)rd_u32(r);
+        depthStencil.depthStoreOp = (WGPUStoreOp)rd_u32(r);
+        depthStencil.depthClearValue = rd_f32(r);
+        depthStencil.depthReadOnly = rd_u32(r);
+        depthStencil.stencilLoadOp = (WGPULoadOp)rd_u32(r);
+        depthStencil.stencilStoreOp = (WGPUStoreOp)rd_u32(r);
+        depthStencil.stencilClearValue = rd_u32(r);
+        depthStencil.stencilReadOnly = rd_u32(r);
+        desc.depthStencilAttachment = &depthStencil;
+    }
+    if(!r->overflow){
+        setObject(id, wgpuCommandEncoderBeginRenderPass(encoder, &desc));
+    }
+}
+
+static bool replayRecord(WGVKCaptureOp op, Reader* r, FrameTimes* frames, FrameTimes* submits){
+    switch(op){
+        case WGVKCaptureOp_CreateBuffer:{
+            rd_device(r);
+            const uint64_t id = rd_u64(r);
+            WGPUBufferDescriptor desc = {0};
+            desc.usage = (WGPUBufferUsage)rd_u64(r);
+            desc.size = rd_u64(r);
+            desc.mappedAtCreation = rd_u32(r);
+            setObject(id, wgpuDeviceCreateBuffer(replay.device, &desc));
+        }break;
+        case WGVKCaptureOp_CreateTexture:{
+            rd_device(r);
+            const uint64_t id = rd_u64(r);
+            WGPUTextureDescriptor desc = {0};
+            desc.usage = (WGPUTextureUsage)rd_u64(r);
+            desc.dimension = (WGPUTextureDimension)rd_u32(r);
+            desc.size.width = rd_u32(r);
+            desc.size.height = rd_u32(r);
+            desc.size.depthOrArrayLayers = rd_u32(r);
+            desc.format = (WGPUTextureFormat)rd_u32(r);
+            desc.mipLevelCount = rd_u32(r);
+            desc.sampleCount = rd_u32(r);
+            desc.viewFormatCount = rd_u32(r);
+            WGPUTextureFormat* viewFormats = (WGPUTextureFormat*)scratchAlloc(desc.viewFormatCount * sizeof(WGPUTextureFormat));
+            for(size_t i = 0;i < desc.viewFormatCount;i++){
+                viewFormats[i] = (WGPUTextureFormat)rd_u32(r);
+            }
+            desc.viewFormats = viewFormats;
+            if(!r->overflow){
+                setObject(id, wgpuDeviceCreateTexture(replay.device, &desc));
+            }
+        }break;
+        case WGVKCaptureOp_TextureCreateView:{
+            WGPUTexture texture = (WGPUTexture)rd_object(r);
+            const uint64_t id = rd_u64(r);
+            WGPUTextureViewDescriptor desc = {0};
+            WGPUTextureComponentSwizzleDescriptor swizzle = {0};
+            const bool hasDescriptor = rd_u32(r);
+            if(hasDescriptor){
+                desc.format = (WGPUTextureFormat)rd_u32(r);
+                desc.dimension = (WGPUTextureViewDimension)rd_u32(r);
+                desc.baseMipLevel = rd_u32(r);
+                desc.mipLevelCount = rd_u32(r);
+                desc.baseArrayLayer = rd_u32(r);
+                desc.arrayLayerCount = rd_u32(r);
+                desc.aspect = (WGPUTextureAspect)rd_u32(r);
+                desc.usage = (WGPUTextureUsage)rd_u64(r);
+                if(rd_u32(r)){
+                    swizzle.chain.sType = WGPUSType_TextureComponentSwizzleDescriptor;
+                    swizzle.swizzle.r = (WGPUComponentSwizzle)rd_u32(r);
+                    swizzle.swizzle.g = (WGPUComponentSwizzle)rd_u32(r);
+                    swizzle.swizzle.b = (WGPUComponentSwizzle)rd_u32(r);
+                    swizzle.swizzle.a = (WGPUComponentSwizzle)rd_u32(r);
+                    desc.nextInChain = &swizzle.chain;
+                }
+            }
+            if(!r->overflow){
+                setObject(id, wgpuTextureCreateView(texture, hasDescriptor ? &desc : NULL));
+            }
+        }break;
+        case WGVKCaptureOp_CreateSampler:{
+            rd_device(r);
+            const uint64_t id = rd_u64(r);
+            WGPUSamplerDescriptor desc = {0};
+            desc.addressModeU = (WGPUAddressMode)rd_u32(r);
+            desc.addressModeV = (WGPUAddressMode)rd_u32(r);
+            desc.addressModeW = (WGPUAddressMode)rd_u32(r);
+            desc.magFilter = (WGPUFilterMode)rd_u32(r);
+            desc.minFilter = (WGPUFilterMode)rd_u32(r);
+            desc.mipmapFilter = (WGPUMipmapFilterMode)rd_u32(r);
+            desc.lodMinClamp = rd_f32(r);
+            desc.lodMaxClamp = rd_f32(r);
+            desc.compare = (WGPUCompareFunction)rd_u32(r);
+            desc.maxAnisotropy = (uint16_t)rd_u32(r);
+            setObject(id, wgpuDeviceCreateSampler(replay.device, &desc));
+        }break;
+        case WGVKCaptureOp_CreateShaderModule:{
+            rd_device(r);
+            const uint64_t id = rd_u64(r);
+            const WGPUSType sType = (WGPUSType)rd_u32(r);
+            const uint32_t stage = rd_u32(r);
+            size_t codeSize = 0;
+            const void* code = rd_blob(r, &codeSize);
+            // SPIR-V has to be word aligned and the shader languages null terminated
+            char* codeCopy = (char*)scratchAlloc(codeSize + 4);
+            memcpy(codeCopy, code, codeSize);
+            WGPUShaderSourceSPIRV spirv = {.chain.sType = WGPUSType_ShaderSourceSPIRV, .codeSize = (uint32_t)codeSize, .code = (const uint32_t*)codeCopy};
+            WGPUShaderSourceWGSL wgsl = {.chain.sType = WGPUSType_ShaderSourceWGSL, .code = {codeCopy, codeSize}};
+            WGPUShaderSourceGLSL glsl = {.chain.sType = WGPUSType_ShaderSourceGLSL, .stage = (WGPUShaderStage)stage, .code = {codeCopy, codeSize}};
+            WGPUShaderModuleDescriptor desc = {0};
+            switch(sType){
+                case WGPUSType_ShaderSourceSPIRV: desc.nextInChain = &spirv.chain; break;
+                case WGPUSType_ShaderSourceWGSL: desc.nextInChain = &wgsl.chain; break;
+                case WGPUSType_ShaderSourceGLSL: desc.nextInChain = &glsl.chain; break;
+                default: fprintf(stderr, "Shader module %llu has no source that can be replayed\n", (unsigned long long)id);
+            }
+            if(desc.nextInChain && !r->overflow){
+                setObject(id, wgpuDeviceCreateShaderModule(replay.device, &desc));
+            }
+        }break;
+        case WGVKCaptureOp_CreateBindGroupLayout:{
+            rd_device(r);
+            const uint64_t id = rd_u64(r);
+            WGPUBindGroupLayoutDescriptor desc = {0};
+            desc.entryCount = rd_u32(r);
+            WGPUBindGroupLayoutEntry* entries = (WGPUBindGroupLayoutEntry*)scratchAlloc(desc.entryCount * sizeof(WGPUBindGroupLayoutEntry));
+            for(size_t i = 0;i < desc.entryCount && !r->overflow;i++){
+                entries[i].binding = rd_u32(r);
+                entries[i].visibility = (WGPUShaderStage)rd_u64(r);
+                entries[i].buffer.type = (WGPUBufferBindingType)rd_u32(r);
+                entries[i].buffer.hasDynamicOffset = rd_u32(r);
+                entries[i].buffer.minBindingSize = rd_u64(r);
+                entries[i].sampler.type = (WGPUSamplerBindingType)rd_u32(r);
+                entries[i].texture.sampleType = (WGPUTextureSampleType)rd_u32(r);
+                entries[i].texture.viewDimension = (WGPUTextureViewDimension)rd_u32(r);
+                entries[i].texture.multisampled = rd_u32(r);
+                entries[i].storageTexture.access = (WGPUStorageTextureAccess)rd_u32(r);
+                entries[i].storageTexture.format = (WGPUTextureFormat)rd_u32(r);
+                entries[i].storageTexture.viewDimension = (WGPUTextureViewDimension)rd_u32(r);
+                entries[i].accelerationStructure = rd_u32(r);
+            }
+            desc.entries = entries;
+            if(!r->overflow){
+                setObject(id, wgpuDeviceCreateBindGroupLayout(replay.device, &desc));
+            }
+        }break;
+        case WGVKCaptureOp_CreatePipelineLayout:{
+            rd_device(r);
+            const uint64_t id = rd_u64(r);
+            WGPUPipelineLayoutDescriptor desc = {0};
+            desc.bindGroupLayoutCount = rd_u32(r);
+            WGPUBindGroupLayout* layouts = (WGPUBindGroupLayout*)scratchAlloc(desc.bindGroupLayoutCount * sizeof(WGPUBindGroupLayout));
+            for(size_t i = 0;i < desc.bindGroupLayoutCount;i++){
+                layouts[i] = (WGPUBindGroupLayout)rd_object(r);
+            }
+            desc.bindGroupLayouts = layouts;
+            desc.immediateDataRangeByteSize = rd_u32(r);
+            if(!r->overflow){
+                setObject(id, wgpuDeviceCreatePipelineLayout(replay.device, &desc));
+            }
+        }break;
+        case WGVKCaptureOp_CreateBindGroup:{
+            rd_device(r);
+            const uint64_t id = rd_u64(r);
+            WGPUBindGroupDescriptor desc = {0};
+            desc.layout = (WGPUBindGroupLayout)rd_object(r);
+            desc.entryCount = rd_u32(r);
+            WGPUBindGroupEntry* entries = (WGPUBindGroupEntry*)scratchAlloc(desc.entryCount * sizeof(WGPUBindGroupEntry));
+            for(size_t i = 0;i < desc.entryCount && !r->overflow;i++){
+                entries[i].binding = rd_u32(r);
+                entries[i].buffer = (WGPUBuffer)rd_object(r);
+                entries[i].offset = rd_u64(r);
+                entries[i].size = rd_u64(r);
+                entries[i].sampler = (WGPUSampler)rd_object(r);
+                entries[i].textureView = (WGPUTextureView)rd_object(r);
+            }
+            desc.entries = entries;
+            if(!r->overflow){
+                setObject(id, wgpuDeviceCreateBindGroup(replay.device, &desc));
+            }
+        }break;
+        case WGVKCaptureOp_CreateRenderPipeline:
+            replayCreateRenderPipeline(r);
+            break;
+        case WGVKCaptureOp_CreateComputePipeline:{
+            rd_device(r);
+            const uint64_t id = rd_u64(r);
+            WGPUComputePipelineDescriptor desc = {0};
+            desc.layout = (WGPUPipelineLayout)rd_object(r);
+            desc.compute.module = (WGPUShaderModule)rd_object(r);
+            desc.compute.entryPoint = rd_string(r);
+            desc.compute.constants = rd_constants(r, &desc.compute.constantCount);
+            if(!r->overflow){
+                setObject(id, wgpuDeviceCreateComputePipeline(replay.device, &desc));
+            }
+        }break;
+        case WGVKCaptureOp_RenderPipelineGetBindGroupLayout:{
+            WGPURenderPipeline pipeline = (WGPURenderPipeline)rd_object(r);
+            const uint32_t groupIndex = rd_u32(r);
+            const uint64_t id = rd_u64(r);
+            setObject(id, wgpuRenderPipelineGetBindGroupLayout(pipeline, groupIndex));
+        }break;
+        case WGVKCaptureOp_ComputePipelineGetBindGroupLayout:{
+            WGPUComputePipeline pipeline = (WGPUComputePipeline)rd_object(r);
+            const uint32_t groupIndex = rd_u32(r);
+            const uint64_t id = rd_u64(r);
+            setObject(id, wgpuComputePipelineGetBindGroupLayout(pipeline, groupIndex));
+        }break;
+        case WGVKCaptureOp_CreateCommandEncoder:{
+            rd_device(r);
+            const uint64_t id = rd_u64(r);
+            setObject(id, wgpuDeviceCreateCommandEncoder(replay.device, NULL));
+        }break;
+        case WGVKCaptureOp_CreateRenderBundleEncoder:{
+            rd_device(r);
+            const uint64_t id = rd_u64(r);
+            WGPURenderBundleEncoderDescriptor desc = {0};
+            desc.colorFormatCount = rd_u32(r);
+            WGPUTextureFormat* colorFormats = (WGPUTextureFormat*)scratchAlloc(desc.colorFormatCount * sizeof(WGPUTextureFormat));
+            for(size_t i = 0;i < desc.colorFormatCount;i++){
+                colorFormats[i] = (WGPUTextureFormat)rd_u32(r);
+            }
+            desc.colorFormats = colorFormats;
+            desc.depthStencilFormat = (WGPUTextureFormat)rd_u32(r);
+            desc.sampleCount = rd_u32(r);
+            desc.depthReadOnly = rd_u32(r);
+            desc.stencilReadOnly = rd_u32(r);
+            if(!r->overflow){
+                setObject(id, wgpuDeviceCreateRenderBundleEncoder(replay.device, &desc));
+            }
+        }break;
+
+        case WGVKCaptureOp_AddRef:
+        case WGVKCaptureOp_Release:{
+            const WGVKCaptureObjectType type = (WGVKCaptureObjectType)rd_u32(r);
+            void* object = rd_object(r);
+            if(object){
+                if(op == WGVKCaptureOp_AddRef){
+                    replayAddRef(type, object);
+                }
+                else{
+                    replayRelease(type, object);
+                }
+            }
+        }break;
+        case WGVKCaptureOp_BufferDestroy:{
+            WGPUBuffer buffer = (WGPUBuffer)rd_object(r);
+            if(buffer){
+                wgpuBufferDestroy(buffer);
+            }
+        }break;
+        case WGVKCaptureOp_TextureDestroy:{
+            WGPUTexture texture = (WGPUTexture)rd_object(r);
+            if(texture){
+                wgpuTextureDestroy(texture);
+            }
+        }break;
+        case WGVKCaptureOp_BufferUnmap:{
+            WGPUBuffer buffer = (WGPUBuffer)rd_object(r);
+            const WGPUMapMode mode = (WGPUMapMode)rd_u32(r);
+            const uint64_t offset = rd_u64(r);
+            const uint64_t size = rd_u64(r);
+            size_t contentSize = 0;
+            const void* contents = rd_blob(r, &contentSize);
+            if(buffer == NULL || r->overflow){
+                break;
+            }
+            void* mapped = NULL;
+            if(wgpuBufferGetMapState(buffer) == WGPUBufferMapState_Mapped){
+                mapped = wgpuBufferGetMappedRange(buffer, 0, size);
+            }
+            else if(mode != WGPUMapMode_None){
+                // Maps block on the buffer's last submit, like they did in the application
+                wgpuBufferMap(buffer, mode, offset, size, &mapped);
+            }
+            if(mapped && contentSize){
+                memcpy(mapped, contents, contentSize);
+            }
+            wgpuBufferUnmap(buffer);
+        }break;
+
+        case WGVKCaptureOp_QueueWriteBuffer:{
+            rd_queue(r);
+            WGPUBuffer buffer = (WGPUBuffer)rd_object(r);
+            const uint64_t offset = rd_u64(r);
+            size_t size = 0;
+            const void* data = rd_blob(r, &size);
+            if(buffer && !r->overflow){
+                wgpuQueueWriteBuffer(replay.queue, buffer, offset, data, size);
+            }
+        }break;
+        case WGVKCaptureOp_QueueWriteTexture:{
+            rd_queue(r);
+            const WGPUTexelCopyTextureInfo destination = rd_texelCopyTexture(r);
+            const WGPUTexelCopyBufferLayout layout = rd_texelCopyBufferLayout(r);
+            const WGPUExtent3D extent = rd_extent(r);
+            size_t size = 0;
+            const void* data = rd_blob(r, &size);
+            if(destination.texture && !r->overflow){
+                wgpuQueueWriteTexture(replay.queue, &destination, data, size, &layout, &extent);
+            }
+        }break;
+        case WGVKCaptureOp_QueueSubmit:{
+            rd_queue(r);
+            const size_t count = rd_u32(r);
+            WGPUCommandBuffer* buffers = (WGPUCommandBuffer*)scratchAlloc(count * sizeof(WGPUCommandBuffer));
+            for(size_t i = 0;i < count;i++){
+                buffers[i] = (WGPUCommandBuffer)rd_object(r);
+            }
+            const uint64_t timestamp = rd_u64(r);
+            if(!r->overflow){
+                wgpuQueueSubmit(replay.queue, count, buffers);
+                frameEnd(submits, timestamp);
+            }
+        }break;
+
+        case WGVKCaptureOp_BeginRenderPass:
+            replayBeginRenderPass(r);
+            break;
+        case WGVKCaptureOp_BeginComputePass:{
+            WGPUCommandEncoder encoder = (WGPUCommandEncoder)rd_object(r);
+            const uint64_t id = rd_u64(r);
+            setObject(id, wgpuCommandEncoderBeginComputePass(encoder, NULL));
+        }break;
+        case WGVKCaptureOp_CopyBufferToBuffer:{
+            WGPUCommandEncoder encoder = (WGPUCommandEncoder)rd_object(r);
+            WGPUBuffer source = (WGPUBuffer)rd_object(r);
+            const uint64_t sourceOffset = rd_u64(r);
+            WGPUBuffer destination = (WGPUBuffer)rd_object(r);
+            const uint64_t destinationOffset = rd_u64(r);
+            const uint64_t size = rd_u64(r);
+            wgpuCommandEncoderCopyBufferToBuffer(encoder, source, sourceOffset, destination, destinationOffset, size);
+        }break;
+        case WGVKCaptureOp_CopyBufferToTexture:{
+            WGPUCommandEncoder encoder = (WGPUCommandEncoder)rd_object(r);
+            const WGPUTexelCopyBufferInfo source = rd_texelCopyBuffer(r);
+            const WGPUTexelCopyTextureInfo destination = rd_texelCopyTexture(r);
+            const WGPUExtent3D extent = rd_extent(r);
+            wgpuCommandEncoderCopyBufferToTexture(encoder, &source, &destination, &extent);
+        }break;
+        case WGVKCaptureOp_CopyTextureToBuffer:{
+            WGPUCommandEncoder encoder = (WGPUCommandEncoder)rd_object(r);
+            const WGPUTexelCopyTextureInfo source = rd_texelCopyTexture(r);
+            const WGPUTexelCopyBufferInfo destination = rd_texelCopyBuffer(r);
+            const WGPUExtent3D extent = rd_extent(r);
+            wgpuCommandEncoderCopyTextureToBuffer(encoder, &source, &destination, &extent);
+        }break;
+        case WGVKCaptureOp_CopyTextureToTexture:{
+            WGPUCommandEncoder encoder = (WGPUCommandEncoder)rd_object(r);
+            const WGPUTexelCopyTextureInfo source = rd_texelCopyTexture(r);
+            const WGPUTexelCopyTextureInfo destination = rd_texelCopyTexture(r);
+            const WGPUExtent3D extent = rd_extent(r);
+            wgpuCommandEncoderCopyTextureToTexture(encoder, &source, &destination, &extent);
+        }break;
+        case WGVKCaptureOp_ClearBuffer:{
+            WGPUCommandEncoder encoder = (WGPUCommandEncoder)rd_object(r);
+            WGPUBuffer buffer = (WGPUBuffer)rd_object(r);
+            const uint64_t offset = rd_u64(r);
+            const uint64_t size = rd_u64(r);
+            wgpuCommandEncoderClearBuffer(encoder, buffer, offset, size);
+        }break;
+        case WGVKCaptureOp_CommandEncoderFinish:{
+            WGPUCommandEncoder encoder = (WGPUCommandEncoder)rd_object(r);
+            const uint64_t id = rd_u64(r);
+            setObject(id, wgpuCommandEncoderFinish(encoder, NULL));
+        }break;
+
+        case WGVKCaptureOp_RenderPassSetPipeline:{
+            WGPURenderPassEncoder pass = (WGPURenderPassEncoder)rd_object(r);
+            WGPURenderPipeline pipeline = (WGPURenderPipeline)rd_object(r);
+            wgpuRenderPassEncoderSetPipeline(pass, pipeline);
+        }break;
+        case WGVKCaptureOp_RenderPassSetBindGroup:{
+            WGPURenderPassEncoder pass = (WGPURenderPassEncoder)rd_object(r);
+            const BindGroupOffsets bg = rd_bindGroupOffsets(r);
+            wgpuRenderPassEncoderSetBindGroup(pass, bg.groupIndex, bg.group, bg.count, bg.offsets);
+        }break;
+        case WGVKCaptureOp_RenderPassSetVertexBuffer:{
+            WGPURenderPassEncoder pass = (WGPURenderPassEncoder)rd_object(r);
+            const uint32_t slot = rd_u32(r);
+            WGPUBuffer buffer = (WGPUBuffer)rd_object(r);
+            const uint64_t offset = rd_u64(r);
+            const uint64_t size = rd_u64(r);
+            wgpuRenderPassEncoderSetVertexBuffer(pass, slot, buffer, (size_t)offset, size);
+        }break;
+        case WGVKCaptureOp_RenderPassSetIndexBuffer:{
+            WGPURenderPassEncoder pass = (WGPURenderPassEncoder)rd_object(r);
+            WGPUBuffer buffer = (WGPUBuffer)rd_object(r);
+            const WGPUIndexFormat format = (WGPUIndexFormat)rd_u32(r);
+            const uint64_t offset = rd_u64(r);
+            const uint64_t size = rd_u64(r);
+            wgpuRenderPassEncoderSetIndexBuffer(pass, buffer, format, offset, size);
+        }break;
+        case WGVKCaptureOp_RenderPassSetViewport:{
+            WGPURenderPassEncoder pass = (WGPURenderPassEncoder)rd_object(r);
+            float v[6];
+            for(uint32_t i = 0;i < 6;i++){
+                v[i] = rd_f32(r);
+            }
+            wgpuRenderPassEncoderSetViewport(pass, v[0], v[1], v[2], v[3], v[4], v[5]);
+        }break;
+        case WGVKCaptureOp_RenderPassSetScissorRect:{
+            WGPURenderPassEncoder pass = (WGPURenderPassEncoder)rd_object(r);
+            uint32_t v[4];
+            for(uint32_t i = 0;i < 4;i++){
+                v[i] = rd_u32(r);
+            }
+            wgpuRenderPassEncoderSetScissorRect(pass, v[0], v[1], v[2], v[3]);
+        }break;
+        case WGVKCaptureOp_RenderPassSetBlendConstant:{
+            WGPURenderPassEncoder pass = (WGPURenderPassEncoder)rd_object(r);
+            WGPUColor color;
+            color.r = rd_f64(r);
+            color.g = rd_f64(r);
+            color.b = rd_f64(r);
+            color.a = rd_f64(r);
+            wgpuRenderPassEncoderSetBlendConstant(pass, &color);
+        }break;
+        case WGVKCaptureOp_RenderPassSetStencilReference:{
+            WGPURenderPassEncoder pass = (WGPURenderPassEncoder)rd_object(r);
+            wgpuRenderPassEncoderSetStencilReference(pass, rd_u32(r));
+        }break;
+        case WGVKCaptureOp_RenderPassDraw:{
+            WGPURenderPassEncoder pass = (WGPURenderPassEncoder)rd_object(r);
+            uint32_t v[4];
+            for(uint32_t i = 0;i < 4;i++){
+                v[i] = rd_u32(r);
+            }
+            wgpuRenderPassEncoderDraw(pass, v[0], v[1], v[2], v[3]);
+        }break;
+        case WGVKCaptureOp_RenderPassDrawIndexed:{
+            WGPURenderPassEncoder pass = (WGPURenderPassEncoder)rd_object(r);
+            const uint32_t indexCount = rd_u32(r);
+            const uint32_t instanceCount = rd_u32(r);
+            const uint32_t firstIndex = rd_u32(r);
+            const int32_t baseVertex = rd_i32(r);
+            const uint32_t firstInstance = rd_u32(r);
+            wgpuRenderPassEncoderDrawIndexed(pass, indexCount, instanceCount, firstIndex, baseVertex, firstInstance);
+        }break;
+        case WGVKCaptureOp_RenderPassDrawIndirect:{
+            WGPURenderPassEncoder pass = (WGPURenderPassEncoder)rd_object(r);
+            WGPUBuffer buffer = (WGPUBuffer)rd_object(r);
+            wgpuRenderPassEncoderDrawIndirect(pass, buffer, rd_u64(r));
+        }break;
+        case WGVKCaptureOp_RenderPassDrawIndexedIndirect:{
+            WGPURenderPassEncoder pass = (WGPURenderPassEncoder)rd_object(r);
+            WGPUBuffer buffer = (WGPUBuffer)rd_object(r);
+            wgpuRenderPassEncoderDrawIndexedIndirect(pass, buffer, rd_u64(r));
+        }break;
+        case WGVKCaptureOp_RenderPassMultiDrawIndirect:{
+            WGPURenderPassEncoder pass = (WGPURenderPassEncoder)rd_object(r);
+            const MultiDraw md = rd_multiDraw(r);
+            wgpuRenderPassEncoderMultiDrawIndirect(pass, md.indirectBuffer, md.indirectOffset, md.maxDrawCount, md.drawCountBuffer, md.drawCountBufferOffset);
+        }break;
+        case WGVKCaptureOp_RenderPassMultiDrawIndexedIndirect:{
+            WGPURenderPassEncoder pass = (WGPURenderPassEncoder)rd_object(r);
+            const MultiDraw md = rd_multiDraw(r);
+            wgpuRenderPassEncoderMultiDrawIndexedIndirect(pass, md.indirectBuffer, md.indirectOffset, md.maxDrawCount, md.drawCountBuffer, md.drawCountBufferOffset);
+        }break;
+        case WGVKCaptureOp_RenderPassExecuteBundles:{
+            WGPURenderPassEncoder pass = (WGPURenderPassEncoder)rd_object(r);
+            const size_t count = rd_u32(r);
+            WGPURenderBundle* bundles = (WGPURenderBundle*)scratchAlloc(count * sizeof(WGPURenderBundle));
+            for(size_t i = 0;i < count;i++){
+                bundles[i] = (WGPURenderBundle)rd_object(r);
+            }
+            if(!r->overflow){
+                wgpuRenderPassEncoderExecuteBundles(pass, count, bundles);
+            }
+        }break;
+        case WGVKCaptureOp_RenderPassEnd:
+            wgpuRenderPassEncoderEnd((WGPURenderPassEncoder)rd_object(r));
+            break;
+
+        case WGVKCaptureOp_ComputePassSetPipeline:{
+            WGPUComputePassEncoder pass = (WGPUComputePassEncoder)rd_object(r);
+            WGPUComputePipeline pipeline = (WGPUComputePipeline)rd_object(r);
+            wgpuComputePassEncoderSetPipeline(pass, pipeline);
+        }break;
+        case WGVKCaptureOp_ComputePassSetBindGroup:{
+            WGPUComputePassEncoder pass = (WGPUComputePassEncoder)rd_object(r);
+            const BindGroupOffsets bg = rd_bindGroupOffsets(r);
+            wgpuComputePassEncoderSetBindGroup(pass, bg.groupIndex, bg.group, bg.count, bg.offsets);
+        }break;
+        case WGVKCaptureOp_ComputePassDispatchWorkgroups:{
+            WGPUComputePassEncoder pass = (WGPUComputePassEncoder)rd_object(r);
+            const uint32_t x = rd_u32(r);
+            const uint32_t y = rd_u32(r);
+            const uint32_t z = rd_u32(r);
+            wgpuComputePassEncoderDispatchWorkgroups(pass, x, y, z);
+        }break;
+        case WGVKCaptureOp_ComputePassDispatchWorkgroupsIndirect:{
+            WGPUComputePassEncoder pass = (WGPUComputePassEncoder)rd_object(r);
+            WGPUBuffer buffer = (WGPUBuffer)rd_object(r);
+            wgpuComputePassEncoderDispatchWorkgroupsIndirect(pass, buffer, rd_u64(r));
+        }break;
+        case WGVKCaptureOp_ComputePassEnd:
+            wgpuComputePassEncoderEnd((WGPUComputePassEncoder)rd_object(r));
+            break;
+
+        case WGVKCaptureOp_RenderBundleSetPipeline:{
+            WGPURenderBundleEncoder encoder = (WGPURenderBundleEncoder)rd_object(r);
+            WGPURenderPipeline pipeline = (WGPURenderPipeline)rd_object(r);
+            wgpuRenderBundleEncoderSetPipeline(encoder, pipeline);
+        }break;
+        case WGVKCaptureOp_RenderBundleSetBindGroup:{
+            WGPURenderBundleEncoder encoder = (WGPURenderBundleEncoder)rd_object(r);
+            const BindGroupOffsets bg = rd_bindGroupOffsets(r);
+            wgpuRenderBundleEncoderSetBindGroup(encoder, bg.groupIndex, bg.group, bg.count, bg.offsets);
+        }break;
+        case WGVKCaptureOp_RenderBundleSetVertexBuffer:{
+            WGPURenderBundleEncoder encoder = (WGPURenderBundleEncoder)rd_object(r);
+            const uint32_t slot = rd_u32(r);
+            WGPUBuffer buffer = (WGPUBuffer)rd_object(r);
+            const uint64_t offset = rd_u64(r);
+            const uint64_t size = rd_u64(r);
+            wgpuRenderBundleEncoderSetVertexBuffer(encoder, slot, buffer, offset, size);
+        }break;
+        case WGVKCaptureOp_RenderBundleSetIndexBuffer:{
+            WGPURenderBundleEncoder encoder = (WGPURenderBundleEncoder)rd_object(r);
+            WGPUBuffer buffer = (WGPUBuffer)rd_object(r);
+            const WGPUIndexFormat format = (WGPUIndexFormat)rd_u32(r);
+            const uint64_t offset = rd_u64(r);
+            const uint64_t size = rd_u64(r);
+            wgpuRenderBundleEncoderSetIndexBuffer(encoder, buffer, format, offset, size);
+        }break;
+        case WGVKCaptureOp_RenderBundleDraw:{
+            WGPURenderBundleEncoder encoder = (WGPURenderBundleEncoder)rd_object(r);
+            uint32_t v[4];
+            for(uint32_t i = 0;i < 4;i++){
+                v[i] = rd_u32(r);
+            }
+            wgpuRenderBundleEncoderDraw(encoder, v[0], v[1], v[2], v[3]);
+        }break;
+        case WGVKCaptureOp_RenderBundleDrawIndexed:{
+            WGPURenderBundleEncoder encoder = (WGPURenderBundleEncoder)rd_object(r);
+            const uint32_t indexCount = rd_u32(r);
+            const uint32_t instanceCount = rd_u32(r);
+            const uint32_t firstIndex = rd_u32(r);
+            const int32_t baseVertex = rd_i32(r);
+            const uint32_t firstInstance = rd_u32(r);
+            wgpuRenderBundleEncoderDrawIndexed(encoder, indexCount, instanceCount, firstIndex, baseVertex, firstInstance);
+        }break;
+        case WGVKCaptureOp_RenderBundleDrawIndirect:{
+            WGPURenderBundleEncoder encoder = (WGPURenderBundleEncoder)rd_object(r);
+            WGPUBuffer buffer = (WGPUBuffer)rd_object(r);
+            wgpuRenderBundleEncoderDrawIndirect(encoder, buffer, rd_u64(r));
+        }break;
+        case WGVKCaptureOp_RenderBundleDrawIndexedIndirect:{
+            WGPURenderBundleEncoder encoder = (WGPURenderBundleEncoder)rd_object(r);
+            WGPUBuffer buffer = (WGPUBuffer)rd_object(r);
+            wgpuRenderBundleEncoderDrawIndexedIndirect(encoder, buffer, rd_u64(r));
+        }break;
+        case WGVKCaptureOp_RenderBundleMultiDrawIndirect:{
+            WGPURenderBundleEncoder encoder = (WGPURenderBundleEncoder)rd_object(r);
+            const MultiDraw md = rd_multiDraw(r);
+            wgpuRenderBundleEncoderMultiDrawIndirect(encoder, md.indirectBuffer, md.indirectOffset, md.maxDrawCount, md.drawCountBuffer, md.drawCountBufferOffset);
+        }break;
+        case WGVKCaptureOp_RenderBundleMultiDrawIndexedIndirect:{
+            WGPURenderBundleEncoder encoder = (WGPURenderBundleEncoder)rd_object(r);
+            const MultiDraw md = rd_multiDraw(r);
+            wgpuRenderBundleEncoderMultiDrawIndexedIndirect(encoder, md.indirectBuffer, md.indirectOffset, md.maxDrawCount, md.drawCountBuffer, md.drawCountBufferOffset);
+        }break;
+        case WGVKCaptureOp_RenderBundleFinish:{
+            WGPURenderBundleEncoder encoder = (WGPURenderBundleEncoder)rd_object(r);
+            const uint64_t id = rd_u64(r);
+            setObject(id, wgpuRenderBundleEncoderFinish(encoder, NULL));
+        }break;
+
+        case WGVKCaptureOp_SurfaceConfigure:{
+            ReplaySurface* surface = rd_surface(r);
+            WGPUTextureDescriptor desc = {0};
+            desc.format = (WGPUTextureFormat)rd_u32(r);
+            desc.usage = (WGPUTextureUsage)rd_u64(r) | WGPUTextureUsage_RenderAttachment;
+            desc.size.width = rd_u32(r);
+            desc.size.height = rd_u32(r);
+            desc.size.depthOrArrayLayers = 1;
+            desc.dimension = WGPUTextureDimension_2D;
+            desc.mipLevelCount = 1;
+            desc.sampleCount = 1;
+            desc.viewFormatCount = rd_u32(r);
+            WGPUTextureFormat* viewFormats = (WGPUTextureFormat*)scratchAlloc(desc.viewFormatCount * sizeof(WGPUTextureFormat));
+            for(size_t i = 0;i < desc.viewFormatCount;i++){
+                viewFormats[i] = (WGPUTextureFormat)rd_u32(r);
+            }
+            desc.viewFormats = viewFormats;
+            if(r->overflow){
+                break;
+            }
+            if(surface->texture){
+                wgpuTextureRelease(surface->texture);
+            }
+            surface->texture = wgpuDeviceCreateTexture(replay.device, &desc);
+        }break;
+        case WGVKCaptureOp_SurfaceGetCurrentTexture:{
+            ReplaySurface* surface = rd_surface(r);
+            const uint64_t id = rd_u64(r);
+            // The application releases what it acquired
+            if(surface->texture){
+                wgpuTextureAddRef(surface->texture);
+            }
+            setObject(id, surface->texture);
+        }break;
+        case WGVKCaptureOp_SurfacePresent:{
+            (void)rd_surface(r);
+            const uint64_t timestamp = rd_u64(r);
+            wgpuDeviceTick(replay.device);
+            frameEnd(frames, timestamp);
+        }break;
+        case WGVKCaptureOp_DeviceTick:{
+            rd_device(r);
+            const uint64_t timestamp = rd_u64(r);
+            wgpuDeviceTick(replay.device);
+            frameEnd(frames, timestamp);
+        }break;
+        default:
+            fprintf(stderr, "Unknown op %u\n", (unsigned)op);
+            return false;
+    }
+    if(r->overflow){
+        fprintf(stderr, "Truncated record for op %u\n", (unsigned)op);
+        return false;
+    }
+    return true;
+}
+
+static int compareDoubles(const void* a, const void* b){
+    const double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static void printSummary(const char* unit, const FrameTimes* times){
+    double* sorted = (double*)malloc(times->count * sizeof(double));
+    memcpy(sorted, times->replayMs, times->count * sizeof(double));
+    qsort(sorted, times->count, sizeof(double), compareDoubles);
+    double total = 0, capturedTotal = 0;
+    for(size_t i = 0;i < times->count;i++){
+        total += times->replayMs[i];
+        capturedTotal += times->capturedMs[i];
+    }
+    printf("%zu %ss, replay %.3f ms total\n", times->count, unit, total);
+    printf("  replay   avg %.3f ms, median %.3f ms, min %.3f ms, max %.3f ms\n",
+        total / times->count, sorted[times->count / 2], sorted[0], sorted[times->count - 1]);
+    printf("  captured avg %.3f ms\n", capturedTotal / times->count);
+    free(sorted);
+}
+
+void adapterCallbackFunction(WGPURequestAdapterStatus status, WGPUAdapter adapter, WGPUStringView label, void* userdata1, void* userdata2){
+    *((WGPUAdapter*)userdata1) = adapter;
+}
+void deviceCallbackFunction(WGPURequestDeviceStatus status, WGPUDevice device, WGPUStringView message, void* userdata1, void* userdata2){
+    *((WGPUDevice*)userdata1) = device;
+}
+void errorCallbackFunction(const WGPUDevice* device, WGPUErrorType type, WGPUStringView message, void* userdata1, void* userdata2){
+    fprintf(stderr, "Device error: %.*s\n", (int)message.length, message.data);
+}
+
+int main(int argc, char** argv){
+    const char* tracePath = NULL;
+    const char* csvPath = NULL;
+    bool quiet = false;
+    bool forceFallbackAdapter = true;
+    for(int i = 1;i < argc;i++){
+        if(strcmp(argv[i], "--gpu") == 0){
+            forceFallbackAdapter = false;
+        }
+        else if(strcmp(argv[i], "--quiet") == 0){
+            quiet = true;
+        }
+        else if(strcmp(argv[i], "--csv") == 0 && i + 1 < argc){
+            csvPath = argv[++i];
+        }
+        else{
+            tracePath = argv[i];
+        }
+    }
+    if(tracePath == NULL){
+        fprintf(stderr, "Usage: %s [--gpu] [--quiet] [--csv <file>] <trace>\n", argv[0]);
+        return 2;
+    }
+    FILE* trace = fopen(tracePath, "rb");
+    if(trace == NULL){
+        fprintf(stderr, "Could not open %s\n", tracePath);
+        return 1;
+    }
+    WGVKCaptureHeader header = {0};
+    if(fread(&header, sizeof(header), 1, trace) != 1 || memcmp(header.magic, WGVK_CAPTURE_MAGIC, sizeof(WGVK_CAPTURE_MAGIC)) != 0){
+        fprintf(stderr, "%s is not a wgvk trace\n", tracePath);
+        return 1;
+    }
+    if(header.version != WGVK_CAPTURE_VERSION){
+        fprintf(stderr, "Trace version %u, this replayer reads version %u\n", header.version, WGVK_CAPTURE_VERSION);
+        return 1;
+    }
+
+    WGPUInstanceFeatureName instanceFeatures[1] = {
+        WGPUInstanceFeatureName_TimedWaitAny,
+    };
+    WGPUInstanceDescriptor instanceDescriptor = {
+        .requiredFeatures = instanceFeatures,
+        .requiredFeatureCount = 1,
+    };
+    WGPUInstance instance = wgpuCreateInstance(&instanceDescriptor);
+    WGPURequestAdapterOptions adapterOptions = {
+        .featureLevel = WGPUFeatureLevel_Core,
+        .forceFallbackAdapter = forceFallbackAdapter,
+    };
+    WGPUAdapter adapter = NULL;
+    WGPUFutureWaitInfo adapterWaitInfo = {
+        .future = wgpuInstanceRequestAdapter(instance, &adapterOptions, (WGPURequestAdapterCallbackInfo){
+            .callback = adapterCallbackFunction,
+            .userdata1 = &adapter,
+        }),
+    };
+    wgpuInstanceWaitAny(instance, 1, &adapterWaitInfo, ~0ull);
+    if(adapter == NULL){
+        fprintf(stderr, "No adapter\n");
+        return 1;
+    }
+    WGPUDeviceDescriptor deviceDescriptor = {
+        .label = STRVIEW("Replay device"),
+        .uncapturedErrorCallbackInfo.callback = errorCallbackFunction,
+    };
+    WGPUFutureWaitInfo deviceWaitInfo = {
+        .future = wgpuAdapterRequestDevice(adapter, &deviceDescriptor, (WGPURequestDeviceCallbackInfo){
+            .callback = deviceCallbackFunction,
+            .mode = WGPUCallbackMode_WaitAnyOnly,
+            .userdata1 = &replay.device,
+        }),
+    };
+    wgpuInstanceWaitAny(instance, 1, &deviceWaitInfo, ~0ull);
+    if(replay.device == NULL){
+        fprintf(stderr, "No device\n");
+        return 1;
+    }
+    replay.queue = wgpuDeviceGetQueue(replay.device);
+
+    FrameTimes frames = {0}, submits = {0};
+    frames.replayStart = submits.replayStart = nanoTime();
+    uint8_t* payload = NULL;
+    size_t payloadCapacity = 0;
+    uint64_t recordCount = 0;
+    bool ok = true;
+    for(;;){
+        uint32_t recordHeader[2];
+        if(fread(recordHeader, sizeof(recordHeader), 1, trace) != 1){
+            break;
+        }
+        if(recordHeader[1] > payloadCapacity){
+            payloadCapacity = recordHeader[1];
+            payload = (uint8_t*)realloc(payload, payloadCapacity);
+        }
+        if(recordHeader[1] && fread(payload, recordHeader[1], 1, trace) != 1){
+            fprintf(stderr, "Trace ends inside record %llu\n", (unsigned long long)recordCount);
+            break;
+        }
+        Reader reader = {.data = payload, .size = recordHeader[1]};
+        ok = replayRecord((WGVKCaptureOp)recordHeader[0], &reader, &frames, &submits);
+        scratchReset();
+        ++recordCount;
+        if(!ok){
+            break;
+        }
+    }
+    wgpuQueueWaitIdle(replay.queue);
+    fclose(trace);
+
+    // Applications that never present or tick are timed per submit
+    const FrameTimes* times = frames.count ? &frames : &submits;
+    const char* unit = frames.count ? "frame" : "submit";
+    printf("Replayed %llu records\n", (unsigned long long)recordCount);
+    if(!quiet){
+        for(size_t i = 0;i < times->count;i++){
+            printf("%s %zu: replay %.3f ms, captured %.3f ms\n", unit, i, times->replayMs[i], times->capturedMs[i]);
+        }
+    }
+    if(times->count){
+        printSummary(unit, times);
+    }
+    if(csvPath){
+        FILE* csv = fopen(csvPath, "w");
+        if(csv){
+            fprintf(csv, "%s,replay_ms,captured_ms\n", unit);
+            for(size_t i = 0;i < times->count;i++){
+                fprintf(csv, "%zu,%.6f,%.6f\n", i, times->replayMs[i], times->capturedMs[i]);
+            }
+            fclose(csv);
+        }
+    }
+    return ok ? 0 : 1;
+}